@@ -0,0 +1,25 @@
+#!/usr/bin/env sh
+# Builds the standalone benchmarks into build/. They need no GL or vcpkg dependencies.
+set -eu
+
+mkdir -p build
+
+CC="${CC:-cc}"
+CFLAGS="-std=c99 -D_GNU_SOURCE -Wall -Wextra -O2 -Isrc"
+
+# Everything but the window, renderer and callbacks
+ENGINE_SRC="src/soundboard.c src/audio.c src/audio_sink.c src/bounce.c src/convert.c src/decoder.c
+  src/header_reader.c src/library_config.c src/library_index.c src/loudness.c src/loudness_cache.c
+  src/mixer.c src/onset.c src/path_trie.c src/pcm_buffer.c src/pcm_cache.c src/process.c
+  src/scanner.c src/search_index.c src/sidecar_cache.c src/spsc_ring.c src/stream.c src/thread.c
+  src/wav.c src/watcher.c src/waveform.c src/waveform_cache.c src/worker_pool.c src/xxhash.c"
+
+set -x
+${CC} ${CFLAGS} -o build/bench_convert bench/bench_convert.c src/convert.c src/thread.c -lm -pthread
+${CC} ${CFLAGS} -o build/bench_latency bench/bench_latency.c ${ENGINE_SRC} -lm -pthread -ldl
+${CC} ${CFLAGS} -o build/bench_scan bench/bench_scan.c src/scanner.c src/library_config.c \
+  src/decoder.c src/convert.c src/wav.c src/thread.c -lm -pthread -ldl
+${CC} ${CFLAGS} -o build/bench_search bench/bench_search.c src/search_index.c src/thread.c -pthread
+set +x
+
+echo "Benchmarks built: build/bench_convert build/bench_latency build/bench_scan build/bench_search"
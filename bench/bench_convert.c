@@ -0,0 +1,102 @@
+// Throughput of the sample-format and sample-rate conversion stage, SIMD vs scalar.
+// Build with bench/bench.sh and run build/bench_convert
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "convert.h"
+#include "thread.h"
+
+#define BENCH_SAMPLES (1u << 20)
+#define BENCH_ROUNDS 20
+
+static const char* format_names[] = {"u8", "s16", "s24", "s32", "f32"};
+
+static double bench_to_f32(SampleFormat format, const unsigned char* raw, float* out) {
+  uint64_t start = time_ns();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    convert_to_f32(out, raw, format, BENCH_SAMPLES);
+  uint64_t elapsed = time_ns() - start;
+  return (double)BENCH_SAMPLES * BENCH_ROUNDS / ((double)elapsed / 1e9);
+}
+
+static double bench_to_s16(const float* in, int16_t* out) {
+  uint64_t start = time_ns();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    convert_f32_to_s16(out, in, BENCH_SAMPLES);
+  uint64_t elapsed = time_ns() - start;
+  return (double)BENCH_SAMPLES * BENCH_ROUNDS / ((double)elapsed / 1e9);
+}
+
+// Returns input frames per second, fed in decode-sized chunks
+static double bench_resample(uint32_t in_rate, const float* in, float* out) {
+  const uint32_t chunk = 4096;
+  const uint32_t frames = BENCH_SAMPLES / 2;
+  Resampler* resampler = resampler_create(in_rate, 48000);
+  if (!resampler)
+    return 0.0;
+
+  uint32_t capacity = resampler_max_output(resampler, chunk);
+  uint64_t start = time_ns();
+  for (int r = 0; r < BENCH_ROUNDS / 4; r++) {
+    for (uint32_t i = 0; i < frames; i += chunk)
+      resampler_process(resampler, in + (size_t)i * 2, chunk, out, capacity);
+  }
+  uint64_t elapsed = time_ns() - start;
+  resampler_destroy(resampler);
+  return (double)frames * (BENCH_ROUNDS / 4) / ((double)elapsed / 1e9);
+}
+
+int main(void) {
+  unsigned char* raw = (unsigned char*)malloc((size_t)BENCH_SAMPLES * 4);
+  float* floats = (float*)malloc((size_t)BENCH_SAMPLES * sizeof(float));
+  float* out = (float*)malloc((size_t)BENCH_SAMPLES * 2 * sizeof(float));
+  int16_t* s16 = (int16_t*)malloc((size_t)BENCH_SAMPLES * sizeof(int16_t));
+  if (!raw || !floats || !out || !s16) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  srand(1);
+  for (uint32_t i = 0; i < BENCH_SAMPLES * 4; i++)
+    raw[i] = (unsigned char)rand();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+    floats[i] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+
+  printf("%-16s %14s %14s %8s\n", "path", "simd Msamp/s", "scalar Msamp/s", "speedup");
+  for (int f = SAMPLE_U8; f <= SAMPLE_F32; f++) {
+    convert_force_scalar(0);
+    double simd = bench_to_f32((SampleFormat)f, raw, out);
+    convert_force_scalar(1);
+    double scalar = bench_to_f32((SampleFormat)f, raw, out);
+    char name[32];
+    snprintf(name, sizeof(name), "%s -> f32", format_names[f]);
+    printf("%-16s %14.1f %14.1f %7.2fx\n", name, simd / 1e6, scalar / 1e6, simd / scalar);
+  }
+
+  convert_force_scalar(0);
+  double simd = bench_to_s16(floats, s16);
+  convert_force_scalar(1);
+  double scalar = bench_to_s16(floats, s16);
+  printf("%-16s %14.1f %14.1f %7.2fx\n", "f32 -> s16", simd / 1e6, scalar / 1e6, simd / scalar);
+
+  const uint32_t rates[] = {44100, 96000};
+  for (int i = 0; i < 2; i++) {
+    convert_force_scalar(0);
+    simd = bench_resample(rates[i], floats, out);
+    convert_force_scalar(1);
+    scalar = bench_resample(rates[i], floats, out);
+    char name[32];
+    snprintf(name, sizeof(name), "resample %u", rates[i]);
+    // Frames are stereo, so report samples like the other rows
+    printf("%-16s %14.1f %14.1f %7.2fx\n", name, simd * 2 / 1e6, scalar * 2 / 1e6,
+           simd / scalar);
+  }
+
+  convert_force_scalar(0);
+  printf("kernels: %s\n", convert_kernel_name());
+  free(raw);
+  free(floats);
+  free(out);
+  free(s16);
+  return 0;
+}
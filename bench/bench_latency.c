@@ -0,0 +1,325 @@
+// Click-to-first-sample latency. Synthetic clicks go through the same hit test and play_sound()
+// as mouse_button_callback; each stage is timed up to the first non-silent buffer the engine hands
+// its sink, for every backend that opens here and every legacy player on PATH.
+// Build with bench/bench.sh and run build/bench_latency [clicks]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+#include "audio_sink.h"
+#include "process.h"
+#include "soundboard.h"
+#include "thread.h"
+
+#define BENCH_TILES 12
+#define BENCH_SOUND_FRAMES (AUDIO_SAMPLE_RATE / 4)
+#define BENCH_FIRST_SAMPLE_TIMEOUT_NS 500000000ULL
+#define BENCH_MAX_SPAWN_CLICKS 50  // Each spawned player is started and killed; keep it short
+
+// Passes everything on to a real sink, noting when the first non-silent buffer went out after
+// being armed
+typedef struct {
+  AudioSink base;
+  AudioSink* inner;
+  int armed;
+  uint64_t first_ns;
+} LoopbackSink;
+
+static int loopback_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  LoopbackSink* sink = (LoopbackSink*)base;
+  if (__atomic_load_n(&sink->armed, __ATOMIC_ACQUIRE)) {
+    for (uint32_t i = 0; i < frames * base->channels; i++) {
+      if (samples[i] != 0) {
+        __atomic_store_n(&sink->first_ns, time_ns(), __ATOMIC_RELEASE);
+        __atomic_store_n(&sink->armed, 0, __ATOMIC_RELEASE);
+        break;
+      }
+    }
+  }
+  int result = audio_sink_write(sink->inner, samples, frames);
+  base->underruns = sink->inner->underruns;
+  return result;
+}
+
+static void loopback_close(AudioSink* base) {
+  LoopbackSink* sink = (LoopbackSink*)base;
+  audio_sink_close(sink->inner);
+  free(sink);
+}
+
+static LoopbackSink* loopback_open(const char* spec) {
+  AudioSink* inner = audio_sink_open(spec, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS);
+  LoopbackSink* sink = inner ? (LoopbackSink*)calloc(1, sizeof(LoopbackSink)) : NULL;
+  if (!sink) {
+    audio_sink_close(inner);
+    return NULL;
+  }
+  sink->base = *inner;
+  sink->base.write = loopback_write;
+  sink->base.close = loopback_close;
+  sink->inner = inner;
+  return sink;
+}
+
+// A quarter second of noise that is loud from its very first frame
+static int write_test_sound(const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    return 0;
+
+  uint32_t data_bytes = BENCH_SOUND_FRAMES * AUDIO_CHANNELS * sizeof(int16_t);
+  unsigned char header[44] = {0};
+  uint32_t fields[] = {36 + data_bytes, 16, AUDIO_SAMPLE_RATE, AUDIO_SAMPLE_RATE * 4, data_bytes};
+  memcpy(header, "RIFF", 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  memcpy(header + 36, "data", 4);
+  const int offsets[] = {4, 16, 24, 28, 40};
+  for (int f = 0; f < 5; f++) {
+    for (int b = 0; b < 4; b++)
+      header[offsets[f] + b] = (unsigned char)(fields[f] >> (8 * b));
+  }
+  header[20] = 1;  // PCM
+  header[22] = AUDIO_CHANNELS;
+  header[32] = AUDIO_CHANNELS * 2;  // Block align
+  header[34] = 16;  // Bits per sample
+  fwrite(header, 1, sizeof(header), file);
+
+  srand(1);
+  for (uint32_t i = 0; i < BENCH_SOUND_FRAMES * AUDIO_CHANNELS; i++) {
+    int16_t sample = (int16_t)(rand() % 16000 - 8000);
+    if (sample == 0 || i < AUDIO_CHANNELS)
+      sample = 8000;
+    unsigned char bytes[2] = {
+        (unsigned char)(sample & 0xFF), (unsigned char)(((uint16_t)sample >> 8) & 0xFF)};
+    fwrite(bytes, 1, 2, file);
+  }
+  return fclose(file) == 0;
+}
+
+// Every tile plays the same file. The board is never handed to close_library(); its trie lives
+// until the process exits
+static void setup_board(Soundboard* sb, const char* sound_path) {
+  static Tile tiles[BENCH_TILES];
+  static Sound sounds[BENCH_TILES];
+  static PathTrie* paths;
+  memset(sb, 0, sizeof(*sb));
+  sb->window_width = 800.0f;
+  sb->window_height = 600.0f;
+  sb->grid_cols = (int)((sb->window_width - 50.0f) / (TILE_WIDTH + TILE_SPACING));
+  if (!paths)
+    paths = path_trie_create();
+  sb->tiles = tiles;
+  sb->sounds = sounds;
+  sb->paths = paths;
+  sb->count = BENCH_TILES;
+  sb->shown_count = BENCH_TILES;
+  sb->hovered_tile = -1;
+  for (int i = 0; i < BENCH_TILES; i++) {
+    tiles[i].slot = -1;
+    tiles[i].marquee_offset = 0.0f;
+    path_trie_add(paths, sound_path, (uint32_t)i, &sounds[i].dir, &sounds[i].leaf);
+    sounds[i].audio_tile = i;
+    sounds[i].start_ms = -1;
+    sounds[i].duration_ms = 0;
+  }
+  for (int i = 0; i < MAX_PLAYING; i++)
+    sb->playing[i].tile = -1;
+#ifndef _WIN32
+  sb->external_player = -1;
+#endif
+}
+
+// Window position of a tile's centre, laid out as main.c draws it
+static void tile_center(const Soundboard* sb, int tile, double* x, double* y) {
+  int row = tile / sb->grid_cols;
+  int col = tile % sb->grid_cols;
+  *x = 50.0f + col * (TILE_WIDTH + TILE_SPACING) + TILE_WIDTH / 2.0f;
+  *y = sb->window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) + TILE_HEIGHT / 2.0f;
+}
+
+typedef struct {
+  uint64_t* hit_test;
+  uint64_t* play_sound;  // Returns once the engine has the command, or the player is spawned
+  uint64_t* first_sample;  // Click to the first non-silent buffer written to the sink
+  int count;
+  int missed;  // Clicks whose sound never reached the sink in time
+} Samples;
+
+static int compare_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static void print_stage(const char* backend, const char* stage, uint64_t* values, int count) {
+  if (count == 0) {
+    printf("%-10s %-22s %10s %10s %10s %10s\n", backend, stage, "n/a", "n/a", "n/a", "n/a");
+    return;
+  }
+  qsort(values, (size_t)count, sizeof(uint64_t), compare_u64);
+  printf(
+      "%-10s %-22s %10.1f %10.1f %10.1f %10.1f\n",
+      backend,
+      stage,
+      (double)values[(count - 1) / 2] / 1000.0,
+      (double)values[(int)((count - 1) * 0.95)] / 1000.0,
+      (double)values[(int)((count - 1) * 0.99)] / 1000.0,
+      (double)values[count - 1] / 1000.0);
+}
+
+static void print_samples(const char* backend, Samples* samples, int has_sink) {
+  print_stage(backend, "hit test", samples->hit_test, samples->count);
+  print_stage(
+      backend,
+      has_sink ? "play_sound (enqueue)" : "play_sound (spawn)",
+      samples->play_sound,
+      samples->count);
+  print_stage(
+      backend,
+      "click -> first sample",
+      samples->first_sample,
+      has_sink ? samples->count - samples->missed : 0);
+  if (samples->missed > 0)
+    printf("%-10s %d clicks never reached the sink\n", backend, samples->missed);
+}
+
+// One synthetic click on a random tile. With a loopback sink, waits for the sound to come out
+static void click(Soundboard* sb, LoopbackSink* sink, Samples* samples) {
+  double x, y;
+  tile_center(sb, rand() % sb->count, &x, &y);
+  if (sink) {
+    __atomic_store_n(&sink->first_ns, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&sink->armed, 1, __ATOMIC_RELEASE);
+  }
+
+  uint64_t clicked = time_ns();
+  int tile = tile_at(sb, x, y);
+  uint64_t hit = time_ns();
+  if (tile >= 0)
+    play_sound(sound_path(sb, tile), sb, tile);
+  uint64_t played = time_ns();
+
+  int n = samples->count++;
+  samples->hit_test[n] = hit - clicked;
+  samples->play_sound[n] = played - hit;
+  if (sink) {
+    uint64_t first = 0;
+    while ((first = __atomic_load_n(&sink->first_ns, __ATOMIC_ACQUIRE)) == 0 &&
+           time_ns() - clicked < BENCH_FIRST_SAMPLE_TIMEOUT_NS)
+      sleep_ns(20000ULL);
+    __atomic_store_n(&sink->armed, 0, __ATOMIC_RELEASE);
+    if (first)
+      samples->first_sample[n - samples->missed] = first - clicked;
+    else
+      samples->missed++;
+  }
+
+  // Silence the tile and let a couple of periods of silence go out, then land the next click at
+  // a random point in the period
+  if (tile >= 0)
+    stop_tile(sb, tile);
+  sleep_ns(15000000ULL + (uint64_t)(rand() % 5333) * 1000ULL);
+  update_playback(sb);
+}
+
+static int alloc_samples(Samples* samples, int clicks) {
+  memset(samples, 0, sizeof(*samples));
+  samples->hit_test = (uint64_t*)malloc((size_t)clicks * sizeof(uint64_t));
+  samples->play_sound = (uint64_t*)malloc((size_t)clicks * sizeof(uint64_t));
+  samples->first_sample = (uint64_t*)malloc((size_t)clicks * sizeof(uint64_t));
+  return samples->hit_test && samples->play_sound && samples->first_sample;
+}
+
+static void free_samples(Samples* samples) {
+  free(samples->hit_test);
+  free(samples->play_sound);
+  free(samples->first_sample);
+}
+
+static void bench_engine(const char* spec, const char* sound_path, int clicks) {
+  LoopbackSink* sink = loopback_open(spec);
+  if (!sink) {
+    printf("%-10s not available\n", spec);
+    return;
+  }
+
+  static Soundboard sb;
+  setup_board(&sb, sound_path);
+  sb.audio = audio_engine_create_on_sink(&sink->base);
+  sb.pcm_cache = pcm_cache_create(64ULL * 1024ULL * 1024ULL);
+  Samples samples;
+  if (!sb.audio || !sb.pcm_cache || !alloc_samples(&samples, clicks + 1)) {
+    fprintf(stderr, "Failed to start the engine on %s\n", spec);
+    audio_engine_destroy(sb.audio);
+    pcm_cache_destroy(sb.pcm_cache);
+    return;
+  }
+
+  // The first click decodes the sound; report it apart from the warm ones
+  click(&sb, sink, &samples);
+  if (samples.missed == 0)
+    printf("%-10s cold first click: %.1f us\n", spec, (double)samples.first_sample[0] / 1000.0);
+  samples.count = 0;
+  samples.missed = 0;
+  for (int i = 0; i < clicks; i++)
+    click(&sb, sink, &samples);
+  print_samples(spec, &samples, 1);
+
+  free_samples(&samples);
+  audio_engine_destroy(sb.audio);
+  pcm_cache_destroy(sb.pcm_cache);
+}
+
+#ifndef _WIN32
+static void bench_external(int player, const char* sound_path, int clicks) {
+  const char* name = external_player_name(player);
+  if (!program_on_path(name)) {
+    printf("%-10s not installed\n", name);
+    return;
+  }
+
+  static Soundboard sb;
+  setup_board(&sb, sound_path);
+  sb.external_player = player;
+  Samples samples;
+  if (clicks > BENCH_MAX_SPAWN_CLICKS)
+    clicks = BENCH_MAX_SPAWN_CLICKS;
+  if (!alloc_samples(&samples, clicks))
+    return;
+  for (int i = 0; i < clicks; i++)
+    click(&sb, NULL, &samples);
+
+  // The player writes to its own device, so nothing here sees its first sample
+  print_samples(name, &samples, 0);
+  free_samples(&samples);
+  shutdown_audio(&sb);
+}
+#endif
+
+int main(int argc, char** argv) {
+  int clicks = argc > 1 ? atoi(argv[1]) : 200;
+  if (clicks < 1)
+    clicks = 1;
+
+  char sound_path[4096];
+  const char* tmp = getenv("TMPDIR");
+  snprintf(sound_path, sizeof(sound_path), "%s/soundboard-bench-click.wav", tmp ? tmp : "/tmp");
+  if (!write_test_sound(sound_path)) {
+    fprintf(stderr, "Failed to write %s\n", sound_path);
+    return 1;
+  }
+
+  printf("%d clicks per backend, latencies in microseconds\n", clicks);
+  printf("%-10s %-22s %10s %10s %10s %10s\n", "backend", "stage", "p50", "p95", "p99", "max");
+  static const char* const engine_backends[] = {"null", "pulse", "alsa", "pipe", "winmm"};
+  for (int i = 0; i < (int)(sizeof(engine_backends) / sizeof(engine_backends[0])); i++)
+    bench_engine(engine_backends[i], sound_path, clicks);
+#ifndef _WIN32
+  for (int i = 0; external_player_name(i); i++)
+    bench_external(i, sound_path, clicks);
+#endif
+
+  remove(sound_path);
+  return 0;
+}
@@ -0,0 +1,158 @@
+// Library scan time: the original single-threaded snprintf + stat() walk against the parallel
+// scanner at several thread counts. Builds a synthetic tree of 100k files (1000 directories of
+// 100) under $TMPDIR and removes it afterwards, or scans an existing directory given as argument.
+// Build with bench/bench.sh and run build/bench_scan [directory]
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "decoder.h"
+#include "scanner.h"
+#include "thread.h"
+
+#define BENCH_FANOUT 10  // Three levels of 10 directories
+#define BENCH_FILES_PER_DIR 100  // Of which one in ten isn't a sound
+#define BENCH_ROUNDS 3
+
+// The walk load_sounds() used before, without its 100-sound cap
+static void legacy_walk(const char* base_path, uint32_t* count) {
+  DIR* dir = opendir(base_path);
+  if (!dir)
+    return;
+
+  struct dirent* entry;
+  char path[4096];
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", base_path, entry->d_name);
+    struct stat s;
+    if (stat(path, &s) != 0)
+      continue;
+    if (S_ISDIR(s.st_mode)) {
+      legacy_walk(path, count);
+    } else if (S_ISREG(s.st_mode)) {
+      const char* ext = strrchr(entry->d_name, '.');
+      if (ext && decoder_handles_extension(ext))
+        (*count)++;
+    }
+  }
+  closedir(dir);
+}
+
+static int make_tree(const char* root) {
+  char path[4096];
+  if (mkdir(root, 0755) != 0)
+    return 0;
+  for (int a = 0; a < BENCH_FANOUT; a++) {
+    for (int b = 0; b < BENCH_FANOUT; b++) {
+      for (int c = 0; c < BENCH_FANOUT; c++) {
+        // Fail rather than write files under a cut-off path if TMPDIR is very long
+        if (snprintf(path, sizeof(path), "%s/kit%02d", root, a) >= (int)sizeof(path))
+          return 0;
+        mkdir(path, 0755);
+        if (snprintf(path, sizeof(path), "%s/kit%02d/bank%02d", root, a, b) >= (int)sizeof(path))
+          return 0;
+        mkdir(path, 0755);
+        int length = snprintf(path, sizeof(path), "%s/kit%02d/bank%02d/take%02d", root, a, b, c);
+        if (length >= (int)sizeof(path) || mkdir(path, 0755) != 0)
+          return 0;
+        for (int f = 0; f < BENCH_FILES_PER_DIR; f++) {
+          char file[4096];
+          const char* ext = f % 10 == 9 ? "txt" : "wav";
+          if (snprintf(file, sizeof(file), "%s/hit%03d.%s", path, f, ext) >= (int)sizeof(file))
+            return 0;
+          FILE* out = fopen(file, "wb");
+          if (!out)
+            return 0;
+          fclose(out);
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static void remove_tree(const char* path) {
+  DIR* dir = opendir(path);
+  if (dir) {
+    struct dirent* entry;
+    char child[4096];
+    while ((entry = readdir(dir)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        continue;
+      snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+      struct stat s;
+      if (lstat(child, &s) == 0 && S_ISDIR(s.st_mode))
+        remove_tree(child);
+      else
+        unlink(child);
+    }
+    closedir(dir);
+  }
+  rmdir(path);
+}
+
+int main(int argc, char** argv) {
+  char root[4096];
+  int synthetic = argc < 2;
+  if (synthetic) {
+    const char* tmp = getenv("TMPDIR");
+    snprintf(root, sizeof(root), "%s/soundboard-bench-tree-%d", tmp ? tmp : "/tmp", (int)getpid());
+    int files = BENCH_FANOUT * BENCH_FANOUT * BENCH_FANOUT * BENCH_FILES_PER_DIR;
+    printf("Building %d files under %s...\n", files, root);
+    if (!make_tree(root)) {
+      fprintf(stderr, "Failed to build the tree\n");
+      remove_tree(root);
+      return 1;
+    }
+  } else {
+    snprintf(root, sizeof(root), "%s", argv[1]);
+  }
+
+  printf("%u CPUs; best of %d warm-cache rounds\n", cpu_count(), BENCH_ROUNDS);
+  printf("%-24s %10s %10s %10s\n", "scanner", "ms", "sounds", "stats");
+
+  uint64_t best = UINT64_MAX;
+  uint32_t count = 0;
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    count = 0;
+    uint64_t start = time_ns();
+    legacy_walk(root, &count);
+    uint64_t elapsed = time_ns() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  printf("%-24s %10.1f %10u %10s\n", "legacy (stat per entry)", (double)best / 1e6, count, "all");
+
+  // The whole tree, as the default root takes it
+  LibraryRoot scan_root = {root, -1, NULL, 0, NULL, 0};
+  static const uint32_t thread_counts[] = {1, 2, 4, 8, 16};
+  for (int t = 0; t < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); t++) {
+    best = UINT64_MAX;
+    ScanResult result;
+    memset(&result, 0, sizeof(result));
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+      scan_result_free(&result);
+      uint64_t start = time_ns();
+      scan_library(&scan_root, NULL, thread_counts[t], &result);
+      uint64_t elapsed = time_ns() - start;
+      best = elapsed < best ? elapsed : best;
+    }
+    char name[32];
+    snprintf(
+        name,
+        sizeof(name),
+        "parallel, %u thread%s",
+        thread_counts[t],
+        thread_counts[t] == 1 ? "" : "s");
+    printf("%-24s %10.1f %10u %10u\n", name, (double)best / 1e6, result.count, result.stats);
+    scan_result_free(&result);
+  }
+
+  if (synthetic)
+    remove_tree(root);
+  return 0;
+}
@@ -0,0 +1,166 @@
+// Search index build time, memory and query latency over a synthetic library of 100k sound
+// paths, against a plain case-insensitive scan of every path. Build with bench/bench.sh and run
+// build/bench_search [sounds]
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search_index.h"
+#include "thread.h"
+
+#define BENCH_SOUNDS 100000
+#define BENCH_ROUNDS 3
+#define BENCH_QUERY_REPEATS 200
+
+static const char* const categories[] = {
+    "Drums", "Foley", "Vocals", "FX", "Ambience", "Stingers", "Crowd", "Weapons"};
+static const char* const words[] = {
+    "kick",  "snare", "hihat", "crash",  "door",  "slam",    "laser", "zap",   "boom",
+    "whoosh", "riser", "impact", "sweep", "glitch", "laugh", "cheer", "boo",   "applause",
+    "scream", "growl", "rain",  "wind",   "thunder", "gun",  "reload", "click", "beep"};
+
+#define COUNT_OF(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+static char* make_path(int i) {
+  char path[256];
+  snprintf(
+      path,
+      sizeof(path),
+      "./Sample Library/%s/%s Pack %02d/%s_%s_%03d.wav",
+      categories[i % COUNT_OF(categories)],
+      words[(i / 7) % COUNT_OF(words)],
+      (i / 1000) % 100,
+      words[(i * 31 + 5) % COUNT_OF(words)],
+      words[(i * 17 + 3) % COUNT_OF(words)],
+      i % 1000);
+  size_t length = strlen(path) + 1;
+  char* copy = (char*)malloc(length);
+  if (copy)
+    memcpy(copy, path, length);
+  return copy;
+}
+
+// What the grid would do without an index: lowercase every path and strstr() each term
+static uint32_t linear_query(char* const* lowered, int count, const char* query, uint32_t* out) {
+  char terms[256];
+  snprintf(terms, sizeof(terms), "%s", query);
+  for (char* c = terms; *c; c++)
+    *c = (char)tolower((unsigned char)*c);
+  uint32_t found = 0;
+  for (int i = 0; i < count; i++) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", terms);
+    int match = 1;
+    for (char* term = strtok(copy, " "); term && match; term = strtok(NULL, " "))
+      match = strstr(lowered[i], term) != NULL;
+    if (match)
+      out[found++] = (uint32_t)i;
+  }
+  return found;
+}
+
+static int compare_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : BENCH_SOUNDS;
+  if (count < 1)
+    count = 1;
+  char** paths = (char**)malloc((size_t)count * sizeof(char*));
+  char** lowered = (char**)malloc((size_t)count * sizeof(char*));
+  uint32_t* expected = (uint32_t*)malloc((size_t)count * sizeof(uint32_t));
+  if (!paths || !lowered || !expected)
+    return 1;
+  size_t text_bytes = 0;
+  for (int i = 0; i < count; i++) {
+    paths[i] = make_path(i);
+    lowered[i] = make_path(i);
+    if (!paths[i] || !lowered[i])
+      return 1;
+    for (char* c = lowered[i]; *c; c++)
+      *c = (char)tolower((unsigned char)*c);
+    text_bytes += strlen(paths[i]) + 1;
+  }
+
+  uint64_t best = UINT64_MAX;
+  SearchIndex* index = NULL;
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    search_index_destroy(index);
+    uint64_t start = time_ns();
+    index = search_index_create();
+    for (int i = 0; i < count && index; i++) {
+      if (!search_index_add(index, paths[i])) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+      }
+    }
+    if (index)
+      search_index_shrink(index);
+    uint64_t elapsed = time_ns() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  printf(
+      "%d paths, %.1f MB of text: index built in %.1f ms (%.0f ns per path), %.1f MB\n",
+      count,
+      (double)text_bytes / 1048576.0,
+      (double)best / 1e6,
+      (double)best / count,
+      (double)search_index_memory(index) / 1048576.0);
+
+  static const char* const queries[] = {
+      "k", "ze", "zap", "laser", "Crowd cheer", "drums kick 042", "pack 07/boom", "thunderclap"};
+  printf("%-18s %8s %10s %10s %10s %12s\n", "query", "matches", "p50 us", "p99 us", "max us",
+         "linear us");
+  uint32_t* results = NULL;
+  uint32_t capacity = 0;
+  uint64_t samples[BENCH_QUERY_REPEATS];
+  for (int q = 0; q < COUNT_OF(queries); q++) {
+    uint32_t matches = 0;
+    for (int r = 0; r < BENCH_QUERY_REPEATS; r++) {
+      uint64_t start = time_ns();
+      matches = search_index_query(index, queries[q], &results, &capacity);
+      samples[r] = time_ns() - start;
+    }
+    qsort(samples, BENCH_QUERY_REPEATS, sizeof(uint64_t), compare_u64);
+
+    uint64_t linear = UINT64_MAX;
+    uint32_t linear_matches = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+      uint64_t start = time_ns();
+      linear_matches = linear_query(lowered, count, queries[q], expected);
+      uint64_t elapsed = time_ns() - start;
+      linear = elapsed < linear ? elapsed : linear;
+    }
+    if (linear_matches != matches ||
+        (matches > 0 && memcmp(results, expected, matches * sizeof(uint32_t)) != 0)) {
+      fprintf(stderr, "\"%s\": index and scan disagree\n", queries[q]);
+      return 1;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "\"%s\"", queries[q]);
+    printf(
+        "%-18s %8u %10.1f %10.1f %10.1f %12.1f\n",
+        name,
+        matches,
+        (double)samples[BENCH_QUERY_REPEATS / 2] / 1e3,
+        (double)samples[BENCH_QUERY_REPEATS * 99 / 100] / 1e3,
+        (double)samples[BENCH_QUERY_REPEATS - 1] / 1e3,
+        (double)linear / 1e3);
+  }
+
+  search_index_destroy(index);
+  free(results);
+  for (int i = 0; i < count; i++) {
+    free(paths[i]);
+    free(lowered[i]);
+  }
+  free(paths);
+  free(lowered);
+  free(expected);
+  return 0;
+}
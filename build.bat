@@ -46,7 +46,7 @@ if not exist "build" mkdir build
 REM Compile
 echo Compiling soundboard project...
 echo Using vcpkg libraries from: %VCPKG_INSTALLED%
-%CC% %CFLAGS% %INCLUDES% -o build\soundboard.exe src\main.c src\renderer.c src\soundboard.c src\callbacks.c %LINK_LIBS% -Xlinker /SUBSYSTEM:WINDOWS
+%CC% %CFLAGS% %INCLUDES% -o build\soundboard.exe src\main.c src\renderer.c src\soundboard.c src\callbacks.c src\audio.c src\audio_sink.c src\bounce.c src\convert.c src\decoder.c src\header_reader.c src\library_config.c src\library_index.c src\loudness.c src\loudness_cache.c src\mixer.c src\onset.c src\path_trie.c src\pcm_buffer.c src\pcm_cache.c src\process.c src\scanner.c src\search_index.c src\sidecar_cache.c src\spsc_ring.c src\stream.c src\thread.c src\wav.c src\watcher.c src\waveform.c src\waveform_cache.c src\worker_pool.c src\xxhash.c %LINK_LIBS% -Xlinker /SUBSYSTEM:WINDOWS
 
 if %ERRORLEVEL% EQU 0 (
     echo.
@@ -25,7 +25,7 @@ fi
 mkdir -p build
 
 CC="${CC:-cc}"
-CFLAGS="-std=c99 -Wall -Wextra -O2 -Isrc"
+CFLAGS="-std=c99 -D_GNU_SOURCE -Wall -Wextra -O2 -Isrc"
 PKG_CFLAGS="$(pkg-config --cflags glfw3 glew freetype-gl freetype2)"
 PKG_LIBS="$(pkg-config --libs glfw3 glew freetype-gl freetype2)"
 
@@ -33,6 +33,11 @@ set -x
 ${CC} ${CFLAGS} ${PKG_CFLAGS} \
   -o build/soundboard \
   src/main.c src/renderer.c src/soundboard.c src/callbacks.c \
+  src/audio.c src/audio_sink.c src/bounce.c src/convert.c src/decoder.c src/header_reader.c \
+  src/library_config.c src/library_index.c src/loudness.c src/loudness_cache.c src/mixer.c \
+  src/onset.c src/path_trie.c src/pcm_buffer.c src/pcm_cache.c src/process.c src/scanner.c \
+  src/search_index.c src/sidecar_cache.c src/spsc_ring.c src/stream.c src/thread.c src/wav.c \
+  src/watcher.c src/waveform.c src/waveform_cache.c src/worker_pool.c src/xxhash.c \
   ${PKG_LIBS} -lGLX -lm -pthread -ldl
 set +x
 
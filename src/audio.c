@@ -0,0 +1,561 @@
+#include "audio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mixer.h"
+#include "spsc_ring.h"
+#include "stream.h"
+#include "thread.h"
+
+typedef enum {
+  COMMAND_PLAY,
+  COMMAND_STOP,
+  COMMAND_STOP_ALL,
+  COMMAND_SET_GAIN,
+} CommandType;
+
+// A request from the control thread, carried to the audio thread by the command ring
+typedef struct {
+  CommandType type;
+  int voice;
+  PcmBuffer* buffer;  // COMMAND_PLAY only: the buffer or the stream to play, whose
+  Stream* stream;  // reference the command carries
+  uint32_t start;  // COMMAND_PLAY only: frame the voice starts at
+  float gain;
+  uint64_t order;  // Which start of the voice the command applies to
+  uint32_t offset;  // Frame of the next period a play or stop takes effect at
+} AudioCommand;
+
+// A buffer the audio thread is done with, on its way back to the control thread to be released
+typedef struct {
+  int voice;
+  PcmBuffer* buffer;
+  Stream* stream;
+  uint64_t order;
+} RetiredVoice;
+
+// Voice state owned by the audio thread
+typedef struct {
+  PcmBuffer* buffer;  // The voice holds one reference to its buffer or stream while playing
+  Stream* stream;
+  uint32_t position;
+  uint32_t drained;  // Periods of silence sent since the source ended, while its tail is audible
+  uint32_t delay;  // Frames of the coming period before the voice starts
+  uint32_t stop_at;  // Frame of the coming period the voice is cut at, or AUDIO_PERIOD_FRAMES
+  float gain;
+  uint64_t order;
+} Voice;
+
+// The control thread's view of a voice
+typedef struct {
+  PcmBuffer* buffer;  // Borrowed; valid until the audio thread retires this start of the voice.
+                      // NULL for streams
+  uint64_t order;  // Trigger sequence number, used to find the oldest voice to steal
+  uint32_t length;  // Frames in the sound, 0 if the decoder couldn't tell
+  uint32_t start;  // Frame playback started at
+  int busy;
+  uint32_t prefetched_to;  // Frame the readahead of a mapped buffer has been requested up to
+} VoiceSlot;
+
+struct AudioEngine {
+  AudioSink* sink;
+  Thread thread;
+  int threaded;  // 0 for offline engines, whose periods are mixed by audio_engine_render
+  int running;
+  int failed;  // Set by the audio thread when it gives up on the device
+  uint32_t offset;  // Offline engines: frame of the next period new commands take effect at
+
+  SpscRing commands;  // Control thread -> audio thread
+  SpscRing retired;  // Audio thread -> control thread
+
+  Voice voices[AUDIO_MAX_VOICES];
+  // Published after every period: low 32 bits of the voice's order, then the frames of it
+  // handed to the device so far, counting the silence after its end
+  uint64_t progress[AUDIO_MAX_VOICES];
+  uint32_t latency_frames;  // One period being mixed plus the device buffer
+
+  // Scratch for the period being mixed
+  float mix[AUDIO_PERIOD_FRAMES * AUDIO_CHANNELS];
+  int16_t period[AUDIO_PERIOD_FRAMES * AUDIO_CHANNELS];
+  int16_t streamed[AUDIO_PERIOD_FRAMES * AUDIO_CHANNELS];
+
+  VoiceSlot slots[AUDIO_MAX_VOICES];
+  uint64_t next_order;
+  uint32_t in_flight;  // Buffers handed to the audio thread and not yet retired
+
+  AudioEngineStats stats;  // Every field is accessed with atomics
+};
+
+static int voice_playing(const Voice* voice) {
+  return voice->buffer || voice->stream;
+}
+
+static int voice_active(const Voice* voice) {
+  if (voice->stream)
+    return !stream_finished(voice->stream);
+  return voice->buffer && voice->position < voice->buffer->frame_count;
+}
+
+static uint64_t pack_progress(uint64_t order, uint32_t position) {
+  return ((order & 0xFFFFFFFFULL) << 32) | position;
+}
+
+// Hand a voice's buffer back for release. The control thread never lets more buffers be in
+// flight than the retired ring holds, so this cannot fail while the engine is in use
+static void retire_voice(AudioEngine* engine, int index) {
+  Voice* voice = &engine->voices[index];
+  if (!voice_playing(voice))
+    return;
+
+  RetiredVoice retired;
+  retired.voice = index;
+  retired.buffer = voice->buffer;
+  retired.stream = voice->stream;
+  retired.order = voice->order;
+  if (spsc_ring_push(&engine->retired, &retired)) {
+    voice->buffer = NULL;
+    voice->stream = NULL;
+    voice->stop_at = AUDIO_PERIOD_FRAMES;
+  }
+}
+
+// Stop a voice now, or once offset frames of the coming period have been mixed
+static void stop_voice(AudioEngine* engine, int index, uint32_t offset) {
+  if (offset == 0)
+    retire_voice(engine, index);
+  else if (offset < engine->voices[index].stop_at)
+    engine->voices[index].stop_at = offset;
+}
+
+static void run_command(AudioEngine* engine, const AudioCommand* command) {
+  Voice* voice = command->voice >= 0 ? &engine->voices[command->voice] : NULL;
+  switch (command->type) {
+    case COMMAND_PLAY:
+      // Anything still on the voice is being stolen
+      retire_voice(engine, command->voice);
+      voice->buffer = command->buffer;
+      voice->stream = command->stream;
+      voice->position = command->start;
+      voice->drained = 0;
+      voice->delay = command->offset;
+      voice->stop_at = AUDIO_PERIOD_FRAMES;
+      voice->gain = command->gain;
+      voice->order = command->order;
+      break;
+    case COMMAND_STOP:
+      if (voice_playing(voice) && voice->order == command->order)
+        stop_voice(engine, command->voice, command->offset);
+      break;
+    case COMMAND_STOP_ALL:
+      for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+        if (voice_playing(&engine->voices[i]))
+          stop_voice(engine, i, command->offset);
+      }
+      break;
+    case COMMAND_SET_GAIN:
+      if (voice_playing(voice) && voice->order == command->order)
+        voice->gain = command->gain;
+      break;
+  }
+}
+
+// Drain the commands, mix one period and hand it to the sink. Returns the sink's result
+static int run_period(AudioEngine* engine) {
+  float* mix = engine->mix;
+  int16_t* period = engine->period;
+  int16_t* streamed = engine->streamed;
+  const uint64_t period_ns = (uint64_t)AUDIO_PERIOD_FRAMES * 1000000000ULL / AUDIO_SAMPLE_RATE;
+
+  // From here until the device write: no locks, no allocation, no syscalls
+  // (time_ns reads the vDSO clock)
+  uint64_t start = time_ns();
+
+  AudioCommand command;
+  while (spsc_ring_pop(&engine->commands, &command))
+    run_command(engine, &command);
+
+  memset(mix, 0, sizeof(engine->mix));
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+    Voice* voice = &engine->voices[i];
+    // Only offline engines schedule within a period; otherwise this is the whole period
+    uint32_t begin = voice->delay;
+    uint32_t end = voice->stop_at;
+    voice->delay = 0;
+    if (voice_active(voice) && begin < end) {
+      const int16_t* samples;
+      uint32_t frames;
+      if (voice->stream) {
+        // Whatever the decode thread has ready; a short read is a gap, not the end
+        frames = stream_read(voice->stream, streamed, end - begin);
+        samples = streamed;
+        if (frames < end - begin && !stream_finished(voice->stream))
+          __atomic_add_fetch(&engine->stats.stream_starvations, 1, __ATOMIC_RELAXED);
+      } else {
+        frames = voice->buffer->frame_count - voice->position;
+        if (frames > end - begin)
+          frames = end - begin;
+        samples = voice->buffer->samples + (size_t)voice->position * AUDIO_CHANNELS;
+      }
+      mix_accumulate_s16(
+          mix + (size_t)begin * AUDIO_CHANNELS, samples, frames * AUDIO_CHANNELS, voice->gain);
+      voice->position += frames;
+    } else if (voice_playing(voice)) {
+      // Out of samples, but the end is still in the device buffer; keep the voice until that
+      // has been heard so its progress reaches 100% when the sound really stops
+      voice->drained += AUDIO_PERIOD_FRAMES;
+      if (voice->drained >= engine->latency_frames)
+        retire_voice(engine, i);
+    }
+    if (end < AUDIO_PERIOD_FRAMES)
+      retire_voice(engine, i);
+
+    if (voice_playing(voice)) {
+      __atomic_store_n(
+          &engine->progress[i],
+          pack_progress(voice->order, voice->position + voice->drained),
+          __ATOMIC_RELEASE);
+    }
+  }
+
+  mix_clip_s16(period, mix, AUDIO_PERIOD_FRAMES * AUDIO_CHANNELS);
+
+  uint64_t elapsed = time_ns() - start;
+  if (elapsed > __atomic_load_n(&engine->stats.worst_callback_ns, __ATOMIC_RELAXED))
+    __atomic_store_n(&engine->stats.worst_callback_ns, elapsed, __ATOMIC_RELAXED);
+  if (elapsed > period_ns)
+    __atomic_add_fetch(&engine->stats.late_callbacks, 1, __ATOMIC_RELAXED);
+
+  int result = audio_sink_write(engine->sink, period, AUDIO_PERIOD_FRAMES);
+  __atomic_add_fetch(&engine->stats.periods, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&engine->stats.underruns, engine->sink->underruns, __ATOMIC_RELAXED);
+  return result;
+}
+
+static void* audio_thread_main(void* arg) {
+  AudioEngine* engine = (AudioEngine*)arg;
+  const uint32_t settle_periods = AUDIO_SAMPLE_RATE / AUDIO_PERIOD_FRAMES;  // About a second
+  uint32_t failures = 0;
+  uint32_t since_restart = UINT32_MAX;  // Periods written since the last restart
+  while (__atomic_load_n(&engine->running, __ATOMIC_ACQUIRE)) {
+    if (run_period(engine) == 0) {
+      failures = 0;
+      if (since_restart < UINT32_MAX)
+        since_restart++;
+      continue;
+    }
+
+    // Say so once per outage rather than once per period
+    if (failures++ == 0)
+      fprintf(stderr, "Audio device write failed (%s)\n", engine->sink->name);
+    if (failures < AUDIO_MAX_WRITE_FAILURES) {
+      sleep_ns(1000000ULL);
+      continue;
+    }
+
+    // A device that fails again right after a restart isn't restarted over and over
+    if (engine->sink->restart && since_restart >= settle_periods &&
+        engine->sink->restart(engine->sink) == 0) {
+      fprintf(stderr, "Audio device restarted (%s)\n", engine->sink->name);
+      failures = 0;
+      since_restart = 0;
+      continue;
+    }
+    fprintf(stderr, "Audio device lost (%s)\n", engine->sink->name);
+    __atomic_store_n(&engine->failed, 1, __ATOMIC_RELEASE);
+    break;
+  }
+  return NULL;
+}
+
+// Wrap a sink in an engine, which takes the sink over; on failure the sink is closed
+static AudioEngine* open_engine(AudioSink* sink) {
+  if (!sink)
+    return NULL;
+
+  AudioEngine* engine = (AudioEngine*)calloc(1, sizeof(AudioEngine));
+  if (!engine) {
+    audio_sink_close(sink);
+    return NULL;
+  }
+
+  engine->sink = sink;
+  engine->latency_frames = AUDIO_PERIOD_FRAMES + sink->latency_frames;
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++)
+    engine->voices[i].stop_at = AUDIO_PERIOD_FRAMES;
+  if (!spsc_ring_init(&engine->commands, sizeof(AudioCommand), AUDIO_COMMAND_QUEUE) ||
+      !spsc_ring_init(
+          &engine->retired, sizeof(RetiredVoice), AUDIO_COMMAND_QUEUE + AUDIO_MAX_VOICES)) {
+    spsc_ring_destroy(&engine->commands);
+    spsc_ring_destroy(&engine->retired);
+    audio_sink_close(sink);
+    free(engine);
+    return NULL;
+  }
+  return engine;
+}
+
+AudioEngine* audio_engine_create(const char* backend) {
+  return audio_engine_create_on_sink(audio_sink_open(backend, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS));
+}
+
+AudioEngine* audio_engine_create_on_sink(AudioSink* sink) {
+  AudioEngine* engine = open_engine(sink);
+  if (!engine)
+    return NULL;
+
+  engine->running = 1;
+  engine->threaded = 1;
+  if (!thread_create(&engine->thread, audio_thread_main, engine)) {
+    fprintf(stderr, "Failed to create audio thread\n");
+    engine->threaded = 0;
+    audio_engine_destroy(engine);
+    return NULL;
+  }
+
+  return engine;
+}
+
+AudioEngine* audio_engine_create_offline(const char* backend) {
+  return open_engine(audio_sink_open(backend, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS));
+}
+
+void audio_engine_schedule(AudioEngine* engine, uint32_t offset) {
+  if (!engine->threaded)
+    engine->offset = offset < AUDIO_PERIOD_FRAMES ? offset : AUDIO_PERIOD_FRAMES - 1;
+}
+
+int audio_engine_render(AudioEngine* engine) {
+  if (engine->threaded)
+    return 0;
+  if (run_period(engine) != 0) {
+    fprintf(stderr, "Audio device write failed (%s)\n", engine->sink->name);
+    return 0;
+  }
+  return 1;
+}
+
+void audio_engine_destroy(AudioEngine* engine) {
+  if (!engine)
+    return;
+
+  if (engine->threaded) {
+    __atomic_store_n(&engine->running, 0, __ATOMIC_RELEASE);
+    thread_join(engine->thread);
+  }
+  audio_sink_close(engine->sink);
+
+  // The audio thread is gone, so every buffer still owned anywhere can be released from here
+  AudioCommand command;
+  while (spsc_ring_pop(&engine->commands, &command)) {
+    if (command.type == COMMAND_PLAY) {
+      pcm_buffer_release(command.buffer);
+      stream_release(command.stream);
+    }
+  }
+  RetiredVoice retired;
+  while (spsc_ring_pop(&engine->retired, &retired)) {
+    pcm_buffer_release(retired.buffer);
+    stream_release(retired.stream);
+  }
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+    pcm_buffer_release(engine->voices[i].buffer);
+    stream_release(engine->voices[i].stream);
+  }
+
+  spsc_ring_destroy(&engine->commands);
+  spsc_ring_destroy(&engine->retired);
+  free(engine);
+}
+
+const char* audio_engine_backend_name(const AudioEngine* engine) {
+  return engine->sink->name;
+}
+
+int audio_engine_failed(const AudioEngine* engine) {
+  return __atomic_load_n(&engine->failed, __ATOMIC_ACQUIRE);
+}
+
+static int send_command(AudioEngine* engine, const AudioCommand* command) {
+  AudioCommand scheduled = *command;
+  scheduled.offset = engine->offset;
+  if (spsc_ring_push(&engine->commands, &scheduled))
+    return 1;
+  __atomic_add_fetch(&engine->stats.overruns, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+// Release what the audio thread has handed back and free the matching voices
+static void reap_retired(AudioEngine* engine) {
+  RetiredVoice retired;
+  while (spsc_ring_pop(&engine->retired, &retired)) {
+    VoiceSlot* slot = &engine->slots[retired.voice];
+    if (slot->busy && slot->order == retired.order) {
+      slot->busy = 0;
+      slot->buffer = NULL;
+    }
+    pcm_buffer_release(retired.buffer);
+    stream_release(retired.stream);
+    engine->in_flight--;
+  }
+}
+
+static int start_voice(
+    AudioEngine* engine,
+    PcmBuffer* buffer,
+    Stream* stream,
+    uint32_t length,
+    uint32_t start,
+    float gain) {
+  reap_retired(engine);
+  if (engine->in_flight >= spsc_ring_capacity(&engine->retired)) {
+    __atomic_add_fetch(&engine->stats.overruns, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+
+  int index = -1;
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+    if (!engine->slots[i].busy) {
+      index = i;
+      break;
+    }
+  }
+  if (index < 0) {
+    index = 0;
+    for (int i = 1; i < AUDIO_MAX_VOICES; i++) {
+      if (engine->slots[i].order < engine->slots[index].order)
+        index = i;
+    }
+  }
+
+  AudioCommand command;
+  command.type = COMMAND_PLAY;
+  command.voice = index;
+  command.buffer = buffer;
+  command.stream = stream;
+  command.start = start;
+  command.gain = gain;
+  command.order = engine->next_order;
+  if (!send_command(engine, &command))
+    return -1;
+
+  VoiceSlot* slot = &engine->slots[index];
+  slot->buffer = buffer;
+  slot->order = engine->next_order++;
+  slot->length = length;
+  slot->start = start;
+  slot->busy = 1;
+  slot->prefetched_to = start;
+  engine->in_flight++;
+  return index;
+}
+
+int audio_engine_play(AudioEngine* engine, PcmBuffer* buffer, uint32_t start, float gain) {
+  if (start >= buffer->frame_count)
+    start = 0;
+  return start_voice(engine, buffer, NULL, buffer->frame_count, start, gain);
+}
+
+int audio_engine_play_stream(AudioEngine* engine, Stream* stream, uint32_t start, float gain) {
+  return start_voice(engine, NULL, stream, stream_frame_count(stream), start, gain);
+}
+
+void audio_engine_stop(AudioEngine* engine, int voice) {
+  if (voice < 0 || voice >= AUDIO_MAX_VOICES || !engine->slots[voice].busy)
+    return;
+
+  AudioCommand command;
+  memset(&command, 0, sizeof(command));
+  command.type = COMMAND_STOP;
+  command.voice = voice;
+  command.order = engine->slots[voice].order;
+  send_command(engine, &command);
+}
+
+void audio_engine_stop_all(AudioEngine* engine) {
+  AudioCommand command;
+  memset(&command, 0, sizeof(command));
+  command.type = COMMAND_STOP_ALL;
+  command.voice = -1;
+  send_command(engine, &command);
+}
+
+void audio_engine_set_gain(AudioEngine* engine, int voice, float gain) {
+  if (voice < 0 || voice >= AUDIO_MAX_VOICES || !engine->slots[voice].busy)
+    return;
+
+  AudioCommand command;
+  memset(&command, 0, sizeof(command));
+  command.type = COMMAND_SET_GAIN;
+  command.voice = voice;
+  command.gain = gain;
+  command.order = engine->slots[voice].order;
+  send_command(engine, &command);
+}
+
+// Frames of a voice's current start the audio thread has sent to the device so far
+static uint32_t sent_frames(const AudioEngine* engine, int voice) {
+  // Until the audio thread has picked up the play command, the voice is where it will start
+  uint64_t progress = __atomic_load_n(&engine->progress[voice], __ATOMIC_ACQUIRE);
+  if ((progress >> 32) != (engine->slots[voice].order & 0xFFFFFFFFULL))
+    return engine->slots[voice].start;
+  return (uint32_t)progress;
+}
+
+void audio_engine_update(AudioEngine* engine) {
+  reap_retired(engine);
+
+  // Ask for a few seconds at a time, once a voice gets within a second of the last request
+  const uint32_t window = AUDIO_SAMPLE_RATE * 3;
+  const uint32_t margin = AUDIO_SAMPLE_RATE;
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+    VoiceSlot* slot = &engine->slots[i];
+    if (!slot->busy || !slot->buffer || !slot->buffer->mapping)
+      continue;
+
+    uint32_t position = sent_frames(engine, i);
+    if (slot->prefetched_to > position + margin)
+      continue;
+
+    // madvise can block, but only this thread waits on it
+    uint32_t start = slot->prefetched_to > position ? slot->prefetched_to : position;
+    pcm_buffer_prefetch(slot->buffer, start, window);
+    slot->prefetched_to = position + window;
+  }
+}
+
+int audio_engine_voice_busy(const AudioEngine* engine, int voice) {
+  return voice >= 0 && voice < AUDIO_MAX_VOICES && engine->slots[voice].busy;
+}
+
+int audio_engine_voice_position(
+    const AudioEngine* engine,
+    int voice,
+    uint32_t* position,
+    uint32_t* length) {
+  if (!audio_engine_voice_busy(engine, voice))
+    return 0;
+
+  // What is coming out of the speaker now was sent latency_frames ago
+  uint32_t sent = sent_frames(engine, voice);
+  const VoiceSlot* slot = &engine->slots[voice];
+  uint32_t audible = sent > engine->latency_frames ? sent - engine->latency_frames : 0;
+  if (audible < slot->start)
+    audible = slot->start;
+  if (slot->length > 0 && audible > slot->length)
+    audible = slot->length;
+  *position = audible;
+  *length = slot->length;
+  return 1;
+}
+
+void audio_engine_get_stats(const AudioEngine* engine, AudioEngineStats* stats) {
+  stats->periods = __atomic_load_n(&engine->stats.periods, __ATOMIC_RELAXED);
+  stats->underruns = __atomic_load_n(&engine->stats.underruns, __ATOMIC_RELAXED);
+  stats->overruns = __atomic_load_n(&engine->stats.overruns, __ATOMIC_RELAXED);
+  stats->late_callbacks = __atomic_load_n(&engine->stats.late_callbacks, __ATOMIC_RELAXED);
+  stats->stream_starvations =
+      __atomic_load_n(&engine->stats.stream_starvations, __ATOMIC_RELAXED);
+  stats->worst_callback_ns = __atomic_load_n(&engine->stats.worst_callback_ns, __ATOMIC_RELAXED);
+}
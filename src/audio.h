@@ -0,0 +1,99 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+
+#include "audio_sink.h"
+#include "pcm_buffer.h"
+#include "stream.h"
+
+#define AUDIO_PERIOD_FRAMES 256  // ~5.3 ms per audio thread iteration
+#define AUDIO_MAX_VOICES 32  // Sounds that can play at once before the oldest is stolen
+#define AUDIO_COMMAND_QUEUE 256  // Commands that can be in flight to the audio thread
+#define AUDIO_MAX_WRITE_FAILURES 50  // Failed device writes in a row (~50 ms) before restarting it
+
+typedef struct AudioEngine AudioEngine;
+
+// Counters kept by the audio thread. The callback is the work done between two device writes:
+// draining commands, mixing and clipping one period
+typedef struct {
+  uint64_t periods;  // Periods handed to the device
+  uint64_t underruns;  // Times the device ran dry (where the backend can tell)
+  uint64_t overruns;  // Commands dropped because the queue to the audio thread was full
+  uint64_t late_callbacks;  // Callbacks that took longer than one period of audio
+  uint64_t stream_starvations;  // Periods a streaming voice had no decoded audio ready in time
+  uint64_t worst_callback_ns;
+} AudioEngineStats;
+
+// Open the sink named by backend (see audio_sink_open) and start the audio thread.
+// Returns NULL if no device could be opened
+AudioEngine* audio_engine_create(const char* backend);
+
+// Same as audio_engine_create on a sink the caller opened, or built to observe what the engine
+// writes. The engine takes the sink over, closing it if the engine can't start
+AudioEngine* audio_engine_create_on_sink(AudioSink* sink);
+
+// Open the sink like audio_engine_create, but start no audio thread: a period is only mixed
+// when the caller asks for it with audio_engine_render, as fast as the caller likes. For bouncing
+// to a file. The control side and the rendering then share the caller's thread
+AudioEngine* audio_engine_create_offline(const char* backend);
+
+// Offline engines only: run the commands sent so far, mix the next AUDIO_PERIOD_FRAMES and write
+// them to the sink. Returns 0 if the write failed or the engine has its own audio thread
+int audio_engine_render(AudioEngine* engine);
+
+// Offline engines only: plays and stops sent after this take effect offset frames into the next
+// period rendered rather than at its start, so a trigger lands on its exact frame
+void audio_engine_schedule(AudioEngine* engine, uint32_t offset);
+
+// Stop the audio thread and close the device
+void audio_engine_destroy(AudioEngine* engine);
+
+// Name of the sink the engine is writing to
+const char* audio_engine_backend_name(const AudioEngine* engine);
+
+// Whether the audio thread gave up on a device that kept failing and couldn't be restarted.
+// Nothing started on the engine is heard after that; destroy it and play some other way
+int audio_engine_failed(const AudioEngine* engine);
+
+// The functions below are the control side of the engine and must all be called from one thread.
+// They only talk to the audio thread through lock-free queues
+
+// Start a buffer on a free voice at frame start, layered over whatever is already playing.
+// When every voice is busy the one that started longest ago is stolen.
+// The engine takes over the caller's reference and returns the voice index, or returns -1
+// and leaves the reference with the caller if the command queue is full
+int audio_engine_play(AudioEngine* engine, PcmBuffer* buffer, uint32_t start, float gain);
+
+// Same as audio_engine_play for a stream being decoded in the background. The stream must have
+// been opened at start already; start only tells the engine where its position counts from
+int audio_engine_play_stream(AudioEngine* engine, Stream* stream, uint32_t start, float gain);
+
+// Stop one voice, or every voice
+void audio_engine_stop(AudioEngine* engine, int voice);
+void audio_engine_stop_all(AudioEngine* engine);
+
+// Change the gain of a voice that is still playing
+void audio_engine_set_gain(AudioEngine* engine, int voice, float gain);
+
+// Release the buffers of voices the audio thread has finished with, and keep the OS reading
+// ahead of every voice playing from a mapped file so the audio thread never faults on a page
+// that is still on disk. Call regularly
+void audio_engine_update(AudioEngine* engine);
+
+// Whether a voice started by audio_engine_play is still playing
+int audio_engine_voice_busy(const AudioEngine* engine, int voice);
+
+// Where a busy voice is in its sound, in frames from the top of the sound, compensated for the
+// audio buffered between the engine and the speaker. length is 0 if the decoder can't tell.
+// Returns 0 once the voice is idle
+int audio_engine_voice_position(
+    const AudioEngine* engine,
+    int voice,
+    uint32_t* position,
+    uint32_t* length);
+
+// Snapshot the audio thread counters
+void audio_engine_get_stats(const AudioEngine* engine, AudioEngineStats* stats);
+
+#endif  // AUDIO_H
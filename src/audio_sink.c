@@ -0,0 +1,602 @@
+#include "audio_sink.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "process.h"
+#include "thread.h"
+
+#ifdef _WIN32
+#include <mmsystem.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Target device buffering. Small enough to feel instant, large enough to survive scheduling jitter
+#define SINK_LATENCY_US 20000
+#define SINK_LATENCY_FRAMES(rate) ((uint32_t)((uint64_t)(rate) * SINK_LATENCY_US / 1000000ULL))
+
+// ---------------------------------------------------------------------------
+// Paced sinks (null / file): consume audio at the device rate without hardware. The bounce sink
+// is the same WAV writer without the pacing, for offline rendering
+
+typedef struct {
+  AudioSink base;
+  FILE* file;
+  int paced;
+  uint32_t data_bytes;
+  uint64_t deadline_ns;
+} PacedSink;
+
+static void pace(PacedSink* sink, uint32_t frames) {
+  uint64_t now = time_ns();
+  if (sink->deadline_ns != 0 && now > sink->deadline_ns)
+    sink->base.underruns++;  // Everything written so far would already have been played
+  if (sink->deadline_ns == 0 || now > sink->deadline_ns)
+    sink->deadline_ns = now;
+
+  // Stay one latency window ahead of the clock, like a real device buffer would
+  sink->deadline_ns += (uint64_t)frames * 1000000000ULL / sink->base.sample_rate;
+  uint64_t ahead = (uint64_t)SINK_LATENCY_US * 1000ULL;
+  if (sink->deadline_ns > now + ahead)
+    sleep_ns(sink->deadline_ns - now - ahead);
+}
+
+static void write_u16_le(unsigned char* bytes, uint16_t value) {
+  bytes[0] = (unsigned char)(value & 0xFF);
+  bytes[1] = (unsigned char)(value >> 8);
+}
+
+static void write_u32_le(unsigned char* bytes, uint32_t value) {
+  bytes[0] = (unsigned char)(value & 0xFF);
+  bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+  bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+  bytes[3] = (unsigned char)(value >> 24);
+}
+
+static void write_wav_header(PacedSink* sink) {
+  unsigned char header[44];
+  uint16_t block_align = (uint16_t)(sink->base.channels * sizeof(int16_t));
+  memcpy(header, "RIFF", 4);
+  write_u32_le(header + 4, 36 + sink->data_bytes);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  write_u32_le(header + 16, 16);
+  write_u16_le(header + 20, 1);
+  write_u16_le(header + 22, (uint16_t)sink->base.channels);
+  write_u32_le(header + 24, sink->base.sample_rate);
+  write_u32_le(header + 28, sink->base.sample_rate * block_align);
+  write_u16_le(header + 32, block_align);
+  write_u16_le(header + 34, 16);
+  memcpy(header + 36, "data", 4);
+  write_u32_le(header + 40, sink->data_bytes);
+  fseek(sink->file, 0, SEEK_SET);
+  fwrite(header, 1, sizeof(header), sink->file);
+  fseek(sink->file, 0, SEEK_END);
+}
+
+static int paced_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  PacedSink* sink = (PacedSink*)base;
+  if (sink->file) {
+    size_t bytes = (size_t)frames * base->channels * sizeof(int16_t);
+    if (fwrite(samples, 1, bytes, sink->file) != bytes)
+      return -1;
+    sink->data_bytes += (uint32_t)bytes;
+  }
+  if (sink->paced)
+    pace(sink, frames);
+  return 0;
+}
+
+static void paced_close(AudioSink* base) {
+  PacedSink* sink = (PacedSink*)base;
+  if (sink->file) {
+    write_wav_header(sink);
+    fclose(sink->file);
+  }
+  free(sink);
+}
+
+static AudioSink* open_paced_sink(
+    const char* file_path,
+    int paced,
+    uint32_t sample_rate,
+    uint32_t channels) {
+  PacedSink* sink = (PacedSink*)calloc(1, sizeof(PacedSink));
+  if (!sink)
+    return NULL;
+
+  sink->base.name = !paced ? "bounce" : file_path ? "file" : "null";
+  sink->base.sample_rate = sample_rate;
+  sink->base.channels = channels;
+  sink->base.latency_frames = paced ? SINK_LATENCY_FRAMES(sample_rate) : 0;
+  sink->paced = paced;
+  sink->base.write = paced_write;
+  sink->base.close = paced_close;
+
+  if (file_path) {
+    sink->file = fopen(file_path, "wb");
+    if (!sink->file) {
+      fprintf(stderr, "Failed to open audio output file %s\n", file_path);
+      free(sink);
+      return NULL;
+    }
+    write_wav_header(sink);
+  }
+  return &sink->base;
+}
+
+#ifdef _WIN32
+// ---------------------------------------------------------------------------
+// waveOut: a small ring of headers, refilled as the driver hands them back
+
+#define WINMM_BUFFERS 4
+
+typedef struct {
+  AudioSink base;
+  HWAVEOUT device;
+  HANDLE done_event;
+  WAVEHDR headers[WINMM_BUFFERS];
+  int16_t* buffers[WINMM_BUFFERS];
+  uint32_t buffer_frames;
+  int next;
+  int started;
+} WinmmSink;
+
+static int winmm_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  WinmmSink* sink = (WinmmSink*)base;
+
+  // The driver hands headers back as it finishes them; none left queued means it ran dry
+  int queued = 0;
+  for (int i = 0; i < WINMM_BUFFERS; i++)
+    queued |= (sink->headers[i].dwFlags & WHDR_INQUEUE) != 0;
+  if (sink->started && !queued)
+    base->underruns++;
+  sink->started = 1;
+
+  while (frames > 0) {
+    WAVEHDR* header = &sink->headers[sink->next];
+    while (header->dwFlags & WHDR_INQUEUE)
+      WaitForSingleObject(sink->done_event, INFINITE);
+
+    uint32_t chunk = frames < sink->buffer_frames ? frames : sink->buffer_frames;
+    memcpy(sink->buffers[sink->next], samples, (size_t)chunk * base->channels * sizeof(int16_t));
+    header->dwBufferLength = chunk * base->channels * sizeof(int16_t);
+    if (waveOutWrite(sink->device, header, sizeof(WAVEHDR)) != MMSYSERR_NOERROR)
+      return -1;
+
+    sink->next = (sink->next + 1) % WINMM_BUFFERS;
+    samples += (size_t)chunk * base->channels;
+    frames -= chunk;
+  }
+  return 0;
+}
+
+static void winmm_close(AudioSink* base) {
+  WinmmSink* sink = (WinmmSink*)base;
+  waveOutReset(sink->device);
+  for (int i = 0; i < WINMM_BUFFERS; i++) {
+    waveOutUnprepareHeader(sink->device, &sink->headers[i], sizeof(WAVEHDR));
+    free(sink->buffers[i]);
+  }
+  waveOutClose(sink->device);
+  CloseHandle(sink->done_event);
+  free(sink);
+}
+
+static AudioSink* open_winmm_sink(uint32_t sample_rate, uint32_t channels) {
+  WinmmSink* sink = (WinmmSink*)calloc(1, sizeof(WinmmSink));
+  if (!sink)
+    return NULL;
+
+  WAVEFORMATEX format;
+  memset(&format, 0, sizeof(format));
+  format.wFormatTag = WAVE_FORMAT_PCM;
+  format.nChannels = (WORD)channels;
+  format.nSamplesPerSec = sample_rate;
+  format.wBitsPerSample = 16;
+  format.nBlockAlign = (WORD)(channels * sizeof(int16_t));
+  format.nAvgBytesPerSec = sample_rate * format.nBlockAlign;
+
+  sink->done_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (waveOutOpen(
+          &sink->device,
+          WAVE_MAPPER,
+          &format,
+          (DWORD_PTR)sink->done_event,
+          0,
+          CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+    CloseHandle(sink->done_event);
+    free(sink);
+    return NULL;
+  }
+
+  sink->buffer_frames = (uint32_t)((uint64_t)sample_rate * SINK_LATENCY_US / 1000000ULL /
+                                   (WINMM_BUFFERS / 2));
+  for (int i = 0; i < WINMM_BUFFERS; i++) {
+    sink->buffers[i] = (int16_t*)calloc(sink->buffer_frames * channels, sizeof(int16_t));
+    sink->headers[i].lpData = (LPSTR)sink->buffers[i];
+    sink->headers[i].dwBufferLength = sink->buffer_frames * channels * sizeof(int16_t);
+    waveOutPrepareHeader(sink->device, &sink->headers[i], sizeof(WAVEHDR));
+  }
+
+  sink->base.name = "winmm";
+  sink->base.sample_rate = sample_rate;
+  sink->base.channels = channels;
+  sink->base.latency_frames = SINK_LATENCY_FRAMES(sample_rate);
+  sink->base.write = winmm_write;
+  sink->base.close = winmm_close;
+  return &sink->base;
+}
+#else
+// ---------------------------------------------------------------------------
+// PulseAudio (pa_simple) and ALSA, loaded at runtime so neither is a build dependency
+
+typedef struct {
+  int format;
+  uint32_t rate;
+  uint8_t channels;
+} PaSampleSpec;
+
+typedef struct {
+  uint32_t maxlength;
+  uint32_t tlength;
+  uint32_t prebuf;
+  uint32_t minreq;
+  uint32_t fragsize;
+} PaBufferAttr;
+
+#define PA_SAMPLE_S16LE 3
+#define PA_STREAM_PLAYBACK 1
+
+typedef struct {
+  AudioSink base;
+  void* library;
+  void* stream;
+  int (*simple_write)(void*, const void*, size_t, int*);
+  int (*simple_drain)(void*, int*);
+  void (*simple_free)(void*);
+} PulseSink;
+
+static int pulse_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  PulseSink* sink = (PulseSink*)base;
+  int error = 0;
+  size_t bytes = (size_t)frames * base->channels * sizeof(int16_t);
+  return sink->simple_write(sink->stream, samples, bytes, &error) < 0 ? -1 : 0;
+}
+
+static void pulse_close(AudioSink* base) {
+  PulseSink* sink = (PulseSink*)base;
+  int error = 0;
+  sink->simple_drain(sink->stream, &error);
+  sink->simple_free(sink->stream);
+  dlclose(sink->library);
+  free(sink);
+}
+
+static AudioSink* open_pulse_sink(uint32_t sample_rate, uint32_t channels) {
+  void* library = dlopen("libpulse-simple.so.0", RTLD_NOW);
+  if (!library)
+    return NULL;
+
+  void* (*simple_new)(
+      const char*,
+      const char*,
+      int,
+      const char*,
+      const char*,
+      const PaSampleSpec*,
+      const void*,
+      const PaBufferAttr*,
+      int*);
+  PulseSink* sink = (PulseSink*)calloc(1, sizeof(PulseSink));
+  if (!sink) {
+    dlclose(library);
+    return NULL;
+  }
+  *(void**)&simple_new = dlsym(library, "pa_simple_new");
+  *(void**)&sink->simple_write = dlsym(library, "pa_simple_write");
+  *(void**)&sink->simple_drain = dlsym(library, "pa_simple_drain");
+  *(void**)&sink->simple_free = dlsym(library, "pa_simple_free");
+  if (!simple_new || !sink->simple_write || !sink->simple_drain || !sink->simple_free) {
+    free(sink);
+    dlclose(library);
+    return NULL;
+  }
+
+  PaSampleSpec spec;
+  spec.format = PA_SAMPLE_S16LE;
+  spec.rate = sample_rate;
+  spec.channels = (uint8_t)channels;
+
+  // Keep the server-side buffer short; the defaults are tuned for music players (~2 s)
+  PaBufferAttr attr;
+  uint32_t bytes_per_second = sample_rate * channels * sizeof(int16_t);
+  attr.maxlength = (uint32_t)-1;
+  attr.tlength = (uint32_t)((uint64_t)bytes_per_second * SINK_LATENCY_US / 1000000ULL);
+  attr.prebuf = (uint32_t)-1;
+  attr.minreq = (uint32_t)-1;
+  attr.fragsize = (uint32_t)-1;
+
+  int error = 0;
+  sink->stream = simple_new(
+      NULL, "Soundboard", PA_STREAM_PLAYBACK, NULL, "playback", &spec, NULL, &attr, &error);
+  if (!sink->stream) {
+    free(sink);
+    dlclose(library);
+    return NULL;
+  }
+
+  sink->library = library;
+  sink->base.name = "pulse";
+  sink->base.sample_rate = sample_rate;
+  sink->base.channels = channels;
+  sink->base.latency_frames = SINK_LATENCY_FRAMES(sample_rate);
+  sink->base.write = pulse_write;
+  sink->base.close = pulse_close;
+  return &sink->base;
+}
+
+#define SND_PCM_STREAM_PLAYBACK 0
+#define SND_PCM_FORMAT_S16_LE 2
+#define SND_PCM_ACCESS_RW_INTERLEAVED 3
+
+typedef struct {
+  AudioSink base;
+  void* library;
+  void* pcm;
+  long (*pcm_writei)(void*, const void*, unsigned long);
+  int (*pcm_recover)(void*, int, int);
+  int (*pcm_drain)(void*);
+  int (*pcm_close)(void*);
+} AlsaSink;
+
+static int alsa_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  AlsaSink* sink = (AlsaSink*)base;
+  while (frames > 0) {
+    long written = sink->pcm_writei(sink->pcm, samples, frames);
+    if (written < 0) {
+      if (written == -EPIPE)
+        base->underruns++;
+      if (sink->pcm_recover(sink->pcm, (int)written, 1) < 0)
+        return -1;
+      continue;
+    }
+    samples += (size_t)written * base->channels;
+    frames -= (uint32_t)written;
+  }
+  return 0;
+}
+
+static void alsa_close(AudioSink* base) {
+  AlsaSink* sink = (AlsaSink*)base;
+  sink->pcm_drain(sink->pcm);
+  sink->pcm_close(sink->pcm);
+  dlclose(sink->library);
+  free(sink);
+}
+
+static AudioSink* open_alsa_sink(uint32_t sample_rate, uint32_t channels) {
+  void* library = dlopen("libasound.so.2", RTLD_NOW);
+  if (!library)
+    return NULL;
+
+  int (*pcm_open)(void**, const char*, int, int);
+  int (*pcm_set_params)(void*, int, int, unsigned int, unsigned int, int, unsigned int);
+  AlsaSink* sink = (AlsaSink*)calloc(1, sizeof(AlsaSink));
+  if (!sink) {
+    dlclose(library);
+    return NULL;
+  }
+  *(void**)&pcm_open = dlsym(library, "snd_pcm_open");
+  *(void**)&pcm_set_params = dlsym(library, "snd_pcm_set_params");
+  *(void**)&sink->pcm_writei = dlsym(library, "snd_pcm_writei");
+  *(void**)&sink->pcm_recover = dlsym(library, "snd_pcm_recover");
+  *(void**)&sink->pcm_drain = dlsym(library, "snd_pcm_drain");
+  *(void**)&sink->pcm_close = dlsym(library, "snd_pcm_close");
+  if (!pcm_open || !pcm_set_params || !sink->pcm_writei || !sink->pcm_recover ||
+      !sink->pcm_drain || !sink->pcm_close) {
+    free(sink);
+    dlclose(library);
+    return NULL;
+  }
+
+  if (pcm_open(&sink->pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+    free(sink);
+    dlclose(library);
+    return NULL;
+  }
+
+  if (pcm_set_params(
+          sink->pcm,
+          SND_PCM_FORMAT_S16_LE,
+          SND_PCM_ACCESS_RW_INTERLEAVED,
+          channels,
+          sample_rate,
+          1,
+          SINK_LATENCY_US) < 0) {
+    sink->pcm_close(sink->pcm);
+    free(sink);
+    dlclose(library);
+    return NULL;
+  }
+
+  sink->library = library;
+  sink->base.name = "alsa";
+  sink->base.sample_rate = sample_rate;
+  sink->base.channels = channels;
+  sink->base.latency_frames = SINK_LATENCY_FRAMES(sample_rate);
+  sink->base.write = alsa_write;
+  sink->base.close = alsa_close;
+  return &sink->base;
+}
+
+// ---------------------------------------------------------------------------
+// Pipe: one long-lived player process reading raw PCM on stdin, for systems where neither
+// library can be loaded but a command-line player is installed
+
+static const char* const pipe_players[] = {"pacat", "pw-cat", "aplay"};
+
+typedef struct {
+  AudioSink base;
+  int player;  // Index into pipe_players
+  pid_t pid;  // -1 once a restart failed
+  int fd;
+} PipeSink;
+
+// Start a player reading raw PCM on stdin, whose write end goes to fd. Returns its pid, or -1
+static pid_t spawn_pipe_player(int player, uint32_t sample_rate, uint32_t channels, int* fd) {
+  char rate[16];
+  char channel_count[16];
+  char latency_ms[16];
+  char latency_us[16];
+  snprintf(rate, sizeof(rate), "%u", sample_rate);
+  snprintf(channel_count, sizeof(channel_count), "%u", channels);
+  snprintf(latency_ms, sizeof(latency_ms), "%u", SINK_LATENCY_US / 1000);
+  snprintf(latency_us, sizeof(latency_us), "%u", SINK_LATENCY_US);
+
+  char* const pacat_argv[] = {
+      "pacat", "--playback", "--raw", "--format=s16le", "--rate", rate, "--channels",
+      channel_count, "--latency-msec", latency_ms, "--client-name=Soundboard", NULL};
+  char pw_latency[16];
+  snprintf(pw_latency, sizeof(pw_latency), "%ums", SINK_LATENCY_US / 1000);
+  char* const pw_cat_argv[] = {
+      "pw-cat", "--playback", "--format=s16", "--rate", rate, "--channels", channel_count,
+      "--latency", pw_latency, "-", NULL};
+  char* const aplay_argv[] = {
+      "aplay", "-q", "-t", "raw", "-f", "S16_LE", "-r", rate, "-c", channel_count, "-B",
+      latency_us, "-", NULL};
+  char* const* players[] = {pacat_argv, pw_cat_argv, aplay_argv};
+
+  pid_t pid = spawn_program(players[player], fd);
+  if (pid < 0)
+    return -1;
+
+  // The default 64 KB pipe would queue ~340 ms of audio in front of the player; shrink it to
+  // one page
+#ifdef F_SETPIPE_SZ
+  fcntl(*fd, F_SETPIPE_SZ, 4096);
+#endif
+  return pid;
+}
+
+static int pipe_write(AudioSink* base, const int16_t* samples, uint32_t frames) {
+  PipeSink* sink = (PipeSink*)base;
+  if (sink->pid < 0)
+    return -1;  // No player since a restart failed
+  const char* bytes = (const char*)samples;
+  size_t left = (size_t)frames * base->channels * sizeof(int16_t);
+  while (left > 0) {
+    ssize_t written = write(sink->fd, bytes, left);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    bytes += written;
+    left -= (size_t)written;
+  }
+  return 0;
+}
+
+// The player exited or stopped reading; reap it and start another on a new pipe
+static int pipe_restart(AudioSink* base) {
+  PipeSink* sink = (PipeSink*)base;
+  if (sink->pid > 0) {
+    close(sink->fd);
+    kill(sink->pid, SIGTERM);  // In case it closed its input but is still running
+    waitpid(sink->pid, NULL, 0);
+  }
+  sink->pid = spawn_pipe_player(sink->player, base->sample_rate, base->channels, &sink->fd);
+  return sink->pid > 0 ? 0 : -1;
+}
+
+static void pipe_close(AudioSink* base) {
+  PipeSink* sink = (PipeSink*)base;
+  if (sink->pid > 0) {
+    close(sink->fd);  // The player drains what it has and exits on end of input
+    waitpid(sink->pid, NULL, 0);
+  }
+  free(sink);
+}
+
+static AudioSink* open_pipe_sink(uint32_t sample_rate, uint32_t channels) {
+  // Probe once, here; every sound after that is just more bytes down the same pipe
+  int player = -1;
+  for (int i = 0; i < 3 && player < 0; i++) {
+    if (program_on_path(pipe_players[i]))
+      player = i;
+  }
+  if (player < 0)
+    return NULL;
+
+  PipeSink* sink = (PipeSink*)calloc(1, sizeof(PipeSink));
+  if (!sink)
+    return NULL;
+
+  sink->player = player;
+  sink->pid = spawn_pipe_player(player, sample_rate, channels, &sink->fd);
+  if (sink->pid < 0) {
+    free(sink);
+    return NULL;
+  }
+
+  // A player that dies should fail the next write, not kill the soundboard
+  signal(SIGPIPE, SIG_IGN);
+
+  int pipe_bytes = 65536;
+#ifdef F_GETPIPE_SZ
+  int size = fcntl(sink->fd, F_GETPIPE_SZ);
+  if (size > 0)
+    pipe_bytes = size;
+#endif
+
+  sink->base.name = pipe_players[player];
+  sink->base.sample_rate = sample_rate;
+  sink->base.channels = channels;
+  sink->base.latency_frames = SINK_LATENCY_FRAMES(sample_rate) +
+                              (uint32_t)pipe_bytes / (channels * (uint32_t)sizeof(int16_t));
+  sink->base.write = pipe_write;
+  sink->base.restart = pipe_restart;
+  sink->base.close = pipe_close;
+  return &sink->base;
+}
+#endif
+
+AudioSink* audio_sink_open(const char* spec, uint32_t sample_rate, uint32_t channels) {
+  if (spec && strcmp(spec, "null") == 0)
+    return open_paced_sink(NULL, 1, sample_rate, channels);
+  if (spec && strncmp(spec, "file:", 5) == 0)
+    return open_paced_sink(spec + 5, 1, sample_rate, channels);
+  if (spec && strncmp(spec, "bounce:", 7) == 0)
+    return open_paced_sink(spec + 7, 0, sample_rate, channels);
+
+  int is_auto = !spec || spec[0] == '\0' || strcmp(spec, "auto") == 0;
+  AudioSink* sink = NULL;
+#ifdef _WIN32
+  if (is_auto || strcmp(spec, "winmm") == 0)
+    sink = open_winmm_sink(sample_rate, channels);
+#else
+  if (is_auto || strcmp(spec, "pulse") == 0)
+    sink = open_pulse_sink(sample_rate, channels);
+  if (!sink && (is_auto || strcmp(spec, "alsa") == 0))
+    sink = open_alsa_sink(sample_rate, channels);
+  if (!sink && (is_auto || strcmp(spec, "pipe") == 0))
+    sink = open_pipe_sink(sample_rate, channels);
+#endif
+  return sink;
+}
+
+int audio_sink_write(AudioSink* sink, const int16_t* samples, uint32_t frames) {
+  return sink->write(sink, samples, frames);
+}
+
+void audio_sink_close(AudioSink* sink) {
+  if (sink)
+    sink->close(sink);
+}
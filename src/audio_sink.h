@@ -0,0 +1,38 @@
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include <stdint.h>
+
+// An output device the audio thread writes interleaved int16 frames into
+typedef struct AudioSink AudioSink;
+
+struct AudioSink {
+  const char* name;
+  uint32_t sample_rate;
+  uint32_t channels;
+  uint32_t latency_frames;  // Frames buffered between a write and the speaker
+  uint64_t underruns;  // Times the device ran out of audio, counted by backends that can tell
+
+  // Write frames, blocking until the device has room for them. Returns 0 on success, -1 on error
+  int (*write)(AudioSink* sink, const int16_t* samples, uint32_t frames);
+
+  // Reopen the device after writes kept failing, e.g. start a new player when the old one
+  // exited. Returns 0 on success, -1 on error. NULL for backends that can't
+  int (*restart)(AudioSink* sink);
+
+  // Flush pending audio and release the device
+  void (*close)(AudioSink* sink);
+};
+
+// Open a sink by name: "pulse", "alsa", "pipe", "winmm", "null", "file:<path>" or
+// "bounce:<path>", which writes a WAV as fast as it is fed instead of at the device rate.
+// NULL or "auto" picks the first device that opens, in that order. Returns NULL on failure
+AudioSink* audio_sink_open(const char* spec, uint32_t sample_rate, uint32_t channels);
+
+// Write frames to the sink
+int audio_sink_write(AudioSink* sink, const int16_t* samples, uint32_t frames);
+
+// Close the sink and free it
+void audio_sink_close(AudioSink* sink);
+
+#endif  // AUDIO_SINK_H
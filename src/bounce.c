@@ -0,0 +1,230 @@
+#include "bounce.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+#include "soundboard.h"
+#include "thread.h"
+
+typedef enum {
+  TRIGGER_PLAY,
+  TRIGGER_STOP,
+  TRIGGER_STOP_ALL,
+  TRIGGER_END,
+} TriggerType;
+
+typedef struct {
+  uint64_t frame;  // When the trigger fires, in frames from the start of the render
+  TriggerType type;
+  int tile;  // Sound the trigger applies to, for play and stop
+  int line;  // Keeps triggers at the same time in script order
+} Trigger;
+
+typedef struct {
+  Trigger* triggers;
+  size_t count;
+  size_t capacity;
+} TriggerList;
+
+static int compare_triggers(const void* a, const void* b) {
+  const Trigger* ta = (const Trigger*)a;
+  const Trigger* tb = (const Trigger*)b;
+  if (ta->frame != tb->frame)
+    return ta->frame < tb->frame ? -1 : 1;
+  return ta->line - tb->line;
+}
+
+static char* trim(char* text) {
+  while (isspace((unsigned char)*text))
+    text++;
+  size_t length = strlen(text);
+  while (length > 0 && isspace((unsigned char)text[length - 1]))
+    text[--length] = '\0';
+  return text;
+}
+
+static int add_trigger(TriggerList* list, const Trigger* trigger) {
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 64;
+    Trigger* grown = (Trigger*)realloc(list->triggers, capacity * sizeof(Trigger));
+    if (!grown)
+      return 0;
+    list->triggers = grown;
+    list->capacity = capacity;
+  }
+  list->triggers[list->count++] = *trigger;
+  return 1;
+}
+
+// Parse the script into triggers sorted by time. Reports the first bad line and returns 0
+static int load_script(const char* script_path, const Soundboard* sb, TriggerList* list) {
+  FILE* file = fopen(script_path, "r");
+  if (!file) {
+    fprintf(stderr, "Failed to open trigger script %s\n", script_path);
+    return 0;
+  }
+
+  char* line = NULL;
+  size_t capacity = 0;
+  int line_number = 0;
+  int ok = 1;
+  while (ok && read_line(file, &line, &capacity)) {
+    line_number++;
+    char* text = trim(line);
+    if (text[0] == '\0' || text[0] == '#')
+      continue;
+
+    double seconds;
+    char action[16];
+    int consumed = 0;
+    if (sscanf(text, "%lf %15s %n", &seconds, action, &consumed) < 2 || !(seconds >= 0.0)) {
+      fprintf(
+          stderr, "%s:%d: expected \"<seconds> <action> [sound]\"\n", script_path, line_number);
+      ok = 0;
+      break;
+    }
+    const char* argument = text + consumed;
+
+    Trigger trigger;
+    trigger.frame = (uint64_t)llround(seconds * AUDIO_SAMPLE_RATE);
+    trigger.tile = -1;
+    trigger.line = line_number;
+    if (strcmp(action, "play") == 0 || strcmp(action, "stop") == 0) {
+      trigger.type = action[1] == 'l' ? TRIGGER_PLAY : TRIGGER_STOP;
+      trigger.tile = find_tile(sb, argument);
+      if (trigger.tile < 0) {
+        fprintf(stderr, "%s:%d: no sound named \"%s\"\n", script_path, line_number, argument);
+        ok = 0;
+      }
+    } else if (strcmp(action, "stopall") == 0) {
+      trigger.type = TRIGGER_STOP_ALL;
+    } else if (strcmp(action, "end") == 0) {
+      trigger.type = TRIGGER_END;
+    } else {
+      fprintf(stderr, "%s:%d: unknown action \"%s\"\n", script_path, line_number, action);
+      ok = 0;
+    }
+
+    if (ok && !add_trigger(list, &trigger)) {
+      fprintf(stderr, "Out of memory reading %s\n", script_path);
+      ok = 0;
+    }
+  }
+  free(line);
+  fclose(file);
+
+  if (ok && list->count > 0)
+    qsort(list->triggers, list->count, sizeof(Trigger), compare_triggers);
+  return ok;
+}
+
+// Loudness gains must be known before the first trigger, or the output would depend on how fast
+// the analysis ran
+static void wait_for_analysis(Soundboard* sb) {
+  if (!sb->loudness)
+    return;
+  for (;;) {
+    LoudnessCacheStats stats;
+    loudness_cache_get_stats(sb->loudness, &stats);
+    if (stats.pending == 0)
+      return;
+    sleep_ns(10000000ULL);
+  }
+}
+
+static int any_voice_busy(const Soundboard* sb) {
+  for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+    if (audio_engine_voice_busy(sb->audio, i))
+      return 1;
+  }
+  return 0;
+}
+
+int bounce_script(const char* script_path, const char* wav_path) {
+  Soundboard sb = {0};
+  if (!init_offline_audio(&sb, wav_path)) {
+    fprintf(stderr, "Failed to open %s for writing\n", wav_path);
+    shutdown_audio(&sb);
+    return 0;
+  }
+
+  uint64_t load_start = time_ns();
+  init_analysis(&sb);
+  load_sounds(&sb);
+
+  TriggerList list = {0};
+  if (!load_script(script_path, &sb, &list)) {
+    free(list.triggers);
+    close_library(&sb);
+    shutdown_analysis(&sb);
+    shutdown_audio(&sb);
+    return 0;
+  }
+  wait_for_analysis(&sb);
+  uint64_t load_ns = time_ns() - load_start;
+
+  uint64_t render_start = time_ns();
+  uint64_t frame = 0;
+  uint64_t end_frame = UINT64_MAX;
+  size_t next = 0;
+  int ok = 1;
+  for (;;) {
+    uint64_t period_end = frame + AUDIO_PERIOD_FRAMES;
+    for (; next < list.count && list.triggers[next].frame < period_end; next++) {
+      const Trigger* trigger = &list.triggers[next];
+      audio_engine_schedule(sb.audio, (uint32_t)(trigger->frame - frame));
+      switch (trigger->type) {
+        case TRIGGER_PLAY:
+          play_sound(audio_path(&sb, trigger->tile), &sb, trigger->tile);
+          break;
+        case TRIGGER_STOP:
+          stop_tile(&sb, trigger->tile);
+          break;
+        case TRIGGER_STOP_ALL:
+          audio_engine_stop_all(sb.audio);
+          break;
+        case TRIGGER_END:
+          if (trigger->frame < end_frame)
+            end_frame = trigger->frame;
+          break;
+      }
+    }
+
+    // An end line cuts the render at the period it falls in; otherwise it runs out the sounds
+    if (end_frame != UINT64_MAX ? frame >= end_frame : next == list.count && !any_voice_busy(&sb))
+      break;
+
+    if (!audio_engine_render(sb.audio)) {
+      ok = 0;
+      break;
+    }
+    update_playback(&sb);
+    frame = period_end;
+  }
+  uint64_t render_ns = time_ns() - render_start;
+  free(list.triggers);
+
+  int sounds = sb.count;
+  close_library(&sb);
+  shutdown_analysis(&sb);
+  shutdown_audio(&sb);  // Closing the sink finishes the WAV header
+  if (!ok)
+    return 0;
+
+  double audio_seconds = (double)frame / AUDIO_SAMPLE_RATE;
+  double render_seconds = (double)render_ns / 1e9;
+  printf(
+      "Rendered %.2f s of audio to %s in %.3f s (%.1fx real time), after %.2f s loading %d "
+      "sounds\n",
+      audio_seconds,
+      wav_path,
+      render_seconds,
+      render_seconds > 0.0 ? audio_seconds / render_seconds : 0.0,
+      (double)load_ns / 1e9,
+      sounds);
+  return 1;
+}
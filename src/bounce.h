@@ -0,0 +1,19 @@
+#ifndef BOUNCE_H
+#define BOUNCE_H
+
+// Render a trigger script against the sound library in the current directory into a WAV file,
+// as fast as the CPU allows, without opening a window. One trigger per line:
+//
+//   <seconds> play <sound>
+//   <seconds> stop <sound>
+//   <seconds> stopall
+//   <seconds> end
+//
+// where <sound> is a path as listed by the soundboard, with or without its leading "./".
+// Blank lines and lines starting with '#' are ignored. play, stop and stopall land on the exact
+// frame their time names; "end" finishes the AUDIO_PERIOD_FRAMES (256-frame) period it falls in.
+// Without an "end" the render runs until every sound has finished. Prints the real-time factor
+// achieved. Returns 1 on success
+int bounce_script(const char* script_path, const char* wav_path);
+
+#endif  // BOUNCE_H
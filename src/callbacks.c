@@ -1,6 +1,7 @@
 #include "callbacks.h"
 
 #include <math.h>
+#include <string.h>
 
 #include "renderer.h"
 #include "soundboard.h"
@@ -26,7 +27,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
   sb->scroll_offset += (float)yoffset * 20.0f;
 
   // Calculate total rows needed for grid layout
-  int total_rows = (sb->count + sb->grid_cols - 1) / sb->grid_cols;
+  int total_rows = (sb->shown_count + sb->grid_cols - 1) / sb->grid_cols;
   float max_offset = (total_rows * (TILE_HEIGHT + TILE_SPACING)) - sb->window_height + 50.0f;
 
   if (sb->scroll_offset < 0.0f)
@@ -53,33 +54,30 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     sb->hovered_refresh_button = 1;
   } else {
   */
-  for (int i = 0; i < sb->count; i++) {
-    int row = i / sb->grid_cols;
-    int col = i % sb->grid_cols;
-    float tile_x = 50.0f + col * (TILE_WIDTH + TILE_SPACING);
-    float tile_y =
-        sb->window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) - sb->scroll_offset;
-    if (xpos >= tile_x && xpos <= tile_x + TILE_WIDTH && ypos >= tile_y &&
-        ypos <= tile_y + TILE_HEIGHT) {
-      sb->hovered_tile = i;
-      break;
-    }
-  }
+  sb->hovered_tile = tile_at(sb, xpos, ypos);
   //}
 
   // Reset marquee offset when hovering changes
   if (old_hovered != sb->hovered_tile) {
     if (old_hovered >= 0 && old_hovered < sb->count) {
-      sb->sounds[old_hovered].marquee_offset = 0.0f;
+      sb->tiles[old_hovered].marquee_offset = 0.0f;
     }
     if (sb->hovered_tile >= 0 && sb->hovered_tile < sb->count) {
-      sb->sounds[sb->hovered_tile].marquee_offset = 0.0f;
+      sb->tiles[sb->hovered_tile].marquee_offset = 0.0f;
     }
   }
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
   (void)mods;  // Suppress unused parameter warning
+  if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
+    // Right-click stops whatever is playing on the tile under the cursor
+    Soundboard* sb = (Soundboard*)glfwGetWindowUserPointer(window);
+    if (sb->hovered_tile >= 0 && sb->hovered_tile < sb->count)
+      stop_tile(sb, sb->hovered_tile);
+    return;
+  }
+
   if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
     Soundboard* sb = (Soundboard*)glfwGetWindowUserPointer(window);
     double xpos, ypos;
@@ -98,19 +96,38 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     }
     */
 
-    for (int i = 0; i < sb->count; i++) {
-      int row = i / sb->grid_cols;
-      int col = i % sb->grid_cols;
+    int tile = tile_at(sb, xpos, ypos);
+    if (tile >= 0)
+      play_sound(audio_path(sb, tile), sb, tile);
+  }
+}
 
-      float tile_x = 50.0f + col * (TILE_WIDTH + TILE_SPACING);
-      float tile_y =
-          sb->window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) - sb->scroll_offset;
+void char_callback(GLFWwindow* window, unsigned int codepoint) {
+  Soundboard* sb = (Soundboard*)glfwGetWindowUserPointer(window);
+  size_t length = strlen(sb->search_query);
+  if (codepoint < 0x20 || codepoint > 0x7E || length + 1 >= sizeof(sb->search_query))
+    return;  // Sound names are matched byte for byte, ignoring ASCII case only
+
+  char query[SEARCH_QUERY_MAX];
+  memcpy(query, sb->search_query, length);
+  query[length] = (char)codepoint;
+  query[length + 1] = '\0';
+  set_search(sb, query);
+}
 
-      if (xpos >= tile_x && xpos <= tile_x + TILE_WIDTH && ypos >= tile_y &&
-          ypos <= tile_y + TILE_HEIGHT) {
-        play_sound(sb->sounds[i].path, sb, i);
-        break;
-      }
-    }
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+  (void)scancode;
+  (void)mods;
+  if (action != GLFW_PRESS && action != GLFW_REPEAT)
+    return;
+  Soundboard* sb = (Soundboard*)glfwGetWindowUserPointer(window);
+  size_t length = strlen(sb->search_query);
+  if (key == GLFW_KEY_BACKSPACE && length > 0) {
+    char query[SEARCH_QUERY_MAX];
+    memcpy(query, sb->search_query, length - 1);
+    query[length - 1] = '\0';
+    set_search(sb, query);
+  } else if (key == GLFW_KEY_ESCAPE && length > 0) {
+    set_search(sb, "");
   }
 }
@@ -12,4 +12,9 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 
+// Typing filters the grid: characters go into the search field, Backspace takes the last one
+// back and Escape clears it
+void char_callback(GLFWwindow* window, unsigned int codepoint);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
 #endif  // CALLBACKS_H
@@ -0,0 +1,631 @@
+#include "convert.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define CONVERT_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define CONVERT_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON)
+#define CONVERT_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Resampler filter: RESAMPLER_TAPS input frames per output, RESAMPLER_PHASES sub-sample offsets
+// tabulated and linearly interpolated between
+#define RESAMPLER_TAPS 32
+#define RESAMPLER_PHASES 128
+#define RESAMPLER_KAISER_BETA 8.0
+
+#define S16_SCALE (1.0f / 32768.0f)
+#define S32_SCALE (1.0f / 2147483648.0f)
+#define U8_SCALE (1.0f / 128.0f)
+
+typedef struct {
+  const char* name;
+  void (*u8_to_f32)(float* dst, const uint8_t* src, uint32_t count);
+  void (*s16_to_f32)(float* dst, const int16_t* src, uint32_t count);
+  void (*s24_to_f32)(float* dst, const uint8_t* src, uint32_t count);
+  void (*s32_to_f32)(float* dst, const int32_t* src, uint32_t count);
+  void (*f32_to_s16)(int16_t* dst, const float* src, uint32_t count);
+  // Stereo dot product of the interpolated phase (c0 + frac * (c1 - c0)) with both channels
+  void (*dot2)(
+      const float* c0,
+      const float* c1,
+      float frac,
+      const float* left,
+      const float* right,
+      float* out);
+} ConvertKernels;
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+
+static void u8_to_f32_scalar(float* dst, const uint8_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    dst[i] = (float)((int)src[i] - 128) * U8_SCALE;
+}
+
+static void s16_to_f32_scalar(float* dst, const int16_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    dst[i] = (float)src[i] * S16_SCALE;
+}
+
+static void s24_to_f32_scalar(float* dst, const uint8_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t* s = src + (size_t)i * 3;
+    int32_t value = (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) |
+                              ((uint32_t)s[2] << 24));
+    dst[i] = (float)value * S32_SCALE;
+  }
+}
+
+static void s32_to_f32_scalar(float* dst, const int32_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    dst[i] = (float)src[i] * S32_SCALE;
+}
+
+static void f32_to_s16_scalar(int16_t* dst, const float* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    float value = src[i] * 32768.0f;
+    if (value >= 32767.0f)
+      dst[i] = 32767;
+    else if (value <= -32768.0f)
+      dst[i] = -32768;
+    else
+      dst[i] = (int16_t)lrintf(value);
+  }
+}
+
+static void dot2_scalar(
+    const float* c0,
+    const float* c1,
+    float frac,
+    const float* left,
+    const float* right,
+    float* out) {
+  float sum_l = 0.0f;
+  float sum_r = 0.0f;
+  for (int k = 0; k < RESAMPLER_TAPS; k++) {
+    float c = c0[k] + frac * (c1[k] - c0[k]);
+    sum_l += c * left[k];
+    sum_r += c * right[k];
+  }
+  out[0] = sum_l;
+  out[1] = sum_r;
+}
+
+// ---------------------------------------------------------------------------
+// SSE2 / SSSE3
+
+#ifdef CONVERT_HAVE_SSE2
+static void u8_to_f32_sse2(float* dst, const uint8_t* src, uint32_t count) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i bias = _mm_set1_epi16(128);
+  __m128 scale = _mm_set1_ps(U8_SCALE);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(s, zero), bias);
+    __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(s, zero), bias);
+    __m128i parts[4] = {
+        _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16),
+        _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16),
+        _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16),
+        _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16),
+    };
+    for (int j = 0; j < 4; j++)
+      _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_cvtepi32_ps(parts[j]), scale));
+  }
+  u8_to_f32_scalar(dst + i, src + i, count - i);
+}
+
+static void s16_to_f32_sse2(float* dst, const int16_t* src, uint32_t count) {
+  __m128 scale = _mm_set1_ps(S16_SCALE);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  s16_to_f32_scalar(dst + i, src + i, count - i);
+}
+
+static void s32_to_f32_sse2(float* dst, const int32_t* src, uint32_t count) {
+  __m128 scale = _mm_set1_ps(S32_SCALE);
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+  }
+  s32_to_f32_scalar(dst + i, src + i, count - i);
+}
+
+static void f32_to_s16_sse2(int16_t* dst, const float* src, uint32_t count) {
+  __m128 scale = _mm_set1_ps(32768.0f);
+  __m128 max = _mm_set1_ps(32767.0f);
+  __m128 min = _mm_set1_ps(-32768.0f);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+    __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+    a = _mm_min_ps(_mm_max_ps(a, min), max);
+    b = _mm_min_ps(_mm_max_ps(b, min), max);
+    _mm_storeu_si128(
+        (__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+  }
+  f32_to_s16_scalar(dst + i, src + i, count - i);
+}
+
+static void dot2_sse2(
+    const float* c0,
+    const float* c1,
+    float frac,
+    const float* left,
+    const float* right,
+    float* out) {
+  __m128 f = _mm_set1_ps(frac);
+  __m128 sum_l = _mm_setzero_ps();
+  __m128 sum_r = _mm_setzero_ps();
+  for (int k = 0; k < RESAMPLER_TAPS; k += 4) {
+    __m128 a = _mm_loadu_ps(c0 + k);
+    __m128 c = _mm_add_ps(a, _mm_mul_ps(f, _mm_sub_ps(_mm_loadu_ps(c1 + k), a)));
+    sum_l = _mm_add_ps(sum_l, _mm_mul_ps(c, _mm_loadu_ps(left + k)));
+    sum_r = _mm_add_ps(sum_r, _mm_mul_ps(c, _mm_loadu_ps(right + k)));
+  }
+
+  // Horizontal add of both accumulators at once: (l0+l1+l2+l3, r0+r1+r2+r3)
+  __m128 lo = _mm_unpacklo_ps(sum_l, sum_r);
+  __m128 hi = _mm_unpackhi_ps(sum_l, sum_r);
+  __m128 sum = _mm_add_ps(lo, hi);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  _mm_storel_pi((__m64*)out, sum);
+}
+#endif
+
+#ifdef CONVERT_HAVE_AVX2
+__attribute__((target("ssse3"))) static void s24_to_f32_ssse3(
+    float* dst,
+    const uint8_t* src,
+    uint32_t count) {
+  // Move each 3-byte sample into the top of an int32 lane; the low byte is zeroed
+  __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  __m128 scale = _mm_set1_ps(S32_SCALE);
+  uint32_t i = 0;
+  // Each step reads 16 bytes but only uses 12, so stop while a full load still fits
+  for (; i + 6 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 3));
+    __m128i v = _mm_shuffle_epi8(s, shuffle);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+  }
+  s24_to_f32_scalar(dst + i, src + (size_t)i * 3, count - i);
+}
+
+__attribute__((target("avx2"))) static void s16_to_f32_avx2(
+    float* dst,
+    const int16_t* src,
+    uint32_t count) {
+  __m256 scale = _mm256_set1_ps(S16_SCALE);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+  }
+  s16_to_f32_sse2(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void f32_to_s16_avx2(
+    int16_t* dst,
+    const float* src,
+    uint32_t count) {
+  __m256 scale = _mm256_set1_ps(32768.0f);
+  __m256 max = _mm256_set1_ps(32767.0f);
+  __m256 min = _mm256_set1_ps(-32768.0f);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+    __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+    a = _mm256_min_ps(_mm256_max_ps(a, min), max);
+    b = _mm256_min_ps(_mm256_max_ps(b, min), max);
+    __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  f32_to_s16_sse2(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void dot2_avx2(
+    const float* c0,
+    const float* c1,
+    float frac,
+    const float* left,
+    const float* right,
+    float* out) {
+  __m256 f = _mm256_set1_ps(frac);
+  __m256 sum_l = _mm256_setzero_ps();
+  __m256 sum_r = _mm256_setzero_ps();
+  for (int k = 0; k < RESAMPLER_TAPS; k += 8) {
+    __m256 a = _mm256_loadu_ps(c0 + k);
+    __m256 c = _mm256_add_ps(a, _mm256_mul_ps(f, _mm256_sub_ps(_mm256_loadu_ps(c1 + k), a)));
+    sum_l = _mm256_add_ps(sum_l, _mm256_mul_ps(c, _mm256_loadu_ps(left + k)));
+    sum_r = _mm256_add_ps(sum_r, _mm256_mul_ps(c, _mm256_loadu_ps(right + k)));
+  }
+
+  __m128 l = _mm_add_ps(_mm256_castps256_ps128(sum_l), _mm256_extractf128_ps(sum_l, 1));
+  __m128 r = _mm_add_ps(_mm256_castps256_ps128(sum_r), _mm256_extractf128_ps(sum_r, 1));
+  __m128 sum = _mm_add_ps(_mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  _mm_storel_pi((__m64*)out, sum);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// NEON
+
+#ifdef CONVERT_HAVE_NEON
+static void s16_to_f32_neon(float* dst, const int16_t* src, uint32_t count) {
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t s = vld1q_s16(src + i);
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), S16_SCALE));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), S16_SCALE));
+  }
+  s16_to_f32_scalar(dst + i, src + i, count - i);
+}
+
+static void f32_to_s16_neon(int16_t* dst, const float* src, uint32_t count) {
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int32x4_t lo = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f));
+    int32x4_t hi = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f));
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+  f32_to_s16_scalar(dst + i, src + i, count - i);
+}
+
+static void dot2_neon(
+    const float* c0,
+    const float* c1,
+    float frac,
+    const float* left,
+    const float* right,
+    float* out) {
+  float32x4_t sum_l = vdupq_n_f32(0.0f);
+  float32x4_t sum_r = vdupq_n_f32(0.0f);
+  for (int k = 0; k < RESAMPLER_TAPS; k += 4) {
+    float32x4_t a = vld1q_f32(c0 + k);
+    float32x4_t c = vmlaq_n_f32(a, vsubq_f32(vld1q_f32(c1 + k), a), frac);
+    sum_l = vmlaq_f32(sum_l, c, vld1q_f32(left + k));
+    sum_r = vmlaq_f32(sum_r, c, vld1q_f32(right + k));
+  }
+  out[0] = vaddvq_f32(sum_l);
+  out[1] = vaddvq_f32(sum_r);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch
+
+static const ConvertKernels scalar_kernels = {
+    "scalar",
+    u8_to_f32_scalar,
+    s16_to_f32_scalar,
+    s24_to_f32_scalar,
+    s32_to_f32_scalar,
+    f32_to_s16_scalar,
+    dot2_scalar,
+};
+
+static int force_scalar = 0;
+
+static const ConvertKernels* select_kernels(void) {
+  static ConvertKernels best;
+  best = scalar_kernels;
+#ifdef CONVERT_HAVE_SSE2
+  best.name = "sse2";
+  best.u8_to_f32 = u8_to_f32_sse2;
+  best.s16_to_f32 = s16_to_f32_sse2;
+  best.s32_to_f32 = s32_to_f32_sse2;
+  best.f32_to_s16 = f32_to_s16_sse2;
+  best.dot2 = dot2_sse2;
+#endif
+#ifdef CONVERT_HAVE_AVX2
+  if (__builtin_cpu_supports("ssse3"))
+    best.s24_to_f32 = s24_to_f32_ssse3;
+  if (__builtin_cpu_supports("avx2")) {
+    best.name = "avx2";
+    best.s16_to_f32 = s16_to_f32_avx2;
+    best.f32_to_s16 = f32_to_s16_avx2;
+    best.dot2 = dot2_avx2;
+  }
+#endif
+#ifdef CONVERT_HAVE_NEON
+  best.name = "neon";
+  best.s16_to_f32 = s16_to_f32_neon;
+  best.f32_to_s16 = f32_to_s16_neon;
+  best.dot2 = dot2_neon;
+#endif
+  return &best;
+}
+
+static const ConvertKernels* kernels(void) {
+  static const ConvertKernels* selected = NULL;
+  if (__atomic_load_n(&force_scalar, __ATOMIC_RELAXED))
+    return &scalar_kernels;
+
+  const ConvertKernels* k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+  if (!k) {
+    k = select_kernels();
+    __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+uint32_t sample_format_bytes(SampleFormat format) {
+  switch (format) {
+    case SAMPLE_U8:
+      return 1;
+    case SAMPLE_S16:
+      return 2;
+    case SAMPLE_S24:
+      return 3;
+    case SAMPLE_S32:
+    case SAMPLE_F32:
+      return 4;
+  }
+  return 0;
+}
+
+void convert_to_f32(float* dst, const void* src, SampleFormat format, uint32_t count) {
+  const ConvertKernels* k = kernels();
+  switch (format) {
+    case SAMPLE_U8:
+      k->u8_to_f32(dst, (const uint8_t*)src, count);
+      break;
+    case SAMPLE_S16:
+      k->s16_to_f32(dst, (const int16_t*)src, count);
+      break;
+    case SAMPLE_S24:
+      k->s24_to_f32(dst, (const uint8_t*)src, count);
+      break;
+    case SAMPLE_S32:
+      k->s32_to_f32(dst, (const int32_t*)src, count);
+      break;
+    case SAMPLE_F32:
+      memmove(dst, src, (size_t)count * sizeof(float));
+      break;
+  }
+}
+
+void convert_f32_to_s16(int16_t* dst, const float* src, uint32_t count) {
+  kernels()->f32_to_s16(dst, src, count);
+}
+
+void convert_to_stereo(float* dst, const float* src, uint32_t src_channels, uint32_t frames) {
+  if (src_channels == 2) {
+    memmove(dst, src, (size_t)frames * 2 * sizeof(float));
+    return;
+  }
+
+  // Both directions keep dst == src safe: mono widens from the end, more channels narrow
+  // from the start
+  if (src_channels == 1) {
+    for (uint32_t i = frames; i-- > 0;) {
+      dst[i * 2] = src[i];
+      dst[i * 2 + 1] = src[i];
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < frames; i++) {
+    const float* frame = src + (size_t)i * src_channels;
+    float left = frame[0];
+    float right = frame[1];
+    dst[i * 2] = left;
+    dst[i * 2 + 1] = right;
+  }
+}
+
+const char* convert_kernel_name(void) {
+  return kernels()->name;
+}
+
+void convert_force_scalar(int enabled) {
+  __atomic_store_n(&force_scalar, enabled, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------
+// Polyphase resampler
+
+struct Resampler {
+  uint64_t step;  // Input frames per output frame, 32.32 fixed point
+  uint64_t position;  // Centre of the next output, 32.32 relative to history[0]
+  float* coefs;  // (RESAMPLER_PHASES + 1) rows of RESAMPLER_TAPS
+  float* history[2];  // Planar input still needed by the filter
+  uint32_t history_len;
+  uint32_t history_cap;
+  int flushed;
+};
+
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+static void build_filter(float* coefs, double cutoff) {
+  const double pi = 3.14159265358979323846;
+  const double half = RESAMPLER_TAPS / 2;
+  double i0_beta = bessel_i0(RESAMPLER_KAISER_BETA);
+
+  for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+    float* row = coefs + (size_t)p * RESAMPLER_TAPS;
+    double frac = (double)p / RESAMPLER_PHASES;
+    double sum = 0.0;
+    for (int k = 0; k < RESAMPLER_TAPS; k++) {
+      // Tap k sits at input frame (centre - half + 1 + k); x is its distance from the output
+      double x = (double)(k - half + 1) - frac;
+      double sinc = x == 0.0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+      double w = x / half;
+      double window = fabs(w) >= 1.0 ? 0.0
+                                     : bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - w * w)) /
+                                           i0_beta;
+      row[k] = (float)(cutoff * sinc * window);
+      sum += row[k];
+    }
+
+    // Unity gain at DC for every phase
+    for (int k = 0; k < RESAMPLER_TAPS; k++)
+      row[k] = (float)(row[k] / sum);
+  }
+}
+
+Resampler* resampler_create(uint32_t in_rate, uint32_t out_rate) {
+  Resampler* resampler = (Resampler*)calloc(1, sizeof(Resampler));
+  if (!resampler)
+    return NULL;
+
+  resampler->step = ((uint64_t)in_rate << 32) / out_rate;
+  resampler->coefs =
+      (float*)malloc((size_t)(RESAMPLER_PHASES + 1) * RESAMPLER_TAPS * sizeof(float));
+  resampler->history_cap = 4096;
+  resampler->history[0] = (float*)calloc(resampler->history_cap, sizeof(float));
+  resampler->history[1] = (float*)calloc(resampler->history_cap, sizeof(float));
+  if (!resampler->coefs || !resampler->history[0] || !resampler->history[1]) {
+    resampler_destroy(resampler);
+    return NULL;
+  }
+
+  // Downsampling lowers the cutoff below the output Nyquist to keep images out of band
+  double cutoff = in_rate > out_rate ? (double)out_rate / in_rate : 1.0;
+  build_filter(resampler->coefs, cutoff * 0.95);
+
+  // Pre-roll with silence so the first output is centred on the first input frame
+  resampler->history_len = RESAMPLER_TAPS / 2 - 1;
+  resampler->position = (uint64_t)(RESAMPLER_TAPS / 2 - 1) << 32;
+  return resampler;
+}
+
+void resampler_destroy(Resampler* resampler) {
+  if (!resampler)
+    return;
+  free(resampler->coefs);
+  free(resampler->history[0]);
+  free(resampler->history[1]);
+  free(resampler);
+}
+
+uint64_t resampler_seek(Resampler* resampler, uint64_t out_frame) {
+  // out_frame * step in 32.32, split so it can't overflow: the fraction stays the filter phase
+  uint64_t frac = out_frame * (resampler->step & 0xFFFFFFFFULL);
+  uint64_t in_frame = out_frame * (resampler->step >> 32) + (frac >> 32);
+
+  // The filter reaches back preroll frames: ask for them, or silence before the first frame
+  uint32_t preroll = RESAMPLER_TAPS / 2 - 1;
+  uint32_t lead = in_frame < preroll ? (uint32_t)in_frame : preroll;
+  memset(resampler->history[0], 0, (preroll - lead) * sizeof(float));
+  memset(resampler->history[1], 0, (preroll - lead) * sizeof(float));
+  resampler->history_len = preroll - lead;
+  resampler->position = ((uint64_t)preroll << 32) | (frac & 0xFFFFFFFFULL);
+  resampler->flushed = 0;
+  return in_frame - lead;
+}
+
+uint32_t resampler_max_output(const Resampler* resampler, uint32_t in_frames) {
+  uint64_t frames = ((uint64_t)(in_frames + RESAMPLER_TAPS) << 32) / resampler->step;
+  return (uint32_t)frames + 2;
+}
+
+static int append_history(Resampler* resampler, const float* in, uint32_t frames, int silence) {
+  uint32_t needed = resampler->history_len + frames;
+  if (needed > resampler->history_cap) {
+    uint32_t cap = resampler->history_cap;
+    while (cap < needed)
+      cap *= 2;
+    for (int ch = 0; ch < 2; ch++) {
+      float* grown = (float*)realloc(resampler->history[ch], cap * sizeof(float));
+      if (!grown)
+        return 0;
+      resampler->history[ch] = grown;
+    }
+    resampler->history_cap = cap;
+  }
+
+  float* left = resampler->history[0] + resampler->history_len;
+  float* right = resampler->history[1] + resampler->history_len;
+  for (uint32_t i = 0; i < frames; i++) {
+    left[i] = silence ? 0.0f : in[i * 2];
+    right[i] = silence ? 0.0f : in[i * 2 + 1];
+  }
+  resampler->history_len = needed;
+  return 1;
+}
+
+uint32_t resampler_process(
+    Resampler* resampler,
+    const float* in,
+    uint32_t in_frames,
+    float* out,
+    uint32_t out_capacity) {
+  if (in_frames > 0) {
+    if (!append_history(resampler, in, in_frames, 0))
+      return 0;
+  } else if (!resampler->flushed) {
+    // End of stream: run the filter over trailing silence to drain its tail
+    if (!append_history(resampler, NULL, RESAMPLER_TAPS / 2, 1))
+      return 0;
+    resampler->flushed = 1;
+  }
+
+  const ConvertKernels* k = kernels();
+  const uint32_t before = RESAMPLER_TAPS / 2 - 1;
+  uint32_t produced = 0;
+  while (produced < out_capacity) {
+    uint32_t centre = (uint32_t)(resampler->position >> 32);
+    if (centre + RESAMPLER_TAPS / 2 >= resampler->history_len)
+      break;
+
+    uint32_t frac_fixed = (uint32_t)(resampler->position & 0xFFFFFFFFULL);
+    uint64_t phase_fixed = (uint64_t)frac_fixed * RESAMPLER_PHASES;
+    uint32_t phase = (uint32_t)(phase_fixed >> 32);
+    float phase_frac = (float)(phase_fixed & 0xFFFFFFFFULL) / 4294967296.0f;
+
+    const float* c0 = resampler->coefs + (size_t)phase * RESAMPLER_TAPS;
+    k->dot2(
+        c0,
+        c0 + RESAMPLER_TAPS,
+        phase_frac,
+        resampler->history[0] + centre - before,
+        resampler->history[1] + centre - before,
+        out + (size_t)produced * 2);
+    produced++;
+    resampler->position += resampler->step;
+  }
+
+  // Drop input the filter has moved past
+  uint32_t centre = (uint32_t)(resampler->position >> 32);
+  if (centre > before) {
+    uint32_t drop = centre - before;
+    if (drop > resampler->history_len)
+      drop = resampler->history_len;
+    uint32_t keep = resampler->history_len - drop;
+    memmove(resampler->history[0], resampler->history[0] + drop, keep * sizeof(float));
+    memmove(resampler->history[1], resampler->history[1] + drop, keep * sizeof(float));
+    resampler->history_len = keep;
+    resampler->position -= (uint64_t)drop << 32;
+  }
+
+  return produced;
+}
@@ -0,0 +1,55 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdint.h>
+
+typedef enum {
+  SAMPLE_U8,
+  SAMPLE_S16,
+  SAMPLE_S24,  // Packed 3-byte little-endian
+  SAMPLE_S32,
+  SAMPLE_F32,
+} SampleFormat;
+
+// Bytes per sample of a format
+uint32_t sample_format_bytes(SampleFormat format);
+
+// Convert interleaved samples to float in [-1, 1). count is in samples, not frames
+void convert_to_f32(float* dst, const void* src, SampleFormat format, uint32_t count);
+
+// Convert float samples to int16 with rounding and saturation
+void convert_f32_to_s16(int16_t* dst, const float* src, uint32_t count);
+
+// Map interleaved float frames with src_channels channels onto stereo; dst may equal src.
+// Mono is duplicated; anything beyond the first two channels is dropped
+void convert_to_stereo(float* dst, const float* src, uint32_t src_channels, uint32_t frames);
+
+// Name of the kernel set picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* convert_kernel_name(void);
+
+// Force the scalar kernels (for benchmarks and bit-exactness checks)
+void convert_force_scalar(int enabled);
+
+// Streaming polyphase resampler for interleaved stereo float
+typedef struct Resampler Resampler;
+
+Resampler* resampler_create(uint32_t in_rate, uint32_t out_rate);
+void resampler_destroy(Resampler* resampler);
+
+// Forget all input and restart as if output frame out_frame were next. Feeding input from the
+// returned input frame on gives the same output as feeding it all from the start
+uint64_t resampler_seek(Resampler* resampler, uint64_t out_frame);
+
+// Output frames that in_frames more input frames will produce at most
+uint32_t resampler_max_output(const Resampler* resampler, uint32_t in_frames);
+
+// Feed in_frames of input and write up to out_capacity frames. Returns frames written.
+// All input is consumed; pass in_frames = 0 at end of stream to flush the filter tail
+uint32_t resampler_process(
+    Resampler* resampler,
+    const float* in,
+    uint32_t in_frames,
+    float* out,
+    uint32_t out_capacity);
+
+#endif  // CONVERT_H
@@ -0,0 +1,459 @@
+#include "decoder.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "convert.h"
+#include "pcm_buffer.h"
+#include "thread.h"
+#include "wav.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define str_casecmp _stricmp
+#else
+#include <dlfcn.h>
+#include <strings.h>
+#define str_casecmp strcasecmp
+#endif
+
+// ---------------------------------------------------------------------------
+// libsndfile, loaded on first use so it stays an optional runtime dependency
+
+typedef struct {
+  int64_t frames;
+  int samplerate;
+  int channels;
+  int format;
+  int sections;
+  int seekable;
+} SfInfo;
+
+#define SFM_READ 0x10
+
+typedef struct {
+  void* (*open)(const char*, int, SfInfo*);
+  int64_t (*readf_float)(void*, float*, int64_t);
+  int64_t (*seek)(void*, int64_t, int);
+  int (*close)(void*);
+} SndfileApi;
+
+static SndfileApi sndfile;
+static int sndfile_state = 0;  // 0 = not tried, 1 = loading, 2 = done (sndfile.open set if usable)
+
+static void load_sndfile(void) {
+#ifdef _WIN32
+  HMODULE library = LoadLibraryA("sndfile.dll");
+  if (!library)
+    return;
+  *(FARPROC*)&sndfile.open = GetProcAddress(library, "sf_open");
+  *(FARPROC*)&sndfile.readf_float = GetProcAddress(library, "sf_readf_float");
+  *(FARPROC*)&sndfile.seek = GetProcAddress(library, "sf_seek");
+  *(FARPROC*)&sndfile.close = GetProcAddress(library, "sf_close");
+#else
+  void* library = dlopen("libsndfile.so.1", RTLD_NOW);
+  if (!library)
+    return;
+  *(void**)&sndfile.open = dlsym(library, "sf_open");
+  *(void**)&sndfile.readf_float = dlsym(library, "sf_readf_float");
+  *(void**)&sndfile.seek = dlsym(library, "sf_seek");
+  *(void**)&sndfile.close = dlsym(library, "sf_close");
+#endif
+  if (!sndfile.open || !sndfile.readf_float || !sndfile.seek || !sndfile.close)
+    sndfile.open = NULL;
+}
+
+static const SndfileApi* get_sndfile(void) {
+  int expected = 0;
+  if (__atomic_compare_exchange_n(
+          &sndfile_state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    load_sndfile();
+    __atomic_store_n(&sndfile_state, 2, __ATOMIC_RELEASE);
+  }
+  while (__atomic_load_n(&sndfile_state, __ATOMIC_ACQUIRE) != 2)
+    sleep_ns(1000000ULL);
+  return sndfile.open ? &sndfile : NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Decoder: a source producing native frames as float, then the shared conversion pipeline
+
+struct Decoder {
+  // Read up to frames native frames as interleaved float; 0 at end of stream
+  uint32_t (*read_source)(Decoder* decoder, float* dst, uint32_t frames);
+  // Position the source at native frame frame. Returns 0 if it can't
+  int (*seek_source)(Decoder* decoder, uint64_t frame);
+  void (*close_source)(Decoder* decoder);
+  uint32_t channels;
+  uint32_t source_rate;
+  uint32_t frame_limit;  // Device-rate length; output stops here even if the resampler has more
+  uint32_t frames_out;
+
+  // WAV source
+  FILE* file;
+  SampleFormat format;
+  uint32_t block_align;
+  uint32_t data_frames;
+  uint64_t data_offset;
+  uint32_t frames_left;
+  unsigned char* raw;
+
+  // libsndfile source
+  void* sndfile;
+
+  Resampler* resampler;  // NULL when the file is already at the device rate
+  float* source;  // One chunk of source frames, widened to stereo in place
+  float* resampled;
+  uint32_t resampled_capacity;
+  const float* pending;  // Stereo frames converted but not yet handed out
+  uint32_t pending_count;
+  uint32_t pending_pos;
+  int flushed;
+};
+
+static uint32_t read_wav_source(Decoder* decoder, float* dst, uint32_t frames) {
+  if (frames > decoder->frames_left)
+    frames = decoder->frames_left;
+  frames = (uint32_t)fread(decoder->raw, decoder->block_align, frames, decoder->file);
+  decoder->frames_left = frames > 0 ? decoder->frames_left - frames : 0;
+  convert_to_f32(dst, decoder->raw, decoder->format, frames * decoder->channels);
+  return frames;
+}
+
+static int seek_wav_source(Decoder* decoder, uint64_t frame) {
+  if (frame > decoder->data_frames)
+    frame = decoder->data_frames;
+  uint64_t offset = decoder->data_offset + frame * decoder->block_align;
+  if (offset > LONG_MAX || fseek(decoder->file, (long)offset, SEEK_SET) != 0)
+    return 0;
+  decoder->frames_left = decoder->data_frames - (uint32_t)frame;
+  return 1;
+}
+
+static void close_wav_source(Decoder* decoder) {
+  fclose(decoder->file);
+  free(decoder->raw);
+}
+
+static int open_wav_source(Decoder* decoder, const char* path, uint32_t* source_frames) {
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return 0;
+
+  WavInfo info;
+  SampleFormat format;
+  if (!wav_read_info(f, &info) || !wav_sample_format(&info, &format) || info.channels == 0 ||
+      info.sample_rate == 0 || info.block_align != info.channels * sample_format_bytes(format) ||
+      fseek(f, (long)info.data_offset, SEEK_SET) != 0) {
+    fclose(f);
+    return 0;
+  }
+
+  decoder->raw = (unsigned char*)malloc((size_t)DECODER_CHUNK_FRAMES * info.block_align);
+  if (!decoder->raw) {
+    fclose(f);
+    return 0;
+  }
+
+  decoder->read_source = read_wav_source;
+  decoder->seek_source = seek_wav_source;
+  decoder->close_source = close_wav_source;
+  decoder->file = f;
+  decoder->format = format;
+  decoder->block_align = info.block_align;
+  decoder->channels = info.channels;
+  decoder->source_rate = info.sample_rate;
+  decoder->data_frames = info.data_size / info.block_align;
+  decoder->data_offset = info.data_offset;
+  decoder->frames_left = decoder->data_frames;
+  *source_frames = decoder->frames_left;
+  return 1;
+}
+
+static uint32_t read_sndfile_source(Decoder* decoder, float* dst, uint32_t frames) {
+  int64_t read = sndfile.readf_float(decoder->sndfile, dst, frames);
+  return read > 0 ? (uint32_t)read : 0;
+}
+
+static int seek_sndfile_source(Decoder* decoder, uint64_t frame) {
+  return sndfile.seek(decoder->sndfile, (int64_t)frame, SEEK_SET) >= 0;
+}
+
+static void close_sndfile_source(Decoder* decoder) {
+  sndfile.close(decoder->sndfile);
+}
+
+static int open_sndfile_source(Decoder* decoder, const char* path, uint32_t* source_frames) {
+  const SndfileApi* api = get_sndfile();
+  if (!api)
+    return 0;
+
+  SfInfo info;
+  memset(&info, 0, sizeof(info));
+  void* handle = api->open(path, SFM_READ, &info);
+  if (!handle)
+    return 0;
+  if (info.channels <= 0 || info.samplerate <= 0) {
+    api->close(handle);
+    return 0;
+  }
+
+  decoder->read_source = read_sndfile_source;
+  decoder->seek_source = seek_sndfile_source;
+  decoder->close_source = close_sndfile_source;
+  decoder->sndfile = handle;
+  decoder->channels = (uint32_t)info.channels;
+  decoder->source_rate = (uint32_t)info.samplerate;
+  // Streams that can't tell their length report a huge count; treat those as unknown
+  *source_frames = info.frames > 0 && info.frames < UINT32_MAX ? (uint32_t)info.frames : 0;
+  return 1;
+}
+
+// Source length converted to device-rate frames; UINT32_MAX when the source can't tell
+static uint32_t device_frames(uint32_t source_frames, uint32_t source_rate) {
+  if (source_frames == 0)
+    return UINT32_MAX;
+  return (uint32_t)(((uint64_t)source_frames * AUDIO_SAMPLE_RATE) / source_rate);
+}
+
+Decoder* decoder_open(const char* path) {
+  Decoder* decoder = (Decoder*)calloc(1, sizeof(Decoder));
+  if (!decoder)
+    return NULL;
+
+  // WAVs the native reader can't handle (ADPCM, A-law, ...) still get a chance with libsndfile
+  uint32_t source_frames = 0;
+  const char* ext = strrchr(path, '.');
+  int is_wav = ext && str_casecmp(ext, ".wav") == 0;
+  if (!(is_wav && open_wav_source(decoder, path, &source_frames)) &&
+      !open_sndfile_source(decoder, path, &source_frames)) {
+    free(decoder);
+    return NULL;
+  }
+
+  decoder->frame_limit = device_frames(source_frames, decoder->source_rate);
+
+  uint32_t width = decoder->channels > 2 ? decoder->channels : 2;
+  decoder->source = (float*)malloc((size_t)DECODER_CHUNK_FRAMES * width * sizeof(float));
+  int ok = decoder->source != NULL;
+  if (ok && decoder->source_rate != AUDIO_SAMPLE_RATE) {
+    decoder->resampler = resampler_create(decoder->source_rate, AUDIO_SAMPLE_RATE);
+    decoder->resampled_capacity =
+        decoder->resampler ? resampler_max_output(decoder->resampler, DECODER_CHUNK_FRAMES) : 0;
+    decoder->resampled =
+        (float*)malloc((size_t)decoder->resampled_capacity * AUDIO_CHANNELS * sizeof(float));
+    ok = decoder->resampler && decoder->resampled;
+  }
+
+  if (!ok) {
+    decoder_close(decoder);
+    return NULL;
+  }
+  return decoder;
+}
+
+void decoder_close(Decoder* decoder) {
+  if (!decoder)
+    return;
+  decoder->close_source(decoder);
+  resampler_destroy(decoder->resampler);
+  free(decoder->source);
+  free(decoder->resampled);
+  free(decoder);
+}
+
+// What a WAV's header says, if the native decoder can read it
+static int describe_wav(const WavInfo* wav, DecoderInfo* info) {
+  SampleFormat format;
+  if (!wav_sample_format(wav, &format) || wav->channels == 0 || wav->sample_rate == 0 ||
+      wav->block_align != wav->channels * sample_format_bytes(format))
+    return 0;
+  uint32_t frames = device_frames(wav->data_size / wav->block_align, wav->sample_rate);
+  info->frames = frames == UINT32_MAX ? 0 : frames;
+  info->source_rate = wav->sample_rate;
+  info->channels = wav->channels;
+  info->sample_bits = wav->bits_per_sample;
+  return 1;
+}
+
+int decoder_probe(const char* path, DecoderInfo* info) {
+  memset(info, 0, sizeof(*info));
+  const char* ext = strrchr(path, '.');
+  if (ext && str_casecmp(ext, ".wav") == 0) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+      return 0;
+    WavInfo wav;
+    int ok = wav_read_info(f, &wav) && describe_wav(&wav, info);
+    fclose(f);
+    if (ok)
+      return 1;
+  }
+
+  // Compressed files, and WAVs only libsndfile can read
+  const SndfileApi* api = get_sndfile();
+  if (!api)
+    return 0;
+  SfInfo sf;
+  memset(&sf, 0, sizeof(sf));
+  void* handle = api->open(path, SFM_READ, &sf);
+  if (!handle)
+    return 0;
+  api->close(handle);
+  if (sf.channels <= 0 || sf.samplerate <= 0 || sf.channels > UINT16_MAX)
+    return 0;
+  uint32_t source_frames = sf.frames > 0 && sf.frames < UINT32_MAX ? (uint32_t)sf.frames : 0;
+  uint32_t frames = device_frames(source_frames, (uint32_t)sf.samplerate);
+  info->frames = frames == UINT32_MAX ? 0 : frames;
+  info->source_rate = (uint32_t)sf.samplerate;
+  info->channels = (uint16_t)sf.channels;
+  return 1;
+}
+
+uint32_t decoder_frame_count(const Decoder* decoder) {
+  return decoder->frame_limit == UINT32_MAX ? 0 : decoder->frame_limit;
+}
+
+// Run the next source chunk through the pipeline. Returns 0 once nothing more can come out
+static int refill(Decoder* decoder) {
+  if (decoder->flushed)
+    return 0;
+
+  uint32_t frames = decoder->read_source(decoder, decoder->source, DECODER_CHUNK_FRAMES);
+  convert_to_stereo(decoder->source, decoder->source, decoder->channels, frames);
+
+  decoder->pending_pos = 0;
+  if (!decoder->resampler) {
+    decoder->pending = decoder->source;
+    decoder->pending_count = frames;
+    decoder->flushed = frames == 0;
+    return frames > 0;
+  }
+
+  // A zero-length feed at the end drains the filter tail
+  decoder->pending = decoder->resampled;
+  decoder->pending_count = resampler_process(
+      decoder->resampler,
+      decoder->source,
+      frames,
+      decoder->resampled,
+      decoder->resampled_capacity);
+  decoder->flushed = frames == 0;
+  return frames > 0 || decoder->pending_count > 0;
+}
+
+uint32_t decoder_read(Decoder* decoder, int16_t* out, uint32_t frames) {
+  uint32_t written = 0;
+  while (written < frames && decoder->frames_out < decoder->frame_limit) {
+    if (decoder->pending_pos == decoder->pending_count && !refill(decoder))
+      break;
+
+    uint32_t count = decoder->pending_count - decoder->pending_pos;
+    if (count > frames - written)
+      count = frames - written;
+    if (count > decoder->frame_limit - decoder->frames_out)
+      count = decoder->frame_limit - decoder->frames_out;
+    convert_f32_to_s16(
+        out + (size_t)written * AUDIO_CHANNELS,
+        decoder->pending + (size_t)decoder->pending_pos * AUDIO_CHANNELS,
+        count * AUDIO_CHANNELS);
+    decoder->pending_pos += count;
+    decoder->frames_out += count;
+    written += count;
+  }
+  return written;
+}
+
+int decoder_seek(Decoder* decoder, uint32_t frame) {
+  if (frame > decoder->frame_limit)
+    frame = decoder->frame_limit;
+  uint64_t source_frame = frame;
+  if (decoder->resampler)
+    source_frame = resampler_seek(decoder->resampler, frame);
+  if (!decoder->seek_source(decoder, source_frame)) {
+    if (decoder->resampler)
+      resampler_seek(decoder->resampler, 0);
+    return 0;
+  }
+
+  decoder->frames_out = frame;
+  decoder->pending_count = 0;
+  decoder->pending_pos = 0;
+  decoder->flushed = 0;
+  return 1;
+}
+
+int decoder_load_s16(const char* path, int16_t** out_samples, uint32_t* out_frames) {
+  Decoder* decoder = decoder_open(path);
+  if (!decoder)
+    return 0;
+
+  // Decoders that don't know their length grow the buffer as they go
+  uint32_t capacity = decoder->frame_limit != UINT32_MAX ? decoder->frame_limit
+                                                         : AUDIO_SAMPLE_RATE * 10;
+  int16_t* samples = (int16_t*)malloc((size_t)capacity * AUDIO_CHANNELS * sizeof(int16_t) + 1);
+  uint32_t frames = 0;
+  while (samples) {
+    if (frames == capacity) {
+      if (decoder->frame_limit != UINT32_MAX)
+        break;
+      capacity *= 2;
+      int16_t* grown =
+          (int16_t*)realloc(samples, (size_t)capacity * AUDIO_CHANNELS * sizeof(int16_t));
+      if (!grown) {
+        free(samples);
+        samples = NULL;
+        break;
+      }
+      samples = grown;
+    }
+
+    uint32_t read = decoder_read(
+        decoder, samples + (size_t)frames * AUDIO_CHANNELS, capacity - frames);
+    if (read == 0)
+      break;
+    frames += read;
+  }
+  decoder_close(decoder);
+
+  if (!samples || frames == 0) {
+    free(samples);
+    return 0;
+  }
+  *out_samples = samples;
+  *out_frames = frames;
+  return 1;
+}
+
+static const char* compressed_extensions[] = {".flac", ".ogg", ".oga", ".opus", ".mp3"};
+
+int decoder_probe_header(
+    const char* path,
+    const void* bytes,
+    uint32_t length,
+    uint64_t file_size,
+    DecoderInfo* info) {
+  memset(info, 0, sizeof(*info));
+  const char* ext = strrchr(path, '.');
+  WavInfo wav;
+  if (ext && str_casecmp(ext, ".wav") == 0 && wav_parse_header(bytes, length, file_size, &wav) &&
+      describe_wav(&wav, info))
+    return 1;
+  return decoder_probe(path, info);
+}
+
+int decoder_is_compressed_extension(const char* ext) {
+  for (size_t i = 0; i < sizeof(compressed_extensions) / sizeof(compressed_extensions[0]); i++) {
+    if (str_casecmp(ext, compressed_extensions[i]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+int decoder_handles_extension(const char* ext) {
+  if (str_casecmp(ext, ".wav") == 0)
+    return 1;
+  return decoder_is_compressed_extension(ext) && get_sndfile() != NULL;
+}
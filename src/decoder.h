@@ -0,0 +1,58 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+
+#define DECODER_CHUNK_FRAMES 4096  // Source frames converted per step
+
+// Streaming decode of a sound file to device-format frames (see pcm_buffer.h): interleaved
+// stereo int16 at AUDIO_SAMPLE_RATE. WAV is read natively; FLAC, Ogg and MP3 go through
+// libsndfile, loaded at runtime when it is installed
+typedef struct Decoder Decoder;
+
+// Open a file for decoding. Returns NULL if the format is unsupported or the file unreadable
+Decoder* decoder_open(const char* path);
+
+void decoder_close(Decoder* decoder);
+
+// Length of the sound in device-rate frames, as reported by the decoder
+uint32_t decoder_frame_count(const Decoder* decoder);
+
+// Decode up to frames frames into out. Returns the frames written; 0 means end of stream
+uint32_t decoder_read(Decoder* decoder, int16_t* out, uint32_t frames);
+
+// Start decoding at device-rate frame frame (clamped to the end) without decoding what comes
+// before it. Call before the first decoder_read. Returns 0 if the source can't seek, leaving the
+// decoder at the start
+int decoder_seek(Decoder* decoder, uint32_t frame);
+
+// Decode a whole file. The caller owns *out_samples and must free() it. Returns 1 on success
+int decoder_load_s16(const char* path, int16_t** out_samples, uint32_t* out_frames);
+
+// What a file holds, as its header tells it
+typedef struct {
+  uint32_t frames;  // Length in device-rate frames, 0 if unknown
+  uint32_t source_rate;
+  uint16_t channels;
+  uint16_t sample_bits;  // Bits per stored sample; 0 for compressed formats
+} DecoderInfo;
+
+// Read a file's format and length without setting up a decode. Returns 0 if it can't be decoded
+int decoder_probe(const char* path, DecoderInfo* info);
+
+// decoder_probe() given the file's first length bytes, already read, and its size. A WAV is
+// parsed from them; other formats, and WAVs whose header goes on past them, are opened after all
+int decoder_probe_header(
+    const char* path,
+    const void* bytes,
+    uint32_t length,
+    uint64_t file_size,
+    DecoderInfo* info);
+
+// Whether files with this extension (including the dot) can be decoded
+int decoder_handles_extension(const char* ext);
+
+// Whether the extension is a compressed format that needs libsndfile
+int decoder_is_compressed_extension(const char* ext);
+
+#endif  // DECODER_H
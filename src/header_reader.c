@@ -0,0 +1,342 @@
+#include "header_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// io_uring through its raw syscalls, so that nothing beyond the kernel headers is needed. Headers
+// older than 5.6 lack the open, read and close opcodes, so they build the thread pool only
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_register)
+#define HEADER_READER_IO_URING
+#endif
+#endif
+#endif
+
+#define HEADER_READER_MIN_THREADS 4  // Reads mostly wait on the disk, so more threads than CPUs
+#define HEADER_READER_MAX_THREADS 16
+
+#ifdef HEADER_READER_IO_URING
+#define RING_ENTRIES (2 * HEADER_READER_BATCH)  // A read and a close per file
+#define CLOSE_TAG 0x100000000ULL  // Marks the completions of closes in user_data
+
+typedef struct {
+  int fd;
+  unsigned char* sq_map;
+  size_t sq_map_size;
+  unsigned char* cq_map;
+  size_t cq_map_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+  unsigned* sq_tail;
+  unsigned sq_mask;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe* cqes;
+  unsigned queued;  // SQEs written since the last submission
+} Ring;
+#endif
+
+struct HeaderReader {
+  unsigned char* blocks;  // HEADER_READER_BATCH blocks of HEADER_READ_BYTES
+  uint32_t lengths[HEADER_READER_BATCH];
+  uint32_t threads;
+#ifdef HEADER_READER_IO_URING
+  Ring ring;
+  int use_ring;
+  int fds[HEADER_READER_BATCH];
+#endif
+};
+
+#ifdef HEADER_READER_IO_URING
+static void ring_close(Ring* ring) {
+  if (ring->sqes)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_map)
+    munmap(ring->cq_map, ring->cq_map_size);
+  if (ring->sq_map)
+    munmap(ring->sq_map, ring->sq_map_size);
+  if (ring->fd >= 0)
+    close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static void* map_ring(int fd, size_t size, off_t offset) {
+  void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+  return view == MAP_FAILED ? NULL : view;
+}
+
+// Whether the kernel knows every opcode a batch uses
+static int ring_supports_batches(int fd) {
+  size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, size);
+  if (!probe)
+    return 0;
+  int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+  static const unsigned char needed[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+  for (size_t i = 0; ok && i < sizeof(needed); i++)
+    ok = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  return ok;
+}
+
+static int ring_open(Ring* ring) {
+  memset(ring, 0, sizeof(*ring));
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (ring->fd < 0 || !ring_supports_batches(ring->fd)) {
+    ring_close(ring);
+    return 0;
+  }
+
+  ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq_map = (unsigned char*)map_ring(ring->fd, ring->sq_map_size, IORING_OFF_SQ_RING);
+  ring->cq_map = (unsigned char*)map_ring(ring->fd, ring->cq_map_size, IORING_OFF_CQ_RING);
+  ring->sqes = (struct io_uring_sqe*)map_ring(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+  if (!ring->sq_map || !ring->cq_map || !ring->sqes) {
+    ring_close(ring);
+    return 0;
+  }
+
+  ring->sq_tail = (unsigned*)(ring->sq_map + params.sq_off.tail);
+  ring->sq_mask = *(unsigned*)(ring->sq_map + params.sq_off.ring_mask);
+  ring->cq_head = (unsigned*)(ring->cq_map + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(ring->cq_map + params.cq_off.tail);
+  ring->cq_mask = *(unsigned*)(ring->cq_map + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(ring->cq_map + params.cq_off.cqes);
+
+  // SQE i always sits in slot i of the indirection array
+  unsigned* array = (unsigned*)(ring->sq_map + params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; i++)
+    array[i] = i;
+  return 1;
+}
+
+// Next free SQE, cleared. A batch never queues more than RING_ENTRIES before submitting
+static struct io_uring_sqe* ring_queue(Ring* ring, uint8_t opcode, int fd, uint64_t user_data) {
+  unsigned tail = *ring->sq_tail + ring->queued++;
+  struct io_uring_sqe* sqe = &ring->sqes[tail & ring->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+  return sqe;
+}
+
+// Submit what was queued and wait for every completion, handing each to the reader. Returns the
+// number of io_uring_enter() calls, or 0 if the ring failed
+static uint32_t ring_run(Ring* ring, HeaderReader* reader) {
+  unsigned count = ring->queued;
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + count, __ATOMIC_RELEASE);
+  ring->queued = 0;
+
+  uint32_t calls = 0;
+  unsigned submitted = 0;
+  unsigned completed = 0;
+  while (completed < count) {
+    unsigned to_submit = count - submitted;
+    int result = (int)syscall(
+        __NR_io_uring_enter,
+        ring->fd,
+        to_submit,
+        submitted + to_submit - completed,
+        IORING_ENTER_GETEVENTS,
+        NULL,
+        0);
+    calls++;
+    if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      return 0;
+    if (result > 0)
+      submitted += (unsigned)result;
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++, completed++) {
+      const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+      if (cqe->user_data & CLOSE_TAG)
+        continue;
+      uint32_t i = (uint32_t)cqe->user_data;
+      if (reader->fds[i] == -2)  // Opening
+        reader->fds[i] = cqe->res >= 0 ? cqe->res : -1;
+      else
+        reader->lengths[i] = cqe->res > 0 ? (uint32_t)cqe->res : 0;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    if (result <= 0 && submitted < count && completed == submitted)
+      sleep_ns(100000);  // Out of kernel resources with nothing in flight; let them free up
+  }
+  return calls;
+}
+
+// Opens in one submission, then each read hard-linked to the close of its file, so the close
+// runs even when the read fails
+static uint32_t read_with_ring(HeaderReader* reader, const char* const* paths, uint32_t count) {
+  Ring* ring = &reader->ring;
+  for (uint32_t i = 0; i < count; i++) {
+    reader->fds[i] = -2;
+    struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_OPENAT, AT_FDCWD, i);
+    sqe->addr = (uint64_t)(uintptr_t)paths[i];
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+  }
+  uint32_t opens = ring_run(ring, reader);
+  if (opens == 0) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (reader->fds[i] >= 0)
+        close(reader->fds[i]);
+    }
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (reader->fds[i] < 0)
+      continue;
+    struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_READ, reader->fds[i], i);
+    sqe->addr = (uint64_t)(uintptr_t)(reader->blocks + (size_t)i * HEADER_READ_BYTES);
+    sqe->len = HEADER_READ_BYTES;
+    sqe->flags = IOSQE_IO_HARDLINK;
+    ring_queue(ring, IORING_OP_CLOSE, reader->fds[i], CLOSE_TAG | i);
+  }
+  if (ring->queued == 0)
+    return opens;
+  uint32_t reads = ring_run(ring, reader);
+  return reads ? opens + reads : 0;
+}
+#endif
+
+static void read_header(const char* path, unsigned char* block, uint32_t* length) {
+  *length = 0;
+#ifdef _WIN32
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return;
+  *length = (uint32_t)fread(block, 1, HEADER_READ_BYTES, f);
+  fclose(f);
+#else
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  ssize_t read_bytes;
+  do {
+    read_bytes = pread(fd, block, HEADER_READ_BYTES, 0);
+  } while (read_bytes < 0 && errno == EINTR);
+  *length = read_bytes > 0 ? (uint32_t)read_bytes : 0;
+  close(fd);
+#endif
+}
+
+typedef struct {
+  HeaderReader* reader;
+  const char* const* paths;
+  uint32_t count;
+  uint32_t next;  // Next file to claim
+} PoolBatch;
+
+static void* pool_thread(void* arg) {
+  PoolBatch* batch = (PoolBatch*)arg;
+  HeaderReader* reader = batch->reader;
+  for (;;) {
+    uint32_t i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+    if (i >= batch->count)
+      return NULL;
+    read_header(
+        batch->paths[i], reader->blocks + (size_t)i * HEADER_READ_BYTES, &reader->lengths[i]);
+  }
+}
+
+// The calling thread reads along with the pool, and alone if no thread could be started
+static void read_with_pool(HeaderReader* reader, const char* const* paths, uint32_t count) {
+  PoolBatch batch = {reader, paths, count, 0};
+  Thread threads[HEADER_READER_MAX_THREADS];
+  uint32_t wanted = reader->threads < count ? reader->threads : count;
+  uint32_t started = 0;
+  while (started + 1 < wanted && thread_create(&threads[started], pool_thread, &batch))
+    started++;
+  pool_thread(&batch);
+  for (uint32_t i = 0; i < started; i++)
+    thread_join(threads[i]);
+}
+
+HeaderReader* header_reader_create(void) {
+  HeaderReader* reader = (HeaderReader*)calloc(1, sizeof(HeaderReader));
+  if (!reader)
+    return NULL;
+  reader->blocks = (unsigned char*)malloc((size_t)HEADER_READER_BATCH * HEADER_READ_BYTES);
+  if (!reader->blocks) {
+    free(reader);
+    return NULL;
+  }
+  uint32_t cpus = cpu_count();
+  reader->threads = cpus < HEADER_READER_MIN_THREADS   ? HEADER_READER_MIN_THREADS
+                    : cpus > HEADER_READER_MAX_THREADS ? HEADER_READER_MAX_THREADS
+                                                       : cpus;
+#ifdef HEADER_READER_IO_URING
+  const char* setting = getenv("SOUNDBOARD_IO_URING");
+  reader->ring.fd = -1;
+  if (!setting || strcmp(setting, "off") != 0)
+    reader->use_ring = ring_open(&reader->ring);
+#endif
+  return reader;
+}
+
+void header_reader_destroy(HeaderReader* reader) {
+  if (!reader)
+    return;
+#ifdef HEADER_READER_IO_URING
+  ring_close(&reader->ring);
+#endif
+  free(reader->blocks);
+  free(reader);
+}
+
+uint32_t header_reader_read(HeaderReader* reader, const char* const* paths, uint32_t count) {
+  if (count > HEADER_READER_BATCH)
+    count = HEADER_READER_BATCH;
+  memset(reader->lengths, 0, count * sizeof(uint32_t));
+#ifdef HEADER_READER_IO_URING
+  if (reader->use_ring) {
+    uint32_t round_trips = read_with_ring(reader, paths, count);
+    if (round_trips > 0)
+      return round_trips;
+
+    // Tearing the ring down cancels what is still in flight. Files whose close was already
+    // queued are left to it rather than risk closing a descriptor twice
+    fprintf(stderr, "io_uring failed; reading file headers with threads instead\n");
+    ring_close(&reader->ring);
+    reader->use_ring = 0;
+    memset(reader->lengths, 0, count * sizeof(uint32_t));
+  }
+#endif
+  read_with_pool(reader, paths, count);
+  return 1;
+}
+
+const unsigned char* header_reader_block(const HeaderReader* reader, uint32_t i, uint32_t* length) {
+  *length = reader->lengths[i];
+  return reader->blocks + (size_t)i * HEADER_READ_BYTES;
+}
+
+int header_reader_uses_io_uring(const HeaderReader* reader) {
+#ifdef HEADER_READER_IO_URING
+  return reader->use_ring;
+#else
+  (void)reader;
+  return 0;
+#endif
+}
@@ -0,0 +1,31 @@
+#ifndef HEADER_READER_H
+#define HEADER_READER_H
+
+#include <stdint.h>
+
+#define HEADER_READ_BYTES 4096  // Enough for the fmt chunk and the data chunk header of most WAVs
+#define HEADER_READER_BATCH 256  // Most files one header_reader_read() takes
+
+// Reads the first block of many files at once. On Linux the files are opened in one io_uring
+// submission and read and closed in a second, so a batch costs two round trips into the kernel
+// however many files it holds. Without io_uring (older kernels, container sandboxes that refuse
+// it, other systems, or SOUNDBOARD_IO_URING=off) a pool of threads reads them with pread()
+typedef struct HeaderReader HeaderReader;
+
+// Returns NULL if out of memory
+HeaderReader* header_reader_create(void);
+
+void header_reader_destroy(HeaderReader* reader);
+
+// Read the first HEADER_READ_BYTES of up to HEADER_READER_BATCH files, fewer for shorter ones.
+// Returns how many round trips it took: io_uring submissions, or 1 for the thread pool
+uint32_t header_reader_read(HeaderReader* reader, const char* const* paths, uint32_t count);
+
+// Block read for the i-th file of the last batch, and its length: 0 if the file couldn't be
+// opened or read
+const unsigned char* header_reader_block(const HeaderReader* reader, uint32_t i, uint32_t* length);
+
+// Whether batches go through io_uring rather than the thread pool
+int header_reader_uses_io_uring(const HeaderReader* reader);
+
+#endif  // HEADER_READER_H
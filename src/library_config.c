@@ -0,0 +1,441 @@
+#include "library_config.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+
+// Where settings go while a file or the flags are read
+typedef struct {
+  LibraryConfig* config;
+  const char* source;  // File name, or "command line"
+  int in_root;  // A root came: settings refine the last one
+  int flags;  // Reading flags, whose first root replaces the file's
+  int flag_roots;  // Whether it has
+} ConfigParser;
+
+static char* copy_string(const char* text, size_t length) {
+  char* copy = (char*)malloc(length + 1);
+  if (copy) {
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+  }
+  return copy;
+}
+
+static void free_strings(char** strings, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    free(strings[i]);
+  free(strings);
+}
+
+static void free_root(LibraryRoot* root) {
+  free(root->path);
+  free_strings(root->extensions, root->extension_count);
+  free_strings(root->excludes, root->exclude_count);
+  memset(root, 0, sizeof(*root));
+  root->max_depth = -1;
+}
+
+static int append_string(char*** strings, uint32_t* count, const char* text, size_t length) {
+  char** grown = (char**)realloc(*strings, (*count + 1) * sizeof(char*));
+  if (!grown)
+    return 0;
+  *strings = grown;
+  grown[*count] = copy_string(text, length);
+  if (!grown[*count])
+    return 0;
+  (*count)++;
+  return 1;
+}
+
+// A copy of from's settings under a new path
+static int copy_root(LibraryRoot* root, const LibraryRoot* from, char* path) {
+  memset(root, 0, sizeof(*root));
+  root->path = path;
+  root->max_depth = from->max_depth;
+  int ok = 1;
+  for (uint32_t i = 0; ok && i < from->extension_count; i++) {
+    const char* ext = from->extensions[i];
+    ok = append_string(&root->extensions, &root->extension_count, ext, strlen(ext));
+  }
+  for (uint32_t i = 0; ok && i < from->exclude_count; i++) {
+    const char* glob = from->excludes[i];
+    ok = append_string(&root->excludes, &root->exclude_count, glob, strlen(glob));
+  }
+  return ok;
+}
+
+// "~" for the home directory, no trailing "/", and relative paths written from "./", as the
+// scanner writes the current directory's
+static char* normalize_root(const char* path) {
+  const char* home = "";
+  if (path[0] == '~' && (path[1] == '\0' || path[1] == '/')) {
+    home = getenv("HOME");
+#ifdef _WIN32
+    if (!home)
+      home = getenv("USERPROFILE");
+#endif
+    if (!home)
+      home = "";
+    path++;
+  }
+  size_t length = strlen(path);
+  while (length > 1 && path[length - 1] == '/')
+    length--;
+
+  int absolute = home[0] != '\0' || path[0] == '/' || path[0] == '\\' ||
+                 (isalpha((unsigned char)path[0]) && path[1] == ':');
+  int dotted = (path[0] == '.' && (length == 1 || path[1] == '/')) ||
+               (path[0] == '.' && path[1] == '.' && (length == 2 || path[2] == '/'));
+  const char* prefix = absolute || dotted ? home : "./";
+  size_t prefix_length = strlen(prefix);
+  char* root = (char*)malloc(prefix_length + length + 1);
+  if (root) {
+    memcpy(root, prefix, prefix_length);
+    memcpy(root + prefix_length, path, length);
+    root[prefix_length + length] = '\0';
+  }
+  return root;
+}
+
+static int is_under(const char* path, const char* root) {
+  size_t length = strlen(root);
+  return strncmp(path, root, length) == 0 && (path[length] == '\0' || path[length] == '/');
+}
+
+// A list separated by spaces or commas, each with its leading "." added if missing
+static int set_extensions(LibraryRoot* root, const char* list) {
+  free_strings(root->extensions, root->extension_count);
+  root->extensions = NULL;
+  root->extension_count = 0;
+  for (const char* p = list; *p != '\0';) {
+    p += strspn(p, ", \t");
+    size_t length = strcspn(p, ", \t");
+    if (length == 0)
+      break;
+    char ext[32];
+    if (length + 2 > sizeof(ext)) {
+      p += length;
+      continue;
+    }
+    size_t dot = p[0] != '.';
+    ext[0] = '.';
+    memcpy(ext + dot, p, length);
+    ext[dot + length] = '\0';
+    if (!decoder_handles_extension(ext))
+      fprintf(stderr, "No decoder for %s files, so that extension finds nothing\n", ext);
+    if (!append_string(&root->extensions, &root->extension_count, ext, dot + length))
+      return 0;
+    p += length;
+  }
+  return 1;
+}
+
+// A leading "/" anchors a glob to the root, where it is matched anyway; a trailing one is
+// dropped, since a glob applies to files and directories alike
+static int add_exclude(LibraryRoot* root, const char* glob) {
+  while (*glob == '/')
+    glob++;
+  size_t length = strlen(glob);
+  while (length > 0 && glob[length - 1] == '/')
+    length--;
+  return length == 0 || append_string(&root->excludes, &root->exclude_count, glob, length);
+}
+
+static int change_root(LibraryRoot* root, const char* key, const char* value, int depth) {
+  if (strcmp(key, "depth") == 0) {
+    root->max_depth = depth;
+    return 1;
+  }
+  if (strcmp(key, "extensions") == 0)
+    return set_extensions(root, value);
+  return add_exclude(root, value);
+}
+
+// Apply a setting to the root being read, or to the defaults and every root so far
+static int apply_setting(ConfigParser* parser, const char* key, const char* value) {
+  LibraryConfig* config = parser->config;
+  if (value[0] == '\0') {
+    fprintf(stderr, "%s: %s needs a value\n", parser->source, key);
+    return 0;
+  }
+
+  if (strcmp(key, "root") == 0) {
+    if (parser->flags && !parser->flag_roots) {
+      for (uint32_t i = 0; i < config->count; i++)
+        free_root(&config->roots[i]);
+      config->count = 0;
+      parser->flag_roots = 1;
+    }
+    LibraryRoot* grown =
+        (LibraryRoot*)realloc(config->roots, (config->count + 1) * sizeof(LibraryRoot));
+    if (!grown)
+      return 0;
+    config->roots = grown;
+    char* path = normalize_root(value);
+    if (!path || !copy_root(&grown[config->count], &config->defaults, path)) {
+      grown[config->count].path = path;
+      free_root(&grown[config->count]);
+      return 0;
+    }
+    config->count++;
+    parser->in_root = 1;
+    return 1;
+  }
+
+  int depth = 0;
+  if (strcmp(key, "depth") == 0) {
+    char* end;
+    long levels = strtol(value, &end, 10);
+    if (*end != '\0' || levels < -1 || levels > 4096) {
+      fprintf(stderr, "%s: depth takes a number of levels, or -1 for no limit\n", parser->source);
+      return 0;
+    }
+    depth = (int)levels;
+  } else if (strcmp(key, "extensions") != 0 && strcmp(key, "exclude") != 0) {
+    fprintf(stderr, "%s: unknown setting \"%s\"\n", parser->source, key);
+    return 0;
+  }
+
+  if (parser->in_root)
+    return change_root(&config->roots[config->count - 1], key, value, depth);
+  int ok = change_root(&config->defaults, key, value, depth);
+  for (uint32_t i = 0; ok && i < config->count; i++)
+    ok = change_root(&config->roots[i], key, value, depth);
+  return ok;
+}
+
+// Split a line into its setting and its value, trimmed. Returns 0 for blank lines and comments
+static int split_line(char* line, char** key, char** value) {
+  line += strspn(line, " \t");
+  size_t length = strlen(line);
+  while (length > 0 && isspace((unsigned char)line[length - 1]))
+    line[--length] = '\0';
+  if (length == 0 || line[0] == '#')
+    return 0;
+  *key = line;
+  size_t key_length = strcspn(line, " \t");
+  *value = line + key_length;
+  if (**value != '\0') {
+    **value = '\0';
+    (*value)++;
+    *value += strspn(*value, " \t");
+  }
+  return 1;
+}
+
+static int read_file(ConfigParser* parser, const char* file, int required) {
+  FILE* in = fopen(file, "rb");
+  if (!in) {
+    if (required)
+      fprintf(stderr, "Failed to open %s\n", file);
+    return !required;
+  }
+  char* text = NULL;
+  long size = -1;
+  if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) >= 0 && fseek(in, 0, SEEK_SET) == 0)
+    text = (char*)malloc((size_t)size + 1);
+  int ok = text && fread(text, 1, (size_t)size, in) == (size_t)size;
+  fclose(in);
+  if (!ok) {
+    fprintf(stderr, "Failed to read %s\n", file);
+    free(text);
+    return 0;
+  }
+  text[size] = '\0';
+
+  parser->source = file;
+  for (char* line = text; line;) {
+    char* next = strchr(line, '\n');
+    if (next)
+      *next++ = '\0';
+    char* key;
+    char* value;
+    if (split_line(line, &key, &value) && !apply_setting(parser, key, value))
+      ok = 0;
+    line = next;
+  }
+  free(text);
+  return ok;
+}
+
+static int read_flags(ConfigParser* parser, int argc, char* const* argv) {
+  static const char* const flags[][2] = {
+      {"--root", "root"},
+      {"--depth", "depth"},
+      {"--ext", "extensions"},
+      {"--exclude", "exclude"},
+      {"--config", NULL}};
+  parser->source = "command line";
+  parser->flags = 1;
+  parser->in_root = 0;
+  int ok = 1;
+  for (int i = 0; i < argc; i++) {
+    size_t f = 0;
+    while (f < sizeof(flags) / sizeof(flags[0]) && strcmp(argv[i], flags[f][0]) != 0)
+      f++;
+    if (f == sizeof(flags) / sizeof(flags[0])) {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 0;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 0;
+    }
+    i++;
+    if (flags[f][1] && !apply_setting(parser, flags[f][1], argv[i]))
+      ok = 0;
+  }
+  return ok;
+}
+
+int library_config_load(LibraryConfig* config, const char* file, int argc, char* const* argv) {
+  memset(config, 0, sizeof(*config));
+  config->defaults.max_depth = -1;
+  ConfigParser parser;
+  memset(&parser, 0, sizeof(parser));
+  parser.config = config;
+
+  // Only a file that was asked for has to exist
+  int required = 1;
+  for (int i = 0; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--config") == 0)
+      file = argv[i + 1];
+  }
+  if (!file)
+    file = getenv("SOUNDBOARD_CONFIG");
+  if (!file) {
+    file = LIBRARY_CONFIG_FILE;
+    required = 0;
+  }
+  int ok = read_file(&parser, file, required);
+  ok = read_flags(&parser, argc, argv) && ok;
+  if (config->count == 0) {
+    parser.flags = 0;
+    parser.source = "default";
+    ok = apply_setting(&parser, "root", ".") && ok;
+  }
+
+  // A root inside another would list its sounds twice
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < config->count; i++) {
+    const char* inside = NULL;
+    for (uint32_t j = 0; !inside && j < config->count; j++) {
+      const char* other = config->roots[j].path;
+      if (j != i && is_under(config->roots[i].path, other) &&
+          (strcmp(config->roots[i].path, other) != 0 || j < i))
+        inside = other;
+    }
+    if (inside) {
+      fprintf(stderr, "Root %s is inside %s; leaving it out\n", config->roots[i].path, inside);
+      free_root(&config->roots[i]);
+    } else {
+      config->roots[kept++] = config->roots[i];
+    }
+  }
+  config->count = kept;
+  return ok;
+}
+
+void library_config_free(LibraryConfig* config) {
+  for (uint32_t i = 0; i < config->count; i++)
+    free_root(&config->roots[i]);
+  free(config->roots);
+  free_root(&config->defaults);
+  memset(config, 0, sizeof(*config));
+}
+
+const LibraryRoot* library_config_find_root(const LibraryConfig* config, const char* path) {
+  for (uint32_t i = 0; i < config->count; i++) {
+    if (is_under(path, config->roots[i].path))
+      return &config->roots[i];
+  }
+  return NULL;
+}
+
+// fnmatch() without the brackets: "*" and "?" don't match "/", "**" matches anything
+static int glob_match(const char* glob, const char* text) {
+  for (;;) {
+    if (*glob == '\0')
+      return *text == '\0';
+    if (*glob == '*') {
+      int deep = glob[1] == '*';
+      glob += deep ? 2 : 1;
+      if (deep && *glob == '/' && glob_match(glob + 1, text))
+        return 1;  // "**/" also stands for no directory at all
+      for (const char* rest = text;; rest++) {
+        if (glob_match(glob, rest))
+          return 1;
+        if (*rest == '\0' || (*rest == '/' && !deep))
+          return 0;
+      }
+    }
+    if (*text == '\0' || (*glob == '?' ? *text == '/' : *glob != *text))
+      return 0;
+    glob++;
+    text++;
+  }
+}
+
+int library_root_excludes(const LibraryRoot* root, const char* name, const char* relative) {
+  for (uint32_t i = 0; i < root->exclude_count; i++) {
+    const char* glob = root->excludes[i];
+    if (glob_match(glob, strchr(glob, '/') ? relative : name))
+      return 1;
+  }
+  return 0;
+}
+
+static int same_extension(const char* a, const char* b) {
+  for (; *a && *b; a++, b++) {
+    if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+      return 0;
+  }
+  return *a == *b;
+}
+
+int library_root_takes_file(const LibraryRoot* root, const char* name) {
+  const char* ext = strrchr(name, '.');
+  if (!ext || !decoder_handles_extension(ext))
+    return 0;
+  for (uint32_t i = 0; i < root->extension_count; i++) {
+    if (same_extension(ext, root->extensions[i]))
+      return 1;
+  }
+  return root->extension_count == 0;
+}
+
+int library_config_takes(const LibraryConfig* config, const char* path, int is_dir) {
+  const LibraryRoot* root = library_config_find_root(config, path);
+  if (!root)
+    return 0;
+  size_t root_length = strlen(root->path);
+  if (path[root_length] == '\0')
+    return is_dir;
+
+  // Each name on the way down is a directory one level deeper, and the last is the entry
+  char* relative = copy_string(path + root_length + 1, strlen(path + root_length + 1));
+  if (!relative)
+    return 1;  // Let the scan decide
+  int takes = 1;
+  int depth = 1;
+  for (char* name = relative; takes; depth++) {
+    char* slash = strchr(name, '/');
+    int last = slash == NULL;
+    if (slash)
+      *slash = '\0';
+    int directory = !last || is_dir;
+    takes = !library_root_excludes(root, name, relative) &&
+            (!directory || root->max_depth < 0 || depth <= root->max_depth) &&
+            (directory || library_root_takes_file(root, name));
+    if (last)
+      break;
+    *slash = '/';
+    name = slash + 1;
+  }
+  free(relative);
+  return takes;
+}
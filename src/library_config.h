@@ -0,0 +1,56 @@
+#ifndef LIBRARY_CONFIG_H
+#define LIBRARY_CONFIG_H
+
+#include <stdint.h>
+
+#define LIBRARY_CONFIG_FILE "soundboard.conf"  // In the current directory; SOUNDBOARD_CONFIG or
+                                               // --config point elsewhere
+#define LIBRARY_CONFIG_USAGE                                                                    \
+  "Usage: soundboard [--config <file>] [--root <dir>]... [--depth <levels>] [--ext <list>]\n" \
+  "                  [--exclude <glob>]...\n"                                                   \
+  "       soundboard --render <script> <output.wav>\n"                                          \
+  "Settings before the first --root apply to every root, later ones to the root before them\n"
+
+// A directory tree sounds are gathered from, and how much of it is looked at. Directories pruned
+// by max_depth or an exclude glob are never opened, by the scan or by the watcher
+typedef struct {
+  char* path;  // As the paths under it are written: "." or "./sfx", absolute, no trailing "/"
+  int max_depth;  // Levels of directories below the root that are read, -1 for no limit
+  char** extensions;  // ".wav" and the like; none takes every format the decoder handles
+  uint32_t extension_count;
+  char** excludes;  // Globs against an entry's name, or its path from the root if they have a
+                    // "/"; "*" and "?" stay within one name, "**" spans directories
+  uint32_t exclude_count;
+} LibraryRoot;
+
+// The roots, none inside another, from LIBRARY_CONFIG_FILE and the command line. The file holds
+// "<setting> <value>" lines: "root <dir>" starts a root, and "depth <levels>", "extensions
+// <list>" and "exclude <glob>" refine the root above them, or every root if no root came yet
+typedef struct {
+  LibraryRoot* roots;
+  uint32_t count;
+  LibraryRoot defaults;  // What each root starts from
+} LibraryConfig;
+
+// Read file (NULL for SOUNDBOARD_CONFIG, else LIBRARY_CONFIG_FILE if it exists), then apply the
+// flags in argv, which replace the file's roots if they name any. Without a root the current
+// directory is the only one. Returns 0, after saying why, if a line or flag is malformed; config
+// then holds what could be read and must still be freed
+int library_config_load(LibraryConfig* config, const char* file, int argc, char* const* argv);
+
+void library_config_free(LibraryConfig* config);
+
+// The root path is in or under, or NULL
+const LibraryRoot* library_config_find_root(const LibraryConfig* config, const char* path);
+
+// Whether a scan of path's root would take path: a sound file, or a directory it reads. Nothing
+// above it may be excluded or too deep
+int library_config_takes(const LibraryConfig* config, const char* path, int is_dir);
+
+// Whether an exclude glob of root matches an entry, given its name and its path from the root
+int library_root_excludes(const LibraryRoot* root, const char* name, const char* relative);
+
+// Whether a file of this name is a sound the root takes, going by its extension
+int library_root_takes_file(const LibraryRoot* root, const char* name);
+
+#endif  // LIBRARY_CONFIG_H
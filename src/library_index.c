@@ -0,0 +1,660 @@
+#include "library_index.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "decoder.h"
+#include "header_reader.h"
+#include "pcm_buffer.h"
+#include "scanner.h"
+#include "thread.h"
+#include "wav.h"
+#include "xxhash.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define INDEX_FILE_MAGIC 0x494C4253u  // "SBLI"
+#define INDEX_FILE_VERSION 2u
+#define HASH_READ_BYTES (256 * 1024)
+
+// The file, and a snapshot in memory, is the header, count LibraryEntry records, then the
+// string block. Native byte order
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_size;  // sizeof(LibraryEntry), so a layout change reads as a damaged file
+  uint32_t count;
+  uint64_t strings_size;
+} IndexHeader;
+
+struct LibraryIndex {
+  unsigned char* data;
+  uint64_t size;
+  int mapped;  // data is a file mapping rather than a heap block
+  uint32_t count;
+  const LibraryEntry* entries;
+  const char* strings;
+};
+
+static LibraryIndex* wrap_data(unsigned char* data, uint64_t size, int mapped) {
+  IndexHeader header;
+  if (size < sizeof(header))
+    return NULL;
+  memcpy(&header, data, sizeof(header));
+  uint64_t entries_size = (uint64_t)header.count * sizeof(LibraryEntry);
+  if (header.magic != INDEX_FILE_MAGIC || header.version != INDEX_FILE_VERSION ||
+      header.entry_size != sizeof(LibraryEntry) ||
+      size != sizeof(header) + entries_size + header.strings_size)
+    return NULL;
+
+  const LibraryEntry* entries = (const LibraryEntry*)(data + sizeof(header));
+  const char* strings = (const char*)(data + sizeof(header) + entries_size);
+  if (header.strings_size > 0 && strings[header.strings_size - 1] != '\0')
+    return NULL;
+  for (uint32_t i = 0; i < header.count; i++) {
+    if (entries[i].path_offset >= header.strings_size || entries[i].original > i)
+      return NULL;
+  }
+
+  LibraryIndex* index = (LibraryIndex*)calloc(1, sizeof(LibraryIndex));
+  if (!index)
+    return NULL;
+  index->data = data;
+  index->size = size;
+  index->mapped = mapped;
+  index->count = header.count;
+  index->entries = entries;
+  index->strings = strings;
+  return index;
+}
+
+LibraryIndex* library_index_map(const char* file) {
+#ifdef _WIN32
+  // Read rather than mapped: Windows can't replace a file while a view of it is open, and a
+  // reconcile saves over it while the snapshot is still on screen
+  FILE* f = fopen(file, "rb");
+  if (!f)
+    return NULL;
+  unsigned char* data = NULL;
+  long length = -1;
+  if (fseek(f, 0, SEEK_END) == 0 && (length = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0)
+    data = (unsigned char*)malloc((size_t)length);
+  if (data && fread(data, 1, (size_t)length, f) != (size_t)length) {
+    free(data);
+    data = NULL;
+  }
+  fclose(f);
+  LibraryIndex* index = data ? wrap_data(data, (uint64_t)length, 0) : NULL;
+  if (!index)
+    free(data);
+  return index;
+#else
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  struct stat s;
+  void* view = NULL;
+  if (fstat(fd, &s) == 0 && s.st_size > 0) {
+    view = mmap(NULL, (size_t)s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+      view = NULL;
+  }
+  close(fd);
+  if (!view)
+    return NULL;
+
+  LibraryIndex* index = wrap_data((unsigned char*)view, (uint64_t)s.st_size, 1);
+  if (!index)
+    munmap(view, (size_t)s.st_size);
+  return index;
+#endif
+}
+
+void library_index_free(LibraryIndex* index) {
+  if (!index)
+    return;
+#ifndef _WIN32
+  if (index->mapped)
+    munmap(index->data, (size_t)index->size);
+  else
+#endif
+    free(index->data);
+  free(index);
+}
+
+uint32_t library_index_count(const LibraryIndex* index) {
+  return index ? index->count : 0;
+}
+
+const LibraryEntry* library_index_entry(const LibraryIndex* index, uint32_t i) {
+  return &index->entries[i];
+}
+
+const char* library_index_path(const LibraryIndex* index, uint32_t i) {
+  return index->strings + index->entries[i].path_offset;
+}
+
+// Entries are sorted by path, in the order the scanner returns them
+const LibraryEntry* library_index_find(const LibraryIndex* index, const char* path) {
+  uint32_t low = 0;
+  uint32_t high = library_index_count(index);
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    int order = strcmp(library_index_path(index, mid), path);
+    if (order == 0)
+      return &index->entries[mid];
+    if (order < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return NULL;
+}
+
+static void set_format(LibraryEntry* entry, const DecoderInfo* info) {
+  entry->flags |= LIBRARY_ENTRY_PROBED;
+  entry->duration_ms = (uint32_t)((uint64_t)info->frames * 1000ULL / AUDIO_SAMPLE_RATE);
+  entry->source_rate = info->source_rate;
+  entry->channels = info->channels;
+  entry->sample_bits = info->sample_bits;
+}
+
+// A snapshot being put together, in path order. Paths are borrowed until it is packed
+typedef struct {
+  LibraryEntry entry;
+  const char* path;
+  int unprobed;  // New or changed: the header is still to be read
+} DraftItem;
+
+typedef struct {
+  DraftItem* items;
+  uint32_t count;
+  uint32_t capacity;
+  uint64_t strings_size;
+} Draft;
+
+static int draft_add(Draft* draft, const LibraryEntry* entry, const char* path, int unprobed) {
+  if (draft->count == draft->capacity) {
+    uint32_t capacity = draft->capacity ? draft->capacity * 2 : 256;
+    DraftItem* grown = (DraftItem*)realloc(draft->items, capacity * sizeof(DraftItem));
+    if (!grown)
+      return 0;
+    draft->items = grown;
+    draft->capacity = capacity;
+  }
+  draft->items[draft->count].entry = *entry;
+  draft->items[draft->count].path = path;
+  draft->items[draft->count].unprobed = unprobed;
+  draft->count++;
+  draft->strings_size += strlen(path) + 1;
+  return 1;
+}
+
+static int compare_items(const void* a, const void* b) {
+  return strcmp(((const DraftItem*)a)->path, ((const DraftItem*)b)->path);
+}
+
+// Entry for a file on disk: the previous one if mtime and size still match, else a fresh one
+// with *unprobed set, for probe_draft() to fill in. Returns 0 if the file is gone
+static int describe_file(
+    const char* path,
+    const LibraryIndex* previous,
+    LibraryEntry* entry,
+    int* unprobed,
+    LibraryIndexStats* counters) {
+  struct stat s;
+  if (stat(path, &s) != 0)
+    return 0;
+
+  const LibraryEntry* old = library_index_find(previous, path);
+  if (old && old->mtime == (int64_t)s.st_mtime && old->size == (uint64_t)s.st_size) {
+    *entry = *old;
+    entry->device = (uint64_t)s.st_dev;
+    entry->inode = (uint64_t)s.st_ino;
+    *unprobed = 0;
+    counters->reused++;
+    return 1;
+  }
+  memset(entry, 0, sizeof(*entry));
+  entry->mtime = (int64_t)s.st_mtime;
+  entry->size = (uint64_t)s.st_size;
+  entry->device = (uint64_t)s.st_dev;
+  entry->inode = (uint64_t)s.st_ino;
+  entry->integrated_lufs = NAN;
+  entry->true_peak_dbtp = NAN;
+  *unprobed = 1;
+  return 1;
+}
+
+static int cancelled(const int* cancel) {
+  return cancel && __atomic_load_n(cancel, __ATOMIC_ACQUIRE);
+}
+
+// Read the format of every unprobed item. WAV headers are read HEADER_READER_BATCH files at a
+// time and parsed from memory; compressed files go through libsndfile one by one. Returns 0 if
+// cancelled
+static int probe_draft(Draft* draft, const int* cancel, LibraryIndexStats* counters) {
+  HeaderReader* reader = NULL;
+  const char* paths[HEADER_READER_BATCH];
+  uint32_t items[HEADER_READER_BATCH];
+  uint32_t batched = 0;
+  int ok = 1;
+  for (uint32_t i = 0; ok && i <= draft->count; i++) {
+    if (i < draft->count) {
+      DraftItem* item = &draft->items[i];
+      if (!item->unprobed)
+        continue;
+      item->unprobed = 0;
+      counters->probed++;
+      const char* ext = strrchr(item->path, '.');
+      if (!reader && (!ext || !decoder_is_compressed_extension(ext)))
+        reader = header_reader_create();
+      if (!reader || (ext && decoder_is_compressed_extension(ext))) {
+        DecoderInfo info;
+        if (decoder_probe(item->path, &info))
+          set_format(&item->entry, &info);
+        continue;
+      }
+      paths[batched] = item->path;
+      items[batched++] = i;
+      if (batched < HEADER_READER_BATCH)
+        continue;
+    }
+    if (batched == 0)
+      continue;
+
+    counters->header_round_trips += header_reader_read(reader, paths, batched);
+    for (uint32_t k = 0; k < batched; k++) {
+      DraftItem* item = &draft->items[items[k]];
+      uint32_t length;
+      const unsigned char* block = header_reader_block(reader, k, &length);
+      DecoderInfo info;
+      if (decoder_probe_header(item->path, block, length, item->entry.size, &info))
+        set_format(&item->entry, &info);
+    }
+    batched = 0;
+    ok = !cancelled(cancel);
+  }
+  header_reader_destroy(reader);
+  return ok;
+}
+
+// XXH64 of a sound's audio: the data chunk of a WAV, so that copies whose metadata chunks differ
+// still match, or else the whole file. Returns 0 if it can't be read
+static uint64_t hash_audio(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return 0;
+  unsigned char* buffer = (unsigned char*)malloc(HASH_READ_BYTES);
+  uint64_t left = UINT64_MAX;
+  const char* ext = strrchr(path, '.');
+  WavInfo wav;
+  if (ext && !decoder_is_compressed_extension(ext) && wav_read_info(f, &wav)) {
+    left = wav.data_size;
+    if (fseek(f, (long)wav.data_offset, SEEK_SET) != 0)
+      left = 0;
+  } else {
+    rewind(f);
+  }
+
+  Xxh64 state;
+  xxh64_init(&state, 0);
+  size_t read_bytes;
+  while (buffer && left > 0 &&
+         (read_bytes = fread(buffer, 1, left < HASH_READ_BYTES ? (size_t)left : HASH_READ_BYTES,
+                             f)) > 0) {
+    xxh64_update(&state, buffer, read_bytes);
+    left -= read_bytes;
+  }
+  int ok = buffer && !ferror(f);
+  free(buffer);
+  fclose(f);
+  uint64_t hash = xxh64_digest(&state);
+  return !ok ? 0 : hash != 0 ? hash : 1;
+}
+
+// What entries are grouped by while looking for duplicates, then their index in the draft
+typedef struct {
+  uint64_t first;
+  uint64_t second;
+  uint32_t item;
+} DuplicateKey;
+
+static int compare_keys(const void* a, const void* b) {
+  const DuplicateKey* x = (const DuplicateKey*)a;
+  const DuplicateKey* y = (const DuplicateKey*)b;
+  if (x->first != y->first)
+    return x->first < y->first ? -1 : 1;
+  if (x->second != y->second)
+    return x->second < y->second ? -1 : 1;
+  return x->item < y->item ? -1 : x->item > y->item;
+}
+
+// Point every entry at the first, in path order, with the same audio. Links to one file are
+// found by device and inode without reading anything. Of the rest, only files whose format and
+// length match another's are hashed, and the hash stays with the entry while the file is
+// unchanged. Returns 0 if out of memory or cancelled
+static int find_duplicates(Draft* draft, const int* cancel, LibraryIndexStats* counters) {
+  DuplicateKey* keys = (DuplicateKey*)malloc((draft->count ? draft->count : 1) * sizeof(*keys));
+  if (!keys)
+    return 0;
+  for (uint32_t i = 0; i < draft->count; i++)
+    draft->items[i].entry.original = i;
+
+  // Links: the first of each (device, inode) run stands for the others from here on
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < draft->count; i++) {
+    const LibraryEntry* entry = &draft->items[i].entry;
+    if ((entry->flags & LIBRARY_ENTRY_PROBED) && entry->inode != 0) {
+      DuplicateKey key = {entry->device, entry->inode, i};
+      keys[count++] = key;
+    }
+  }
+  qsort(keys, count, sizeof(*keys), compare_keys);
+  for (uint32_t i = 1; i < count; i++) {
+    if (keys[i].first != keys[i - 1].first || keys[i].second != keys[i - 1].second)
+      continue;
+    LibraryEntry* first = &draft->items[draft->items[keys[i - 1].item].entry.original].entry;
+    LibraryEntry* link = &draft->items[keys[i].item].entry;
+    link->original = first->original;
+    if (first->audio_hash == 0)
+      first->audio_hash = link->audio_hash;
+  }
+
+  // Copies: files with the same format and length, read to compare their audio
+  count = 0;
+  for (uint32_t i = 0; i < draft->count; i++) {
+    const LibraryEntry* entry = &draft->items[i].entry;
+    if ((entry->flags & LIBRARY_ENTRY_PROBED) && entry->original == i) {
+      DuplicateKey key = {
+          ((uint64_t)entry->duration_ms << 32) | entry->source_rate,
+          ((uint64_t)entry->channels << 16) | entry->sample_bits,
+          i};
+      keys[count++] = key;
+    }
+  }
+  qsort(keys, count, sizeof(*keys), compare_keys);
+  int ok = 1;
+  for (uint32_t start = 0, end; ok && start < count; start = end) {
+    for (end = start + 1;
+         end < count && keys[end].first == keys[start].first &&
+         keys[end].second == keys[start].second;
+         end++) {
+    }
+    if (end - start < 2)
+      continue;
+
+    for (uint32_t k = start; k < end; k++) {
+      LibraryEntry* entry = &draft->items[keys[k].item].entry;
+      if (entry->audio_hash == 0) {
+        entry->audio_hash = hash_audio(draft->items[keys[k].item].path);
+        counters->hashed++;
+      }
+      keys[k].first = entry->audio_hash;
+      keys[k].second = 0;
+    }
+    qsort(keys + start, end - start, sizeof(*keys), compare_keys);
+    for (uint32_t k = start + 1; k < end; k++) {
+      if (keys[k].first != 0 && keys[k].first == keys[k - 1].first)
+        draft->items[keys[k].item].entry.original = draft->items[keys[k - 1].item].entry.original;
+    }
+    ok = !cancelled(cancel);
+  }
+  free(keys);
+
+  // Links to a copy follow it to its original, which always comes earlier and points at itself
+  for (uint32_t i = 0; ok && i < draft->count; i++) {
+    LibraryEntry* entry = &draft->items[i].entry;
+    entry->original = draft->items[entry->original].entry.original;
+    if (entry->original != i) {
+      entry->audio_hash = draft->items[entry->original].entry.audio_hash;
+      counters->duplicates++;
+    }
+  }
+  return ok;
+}
+
+// Lay the draft out as a snapshot, taking the latest analysis from loudness on the way
+static LibraryIndex* pack(const Draft* draft, LoudnessCache* loudness) {
+  uint64_t size = sizeof(IndexHeader) + (uint64_t)draft->count * sizeof(LibraryEntry) +
+                  draft->strings_size;
+  unsigned char* data = (unsigned char*)malloc((size_t)size);
+  if (!data)
+    return NULL;
+
+  IndexHeader header = {INDEX_FILE_MAGIC, INDEX_FILE_VERSION, sizeof(LibraryEntry), 0, 0};
+  header.count = draft->count;
+  header.strings_size = draft->strings_size;
+  memcpy(data, &header, sizeof(header));
+  LibraryEntry* entries = (LibraryEntry*)(data + sizeof(IndexHeader));
+  char* strings = (char*)(entries + draft->count);
+  uint64_t strings_used = 0;
+  for (uint32_t i = 0; i < draft->count; i++) {
+    const DraftItem* item = &draft->items[i];
+    LibraryEntry* entry = &entries[i];
+    *entry = item->entry;
+
+    Loudness measured;
+    uint32_t onset = 0;
+    if (loudness_cache_lookup(
+            loudness, item->path, entry->mtime, entry->size, &measured, &onset)) {
+      entry->flags |= LIBRARY_ENTRY_MEASURED;
+      entry->integrated_lufs = measured.integrated_lufs;
+      entry->true_peak_dbtp = measured.true_peak_dbtp;
+      entry->onset_frames = onset;
+    }
+
+    // Only originals are analyzed; duplicates share their measurement
+    const LibraryEntry* original = &entries[entry->original];
+    if (entry->original != i) {
+      entry->flags = (entry->flags & ~LIBRARY_ENTRY_MEASURED) |
+                     (original->flags & LIBRARY_ENTRY_MEASURED);
+      entry->integrated_lufs = original->integrated_lufs;
+      entry->true_peak_dbtp = original->true_peak_dbtp;
+      entry->onset_frames = original->onset_frames;
+    }
+
+    size_t length = strlen(item->path) + 1;
+    entry->path_offset = (uint32_t)strings_used;
+    memcpy(strings + strings_used, item->path, length);
+    strings_used += length;
+  }
+
+  LibraryIndex* index = wrap_data(data, size, 0);
+  if (!index)
+    free(data);
+  return index;
+}
+
+LibraryIndex* library_index_build(
+    const LibraryConfig* config,
+    const LibraryIndex* previous,
+    LoudnessCache* loudness,
+    const int* cancel,
+    LibraryIndexStats* stats,
+    LibraryRootStats* root_stats) {
+  LibraryIndexStats counters;
+  memset(&counters, 0, sizeof(counters));
+  uint64_t start = time_ns();
+
+  ScanResult* scans = (ScanResult*)calloc(config->count ? config->count : 1, sizeof(ScanResult));
+  int ok = scans != NULL;
+  for (uint32_t r = 0; ok && r < config->count; r++) {
+    const LibraryRoot* root = &config->roots[r];
+    uint64_t root_start = time_ns();
+    if (!scan_library(root, NULL, 0, &scans[r]))
+      fprintf(stderr, "Scanning %s failed; the library may be incomplete\n", root->path);
+    counters.directories += scans[r].directories;
+    if (root_stats) {
+      root_stats[r].sounds = scans[r].count;
+      root_stats[r].directories = scans[r].directories;
+      root_stats[r].pruned = scans[r].pruned;
+      root_stats[r].scan_ns = time_ns() - root_start;
+    }
+  }
+  counters.scan_ns = time_ns() - start;
+
+  // Each scan comes back sorted, so the draft is in order as it is filled from a single root
+  Draft draft;
+  memset(&draft, 0, sizeof(draft));
+  for (uint32_t r = 0; ok && r < config->count; r++) {
+    for (uint32_t i = 0; ok && i < scans[r].count; i++) {
+      LibraryEntry entry;
+      int unprobed;
+      if (describe_file(scans[r].paths[i], previous, &entry, &unprobed, &counters))
+        ok = draft_add(&draft, &entry, scans[r].paths[i], unprobed);
+      ok = ok && !cancelled(cancel);
+    }
+  }
+  if (ok && config->count > 1 && draft.count > 1)
+    qsort(draft.items, draft.count, sizeof(DraftItem), compare_items);
+  ok = ok && probe_draft(&draft, cancel, &counters) && find_duplicates(&draft, cancel, &counters);
+
+  LibraryIndex* index = ok ? pack(&draft, loudness) : NULL;
+  free(draft.items);
+  for (uint32_t r = 0; scans && r < config->count; r++)
+    scan_result_free(&scans[r]);
+  free(scans);
+  counters.total_ns = time_ns() - start;
+  if (stats)
+    *stats = counters;
+  return index;
+}
+
+// New entries for one changed path: a file, or a directory to scan. Symlinked directories are
+// skipped, as are paths the roots leave out, as in a full scan. The paths of a scan are kept in
+// *scan until the draft is packed
+static int describe_change(
+    const char* path,
+    const LibraryConfig* config,
+    const LibraryIndex* previous,
+    Draft* draft,
+    ScanResult* scan,
+    LibraryIndexStats* counters) {
+  struct stat s;
+  if (lstat(path, &s) != 0)
+    return 1;  // Deleted
+#ifndef _WIN32
+  if (S_ISLNK(s.st_mode) && (stat(path, &s) != 0 || S_ISDIR(s.st_mode)))
+    return 1;
+#endif
+
+  if (S_ISDIR(s.st_mode)) {
+    if (!library_config_takes(config, path, 1))
+      return 1;
+    uint64_t start = time_ns();
+    if (!scan_library(library_config_find_root(config, path), path, 0, scan))
+      fprintf(stderr, "Scanning %s failed; the library may be incomplete\n", path);
+    counters->directories += scan->directories;
+    counters->scan_ns += time_ns() - start;
+    for (uint32_t i = 0; i < scan->count; i++) {
+      LibraryEntry entry;
+      int unprobed;
+      if (describe_file(scan->paths[i], previous, &entry, &unprobed, counters) &&
+          !draft_add(draft, &entry, scan->paths[i], unprobed))
+        return 0;
+    }
+    return 1;
+  }
+
+  LibraryEntry entry;
+  int unprobed;
+  if (!S_ISREG(s.st_mode) || !library_config_takes(config, path, 0) ||
+      !describe_file(path, previous, &entry, &unprobed, counters))
+    return 1;
+  return draft_add(draft, &entry, path, unprobed);
+}
+
+LibraryIndex* library_index_update(
+    const LibraryIndex* previous,
+    const LibraryConfig* config,
+    const ChangeSet* changes,
+    LoudnessCache* loudness,
+    const int* cancel,
+    LibraryIndexStats* stats) {
+  LibraryIndexStats counters;
+  memset(&counters, 0, sizeof(counters));
+  uint64_t start = time_ns();
+
+  // Whatever the changes cover is dropped from the previous snapshot and looked at again
+  Draft fresh;
+  memset(&fresh, 0, sizeof(fresh));
+  uint32_t change_count = changes->count;
+  ScanResult* scans = (ScanResult*)calloc(change_count ? change_count : 1, sizeof(ScanResult));
+  int ok = scans != NULL;
+  for (uint32_t i = 0; ok && i < changes->count; i++) {
+    ok = describe_change(changes->paths[i], config, previous, &fresh, &scans[i], &counters) &&
+         !cancelled(cancel);
+  }
+  ok = ok && probe_draft(&fresh, cancel, &counters);
+  if (ok && fresh.count > 1)
+    qsort(fresh.items, fresh.count, sizeof(DraftItem), compare_items);
+
+  // Merge the untouched entries with the fresh ones, both in path order
+  Draft draft;
+  memset(&draft, 0, sizeof(draft));
+  uint32_t count = library_index_count(previous);
+  uint32_t next = 0;
+  for (uint32_t i = 0; ok && i <= count; i++) {
+    const char* path = i < count ? library_index_path(previous, i) : NULL;
+    if (path && change_set_covers(changes, path))
+      continue;
+    for (; ok && next < fresh.count && (!path || strcmp(fresh.items[next].path, path) < 0); next++)
+      ok = draft_add(&draft, &fresh.items[next].entry, fresh.items[next].path, 0);
+    if (ok && path) {
+      ok = draft_add(&draft, library_index_entry(previous, i), path, 0);
+      counters.reused++;
+    }
+  }
+  ok = ok && find_duplicates(&draft, cancel, &counters);
+
+  LibraryIndex* index = ok ? pack(&draft, loudness) : NULL;
+  free(draft.items);
+  free(fresh.items);
+  for (uint32_t i = 0; scans && i < change_count; i++)
+    scan_result_free(&scans[i]);
+  free(scans);
+  counters.total_ns = time_ns() - start;
+  if (stats)
+    *stats = counters;
+  return index;
+}
+
+int library_index_save(const LibraryIndex* index, const char* file) {
+  size_t temp_length = strlen(file) + 5;
+  char* temp_path = (char*)malloc(temp_length);
+  if (!temp_path)
+    return 0;
+  snprintf(temp_path, temp_length, "%s.tmp", file);
+
+  FILE* out = fopen(temp_path, "wb");
+  int ok = out != NULL;
+  if (out) {
+    ok = fwrite(index->data, 1, (size_t)index->size, out) == index->size;
+    ok = fclose(out) == 0 && ok;
+  }
+#ifdef _WIN32
+  if (ok)
+    remove(file);
+#endif
+  if (!ok || rename(temp_path, file) != 0) {
+    fprintf(stderr, "Failed to write library index %s\n", file);
+    remove(temp_path);
+    ok = 0;
+  }
+  free(temp_path);
+  return ok;
+}
+
+int library_index_identical(const LibraryIndex* a, const LibraryIndex* b) {
+  if (!a || !b)
+    return a == b;
+  return a->size == b->size && memcmp(a->data, b->data, (size_t)a->size) == 0;
+}
@@ -0,0 +1,102 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stdint.h>
+
+#include "library_config.h"
+#include "loudness_cache.h"
+#include "watcher.h"
+
+#define LIBRARY_INDEX_FILE ".soundboard-library"
+
+#define LIBRARY_ENTRY_PROBED 0x1u  // The format fields were read from the file's header
+#define LIBRARY_ENTRY_MEASURED 0x2u  // The analysis fields hold a loudness measurement
+
+// One sound as the last scan saw it. Stored in the index file exactly as laid out here
+typedef struct {
+  int64_t mtime;
+  uint64_t size;
+  uint64_t device;  // st_dev and st_ino: every link to one file has the same pair
+  uint64_t inode;
+  uint64_t audio_hash;  // XXH64 of the audio, 0 unless another file might hold the same
+  uint32_t path_offset;  // Into the string block; paths are NUL-terminated
+  uint32_t flags;  // LIBRARY_ENTRY_*
+  uint32_t duration_ms;  // 0 if unknown
+  uint32_t source_rate;
+  uint16_t channels;
+  uint16_t sample_bits;  // 0 for compressed formats
+  float integrated_lufs;
+  float true_peak_dbtp;
+  uint32_t onset_frames;
+  uint32_t original;  // First entry with the same audio, or this one's own index if none
+  uint32_t reserved;  // 0
+} LibraryEntry;
+
+// An immutable snapshot of every sound under a root, sorted by path, that a cold start can map
+// and show before touching the tree. Snapshots are never changed in place: a reconcile builds a
+// new one from the disk and the previous snapshot, so readers on other threads need no locks
+typedef struct LibraryIndex LibraryIndex;
+
+typedef struct {
+  uint32_t directories;  // Directories read
+  uint32_t probed;  // New or changed files whose header had to be read
+  uint32_t header_round_trips;  // Kernel round trips that read the probed WAV headers, in batches
+  uint32_t hashed;  // Files whose audio was read whole, to tell copies apart
+  uint32_t duplicates;  // Entries whose original is another
+  uint32_t reused;  // Files unchanged since the previous snapshot, or outside the changes
+  uint64_t scan_ns;  // Walking the tree
+  uint64_t total_ns;  // Walking, stat'ing and probing
+} LibraryIndexStats;
+
+// What a full scan found under one root
+typedef struct {
+  uint32_t sounds;
+  uint32_t directories;  // Directories read
+  uint32_t pruned;  // Directories past the depth limit and excluded entries, left unopened
+  uint64_t scan_ns;
+} LibraryRootStats;
+
+// Map a saved index. Returns NULL if the file is missing, damaged or from another version
+LibraryIndex* library_index_map(const char* file);
+
+// Scan every root of config and build a snapshot. Files whose mtime and size match previous
+// (which may be NULL) keep its entry; the rest have their headers probed, a batch at a time (see
+// header_reader.h). Links to one file, and files whose format and length match another's and
+// whose audio hashes the same, point at the first of them. Analysis comes from loudness (may be
+// NULL) or, failing that, from previous. Stops early and returns NULL once *cancel is set. stats
+// may be NULL, and root_stats, if not NULL, gets an entry per root
+LibraryIndex* library_index_build(
+    const LibraryConfig* config,
+    const LibraryIndex* previous,
+    LoudnessCache* loudness,
+    const int* cancel,
+    LibraryIndexStats* stats,
+    LibraryRootStats* root_stats);
+
+// Like library_index_build(), but only the paths in changes (normalized) are looked at again; the
+// rest of previous is taken as is. A changed directory is rescanned whole, as far as its root's
+// depth limit and excludes let the scan go
+LibraryIndex* library_index_update(
+    const LibraryIndex* previous,
+    const LibraryConfig* config,
+    const ChangeSet* changes,
+    LoudnessCache* loudness,
+    const int* cancel,
+    LibraryIndexStats* stats);
+
+// Write a snapshot to file, through a temporary file renamed over it. Returns 1 on success
+int library_index_save(const LibraryIndex* index, const char* file);
+
+void library_index_free(LibraryIndex* index);
+
+uint32_t library_index_count(const LibraryIndex* index);
+const LibraryEntry* library_index_entry(const LibraryIndex* index, uint32_t i);
+const char* library_index_path(const LibraryIndex* index, uint32_t i);
+
+// Entry for a path, or NULL if the snapshot (which may be NULL) doesn't list it
+const LibraryEntry* library_index_find(const LibraryIndex* index, const char* path);
+
+// Whether two snapshots are identical down to the analysis, so there is nothing to save
+int library_index_identical(const LibraryIndex* a, const LibraryIndex* b);
+
+#endif  // LIBRARY_INDEX_H
@@ -0,0 +1,446 @@
+#include "loudness.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "convert.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define LOUDNESS_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LOUDNESS_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LOUDNESS_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define LOUDNESS_RATE 48000
+#define LOUDNESS_CHUNK_FRAMES 1024  // Frames converted and filtered per step
+#define SUBBLOCK_FRAMES (LOUDNESS_RATE / 10)  // Gating blocks are 400 ms and overlap by 75%
+#define SUBBLOCKS_PER_BLOCK 4
+#define ABSOLUTE_GATE_LUFS -70.0
+#define RELATIVE_GATE_LU -10.0
+
+// True-peak interpolation from BS.1770-4 Annex 2: four phases of a 48-tap FIR
+#define TP_PHASES 4
+#define TP_TAPS 12
+#define TP_HISTORY (TP_TAPS - 1)
+
+static const float tp_coefficients[TP_PHASES][TP_TAPS] = {
+    {0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f,
+     -0.0594482421875f, 0.1373291015625f, 0.9721679687500f, -0.1022949218750f,
+     0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f},
+    {-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f,
+     -0.1665039062500f, 0.4650878906250f, 0.7797851562500f, -0.2003173828125f,
+     0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f},
+    {-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f,
+     -0.2003173828125f, 0.7797851562500f, 0.4650878906250f, -0.1665039062500f,
+     0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f},
+    {-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f,
+     -0.1022949218750f, 0.9721679687500f, 0.1373291015625f, -0.0594482421875f,
+     0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f},
+};
+
+// K-weighting at 48 kHz: a high-shelf pre-filter followed by the RLB high-pass
+static const double kw_shelf_b[3] = {1.53512485958697, -2.69169618940638, 1.19839281085285};
+static const double kw_shelf_a[2] = {-1.69065929318241, 0.73248077421585};
+static const double kw_highpass_b[3] = {1.0, -2.0, 1.0};
+static const double kw_highpass_a[2] = {-1.99004745483398, 0.99007225036621};
+
+// Transposed direct form II state, [register][channel]: shelf z1, shelf z2, high-pass z1, z2
+typedef double KWeightState[4][2];
+
+typedef struct {
+  const char* name;
+  // Filter interleaved stereo through the K-weighting and add the squared output to *energy
+  void (*kweight)(KWeightState state, const float* in, uint32_t frames, double* energy);
+  // Largest |sample| of the 4x oversampled signal. x[-TP_HISTORY..-1] must hold history
+  float (*true_peak)(const float* x, uint32_t count);
+} LoudnessKernels;
+
+struct LoudnessMeter {
+  KWeightState state;
+  double subblock_energy;  // Squared K-weighted samples of both channels in the open sub-block
+  uint32_t subblock_frames;
+  double* subblocks;  // Energy of every completed 100 ms sub-block
+  uint32_t subblock_count;
+  uint32_t subblock_capacity;
+  double total_energy;  // For sounds too short to fill a gating block
+  uint64_t total_frames;
+  float peak;
+  float interleaved[LOUDNESS_CHUNK_FRAMES * 2];
+  float planar[2][TP_HISTORY + LOUDNESS_CHUNK_FRAMES];
+};
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+
+static void kweight_scalar(KWeightState state, const float* in, uint32_t frames, double* energy) {
+  double sum[2] = {0.0, 0.0};
+  for (uint32_t i = 0; i < frames; i++) {
+    for (int c = 0; c < 2; c++) {
+      double x = (double)in[i * 2 + c];
+      double y = kw_shelf_b[0] * x + state[0][c];
+      state[0][c] = kw_shelf_b[1] * x - kw_shelf_a[0] * y + state[1][c];
+      state[1][c] = kw_shelf_b[2] * x - kw_shelf_a[1] * y;
+      double z = kw_highpass_b[0] * y + state[2][c];
+      state[2][c] = kw_highpass_b[1] * y - kw_highpass_a[0] * z + state[3][c];
+      state[3][c] = kw_highpass_b[2] * y - kw_highpass_a[1] * z;
+      sum[c] += z * z;
+    }
+  }
+  *energy += sum[0] + sum[1];
+}
+
+static float true_peak_scalar(const float* x, uint32_t count) {
+  float peak = 0.0f;
+  for (uint32_t n = 0; n < count; n++) {
+    for (int p = 0; p < TP_PHASES; p++) {
+      float y = 0.0f;
+      for (int k = 0; k < TP_TAPS; k++)
+        y += tp_coefficients[p][k] * x[(int32_t)n - k];
+      y = fabsf(y);
+      if (y > peak)
+        peak = y;
+    }
+  }
+  return peak;
+}
+
+// ---------------------------------------------------------------------------
+// SSE2: both channels of the biquads in one register, four true-peak outputs per step
+
+#ifdef LOUDNESS_HAVE_SSE2
+static void kweight_sse2(KWeightState state, const float* in, uint32_t frames, double* energy) {
+  __m128d sb0 = _mm_set1_pd(kw_shelf_b[0]);
+  __m128d sb1 = _mm_set1_pd(kw_shelf_b[1]);
+  __m128d sb2 = _mm_set1_pd(kw_shelf_b[2]);
+  __m128d sa1 = _mm_set1_pd(kw_shelf_a[0]);
+  __m128d sa2 = _mm_set1_pd(kw_shelf_a[1]);
+  __m128d hb0 = _mm_set1_pd(kw_highpass_b[0]);
+  __m128d hb1 = _mm_set1_pd(kw_highpass_b[1]);
+  __m128d hb2 = _mm_set1_pd(kw_highpass_b[2]);
+  __m128d ha1 = _mm_set1_pd(kw_highpass_a[0]);
+  __m128d ha2 = _mm_set1_pd(kw_highpass_a[1]);
+  __m128d s1 = _mm_loadu_pd(state[0]);
+  __m128d s2 = _mm_loadu_pd(state[1]);
+  __m128d h1 = _mm_loadu_pd(state[2]);
+  __m128d h2 = _mm_loadu_pd(state[3]);
+  __m128d sum = _mm_setzero_pd();
+
+  for (uint32_t i = 0; i < frames; i++) {
+    __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(in + i * 2))));
+    __m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s1);
+    s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, y)), s2);
+    s2 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+    __m128d z = _mm_add_pd(_mm_mul_pd(hb0, y), h1);
+    h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, z)), h2);
+    h2 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, z));
+    sum = _mm_add_pd(sum, _mm_mul_pd(z, z));
+  }
+
+  _mm_storeu_pd(state[0], s1);
+  _mm_storeu_pd(state[1], s2);
+  _mm_storeu_pd(state[2], h1);
+  _mm_storeu_pd(state[3], h2);
+  double sums[2];
+  _mm_storeu_pd(sums, sum);
+  *energy += sums[0] + sums[1];
+}
+
+static float true_peak_sse2(const float* x, uint32_t count) {
+  __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 peak = _mm_setzero_ps();
+  uint32_t n = 0;
+  for (; n + 4 <= count; n += 4) {
+    for (int p = 0; p < TP_PHASES; p++) {
+      __m128 y = _mm_setzero_ps();
+      for (int k = 0; k < TP_TAPS; k++)
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_set1_ps(tp_coefficients[p][k]), _mm_loadu_ps(x + n - k)));
+      peak = _mm_max_ps(peak, _mm_andnot_ps(sign, y));
+    }
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, peak);
+  float result = true_peak_scalar(x + n, count - n);
+  for (int i = 0; i < 4; i++)
+    result = lanes[i] > result ? lanes[i] : result;
+  return result;
+}
+#endif
+
+#ifdef LOUDNESS_HAVE_AVX2
+__attribute__((target("avx2"))) static float true_peak_avx2(const float* x, uint32_t count) {
+  __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 peak = _mm256_setzero_ps();
+  uint32_t n = 0;
+  for (; n + 8 <= count; n += 8) {
+    for (int p = 0; p < TP_PHASES; p++) {
+      __m256 y = _mm256_setzero_ps();
+      for (int k = 0; k < TP_TAPS; k++) {
+        __m256 c = _mm256_set1_ps(tp_coefficients[p][k]);
+        y = _mm256_add_ps(y, _mm256_mul_ps(c, _mm256_loadu_ps(x + n - k)));
+      }
+      peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, y));
+    }
+  }
+
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  float result = true_peak_sse2(x + n, count - n);
+  for (int i = 0; i < 4; i++)
+    result = lanes[i] > result ? lanes[i] : result;
+  return result;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// NEON (AArch64, which has double-precision vectors for the biquads)
+
+#ifdef LOUDNESS_HAVE_NEON
+static void kweight_neon(KWeightState state, const float* in, uint32_t frames, double* energy) {
+  float64x2_t s1 = vld1q_f64(state[0]);
+  float64x2_t s2 = vld1q_f64(state[1]);
+  float64x2_t h1 = vld1q_f64(state[2]);
+  float64x2_t h2 = vld1q_f64(state[3]);
+  float64x2_t sum = vdupq_n_f64(0.0);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    float64x2_t x = vcvt_f64_f32(vld1_f32(in + i * 2));
+    float64x2_t y = vaddq_f64(vmulq_n_f64(x, kw_shelf_b[0]), s1);
+    s1 = vaddq_f64(vsubq_f64(vmulq_n_f64(x, kw_shelf_b[1]), vmulq_n_f64(y, kw_shelf_a[0])), s2);
+    s2 = vsubq_f64(vmulq_n_f64(x, kw_shelf_b[2]), vmulq_n_f64(y, kw_shelf_a[1]));
+    float64x2_t z = vaddq_f64(vmulq_n_f64(y, kw_highpass_b[0]), h1);
+    h1 = vaddq_f64(
+        vsubq_f64(vmulq_n_f64(y, kw_highpass_b[1]), vmulq_n_f64(z, kw_highpass_a[0])), h2);
+    h2 = vsubq_f64(vmulq_n_f64(y, kw_highpass_b[2]), vmulq_n_f64(z, kw_highpass_a[1]));
+    sum = vaddq_f64(sum, vmulq_f64(z, z));
+  }
+
+  vst1q_f64(state[0], s1);
+  vst1q_f64(state[1], s2);
+  vst1q_f64(state[2], h1);
+  vst1q_f64(state[3], h2);
+  *energy += vgetq_lane_f64(sum, 0) + vgetq_lane_f64(sum, 1);
+}
+
+static float true_peak_neon(const float* x, uint32_t count) {
+  float32x4_t peak = vdupq_n_f32(0.0f);
+  uint32_t n = 0;
+  for (; n + 4 <= count; n += 4) {
+    for (int p = 0; p < TP_PHASES; p++) {
+      float32x4_t y = vdupq_n_f32(0.0f);
+      for (int k = 0; k < TP_TAPS; k++)
+        y = vmlaq_n_f32(y, vld1q_f32(x + n - k), tp_coefficients[p][k]);
+      peak = vmaxq_f32(peak, vabsq_f32(y));
+    }
+  }
+
+  float result = true_peak_scalar(x + n, count - n);
+  float lanes = vmaxvq_f32(peak);
+  return lanes > result ? lanes : result;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch
+
+static const LoudnessKernels scalar_kernels = {"scalar", kweight_scalar, true_peak_scalar};
+
+static int force_scalar = 0;
+
+static const LoudnessKernels* select_kernels(void) {
+  static LoudnessKernels best;
+  best = scalar_kernels;
+#ifdef LOUDNESS_HAVE_SSE2
+  best.name = "sse2";
+  best.kweight = kweight_sse2;
+  best.true_peak = true_peak_sse2;
+#endif
+#ifdef LOUDNESS_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    best.name = "avx2";
+    best.true_peak = true_peak_avx2;
+  }
+#endif
+#ifdef LOUDNESS_HAVE_NEON
+  best.name = "neon";
+  best.kweight = kweight_neon;
+  best.true_peak = true_peak_neon;
+#endif
+  return &best;
+}
+
+static const LoudnessKernels* kernels(void) {
+  static const LoudnessKernels* selected = NULL;
+  if (__atomic_load_n(&force_scalar, __ATOMIC_RELAXED))
+    return &scalar_kernels;
+
+  const LoudnessKernels* k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+  if (!k) {
+    k = select_kernels();
+    __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+const char* loudness_kernel_name(void) {
+  return kernels()->name;
+}
+
+void loudness_force_scalar(int enabled) {
+  __atomic_store_n(&force_scalar, enabled, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------
+// Meter
+
+LoudnessMeter* loudness_meter_create(void) {
+  return (LoudnessMeter*)calloc(1, sizeof(LoudnessMeter));
+}
+
+void loudness_meter_destroy(LoudnessMeter* meter) {
+  if (!meter)
+    return;
+  free(meter->subblocks);
+  free(meter);
+}
+
+static int close_subblock(LoudnessMeter* meter) {
+  if (meter->subblock_count == meter->subblock_capacity) {
+    uint32_t capacity = meter->subblock_capacity ? meter->subblock_capacity * 2 : 256;
+    double* subblocks = (double*)realloc(meter->subblocks, capacity * sizeof(double));
+    if (!subblocks)
+      return 0;
+    meter->subblocks = subblocks;
+    meter->subblock_capacity = capacity;
+  }
+  meter->subblocks[meter->subblock_count++] = meter->subblock_energy;
+  meter->subblock_energy = 0.0;
+  meter->subblock_frames = 0;
+  return 1;
+}
+
+int loudness_meter_add(LoudnessMeter* meter, const int16_t* samples, uint32_t frames) {
+  const LoudnessKernels* k = kernels();
+#ifdef LOUDNESS_HAVE_SSE2
+  // Filter state decaying through trailing silence would otherwise crawl through denormals
+  unsigned int csr = _mm_getcsr();
+  _mm_setcsr(csr | 0x8040);  // Flush-to-zero and denormals-are-zero
+#endif
+
+  int ok = 1;
+  while (frames > 0 && ok) {
+    uint32_t chunk = frames < LOUDNESS_CHUNK_FRAMES ? frames : LOUDNESS_CHUNK_FRAMES;
+    convert_to_f32(meter->interleaved, samples, SAMPLE_S16, chunk * 2);
+
+    for (int c = 0; c < 2; c++) {
+      float* x = meter->planar[c] + TP_HISTORY;
+      for (uint32_t i = 0; i < chunk; i++)
+        x[i] = meter->interleaved[i * 2 + c];
+      float peak = k->true_peak(x, chunk);
+      if (peak > meter->peak)
+        meter->peak = peak;
+      memmove(meter->planar[c], x + chunk - TP_HISTORY, TP_HISTORY * sizeof(float));
+    }
+
+    const float* in = meter->interleaved;
+    uint32_t left = chunk;
+    while (left > 0) {
+      uint32_t span = SUBBLOCK_FRAMES - meter->subblock_frames;
+      if (span > left)
+        span = left;
+      double energy = 0.0;
+      k->kweight(meter->state, in, span, &energy);
+      meter->subblock_energy += energy;
+      meter->total_energy += energy;
+      meter->subblock_frames += span;
+      if (meter->subblock_frames == SUBBLOCK_FRAMES && !close_subblock(meter)) {
+        ok = 0;
+        break;
+      }
+      in += span * 2;
+      left -= span;
+    }
+
+    meter->total_frames += chunk;
+    samples += chunk * 2;
+    frames -= chunk;
+  }
+
+#ifdef LOUDNESS_HAVE_SSE2
+  _mm_setcsr(csr);
+#endif
+  return ok;
+}
+
+static double energy_to_lufs(double mean_square) {
+  return mean_square > 0.0 ? -0.691 + 10.0 * log10(mean_square) : -INFINITY;
+}
+
+void loudness_meter_result(const LoudnessMeter* meter, Loudness* out) {
+  out->true_peak_dbtp = meter->peak > 0.0f ? 20.0f * log10f(meter->peak) : -INFINITY;
+
+  const double block_frames = (double)(SUBBLOCK_FRAMES * SUBBLOCKS_PER_BLOCK);
+  const double absolute_gate = pow(10.0, (ABSOLUTE_GATE_LUFS + 0.691) / 10.0);
+  uint32_t block_count = meter->subblock_count >= SUBBLOCKS_PER_BLOCK
+                             ? meter->subblock_count - SUBBLOCKS_PER_BLOCK + 1
+                             : 0;
+
+  if (block_count == 0) {
+    double mean_square =
+        meter->total_frames > 0 ? meter->total_energy / (double)meter->total_frames : 0.0;
+    out->integrated_lufs =
+        mean_square > absolute_gate ? (float)energy_to_lufs(mean_square) : -INFINITY;
+    return;
+  }
+
+  // First pass: absolute gate, which sets the relative gate
+  double sum = 0.0;
+  uint32_t passed = 0;
+  for (uint32_t j = 0; j < block_count; j++) {
+    const double* s = meter->subblocks + j;
+    double mean_square = (s[0] + s[1] + s[2] + s[3]) / block_frames;
+    if (mean_square > absolute_gate) {
+      sum += mean_square;
+      passed++;
+    }
+  }
+  if (passed == 0) {
+    out->integrated_lufs = -INFINITY;
+    return;
+  }
+
+  // Second pass: blocks within 10 LU of the absolutely-gated loudness
+  double relative_gate = (sum / passed) * pow(10.0, RELATIVE_GATE_LU / 10.0);
+  sum = 0.0;
+  passed = 0;
+  for (uint32_t j = 0; j < block_count; j++) {
+    const double* s = meter->subblocks + j;
+    double mean_square = (s[0] + s[1] + s[2] + s[3]) / block_frames;
+    if (mean_square > absolute_gate && mean_square > relative_gate) {
+      sum += mean_square;
+      passed++;
+    }
+  }
+  out->integrated_lufs = passed > 0 ? (float)energy_to_lufs(sum / passed) : -INFINITY;
+}
+
+float loudness_normalization_gain(const Loudness* loudness, float target_lufs) {
+  if (!isfinite(loudness->integrated_lufs))
+    return 1.0f;
+
+  float gain_db = target_lufs - loudness->integrated_lufs;
+  float headroom_db = LOUDNESS_PEAK_CEILING_DBTP - loudness->true_peak_dbtp;
+  if (gain_db > headroom_db)
+    gain_db = headroom_db;
+  if (gain_db > LOUDNESS_MAX_BOOST_DB)
+    gain_db = LOUDNESS_MAX_BOOST_DB;
+  return powf(10.0f, gain_db / 20.0f);
+}
@@ -0,0 +1,38 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <stdint.h>
+
+#define LOUDNESS_PEAK_CEILING_DBTP -1.0f  // Normalization never pushes true peaks above this
+#define LOUDNESS_MAX_BOOST_DB 20.0f  // Quiet sounds are raised by at most this much
+
+// Measured loudness of a sound. Both are -INFINITY for digital silence
+typedef struct {
+  float integrated_lufs;  // ITU-R BS.1770 / EBU R128 gated programme loudness
+  float true_peak_dbtp;  // Peak of the 4x oversampled signal
+} Loudness;
+
+// Incremental BS.1770 meter for device-format PCM (interleaved stereo int16 at 48 kHz)
+typedef struct LoudnessMeter LoudnessMeter;
+
+LoudnessMeter* loudness_meter_create(void);
+void loudness_meter_destroy(LoudnessMeter* meter);
+
+// Feed the next frames of the sound. Returns 0 if out of memory
+int loudness_meter_add(LoudnessMeter* meter, const int16_t* samples, uint32_t frames);
+
+// Loudness of everything fed so far. Sounds shorter than one 400 ms gating block are measured
+// as a single block instead of reading as silent
+void loudness_meter_result(const LoudnessMeter* meter, Loudness* out);
+
+// Linear gain that brings a sound to target_lufs without its true peak passing the ceiling.
+// Silence gets unity gain
+float loudness_normalization_gain(const Loudness* loudness, float target_lufs);
+
+// Name of the kernel set picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* loudness_kernel_name(void);
+
+// Force the scalar kernels (for benchmarks and bit-exactness checks)
+void loudness_force_scalar(int enabled);
+
+#endif  // LOUDNESS_H
@@ -0,0 +1,251 @@
+#include "loudness_cache.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+#include "onset.h"
+#include "sidecar_cache.h"
+#include "thread.h"
+
+#define CACHE_FILE_HEADER "soundboard-loudness 2\n"
+#define CACHE_LINE_MAX 8192
+
+typedef struct {
+  SidecarEntry base;
+  Loudness loudness;
+  uint32_t onset_frames;  // Where playback starts: the first audible frame, less a short pre-roll
+} CacheEntry;
+
+struct LoudnessCache {
+  SidecarCache base;
+  float target_lufs;
+  LoudnessCacheStats stats;  // analyzed and analysis_ns; the rest come from base
+};
+
+// Lines are "<mtime> <size> <integrated LUFS> <true peak dBTP> <onset frames> <path>"
+static void load_file(LoudnessCache* cache) {
+  FILE* file = fopen(cache->base.file, "rb");
+  if (!file)
+    return;
+
+  char* line = (char*)malloc(CACHE_LINE_MAX);
+  if (!line || !fgets(line, CACHE_LINE_MAX, file) || strcmp(line, CACHE_FILE_HEADER) != 0) {
+    free(line);
+    fclose(file);
+    return;
+  }
+
+  while (fgets(line, CACHE_LINE_MAX, file)) {
+    size_t length = strlen(line);
+    if (length == 0 || line[length - 1] != '\n')
+      continue;  // Truncated or overlong
+    line[length - 1] = '\0';
+
+    char* cursor = line;
+    int64_t mtime = strtoll(cursor, &cursor, 10);
+    uint64_t size = strtoull(cursor, &cursor, 10);
+    float lufs = strtof(cursor, &cursor);
+    float peak = strtof(cursor, &cursor);
+    uint32_t onset = (uint32_t)strtoul(cursor, &cursor, 10);
+    if (*cursor != ' ' || cursor[1] == '\0')
+      continue;
+
+    CacheEntry* entry = (CacheEntry*)sidecar_cache_add(&cache->base, cursor + 1);
+    if (!entry)
+      break;
+    entry->base.mtime = mtime;
+    entry->base.size = size;
+    entry->base.valid = 1;
+    entry->loudness.integrated_lufs = lufs;
+    entry->loudness.true_peak_dbtp = peak;
+    entry->onset_frames = onset;
+  }
+
+  free(line);
+  fclose(file);
+}
+
+static void* encode_file(SidecarCache* base, size_t* length) {
+  size_t capacity = 4096;
+  char* text = (char*)malloc(capacity);
+  if (!text)
+    return NULL;
+
+  strcpy(text, CACHE_FILE_HEADER);
+  *length = strlen(CACHE_FILE_HEADER);
+  for (SidecarEntry* it = sidecar_cache_next(base, NULL); it; it = sidecar_cache_next(base, it)) {
+    const CacheEntry* entry = (const CacheEntry*)it;
+    if (strchr(it->path, '\n'))
+      continue;
+    size_t needed = strlen(it->path) + 128;
+    if (*length + needed > capacity) {
+      while (*length + needed > capacity)
+        capacity *= 2;
+      char* grown = (char*)realloc(text, capacity);
+      if (!grown) {
+        free(text);
+        return NULL;
+      }
+      text = grown;
+    }
+    // %.9g round-trips a float exactly, so a gain read back from the file matches the one
+    // measured, and renders stay bit-identical from run to run
+    *length += (size_t)snprintf(
+        text + *length,
+        capacity - *length,
+        "%" PRId64 " %" PRIu64 " %.9g %.9g %" PRIu32 " %s\n",
+        it->mtime,
+        it->size,
+        entry->loudness.integrated_lufs,
+        entry->loudness.true_peak_dbtp,
+        entry->onset_frames,
+        it->path);
+  }
+  return text;
+}
+
+static void measure_entry(SidecarCache* base, SidecarEntry* it, int64_t mtime, uint64_t size) {
+  LoudnessCache* cache = (LoudnessCache*)base;
+  CacheEntry* entry = (CacheEntry*)it;
+
+  uint64_t start = time_ns();
+  Decoder* decoder = decoder_open(it->path);
+  LoudnessMeter* meter = decoder ? loudness_meter_create() : NULL;
+  int16_t* chunk = meter ? (int16_t*)malloc(DECODER_CHUNK_FRAMES * 2 * sizeof(int16_t)) : NULL;
+  int ok = chunk != NULL;
+  uint32_t frames;
+  uint32_t decoded = 0;
+  uint32_t onset = UINT32_MAX;
+  while (ok && (frames = decoder_read(decoder, chunk, DECODER_CHUNK_FRAMES)) > 0) {
+    ok = loudness_meter_add(meter, chunk, frames);
+    if (onset == UINT32_MAX) {
+      uint32_t sample = onset_find(chunk, frames * 2, ONSET_THRESHOLD);
+      if (sample < frames * 2)
+        onset = decoded + sample / 2;
+    }
+    decoded += frames;
+  }
+
+  // A silent sound plays from the top
+  Loudness loudness;
+  if (ok)
+    loudness_meter_result(meter, &loudness);
+  if (onset == UINT32_MAX || onset < ONSET_PREROLL_FRAMES)
+    onset = 0;
+  else
+    onset -= ONSET_PREROLL_FRAMES;
+  free(chunk);
+  loudness_meter_destroy(meter);
+  decoder_close(decoder);
+
+  mutex_lock(&base->lock);
+  if (ok) {
+    it->mtime = mtime;
+    it->size = size;
+    it->valid = 1;
+    entry->loudness = loudness;
+    entry->onset_frames = onset;
+    base->dirty = 1;
+    cache->stats.analyzed++;
+  } else {
+    it->valid = 0;
+    base->failed++;
+  }
+  cache->stats.analysis_ns += time_ns() - start;
+  mutex_unlock(&base->lock);
+}
+
+static const SidecarOps LOUDNESS_OPS = {
+    "loudness",
+    sizeof(CacheEntry),
+    measure_entry,
+    encode_file,
+    NULL,
+};
+
+LoudnessCache* loudness_cache_create(const char* file, WorkerPool* pool, float target_lufs) {
+  LoudnessCache* cache = (LoudnessCache*)calloc(1, sizeof(LoudnessCache));
+  if (!cache)
+    return NULL;
+  if (!sidecar_cache_init(&cache->base, &LOUDNESS_OPS, file, pool)) {
+    free(cache);
+    return NULL;
+  }
+
+  cache->target_lufs = target_lufs;
+  load_file(cache);
+  return cache;
+}
+
+void loudness_cache_destroy(LoudnessCache* cache) {
+  if (!cache)
+    return;
+
+  sidecar_cache_destroy(&cache->base);
+  free(cache);
+}
+
+void loudness_cache_analyze(LoudnessCache* cache, const char* path) {
+  if (cache)
+    sidecar_cache_analyze(&cache->base, path);
+}
+
+float loudness_cache_gain(LoudnessCache* cache, const char* path) {
+  if (!cache || isnan(cache->target_lufs))
+    return 1.0f;
+
+  mutex_lock(&cache->base.lock);
+  const CacheEntry* entry = (const CacheEntry*)sidecar_cache_find(&cache->base, path);
+  Loudness loudness = {-INFINITY, -INFINITY};
+  if (entry && entry->base.valid)
+    loudness = entry->loudness;
+  mutex_unlock(&cache->base.lock);
+  return loudness_normalization_gain(&loudness, cache->target_lufs);
+}
+
+uint32_t loudness_cache_onset(LoudnessCache* cache, const char* path) {
+  if (!cache)
+    return 0;
+
+  mutex_lock(&cache->base.lock);
+  const CacheEntry* entry = (const CacheEntry*)sidecar_cache_find(&cache->base, path);
+  uint32_t onset = entry && entry->base.valid ? entry->onset_frames : 0;
+  mutex_unlock(&cache->base.lock);
+  return onset;
+}
+
+int loudness_cache_lookup(
+    LoudnessCache* cache,
+    const char* path,
+    int64_t mtime,
+    uint64_t size,
+    Loudness* loudness,
+    uint32_t* onset_frames) {
+  if (!cache)
+    return 0;
+
+  mutex_lock(&cache->base.lock);
+  const CacheEntry* entry = (const CacheEntry*)sidecar_cache_find(&cache->base, path);
+  int measured = entry && entry->base.valid && entry->base.mtime == mtime &&
+                 entry->base.size == size;
+  if (measured) {
+    *loudness = entry->loudness;
+    *onset_frames = entry->onset_frames;
+  }
+  mutex_unlock(&cache->base.lock);
+  return measured;
+}
+
+void loudness_cache_get_stats(LoudnessCache* cache, LoudnessCacheStats* stats) {
+  mutex_lock(&cache->base.lock);
+  *stats = cache->stats;
+  stats->reused = cache->base.reused;
+  stats->failed = cache->base.failed;
+  stats->pending = cache->base.pending;
+  stats->entries = cache->base.entries;
+  mutex_unlock(&cache->base.lock);
+}
@@ -0,0 +1,58 @@
+#ifndef LOUDNESS_CACHE_H
+#define LOUDNESS_CACHE_H
+
+#include <stdint.h>
+
+#include "loudness.h"
+#include "worker_pool.h"
+
+#define LOUDNESS_DEFAULT_TARGET_LUFS -18.0f
+#define LOUDNESS_CACHE_FILE ".soundboard-loudness"
+
+// Per-sound loudness and leading silence measured in the background in one decode, persisted
+// across runs keyed by path + mtime + size, and turned into a normalization gain and a start
+// offset at playback
+typedef struct LoudnessCache LoudnessCache;
+
+typedef struct {
+  uint64_t analyzed;  // Sounds decoded and measured this run
+  uint64_t reused;  // Sounds whose stored measurement was still valid
+  uint64_t failed;  // Sounds that couldn't be decoded
+  uint64_t analysis_ns;  // Worker time spent decoding and measuring
+  uint32_t pending;  // Sounds queued or being measured
+  uint32_t entries;
+} LoudnessCacheStats;
+
+// Load measurements saved in file (a missing or unreadable file is fine). Measurements run as
+// jobs on pool, which must be destroyed before the cache. A NAN target measures without
+// normalizing
+LoudnessCache* loudness_cache_create(const char* file, WorkerPool* pool, float target_lufs);
+
+// Save anything measured since the last save and free the cache
+void loudness_cache_destroy(LoudnessCache* cache);
+
+// Queue a sound for measurement unless it is already queued. The worker stats the file and keeps
+// the stored result if mtime and size still match; the caller never touches the disk.
+// Results are written back to the file each time the queue drains
+void loudness_cache_analyze(LoudnessCache* cache, const char* path);
+
+// Linear normalization gain for a sound, or 1 if it hasn't been measured yet
+float loudness_cache_gain(LoudnessCache* cache, const char* path);
+
+// Frame playback of a sound should start at to skip its leading silence, or 0 if it hasn't been
+// measured yet
+uint32_t loudness_cache_onset(LoudnessCache* cache, const char* path);
+
+// Stored measurement of a sound as it was at mtime and size. Returns 0 if there is none
+int loudness_cache_lookup(
+    LoudnessCache* cache,
+    const char* path,
+    int64_t mtime,
+    uint64_t size,
+    Loudness* loudness,
+    uint32_t* onset_frames);
+
+// Snapshot the cache counters
+void loudness_cache_get_stats(LoudnessCache* cache, LoudnessCacheStats* stats);
+
+#endif  // LOUDNESS_CACHE_H
@@ -5,14 +5,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef _WIN32
-#define str_casecmp _stricmp
-#else
-#include <strings.h>
-#define str_casecmp strcasecmp
-#endif
-
+#include "bounce.h"
 #include "callbacks.h"
+#include "decoder.h"
 #include "renderer.h"
 #include "soundboard.h"
 
@@ -20,16 +15,48 @@
 #error "This program requires a C99-compliant compiler."
 #endif
 
+// Bottom-left corner of the tile at a grid position; 0 if the tile is scrolled off screen
+static int tile_origin(const Soundboard* sb, int position, float* x, float* y) {
+  int row = position / sb->grid_cols;
+  int col = position % sb->grid_cols;
+  *x = 50.0f + col * (TILE_WIDTH + TILE_SPACING);
+  *y = sb->window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) - sb->scroll_offset;
+  return *y + TILE_HEIGHT >= 0 && *y <= sb->window_height;
+}
+
 #ifdef _WIN32
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
   (void)hInstance;
   (void)hPrevInstance;
   (void)lpCmdLine;
   (void)nCmdShow;
+  int argc = __argc;
+  char** argv = __argv;
 #else
-int main(void) {
+int main(int argc, char** argv) {
 #endif
 
+  // Headless: bounce a trigger script to a WAV file without opening a window
+  if (argc > 1 && strcmp(argv[1], "--render") == 0) {
+    if (argc != 4) {
+      fprintf(stderr, "Usage: soundboard --render <script> <output.wav>\n");
+      return 1;
+    }
+    return bounce_script(argv[2], argv[3]) ? 0 : 1;
+  }
+
+  // Library roots from the config file, with the flags on top
+  if (argc > 1 && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)) {
+    fputs(LIBRARY_CONFIG_USAGE, stdout);
+    return 0;
+  }
+  LibraryConfig library_config;
+  if (!library_config_load(&library_config, NULL, argc - 1, argv + 1)) {
+    fputs(LIBRARY_CONFIG_USAGE, stderr);
+    library_config_free(&library_config);
+    return 1;
+  }
+
   if (!glfwInit()) {
     fprintf(stderr, "Failed to initialize GLFW\n");
     return -1;
@@ -66,6 +93,7 @@ int main(void) {
   set_projection(800.0f, 600.0f);
 
   Soundboard sb = {0};
+  sb.library_config = library_config;
   sb.window_width = 800.0f;
   sb.window_height = 600.0f;
   sb.grid_cols = floor((sb.window_width - 50.0f) / (TILE_WIDTH + TILE_SPACING));
@@ -78,8 +106,12 @@ int main(void) {
   glfwSetScrollCallback(window, scroll_callback);
   glfwSetMouseButtonCallback(window, mouse_button_callback);
   glfwSetCursorPosCallback(window, cursor_position_callback);
+  glfwSetCharCallback(window, char_callback);
+  glfwSetKeyCallback(window, key_callback);
 
-  load_sounds(&sb);
+  init_audio(&sb);
+  init_analysis(&sb);
+  open_library(&sb);
 
   // Start filesystem watcher
 #ifdef _WIN32
@@ -94,24 +126,13 @@ int main(void) {
 #endif
 
   while (!glfwWindowShouldClose(window)) {
-    if (sb.needs_refresh) {
-      load_sounds(&sb);
-      sb.needs_refresh = 0;
-    }
+    refresh_library(&sb);
 
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Update playback status
-    if (sb.playing_tile >= 0) {
-      uint32_t current_time = get_time_ms();
-      uint32_t elapsed = current_time - sb.play_start_time_ms;
-      if (elapsed >= sb.sound_duration_ms) {
-        sb.playing_tile = -1;
-        sb.play_start_time_ms = 0;
-        sb.sound_duration_ms = 0;
-      }
-    }
+    update_playback(&sb);
 
     // Draw refresh button
     /*
@@ -134,38 +155,59 @@ int main(void) {
     draw_text(refresh_button_x + 10.0f, refresh_button_y + 10.0f, "Refresh", 1.0f, 1.0f, 1.0f);
     */
 
-    for (int i = 0; i < sb.count; i++) {
-      int row = i / sb.grid_cols;
-      int col = i % sb.grid_cols;
+    int first_position, end_position;
+    visible_tiles(&sb, &first_position, &end_position);
 
-      float tile_x = 50.0f + col * (TILE_WIDTH + TILE_SPACING);
-      float tile_y =
-          sb.window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) - sb.scroll_offset;
-
-      if (tile_y + TILE_HEIGHT < 0 || tile_y > sb.window_height)
+    // Draw every tile background, with its playback progress overlay, in one call
+    for (int position = first_position; position < end_position; position++) {
+      float tile_x, tile_y;
+      if (!tile_origin(&sb, position, &tile_x, &tile_y))
         continue;
+      float progress = get_tile_progress(&sb, shown_tile(&sb, position));
+      queue_tile(tile_x, tile_y, TILE_WIDTH, TILE_HEIGHT, 0.3f, 0.3f, 0.8f, progress);
+    }
+    draw_tiles(0.2f, 0.2f, 0.6f);
 
-      // Draw tile background
-      draw_rect(tile_x, tile_y, TILE_WIDTH, TILE_HEIGHT, 0.3f, 0.3f, 0.8f);
-
-      // Draw playback progress overlay if this tile is playing
-      if (sb.playing_tile == i && sb.sound_duration_ms > 0) {
-        uint32_t current_time = get_time_ms();
-        uint32_t elapsed = current_time - sb.play_start_time_ms;
-        float progress = (float)elapsed / (float)sb.sound_duration_ms;
-        if (progress > 1.0f)
-          progress = 1.0f;
-
-        float progress_width = TILE_WIDTH * progress;
-        draw_rect(tile_x, tile_y, progress_width, TILE_HEIGHT, 0.2f, 0.2f, 0.6f);
+    for (int position = first_position; position < end_position; position++) {
+      int i = shown_tile(&sb, position);
+      float tile_x, tile_y;
+      if (!tile_origin(&sb, position, &tile_x, &tile_y))
+        continue;
+      float progress = get_tile_progress(&sb, i);
+
+      // Draw the waveform thumbnail, brighter where it has already played, and the playhead
+      float peak_min[TILE_WAVEFORM_COLUMNS];
+      float peak_max[TILE_WAVEFORM_COLUMNS];
+      float wave_x = tile_x + 5.0f;
+      float wave_y = tile_y + 20.0f;
+      uint32_t played = progress > 0.0f ? (uint32_t)(progress * TILE_WAVEFORM_COLUMNS) : 0;
+      if (played > TILE_WAVEFORM_COLUMNS)
+        played = TILE_WAVEFORM_COLUMNS;
+      if (waveform_cache_columns(
+              sb.waveforms, audio_path(&sb, i), TILE_WAVEFORM_COLUMNS, peak_min, peak_max)) {
+        draw_waveform(wave_x, wave_y, 1.0f, 16.0f, peak_min, peak_max, played, 0.9f, 0.9f, 1.0f);
+        draw_waveform(
+            wave_x + (float)played,
+            wave_y,
+            1.0f,
+            16.0f,
+            peak_min + played,
+            peak_max + played,
+            TILE_WAVEFORM_COLUMNS - played,
+            0.55f,
+            0.55f,
+            0.95f);
       }
+      if (progress >= 0.0f)
+        draw_rect(wave_x + (float)played, tile_y, 1.0f, TILE_HEIGHT, 1.0f, 1.0f, 1.0f);
 
       // Prepare filename for display
+      const char* path = sound_path(&sb, i);
       char display_name[32];
-      snprintf(display_name, sizeof(display_name), "%s", sb.sounds[i].name);
+      snprintf(display_name, sizeof(display_name), "%s", path);
       display_name[sizeof(display_name) - 1] = '\0';
       char* ext = strrchr(display_name, '.');
-      if (ext && str_casecmp(ext, ".wav") == 0)
+      if (ext && decoder_handles_extension(ext))
         *ext = '\0';
 
       // Handle marquee scrolling for hovered tile
@@ -173,18 +215,18 @@ int main(void) {
 
       if (sb.hovered_tile == i && strlen(display_name) > 18) {
         // Update marquee offset
-        sb.sounds[i].marquee_offset += 30.0f * (1.0f / 60.0f);  // Assume 60 FPS
+        sb.tiles[i].marquee_offset += 30.0f * (1.0f / 60.0f);  // Assume 60 FPS
 
         // Calculate text width (approximate)
         float text_width = strlen(display_name) * 8.0f;  // Approximate character width
         float visible_width = TILE_WIDTH - 10.0f;  // Available width for text
 
         // Reset offset when text has scrolled completely
-        if (sb.sounds[i].marquee_offset > text_width + visible_width) {
-          sb.sounds[i].marquee_offset = -visible_width;
+        if (sb.tiles[i].marquee_offset > text_width + visible_width) {
+          sb.tiles[i].marquee_offset = -visible_width;
         }
 
-        text_x = tile_x + 5.0f - sb.sounds[i].marquee_offset;
+        text_x = tile_x + 5.0f - sb.tiles[i].marquee_offset;
       } else {
         // Truncate text if not hovered
         if (strlen(display_name) > 18) {
@@ -196,7 +238,7 @@ int main(void) {
       }
 
       // Draw filename text (with clipping for marquee effect)
-      if (sb.hovered_tile == i && strlen(sb.sounds[i].name) > 18) {
+      if (sb.hovered_tile == i && strlen(path) > 18) {
         draw_text_clipped(
             text_x,
             tile_y + TILE_HEIGHT - 15.0f,
@@ -213,6 +255,23 @@ int main(void) {
       }
     }
 
+    // Draw the search field along the bottom while there is a query
+    if (sb.search_query[0] != '\0') {
+      char search_line[SEARCH_QUERY_MAX + 64];
+      if (sb.search)
+        snprintf(
+            search_line,
+            sizeof(search_line),
+            "Search: %s (%d of %d)",
+            sb.search_query,
+            sb.shown_count,
+            sb.count);
+      else
+        snprintf(search_line, sizeof(search_line), "Search: %s (indexing)", sb.search_query);
+      draw_rect(0.0f, 0.0f, sb.window_width, 24.0f, 0.15f, 0.15f, 0.15f);
+      draw_text(10.0f, 8.0f, search_line, 1.0f, 1.0f, 1.0f);
+    }
+
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
@@ -224,10 +283,13 @@ int main(void) {
   CloseHandle(sb.watcher_thread);
   CloseHandle(sb.watcher_stop_event);
 #else
-  sb.watcher_stop = 1;
+  __atomic_store_n(&sb.watcher_stop, 1, __ATOMIC_RELEASE);
   pthread_join(sb.watcher_thread, NULL);
 #endif
 
+  close_library(&sb);
+  shutdown_analysis(&sb);
+  shutdown_audio(&sb);
   cleanup_renderer();
   glfwTerminate();
   return 0;
@@ -0,0 +1,215 @@
+#include "mixer.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define MIX_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define MIX_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON)
+#define MIX_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+  const char* name;
+  void (*accumulate)(float* acc, const int16_t* src, uint32_t count, float gain);
+  void (*clip)(int16_t* dst, const float* acc, uint32_t count);
+} MixKernels;
+
+// Rounds to nearest, ties to even, as cvtps and vcvtnq do, so every kernel gives the same samples
+static int16_t clip_sample(float value) {
+  if (value >= 32767.0f)
+    return 32767;
+  if (value <= -32768.0f)
+    return -32768;
+  return (int16_t)lrintf(value);
+}
+
+static void accumulate_scalar(float* acc, const int16_t* src, uint32_t count, float gain) {
+  for (uint32_t i = 0; i < count; i++)
+    acc[i] += (float)src[i] * gain;
+}
+
+static void clip_scalar(int16_t* dst, const float* acc, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    dst[i] = clip_sample(acc[i]);
+}
+
+#ifdef MIX_HAVE_SSE2
+static void accumulate_sse2(float* acc, const int16_t* src, uint32_t count, float gain) {
+  __m128 g = _mm_set1_ps(gain);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    // Sign-extend by placing each int16 in the high half of an int32 and shifting back down
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    __m128 a0 = _mm_loadu_ps(acc + i);
+    __m128 a1 = _mm_loadu_ps(acc + i + 4);
+    a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+    a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+    _mm_storeu_ps(acc + i, a0);
+    _mm_storeu_ps(acc + i + 4, a1);
+  }
+  accumulate_scalar(acc + i, src + i, count - i, gain);
+}
+
+static void clip_sse2(int16_t* dst, const float* acc, uint32_t count) {
+  __m128 max = _mm_set1_ps(32767.0f);
+  __m128 min = _mm_set1_ps(-32768.0f);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128 a0 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), min), max);
+    __m128 a1 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i + 4), min), max);
+    __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a0), _mm_cvtps_epi32(a1));
+    _mm_storeu_si128((__m128i*)(dst + i), packed);
+  }
+  clip_scalar(dst + i, acc + i, count - i);
+}
+#endif
+
+#ifdef MIX_HAVE_AVX2
+__attribute__((target("avx2"))) static void accumulate_avx2(
+    float* acc,
+    const int16_t* src,
+    uint32_t count,
+    float gain) {
+  __m256 g = _mm256_set1_ps(gain);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+    __m256 a0 = _mm256_loadu_ps(acc + i);
+    __m256 a1 = _mm256_loadu_ps(acc + i + 8);
+    a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), g));
+    a1 = _mm256_add_ps(a1, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), g));
+    _mm256_storeu_ps(acc + i, a0);
+    _mm256_storeu_ps(acc + i + 8, a1);
+  }
+  accumulate_sse2(acc + i, src + i, count - i, gain);
+}
+
+__attribute__((target("avx2"))) static void clip_avx2(
+    int16_t* dst,
+    const float* acc,
+    uint32_t count) {
+  __m256 max = _mm256_set1_ps(32767.0f);
+  __m256 min = _mm256_set1_ps(-32768.0f);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256 a0 = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(acc + i), min), max);
+    __m256 a1 = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(acc + i + 8), min), max);
+    // packs works per 128-bit lane, so restore sample order with a cross-lane permute
+    __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a0), _mm256_cvtps_epi32(a1));
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    _mm256_storeu_si256((__m256i*)(dst + i), packed);
+  }
+  clip_sse2(dst + i, acc + i, count - i);
+}
+#endif
+
+#ifdef MIX_HAVE_NEON
+static void accumulate_neon(float* acc, const int16_t* src, uint32_t count, float gain) {
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t s = vld1q_s16(src + i);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+    vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), lo, gain));
+    vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4), hi, gain));
+  }
+  accumulate_scalar(acc + i, src + i, count - i, gain);
+}
+
+static void clip_neon(int16_t* dst, const float* acc, uint32_t count) {
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // vqmovn saturates the int32 -> int16 narrowing, vcvtnq rounds and saturates float -> int32
+    int32x4_t lo = vcvtnq_s32_f32(vld1q_f32(acc + i));
+    int32x4_t hi = vcvtnq_s32_f32(vld1q_f32(acc + i + 4));
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+  clip_scalar(dst + i, acc + i, count - i);
+}
+#endif
+
+static const MixKernels scalar_kernels = {"scalar", accumulate_scalar, clip_scalar};
+#ifdef MIX_HAVE_AVX2
+static const MixKernels avx2_kernels = {"avx2", accumulate_avx2, clip_avx2};
+#endif
+#ifdef MIX_HAVE_SSE2
+static const MixKernels sse2_kernels = {"sse2", accumulate_sse2, clip_sse2};
+#endif
+#ifdef MIX_HAVE_NEON
+static const MixKernels neon_kernels = {"neon", accumulate_neon, clip_neon};
+#endif
+
+static const MixKernels* forced = NULL;
+
+static const MixKernels* select_kernels(void) {
+#ifdef MIX_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return &avx2_kernels;
+#endif
+#ifdef MIX_HAVE_SSE2
+  return &sse2_kernels;
+#endif
+#ifdef MIX_HAVE_NEON
+  return &neon_kernels;
+#endif
+  return &scalar_kernels;
+}
+
+static const MixKernels* kernels(void) {
+  static const MixKernels* selected = NULL;
+  const MixKernels* k = __atomic_load_n(&forced, __ATOMIC_ACQUIRE);
+  if (k)
+    return k;
+  k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+  if (!k) {
+    k = select_kernels();
+    __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+void mix_accumulate_s16(float* acc, const int16_t* src, uint32_t count, float gain) {
+  kernels()->accumulate(acc, src, count, gain);
+}
+
+void mix_clip_s16(int16_t* dst, const float* acc, uint32_t count) {
+  kernels()->clip(dst, acc, count);
+}
+
+const char* mix_kernel_name(void) {
+  return kernels()->name;
+}
+
+int mix_force_kernel(const char* name) {
+  const MixKernels* k = NULL;
+  if (name && strcmp(name, "scalar") == 0)
+    k = &scalar_kernels;
+#ifdef MIX_HAVE_AVX2
+  if (name && strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    k = &avx2_kernels;
+#endif
+#ifdef MIX_HAVE_SSE2
+  if (name && strcmp(name, "sse2") == 0)
+    k = &sse2_kernels;
+#endif
+#ifdef MIX_HAVE_NEON
+  if (name && strcmp(name, "neon") == 0)
+    k = &neon_kernels;
+#endif
+  if (name && !k)
+    return 0;
+  __atomic_store_n(&forced, k, __ATOMIC_RELEASE);
+  return 1;
+}
@@ -0,0 +1,19 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+
+// Add gain * src to the float accumulator. count is in samples, not frames
+void mix_accumulate_s16(float* acc, const int16_t* src, uint32_t count, float gain);
+
+// Convert the accumulator to int16, saturating anything outside the int16 range
+void mix_clip_s16(int16_t* dst, const float* acc, uint32_t count);
+
+// Name of the kernel set picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* mix_kernel_name(void);
+
+// Use the named kernel set in place of the one picked for this CPU, or the picked one again if
+// name is NULL (for benchmarks and bit-exactness checks). Returns 0 if this CPU can't run it
+int mix_force_kernel(const char* name);
+
+#endif  // MIXER_H
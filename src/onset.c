@@ -0,0 +1,122 @@
+#include "onset.h"
+
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define ONSET_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define ONSET_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define ONSET_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+  const char* name;
+  uint32_t (*find)(const int16_t* samples, uint32_t count, int16_t threshold);
+} OnsetKernels;
+
+static uint32_t find_scalar(const int16_t* samples, uint32_t count, int16_t threshold) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (abs(samples[i]) >= threshold)
+      return i;
+  }
+  return count;
+}
+
+#ifdef ONSET_HAVE_SSE2
+// |s| with -32768 saturated to 32767, so the most negative sample isn't taken for silence
+static __m128i abs_sse2(__m128i s) {
+  return _mm_max_epi16(s, _mm_subs_epi16(_mm_setzero_si128(), s));
+}
+
+static uint32_t find_sse2(const int16_t* samples, uint32_t count, int16_t threshold) {
+  const __m128i below = _mm_set1_epi16((int16_t)(threshold - 1));
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i loud = _mm_cmpgt_epi16(abs_sse2(_mm_loadu_si128((const __m128i*)(samples + i))), below);
+    int mask = _mm_movemask_epi8(loud);
+    if (mask)
+      return i + (uint32_t)__builtin_ctz((unsigned)mask) / 2;
+  }
+  return i + find_scalar(samples + i, count - i, threshold);
+}
+#endif
+
+#ifdef ONSET_HAVE_AVX2
+__attribute__((target("avx2"))) static uint32_t find_avx2(
+    const int16_t* samples,
+    uint32_t count,
+    int16_t threshold) {
+  const __m256i below = _mm256_set1_epi16((int16_t)(threshold - 1));
+  const __m256i zero = _mm256_setzero_si256();
+  uint32_t i = 0;
+  // Two vectors per step; most of a clip's lead-in is silence, so the exit test is what costs
+  for (; i + 32 <= count; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(samples + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(samples + i + 16));
+    a = _mm256_cmpgt_epi16(_mm256_max_epi16(a, _mm256_subs_epi16(zero, a)), below);
+    b = _mm256_cmpgt_epi16(_mm256_max_epi16(b, _mm256_subs_epi16(zero, b)), below);
+    if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b))) {
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(a);
+      if (mask)
+        return i + (uint32_t)__builtin_ctz(mask) / 2;
+      return i + 16 + (uint32_t)__builtin_ctz((uint32_t)_mm256_movemask_epi8(b)) / 2;
+    }
+  }
+  return i + find_sse2(samples + i, count - i, threshold);
+}
+#endif
+
+#ifdef ONSET_HAVE_NEON
+static uint32_t find_neon(const int16_t* samples, uint32_t count, int16_t threshold) {
+  const int16x8_t limit = vdupq_n_s16(threshold);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // vqabs saturates -32768 to 32767
+    uint16x8_t loud = vcgeq_s16(vqabsq_s16(vld1q_s16(samples + i)), limit);
+    if (vmaxvq_u16(loud))
+      break;
+  }
+  return i + find_scalar(samples + i, count - i, threshold);
+}
+#endif
+
+static const OnsetKernels* select_kernels(void) {
+  static const OnsetKernels scalar = {"scalar", find_scalar};
+#ifdef ONSET_HAVE_AVX2
+  static const OnsetKernels avx2 = {"avx2", find_avx2};
+  if (__builtin_cpu_supports("avx2"))
+    return &avx2;
+#endif
+#ifdef ONSET_HAVE_SSE2
+  static const OnsetKernels sse2 = {"sse2", find_sse2};
+  return &sse2;
+#endif
+#ifdef ONSET_HAVE_NEON
+  static const OnsetKernels neon = {"neon", find_neon};
+  return &neon;
+#endif
+  return &scalar;
+}
+
+static const OnsetKernels* kernels(void) {
+  static const OnsetKernels* selected = NULL;
+  const OnsetKernels* k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+  if (!k) {
+    k = select_kernels();
+    __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+uint32_t onset_find(const int16_t* samples, uint32_t count, int16_t threshold) {
+  return kernels()->find(samples, count, threshold);
+}
+
+const char* onset_kernel_name(void) {
+  return kernels()->name;
+}
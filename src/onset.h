@@ -0,0 +1,16 @@
+#ifndef ONSET_H
+#define ONSET_H
+
+#include <stdint.h>
+
+#define ONSET_THRESHOLD 104  // -50 dBFS; anything quieter before the first sound is silence
+#define ONSET_PREROLL_FRAMES 240  // 5 ms kept ahead of the first audible sample to keep the attack
+
+// Index of the first sample in samples[0..count) whose magnitude reaches threshold, or count if
+// there is none. Scans with the widest SIMD the CPU has
+uint32_t onset_find(const int16_t* samples, uint32_t count, int16_t threshold);
+
+// Name of the kernel picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* onset_kernel_name(void);
+
+#endif  // ONSET_H
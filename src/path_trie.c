@@ -0,0 +1,339 @@
+#include "path_trie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_BYTES 65536  // Strings longer than a quarter of this get a block of their own
+#define TABLE_MIN_SLOTS 64
+
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t used;
+  size_t size;
+  char data[];
+} ArenaBlock;
+
+typedef struct {
+  uint32_t parent;
+  uint32_t hash;  // Of parent and name, for the lookup table
+  const char* name;  // In the arena; "" for the root
+  uint32_t first_item;
+  uint32_t end_item;
+} TrieNode;
+
+struct PathTrie {
+  ArenaBlock* blocks;  // Newest first; only the first one still has room
+  size_t arena_bytes;
+  TrieNode* nodes;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t* table;  // Open addressing over node indices; PATH_TRIE_NONE marks a free slot
+  uint32_t table_slots;  // A power of two, at least twice count
+};
+
+static const char* intern(PathTrie* trie, const char* text, size_t length) {
+  ArenaBlock* block = trie->blocks;
+  if (!block || block->size - block->used < length + 1) {
+    size_t size = length + 1 > ARENA_BLOCK_BYTES / 4 ? length + 1 : ARENA_BLOCK_BYTES;
+    ArenaBlock* fresh = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+    if (!fresh)
+      return NULL;
+    fresh->used = 0;
+    fresh->size = size;
+    trie->arena_bytes += sizeof(ArenaBlock) + size;
+
+    // A block sized for one long string goes behind the current one, which keeps its free room
+    if (block && size != ARENA_BLOCK_BYTES) {
+      fresh->next = block->next;
+      block->next = fresh;
+    } else {
+      fresh->next = block;
+      trie->blocks = fresh;
+    }
+    block = fresh;
+  }
+  char* copy = block->data + block->used;
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  block->used += length + 1;
+  return copy;
+}
+
+static uint32_t hash_name(uint32_t parent, const char* name, size_t length) {
+  uint32_t hash = 2166136261u ^ parent;
+  hash *= 16777619u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t find_child(
+    const PathTrie* trie,
+    uint32_t parent,
+    const char* name,
+    size_t length,
+    uint32_t hash) {
+  uint32_t mask = trie->table_slots - 1;
+  for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t node = trie->table[slot];
+    if (node == PATH_TRIE_NONE)
+      return PATH_TRIE_NONE;
+    const TrieNode* candidate = &trie->nodes[node];
+    if (candidate->hash == hash && candidate->parent == parent &&
+        strncmp(candidate->name, name, length) == 0 && candidate->name[length] == '\0')
+      return node;
+  }
+}
+
+static void insert_slot(PathTrie* trie, uint32_t node) {
+  uint32_t mask = trie->table_slots - 1;
+  uint32_t slot = trie->nodes[node].hash & mask;
+  while (trie->table[slot] != PATH_TRIE_NONE)
+    slot = (slot + 1) & mask;
+  trie->table[slot] = node;
+}
+
+static int grow_table(PathTrie* trie) {
+  uint32_t slots = trie->table_slots ? trie->table_slots * 2 : TABLE_MIN_SLOTS;
+  uint32_t* table = (uint32_t*)malloc(slots * sizeof(uint32_t));
+  if (!table)
+    return 0;
+  memset(table, 0xFF, slots * sizeof(uint32_t));
+  free(trie->table);
+  trie->table = table;
+  trie->table_slots = slots;
+  for (uint32_t i = 1; i < trie->count; i++)  // The root is never looked up
+    insert_slot(trie, i);
+  return 1;
+}
+
+static uint32_t add_node(PathTrie* trie, uint32_t parent, const char* name, size_t length) {
+  uint32_t hash = hash_name(parent, name, length);
+  uint32_t node = find_child(trie, parent, name, length, hash);
+  if (node != PATH_TRIE_NONE)
+    return node;
+
+  if (trie->count == trie->capacity) {
+    uint32_t capacity = trie->capacity * 2;
+    TrieNode* grown = (TrieNode*)realloc(trie->nodes, capacity * sizeof(TrieNode));
+    if (!grown)
+      return PATH_TRIE_NONE;
+    trie->nodes = grown;
+    trie->capacity = capacity;
+  }
+  if ((trie->count + 1) * 2 > trie->table_slots && !grow_table(trie))
+    return PATH_TRIE_NONE;
+  const char* copy = intern(trie, name, length);
+  if (!copy)
+    return PATH_TRIE_NONE;
+
+  node = trie->count++;
+  TrieNode* added = &trie->nodes[node];
+  added->parent = parent;
+  added->hash = hash;
+  added->name = copy;
+  added->first_item = 0;
+  added->end_item = 0;
+  insert_slot(trie, node);
+  return node;
+}
+
+PathTrie* path_trie_create(void) {
+  PathTrie* trie = (PathTrie*)calloc(1, sizeof(PathTrie));
+  if (!trie)
+    return NULL;
+  trie->capacity = TABLE_MIN_SLOTS / 2;
+  trie->nodes = (TrieNode*)malloc(trie->capacity * sizeof(TrieNode));
+  if (!trie->nodes || !grow_table(trie)) {
+    path_trie_destroy(trie);
+    return NULL;
+  }
+  TrieNode* root = &trie->nodes[trie->count++];
+  root->parent = PATH_TRIE_NONE;
+  root->hash = 0;
+  root->name = "";
+  root->first_item = 0;
+  root->end_item = 0;
+  return trie;
+}
+
+void path_trie_destroy(PathTrie* trie) {
+  if (!trie)
+    return;
+  while (trie->blocks) {
+    ArenaBlock* next = trie->blocks->next;
+    free(trie->blocks);
+    trie->blocks = next;
+  }
+  free(trie->nodes);
+  free(trie->table);
+  free(trie);
+}
+
+// An absolute path starts with a directory named "", so that formatting puts its "/" back
+uint32_t path_trie_directory(PathTrie* trie, const char* path, size_t length) {
+  uint32_t node = PATH_TRIE_ROOT;
+  size_t start = 0;
+  if (length > 0 && path[0] == '/') {
+    node = add_node(trie, node, "", 0);
+    start = 1;
+  }
+  while (start < length && node != PATH_TRIE_NONE) {
+    const char* slash = (const char*)memchr(path + start, '/', length - start);
+    size_t end = slash ? (size_t)(slash - path) : length;
+    if (end > start)  // Doubled and trailing slashes add nothing
+      node = add_node(trie, node, path + start, end - start);
+    start = end + 1;
+  }
+  return node;
+}
+
+uint32_t path_trie_find(const PathTrie* trie, uint32_t from, const char* path, size_t length) {
+  uint32_t node = from;
+  size_t start = 0;
+  if (length > 0 && path[0] == '/') {
+    node = find_child(trie, node, "", 0, hash_name(node, "", 0));
+    start = 1;
+  }
+  while (start < length && node != PATH_TRIE_NONE) {
+    const char* slash = (const char*)memchr(path + start, '/', length - start);
+    size_t end = slash ? (size_t)(slash - path) : length;
+    if (end > start) {
+      size_t part = end - start;
+      node = find_child(trie, node, path + start, part, hash_name(node, path + start, part));
+    }
+    start = end + 1;
+  }
+  return node;
+}
+
+int path_trie_add(
+    PathTrie* trie,
+    const char* path,
+    uint32_t item,
+    uint32_t* dir,
+    const char** leaf) {
+  const char* slash = strrchr(path, '/');
+  size_t dir_length = slash == path ? 1 : slash ? (size_t)(slash - path) : 0;
+  uint32_t node = path_trie_directory(trie, path, dir_length);
+  const char* name = slash ? slash + 1 : path;
+  const char* copy = node != PATH_TRIE_NONE ? intern(trie, name, strlen(name)) : NULL;
+  if (!copy)
+    return 0;
+
+  // Sorted items make every subtree a contiguous range, so widening it is enough
+  for (uint32_t n = node; n != PATH_TRIE_NONE; n = trie->nodes[n].parent) {
+    TrieNode* above = &trie->nodes[n];
+    if (above->end_item == above->first_item) {
+      above->first_item = item;
+      above->end_item = item + 1;
+    } else {
+      if (item < above->first_item)
+        above->first_item = item;
+      if (item >= above->end_item)
+        above->end_item = item + 1;
+    }
+  }
+  *dir = node;
+  *leaf = copy;
+  return 1;
+}
+
+void path_trie_items(const PathTrie* trie, uint32_t node, uint32_t* first, uint32_t* end) {
+  if (!trie || node >= trie->count) {
+    *first = 0;
+    *end = 0;
+    return;
+  }
+  *first = trie->nodes[node].first_item;
+  *end = trie->nodes[node].end_item;
+}
+
+// Writes what fits of a directory's path below out + size and returns its whole length
+static size_t format_directory(
+    const PathTrie* trie,
+    uint32_t node,
+    char* out,
+    size_t size,
+    size_t at) {
+  if (node == PATH_TRIE_ROOT)
+    return at;
+  const TrieNode* dir = &trie->nodes[node];
+  at = format_directory(trie, dir->parent, out, size, at);
+  if (dir->parent != PATH_TRIE_ROOT) {
+    if (at + 1 < size)
+      out[at] = '/';
+    at++;
+  }
+  for (const char* c = dir->name; *c; c++, at++) {
+    if (at + 1 < size)
+      out[at] = *c;
+  }
+  return at;
+}
+
+size_t path_trie_format(
+    const PathTrie* trie,
+    uint32_t dir,
+    const char* leaf,
+    char* out,
+    size_t size) {
+  size_t at = format_directory(trie, dir, out, size, 0);
+  if (dir != PATH_TRIE_ROOT) {
+    if (at + 1 < size)
+      out[at] = '/';
+    at++;
+  }
+  for (const char* c = leaf; *c; c++, at++) {
+    if (at + 1 < size)
+      out[at] = *c;
+  }
+  if (size > 0)
+    out[at < size ? at : size - 1] = '\0';
+  return at;
+}
+
+// Compare part against the start of *rest, moving *rest past it when they match
+static int compare_part(const char* part, const char** rest) {
+  const unsigned char* a = (const unsigned char*)part;
+  const unsigned char* b = (const unsigned char*)*rest;
+  for (; *a; a++, b++) {
+    if (*a != *b)
+      return *a < *b ? -1 : 1;
+  }
+  *rest = (const char*)b;
+  return 0;
+}
+
+static int compare_directory(const PathTrie* trie, uint32_t node, const char** rest) {
+  if (node == PATH_TRIE_ROOT)
+    return 0;
+  const TrieNode* dir = &trie->nodes[node];
+  int order = compare_directory(trie, dir->parent, rest);
+  if (order == 0 && dir->parent != PATH_TRIE_ROOT)
+    order = compare_part("/", rest);
+  return order != 0 ? order : compare_part(dir->name, rest);
+}
+
+int path_trie_compare(const PathTrie* trie, uint32_t dir, const char* leaf, const char* path) {
+  const char* rest = path;
+  int order = compare_directory(trie, dir, &rest);
+  if (order == 0 && dir != PATH_TRIE_ROOT)
+    order = compare_part("/", &rest);
+  if (order == 0)
+    order = compare_part(leaf, &rest);
+  if (order == 0 && *rest != '\0')
+    order = -1;  // path goes on
+  return order;
+}
+
+uint32_t path_trie_node_count(const PathTrie* trie) {
+  return trie->count;
+}
+
+size_t path_trie_memory(const PathTrie* trie) {
+  return sizeof(PathTrie) + (size_t)trie->capacity * sizeof(TrieNode) +
+         (size_t)trie->table_slots * sizeof(uint32_t) + trie->arena_bytes;
+}
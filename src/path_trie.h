@@ -0,0 +1,58 @@
+#ifndef PATH_TRIE_H
+#define PATH_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PATH_TRIE_ROOT 0u  // The node of paths without a directory, parent of "." and the like
+#define PATH_TRIE_NONE UINT32_MAX
+
+// Directory names held once each, as a tree, with every string in an arena that only grows. A
+// file is its directory's node plus a leaf name, so a folder of thousands of samples stores its
+// path once. Nodes and strings stay put until the trie is destroyed
+typedef struct PathTrie PathTrie;
+
+PathTrie* path_trie_create(void);
+
+void path_trie_destroy(PathTrie* trie);
+
+// Node of a "/"-separated directory path, added along with any missing parents. Returns
+// PATH_TRIE_NONE if out of memory
+uint32_t path_trie_directory(PathTrie* trie, const char* path, size_t length);
+
+// Node of a directory path relative to the node from (PATH_TRIE_ROOT for the whole path), or
+// PATH_TRIE_NONE if no file under it was added
+uint32_t path_trie_find(const PathTrie* trie, uint32_t from, const char* path, size_t length);
+
+// Split a file path at its last "/" into a directory node and a leaf name copied into the arena,
+// and count it as item number item of that directory and every one above it. Items must be added
+// in path order for path_trie_items() to hold. Returns 0 if out of memory
+int path_trie_add(
+    PathTrie* trie,
+    const char* path,
+    uint32_t item,
+    uint32_t* dir,
+    const char** leaf);
+
+// Items [*first, *end) of everything under a node, in O(1) however deep the subtree. Both are 0
+// if none were added
+void path_trie_items(const PathTrie* trie, uint32_t node, uint32_t* first, uint32_t* end);
+
+// Write the path of a file to out like snprintf: truncated to size, always terminated if size is
+// not 0. Returns the length of the whole path
+size_t path_trie_format(
+    const PathTrie* trie,
+    uint32_t dir,
+    const char* leaf,
+    char* out,
+    size_t size);
+
+// strcmp() of a file's path against path, without building it
+int path_trie_compare(const PathTrie* trie, uint32_t dir, const char* leaf, const char* path);
+
+uint32_t path_trie_node_count(const PathTrie* trie);
+
+// Bytes held by the nodes, their lookup table and the arena
+size_t path_trie_memory(const PathTrie* trie);
+
+#endif  // PATH_TRIE_H
@@ -0,0 +1,156 @@
+#include "pcm_buffer.h"
+
+#include <stdlib.h>
+
+#include "wav.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FRAME_BYTES (AUDIO_CHANNELS * sizeof(int16_t))
+
+// Seconds read ahead as soon as a file is mapped, so the first periods never wait on the disk
+#define MAP_INITIAL_PREFETCH_SECONDS 3
+
+PcmBuffer* pcm_buffer_create(int16_t* samples, uint32_t frame_count) {
+  PcmBuffer* buffer = (PcmBuffer*)calloc(1, sizeof(PcmBuffer));
+  if (!buffer) {
+    free(samples);
+    return NULL;
+  }
+  buffer->samples = samples;
+  buffer->frame_count = frame_count;
+  buffer->refcount = 1;
+  return buffer;
+}
+
+static void unmap_file(void* mapping, uint64_t size) {
+#ifdef _WIN32
+  (void)size;
+  UnmapViewOfFile(mapping);
+#else
+  munmap(mapping, (size_t)size);
+#endif
+}
+
+static void* map_file(const char* path, uint64_t* size) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(
+      path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+
+  LARGE_INTEGER file_size;
+  HANDLE mapping = NULL;
+  void* view = NULL;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+      view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+
+  // The view keeps the file mapped after both handles are closed
+  if (mapping)
+    CloseHandle(mapping);
+  CloseHandle(file);
+  *size = (uint64_t)file_size.QuadPart;
+  return view;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat s;
+  void* view = NULL;
+  if (fstat(fd, &s) == 0 && s.st_size > 0) {
+    view = mmap(NULL, (size_t)s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+      view = NULL;
+  }
+
+  close(fd);
+  *size = (uint64_t)s.st_size;
+  return view;
+#endif
+}
+
+PcmBuffer* pcm_buffer_map_wav(const char* path) {
+  uint64_t size = 0;
+  void* mapping = map_file(path, &size);
+  if (!mapping)
+    return NULL;
+
+  // Only the device format can be handed to the mixer as-is; the offset must keep int16 alignment
+  WavInfo info;
+  if (!wav_parse_info(mapping, size, &info) || info.format_tag != WAV_FORMAT_PCM ||
+      info.bits_per_sample != 16 || info.channels != AUDIO_CHANNELS ||
+      info.sample_rate != AUDIO_SAMPLE_RATE || info.block_align != FRAME_BYTES ||
+      (info.data_offset & 1) != 0) {
+    unmap_file(mapping, size);
+    return NULL;
+  }
+
+  PcmBuffer* buffer = (PcmBuffer*)calloc(1, sizeof(PcmBuffer));
+  if (!buffer) {
+    unmap_file(mapping, size);
+    return NULL;
+  }
+
+  buffer->samples = (int16_t*)((unsigned char*)mapping + info.data_offset);
+  buffer->frame_count = info.data_size / FRAME_BYTES;
+  buffer->refcount = 1;
+  buffer->mapping = mapping;
+  buffer->mapping_size = size;
+
+#ifndef _WIN32
+  madvise(mapping, (size_t)size, MADV_SEQUENTIAL);
+#endif
+  pcm_buffer_prefetch(buffer, 0, AUDIO_SAMPLE_RATE * MAP_INITIAL_PREFETCH_SECONDS);
+  return buffer;
+}
+
+void pcm_buffer_retain(PcmBuffer* buffer) {
+  __atomic_add_fetch(&buffer->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void pcm_buffer_release(PcmBuffer* buffer) {
+  if (buffer && __atomic_sub_fetch(&buffer->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+    if (buffer->mapping)
+      unmap_file(buffer->mapping, buffer->mapping_size);
+    else
+      free(buffer->samples);
+    free(buffer);
+  }
+}
+
+uint64_t pcm_buffer_heap_bytes(const PcmBuffer* buffer) {
+  if (buffer->mapping)
+    return 0;
+  return (uint64_t)buffer->frame_count * FRAME_BYTES;
+}
+
+void pcm_buffer_prefetch(const PcmBuffer* buffer, uint32_t first_frame, uint32_t frames) {
+#ifdef _WIN32
+  (void)buffer;
+  (void)first_frame;
+  (void)frames;
+#else
+  if (!buffer->mapping || first_frame >= buffer->frame_count)
+    return;
+  if (frames > buffer->frame_count - first_frame)
+    frames = buffer->frame_count - first_frame;
+
+  // madvise wants a page-aligned start
+  long page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)(buffer->samples + (size_t)first_frame * AUDIO_CHANNELS);
+  uintptr_t end = start + (uintptr_t)frames * FRAME_BYTES;
+  start &= ~(uintptr_t)(page_size - 1);
+  madvise((void*)start, (size_t)(end - start), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef PCM_BUFFER_H
+#define PCM_BUFFER_H
+
+#include <stdint.h>
+
+// Device format shared by every sink and decoded buffer
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNELS 2
+
+// Reference-counted block of interleaved device-format frames, either decoded onto the heap
+// or pointing straight into a memory-mapped WAV file
+typedef struct {
+  int16_t* samples;
+  uint32_t frame_count;
+  int refcount;
+  void* mapping;  // Base of the file mapping, NULL for heap buffers
+  uint64_t mapping_size;
+} PcmBuffer;
+
+// Wrap malloc'd samples in a buffer holding one reference. Takes ownership of samples
+PcmBuffer* pcm_buffer_create(int16_t* samples, uint32_t frame_count);
+
+// Map a WAV file that is already in the device format so it plays with no copy at all.
+// Returns NULL if the file is in any other format or can't be mapped
+PcmBuffer* pcm_buffer_map_wav(const char* path);
+
+// Add a reference to a buffer
+void pcm_buffer_retain(PcmBuffer* buffer);
+
+// Drop a reference, freeing or unmapping the buffer when the last one goes
+void pcm_buffer_release(PcmBuffer* buffer);
+
+// Heap memory held by the buffer's samples (0 for mapped files, which live in the page cache)
+uint64_t pcm_buffer_heap_bytes(const PcmBuffer* buffer);
+
+// Hint that frames [first_frame, first_frame + frames) of a mapped buffer will be read soon
+void pcm_buffer_prefetch(const PcmBuffer* buffer, uint32_t first_frame, uint32_t frames);
+
+#endif  // PCM_BUFFER_H
@@ -0,0 +1,246 @@
+#include "pcm_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "decoder.h"
+#include "thread.h"
+
+typedef struct CacheEntry {
+  char* path;
+  uint64_t hash;
+  PcmBuffer* buffer;  // The cache holds one reference
+  struct CacheEntry* hash_next;
+  struct CacheEntry* lru_prev;  // Towards the most recently used entry
+  struct CacheEntry* lru_next;
+} CacheEntry;
+
+struct PcmCache {
+  Mutex lock;
+  CacheEntry** buckets;
+  uint32_t bucket_count;  // Power of two
+  CacheEntry* lru_head;  // Most recently used
+  CacheEntry* lru_tail;  // Next to evict
+  PcmCacheStats stats;
+};
+
+static uint64_t hash_path(const char* path) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+    hash ^= *p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t mapped_bytes(const PcmBuffer* buffer) {
+  if (!buffer->mapping)
+    return 0;
+  return (uint64_t)buffer->frame_count * AUDIO_CHANNELS * sizeof(int16_t);
+}
+
+static int file_size(const char* path, uint64_t* size) {
+  struct stat s;
+  if (stat(path, &s) != 0)
+    return 0;
+  *size = (uint64_t)s.st_size;
+  return 1;
+}
+
+static void lru_unlink(PcmCache* cache, CacheEntry* entry) {
+  if (entry->lru_prev)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    cache->lru_head = entry->lru_next;
+  if (entry->lru_next)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    cache->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(PcmCache* cache, CacheEntry* entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = cache->lru_head;
+  if (cache->lru_head)
+    cache->lru_head->lru_prev = entry;
+  cache->lru_head = entry;
+  if (!cache->lru_tail)
+    cache->lru_tail = entry;
+}
+
+static CacheEntry* find_entry(PcmCache* cache, const char* path, uint64_t hash) {
+  CacheEntry* entry = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; entry; entry = entry->hash_next) {
+    if (entry->hash == hash && strcmp(entry->path, path) == 0)
+      return entry;
+  }
+  return NULL;
+}
+
+static void remove_entry(PcmCache* cache, CacheEntry* entry) {
+  CacheEntry** link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+  while (*link != entry)
+    link = &(*link)->hash_next;
+  *link = entry->hash_next;
+
+  lru_unlink(cache, entry);
+  cache->stats.bytes_used -= pcm_buffer_heap_bytes(entry->buffer);
+  cache->stats.mapped_bytes -= mapped_bytes(entry->buffer);
+  cache->stats.entries--;
+  pcm_buffer_release(entry->buffer);
+  free(entry->path);
+  free(entry);
+}
+
+static void grow_buckets(PcmCache* cache) {
+  uint32_t new_count = cache->bucket_count * 2;
+  CacheEntry** new_buckets = (CacheEntry**)calloc(new_count, sizeof(CacheEntry*));
+  if (!new_buckets)
+    return;
+
+  for (uint32_t i = 0; i < cache->bucket_count; i++) {
+    CacheEntry* entry = cache->buckets[i];
+    while (entry) {
+      CacheEntry* next = entry->hash_next;
+      entry->hash_next = new_buckets[entry->hash & (new_count - 1)];
+      new_buckets[entry->hash & (new_count - 1)] = entry;
+      entry = next;
+    }
+  }
+
+  free(cache->buckets);
+  cache->buckets = new_buckets;
+  cache->bucket_count = new_count;
+}
+
+PcmCache* pcm_cache_create(uint64_t budget_bytes) {
+  PcmCache* cache = (PcmCache*)calloc(1, sizeof(PcmCache));
+  if (!cache)
+    return NULL;
+
+  cache->bucket_count = 64;
+  cache->buckets = (CacheEntry**)calloc(cache->bucket_count, sizeof(CacheEntry*));
+  if (!cache->buckets) {
+    free(cache);
+    return NULL;
+  }
+
+  cache->stats.budget_bytes = budget_bytes;
+  mutex_init(&cache->lock);
+  return cache;
+}
+
+void pcm_cache_destroy(PcmCache* cache) {
+  if (!cache)
+    return;
+
+  while (cache->lru_head)
+    remove_entry(cache, cache->lru_head);
+  mutex_destroy(&cache->lock);
+  free(cache->buckets);
+  free(cache);
+}
+
+PcmBuffer* pcm_cache_acquire(PcmCache* cache, const char* path, uint64_t decode_limit) {
+  uint64_t hash = hash_path(path);
+
+  mutex_lock(&cache->lock);
+  CacheEntry* entry = find_entry(cache, path, hash);
+  if (entry) {
+    cache->stats.hits++;
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+    pcm_buffer_retain(entry->buffer);
+    PcmBuffer* buffer = entry->buffer;
+    mutex_unlock(&cache->lock);
+    return buffer;
+  }
+  cache->stats.misses++;
+  mutex_unlock(&cache->lock);
+
+  // Decode without holding the lock so other sounds can still hit meanwhile
+  uint64_t size = 0;
+  if (!file_size(path, &size))
+    return NULL;
+
+  int too_big_to_decode = decode_limit > 0 && size >= decode_limit;
+  PcmBuffer* buffer = size >= PCM_CACHE_MAP_THRESHOLD || too_big_to_decode
+                          ? pcm_buffer_map_wav(path)
+                          : NULL;
+  if (!buffer) {
+    if (too_big_to_decode)
+      return NULL;
+    int16_t* samples = NULL;
+    uint32_t frames = 0;
+    if (!decoder_load_s16(path, &samples, &frames))
+      return NULL;
+    buffer = pcm_buffer_create(samples, frames);
+    if (!buffer)
+      return NULL;
+  }
+
+  uint64_t bytes = pcm_buffer_heap_bytes(buffer);
+  if (bytes > cache->stats.budget_bytes)
+    return buffer;  // Too big to ever fit; play it uncached
+
+  mutex_lock(&cache->lock);
+  if (find_entry(cache, path, hash)) {
+    // Another thread decoded the same file meanwhile; keep theirs cached
+    mutex_unlock(&cache->lock);
+    return buffer;
+  }
+
+  while (cache->lru_tail && cache->stats.bytes_used + bytes > cache->stats.budget_bytes) {
+    remove_entry(cache, cache->lru_tail);
+    cache->stats.evictions++;
+  }
+
+  entry = (CacheEntry*)calloc(1, sizeof(CacheEntry));
+  char* path_copy = entry ? (char*)malloc(strlen(path) + 1) : NULL;
+  if (!entry || !path_copy) {
+    free(entry);
+    mutex_unlock(&cache->lock);
+    return buffer;
+  }
+
+  strcpy(path_copy, path);
+  entry->path = path_copy;
+  entry->hash = hash;
+  entry->buffer = buffer;
+  pcm_buffer_retain(buffer);
+
+  if (cache->stats.entries + 1 > cache->bucket_count)
+    grow_buckets(cache);
+  CacheEntry** bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+  entry->hash_next = *bucket;
+  *bucket = entry;
+  lru_push_front(cache, entry);
+  cache->stats.bytes_used += bytes;
+  cache->stats.mapped_bytes += mapped_bytes(buffer);
+  cache->stats.entries++;
+  mutex_unlock(&cache->lock);
+
+  return buffer;
+}
+
+void pcm_cache_invalidate(PcmCache* cache, const char* path) {
+  if (!cache)
+    return;
+
+  uint64_t hash = hash_path(path);
+  mutex_lock(&cache->lock);
+  CacheEntry* entry = find_entry(cache, path, hash);
+  if (entry) {
+    remove_entry(cache, entry);
+    cache->stats.invalidations++;
+  }
+  mutex_unlock(&cache->lock);
+}
+
+void pcm_cache_get_stats(PcmCache* cache, PcmCacheStats* stats) {
+  mutex_lock(&cache->lock);
+  *stats = cache->stats;
+  mutex_unlock(&cache->lock);
+}
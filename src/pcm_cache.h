@@ -0,0 +1,44 @@
+#ifndef PCM_CACHE_H
+#define PCM_CACHE_H
+
+#include <stdint.h>
+
+#include "pcm_buffer.h"
+
+#define PCM_CACHE_DEFAULT_MB 256
+#define PCM_CACHE_MAP_THRESHOLD (8u * 1024u * 1024u)  // Files this big are mapped, not decoded
+
+typedef struct PcmCache PcmCache;
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t invalidations;
+  uint64_t bytes_used;
+  uint64_t budget_bytes;
+  uint64_t mapped_bytes;  // Sample data served from mapped files, outside the budget
+  uint32_t entries;
+} PcmCacheStats;
+
+// Create a cache of decoded device-format PCM holding at most budget_bytes of samples
+PcmCache* pcm_cache_create(uint64_t budget_bytes);
+
+// Free the cache. Buffers still held by voices stay alive until they are released
+void pcm_cache_destroy(PcmCache* cache);
+
+// Get a retained buffer for a sound, decoding it on a miss. A hit does no disk I/O;
+// entries are only dropped by pcm_cache_invalidate(). Large files already in the
+// device format are memory-mapped instead of decoded. A miss on a file of decode_limit bytes
+// or more (0 for no limit) that can't be mapped isn't decoded, so the caller can stream it.
+// Returns NULL if undecodable or not decoded
+PcmBuffer* pcm_cache_acquire(PcmCache* cache, const char* path, uint64_t decode_limit);
+
+// Drop the entry for a file that changed or was deleted, if there is one. Voices still playing
+// it keep their buffer
+void pcm_cache_invalidate(PcmCache* cache, const char* path);
+
+// Snapshot the cache counters
+void pcm_cache_get_stats(PcmCache* cache, PcmCacheStats* stats);
+
+#endif  // PCM_CACHE_H
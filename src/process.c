@@ -0,0 +1,70 @@
+#include "process.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+int program_on_path(const char* name) {
+#ifdef _WIN32
+  char found[MAX_PATH];
+  return SearchPathA(NULL, name, ".exe", MAX_PATH, found, NULL) > 0;
+#else
+  const char* path = getenv("PATH");
+  if (!path)
+    path = "/usr/bin:/bin";
+
+  char candidate[4096];
+  while (*path) {
+    const char* end = strchr(path, ':');
+    size_t len = end ? (size_t)(end - path) : strlen(path);
+    // An empty PATH entry means the current directory
+    snprintf(candidate, sizeof(candidate), "%.*s/%s", len ? (int)len : 1, len ? path : ".", name);
+    if (access(candidate, X_OK) == 0)
+      return 1;
+    if (!end)
+      break;
+    path = end + 1;
+  }
+  return 0;
+#endif
+}
+
+#ifndef _WIN32
+pid_t spawn_program(char* const argv[], int* stdin_fd) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+
+  int fds[2] = {-1, -1};
+  if (stdin_fd) {
+    // Close-on-exec keeps the write end out of this and every later child; dup2 clears it on
+    // the child's copy of the read end
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+      posix_spawn_file_actions_destroy(&actions);
+      return -1;
+    }
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+  }
+
+  pid_t pid = 0;
+  int result = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (stdin_fd) {
+    close(fds[0]);
+    if (result != 0)
+      close(fds[1]);
+    else
+      *stdin_fd = fds[1];
+  }
+  return result == 0 ? pid : -1;
+}
+#endif
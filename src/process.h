@@ -0,0 +1,17 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+// Whether an executable called name can be found on PATH
+int program_on_path(const char* name);
+
+#ifndef _WIN32
+// Start argv[0], looked up on PATH. With stdin_fd non-NULL the child reads its stdin from a
+// pipe and the write end is returned there. Returns the child's pid, or -1
+pid_t spawn_program(char* const argv[], int* stdin_fd);
+#endif
+
+#endif  // PROCESS_H
@@ -27,6 +27,26 @@ static GLuint rect_program = 0;
 static GLint uRectProjLoc = -1, uRectColorLoc = -1;
 static GLuint rectVAO = 0, rectVBO = 0;
 
+// Waveform bars share the rectangle shader but batch every bar into one buffer
+static GLuint waveVAO = 0, waveVBO = 0;
+static float* wave_verts = NULL;
+static uint32_t wave_capacity = 0;  // Bars wave_verts and waveVBO can hold
+
+// Tiles are instances of one unit quad, each carrying its rectangle, color and progress
+typedef struct {
+  float x, y, w, h;
+  float r, g, b;
+  float progress;  // Negative when nothing plays on the tile
+} TileInstance;
+
+static GLuint tile_program = 0;
+static GLint uTileProjLoc = -1, uTileProgressColorLoc = -1;
+static GLuint tileVAO = 0, tileQuadVBO = 0, tileInstanceVBO = 0;
+static TileInstance* tiles = NULL;
+static uint32_t tile_count = 0;
+static uint32_t tile_capacity = 0;  // Tiles the queue can hold
+static uint32_t tile_buffer_capacity = 0;  // Tiles tileInstanceVBO can hold
+
 static float gProj[16];
 
 static void mat4_ortho(float l, float r, float b, float t, float n, float f, float* m) {
@@ -107,6 +127,58 @@ static void ensure_rect_buffers(void) {
   glBindVertexArray(0);
 }
 
+static int ensure_wave_buffers(uint32_t bars) {
+  if (!waveVAO) {
+    glGenVertexArrays(1, &waveVAO);
+    glBindVertexArray(waveVAO);
+    glGenBuffers(1, &waveVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, waveVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, (GLsizei)(2 * sizeof(float)), (void*)0);
+    glBindVertexArray(0);
+  }
+  if (bars <= wave_capacity)
+    return 1;
+
+  float* verts = (float*)realloc(wave_verts, (size_t)bars * 12 * sizeof(float));
+  if (!verts)
+    return 0;
+  wave_verts = verts;
+  wave_capacity = bars;
+  glBindBuffer(GL_ARRAY_BUFFER, waveVBO);
+  glBufferData(
+      GL_ARRAY_BUFFER, (GLsizeiptr)((size_t)bars * 12 * sizeof(float)), NULL, GL_DYNAMIC_DRAW);
+  return 1;
+}
+
+static void ensure_tile_buffers(void) {
+  if (tileVAO)
+    return;
+  static const float corners[12] = {0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1};
+  glGenVertexArrays(1, &tileVAO);
+  glBindVertexArray(tileVAO);
+  glGenBuffers(1, &tileQuadVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, tileQuadVBO);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)sizeof(corners), corners, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, (GLsizei)(2 * sizeof(float)), (void*)0);
+
+  // Rectangle, color and progress advance once per tile rather than per corner
+  GLsizei stride = (GLsizei)sizeof(TileInstance);
+  glGenBuffers(1, &tileInstanceVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, tileInstanceVBO);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)0);
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+  glVertexAttribDivisor(2, 1);
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
+  glVertexAttribDivisor(3, 1);
+  glBindVertexArray(0);
+}
+
 static void ensure_text_buffers(void) {
   if (textVAO)
     return;
@@ -187,6 +259,32 @@ static int create_rect_program(void) {
   return 0;
 }
 
+static int create_tile_program(void) {
+  if (tile_program)
+    return 1;
+
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, TILE_VERTEX_SHADER);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, TILE_FRAGMENT_SHADER);
+  if (!vs || !fs) {
+    if (vs)
+      glDeleteShader(vs);
+    if (fs)
+      glDeleteShader(fs);
+    return 0;
+  }
+
+  tile_program = link_program(vs, fs);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+
+  if (tile_program) {
+    uTileProjLoc = glGetUniformLocation(tile_program, "uProj");
+    uTileProgressColorLoc = glGetUniformLocation(tile_program, "uProgressColor");
+    return 1;
+  }
+  return 0;
+}
+
 static int init_font_system() {
   atlas = texture_atlas_new(512, 512, 1);
 
@@ -293,7 +391,13 @@ int init_renderer(void) {
     return 0;
   }
 
+  if (!create_tile_program()) {
+    fprintf(stderr, "Failed to create tile shader program\n");
+    return 0;
+  }
+
   ensure_rect_buffers();
+  ensure_tile_buffers();
   ensure_text_buffers();
 
   if (!init_font_system()) {
@@ -329,6 +433,38 @@ void cleanup_renderer(void) {
     glDeleteVertexArrays(1, &rectVAO);
     rectVAO = 0;
   }
+  if (waveVBO) {
+    glDeleteBuffers(1, &waveVBO);
+    waveVBO = 0;
+  }
+  if (waveVAO) {
+    glDeleteVertexArrays(1, &waveVAO);
+    waveVAO = 0;
+  }
+  free(wave_verts);
+  wave_verts = NULL;
+  wave_capacity = 0;
+  if (tileInstanceVBO) {
+    glDeleteBuffers(1, &tileInstanceVBO);
+    tileInstanceVBO = 0;
+  }
+  if (tileQuadVBO) {
+    glDeleteBuffers(1, &tileQuadVBO);
+    tileQuadVBO = 0;
+  }
+  if (tileVAO) {
+    glDeleteVertexArrays(1, &tileVAO);
+    tileVAO = 0;
+  }
+  free(tiles);
+  tiles = NULL;
+  tile_count = 0;
+  tile_capacity = 0;
+  tile_buffer_capacity = 0;
+  if (tile_program) {
+    glDeleteProgram(tile_program);
+    tile_program = 0;
+  }
   if (text_program) {
     glDeleteProgram(text_program);
     text_program = 0;
@@ -371,6 +507,92 @@ void draw_rect(float x, float y, float w, float h, float r, float g, float b) {
   glUseProgram(0);
 }
 
+void draw_waveform(
+    float x,
+    float center_y,
+    float column_width,
+    float half_height,
+    const float* mins,
+    const float* maxs,
+    uint32_t count,
+    float r,
+    float g,
+    float b) {
+  if (count == 0 || !ensure_wave_buffers(count))
+    return;
+
+  float* v = wave_verts;
+  for (uint32_t i = 0; i < count; i++) {
+    float x0 = x + (float)i * column_width;
+    float x1 = x0 + column_width;
+    float y0 = center_y + mins[i] * half_height;
+    float y1 = center_y + maxs[i] * half_height;
+    if (y1 - y0 < 1.0f)
+      y1 = y0 + 1.0f;  // Keep silence visible as a line
+    float quad[12] = {x0, y0, x1, y0, x1, y1, x0, y0, x1, y1, x0, y1};
+    memcpy(v, quad, sizeof(quad));
+    v += 12;
+  }
+
+  glUseProgram(rect_program);
+  glUniformMatrix4fv(uRectProjLoc, 1, GL_FALSE, gProj);
+  glUniform3f(uRectColorLoc, r, g, b);
+  glBindVertexArray(waveVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, waveVBO);
+  GLsizeiptr bytes = (GLsizeiptr)((size_t)count * 12 * sizeof(float));
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, wave_verts);
+  glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(count * 6));
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
+
+void queue_tile(float x, float y, float w, float h, float r, float g, float b, float progress) {
+  if (tile_count == tile_capacity) {
+    uint32_t capacity = tile_capacity ? tile_capacity * 2 : 256;
+    TileInstance* grown = (TileInstance*)realloc(tiles, (size_t)capacity * sizeof(TileInstance));
+    if (!grown)
+      return;
+    tiles = grown;
+    tile_capacity = capacity;
+  }
+  TileInstance* tile = &tiles[tile_count++];
+  tile->x = x;
+  tile->y = y;
+  tile->w = w;
+  tile->h = h;
+  tile->r = r;
+  tile->g = g;
+  tile->b = b;
+  tile->progress = progress;
+}
+
+void draw_tiles(float r, float g, float b) {
+  if (tile_count == 0 || !tile_program)
+    return;
+  ensure_tile_buffers();
+
+  glBindBuffer(GL_ARRAY_BUFFER, tileInstanceVBO);
+  GLsizeiptr bytes = (GLsizeiptr)((size_t)tile_count * sizeof(TileInstance));
+  if (tile_count > tile_buffer_capacity) {
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        (GLsizeiptr)((size_t)tile_capacity * sizeof(TileInstance)),
+        NULL,
+        GL_DYNAMIC_DRAW);
+    tile_buffer_capacity = tile_capacity;
+  }
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, tiles);
+
+  glUseProgram(tile_program);
+  glUniformMatrix4fv(uTileProjLoc, 1, GL_FALSE, gProj);
+  glUniform3f(uTileProgressColorLoc, r, g, b);
+  glBindVertexArray(tileVAO);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)tile_count);
+  glBindVertexArray(0);
+  glUseProgram(0);
+  tile_count = 0;
+}
+
 void draw_text(float x, float y, const char* text, float r, float g, float b) {
   if (!font || !atlas || !text_program)
     return;
@@ -1,6 +1,8 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <stdint.h>
+
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <freetype-gl/freetype-gl.h>
@@ -17,6 +19,28 @@ void set_projection(float width, float height);
 // Draw a filled rectangle
 void draw_rect(float x, float y, float w, float h, float r, float g, float b);
 
+// Draw a waveform as count bars, each column_width wide, starting at x. Bar i spans
+// mins[i]..maxs[i] (in [-1, 1]) scaled by half_height around center_y, and is never thinner
+// than one pixel. All bars go out in a single draw call
+void draw_waveform(
+    float x,
+    float center_y,
+    float column_width,
+    float half_height,
+    const float* mins,
+    const float* maxs,
+    uint32_t count,
+    float r,
+    float g,
+    float b);
+
+// Queue a w by h tile at x, y in color r, g, b for the next draw_tiles(). The left progress
+// fraction of its width (none if progress is negative) is drawn in the progress color instead
+void queue_tile(float x, float y, float w, float h, float r, float g, float b, float progress);
+
+// Draw every queued tile with a single instanced call, progress in r, g, b, and empty the queue
+void draw_tiles(float r, float g, float b);
+
 // Draw text at the specified position
 void draw_text(float x, float y, const char* text, float r, float g, float b);
 
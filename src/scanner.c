@@ -0,0 +1,329 @@
+#include "scanner.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "thread.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SCANNER_MIN_THREADS 4
+#define SCANNER_IDLE_NS 50000ULL  // Nap of a thread that found nothing to steal
+
+// A directory waiting to be read
+typedef struct {
+  char* path;
+  int fd;  // Opened by the thread that found it, or -1 to open it by path
+  int depth;  // Levels below the root
+} DirTask;
+
+// One thread's queue. The owner pushes and pops at the tail, depth first; thieves take from the
+// head, where the oldest and usually largest subtrees are
+typedef struct {
+  Mutex lock;
+  DirTask* tasks;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t capacity;
+} TaskQueue;
+
+typedef struct Scanner Scanner;
+
+typedef struct {
+  Scanner* scanner;
+  uint32_t index;
+  TaskQueue queue;
+  char** paths;  // Sounds found by this thread
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t directories;
+  uint32_t stats;
+  uint32_t pruned;
+  int failed;
+} ScanWorker;
+
+struct Scanner {
+  const LibraryRoot* root;
+  size_t root_length;  // Where the path from the root starts in a task's, less its "/"
+  ScanWorker* workers;
+  uint32_t worker_count;
+  uint32_t outstanding;  // Directories queued or being read; the scan ends when this hits 0
+  uint32_t open_dirs;  // Task fds held open
+};
+
+static int push_task(TaskQueue* queue, const DirTask* task) {
+  mutex_lock(&queue->lock);
+  if (queue->tail == queue->capacity) {
+    if (queue->head > 0) {
+      memmove(
+          queue->tasks, queue->tasks + queue->head, (queue->tail - queue->head) * sizeof(DirTask));
+      queue->tail -= queue->head;
+      queue->head = 0;
+    } else {
+      uint32_t capacity = queue->capacity ? queue->capacity * 2 : 64;
+      DirTask* grown = (DirTask*)realloc(queue->tasks, capacity * sizeof(DirTask));
+      if (!grown) {
+        mutex_unlock(&queue->lock);
+        return 0;
+      }
+      queue->tasks = grown;
+      queue->capacity = capacity;
+    }
+  }
+  queue->tasks[queue->tail++] = *task;
+  mutex_unlock(&queue->lock);
+  return 1;
+}
+
+static int pop_task(TaskQueue* queue, DirTask* task, int steal) {
+  mutex_lock(&queue->lock);
+  int found = queue->head < queue->tail;
+  if (found)
+    *task = steal ? queue->tasks[queue->head++] : queue->tasks[--queue->tail];
+  if (queue->head == queue->tail)
+    queue->head = queue->tail = 0;
+  mutex_unlock(&queue->lock);
+  return found;
+}
+
+static char* join_path(const char* dir, const char* name) {
+  size_t dir_length = strlen(dir);
+  size_t name_length = strlen(name);
+  char* path = (char*)malloc(dir_length + name_length + 2);
+  if (path) {
+    memcpy(path, dir, dir_length);
+    path[dir_length] = '/';
+    memcpy(path + dir_length + 1, name, name_length + 1);
+  }
+  return path;
+}
+
+static void add_sound(ScanWorker* worker, char* path) {
+  if (worker->count == worker->capacity) {
+    uint32_t capacity = worker->capacity ? worker->capacity * 2 : 256;
+    char** grown = (char**)realloc(worker->paths, capacity * sizeof(char*));
+    if (!grown) {
+      free(path);
+      worker->failed = 1;
+      return;
+    }
+    worker->paths = grown;
+    worker->capacity = capacity;
+  }
+  worker->paths[worker->count++] = path;
+}
+
+static void add_directory(ScanWorker* worker, char* path, int fd, int depth) {
+  Scanner* scanner = worker->scanner;
+  DirTask task = {path, fd, depth};
+  __atomic_add_fetch(&scanner->outstanding, 1, __ATOMIC_ACQ_REL);
+  if (!push_task(&worker->queue, &task)) {
+#ifndef _WIN32
+    if (fd >= 0) {
+      close(fd);
+      __atomic_sub_fetch(&scanner->open_dirs, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    free(path);
+    worker->failed = 1;
+    __atomic_sub_fetch(&scanner->outstanding, 1, __ATOMIC_ACQ_REL);
+  }
+}
+
+static void scan_directory(ScanWorker* worker, DirTask* task) {
+  Scanner* scanner = worker->scanner;
+#ifdef _WIN32
+  (void)scanner;
+  DIR* dir = opendir(task->path);
+#else
+  int fd = task->fd;
+  if (fd >= 0)
+    __atomic_sub_fetch(&scanner->open_dirs, 1, __ATOMIC_RELAXED);
+  else
+    fd = open(task->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR* dir = fd >= 0 ? fdopendir(fd) : NULL;
+  if (!dir && fd >= 0)
+    close(fd);
+#endif
+  if (!dir)
+    return;
+  worker->directories++;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char* name = entry->d_name;
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+
+    // d_type answers without touching the inode; only unknown types and symlinks need a stat
+    int is_dir = entry->d_type == DT_DIR;
+    int is_file = entry->d_type == DT_REG;
+    if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+      struct stat s;
+      worker->stats++;
+#ifdef _WIN32
+      char* full = join_path(task->path, name);
+      int ok = full && stat(full, &s) == 0;
+      free(full);
+#else
+      int ok = fstatat(dirfd(dir), name, &s, 0) == 0;
+#endif
+      if (!ok)
+        continue;
+      // Symlinked directories are left alone so a link back up the tree can't loop forever
+      is_dir = entry->d_type == DT_UNKNOWN && S_ISDIR(s.st_mode);
+      is_file = S_ISREG(s.st_mode);
+    }
+
+    // Other files, and directories past the depth limit, are skipped before a path is built;
+    // excludes need the path from the root
+    const LibraryRoot* root = scanner->root;
+    if ((is_file && !library_root_takes_file(root, name)) || (!is_file && !is_dir))
+      continue;
+    if (is_dir && root->max_depth >= 0 && task->depth >= root->max_depth) {
+      worker->pruned++;
+      continue;
+    }
+    char* path = join_path(task->path, name);
+    if (!path) {
+      worker->failed = 1;
+      continue;
+    }
+    if (library_root_excludes(root, name, path + scanner->root_length + 1)) {
+      worker->pruned++;
+      free(path);
+      continue;
+    }
+
+    if (is_file) {
+      add_sound(worker, path);
+    } else {
+      int child_fd = -1;
+#ifndef _WIN32
+      // Open it now, relative to this directory, unless too many fds are already waiting
+      if (__atomic_add_fetch(&scanner->open_dirs, 1, __ATOMIC_RELAXED) <= SCANNER_MAX_OPEN_DIRS)
+        child_fd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (child_fd < 0)
+        __atomic_sub_fetch(&scanner->open_dirs, 1, __ATOMIC_RELAXED);
+#endif
+      add_directory(worker, path, child_fd, task->depth + 1);
+    }
+  }
+  closedir(dir);
+}
+
+static void* scan_worker_main(void* arg) {
+  ScanWorker* worker = (ScanWorker*)arg;
+  Scanner* scanner = worker->scanner;
+  for (;;) {
+    DirTask task;
+    int found = pop_task(&worker->queue, &task, 0);
+    for (uint32_t i = 1; !found && i < scanner->worker_count; i++) {
+      ScanWorker* victim = &scanner->workers[(worker->index + i) % scanner->worker_count];
+      found = pop_task(&victim->queue, &task, 1);
+    }
+
+    if (found) {
+      scan_directory(worker, &task);
+      free(task.path);
+      __atomic_sub_fetch(&scanner->outstanding, 1, __ATOMIC_ACQ_REL);
+    } else if (__atomic_load_n(&scanner->outstanding, __ATOMIC_ACQUIRE) == 0) {
+      break;
+    } else {
+      sleep_ns(SCANNER_IDLE_NS);
+    }
+  }
+  return NULL;
+}
+
+static int compare_paths(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int scan_library(const LibraryRoot* root, const char* dir, uint32_t threads, ScanResult* result) {
+  memset(result, 0, sizeof(*result));
+  if (!dir)
+    dir = root->path;
+  if (threads == 0) {
+    threads = cpu_count();
+    if (threads < SCANNER_MIN_THREADS)
+      threads = SCANNER_MIN_THREADS;
+  }
+
+  Scanner scanner;
+  memset(&scanner, 0, sizeof(scanner));
+  scanner.workers = (ScanWorker*)calloc(threads, sizeof(ScanWorker));
+  Thread* handles = (Thread*)calloc(threads, sizeof(Thread));
+  char* dir_path = (char*)malloc(strlen(dir) + 1);
+  if (!scanner.workers || !handles || !dir_path) {
+    free(scanner.workers);
+    free(handles);
+    free(dir_path);
+    return 0;
+  }
+  strcpy(dir_path, dir);
+  scanner.root = root;
+  scanner.root_length = strlen(root->path);
+  scanner.worker_count = threads;
+  for (uint32_t i = 0; i < threads; i++) {
+    scanner.workers[i].scanner = &scanner;
+    scanner.workers[i].index = i;
+    mutex_init(&scanner.workers[i].queue.lock);
+  }
+  // A directory under the root starts as deep as it has "/"s past it
+  int depth = 0;
+  for (const char* p = dir + scanner.root_length; *p != '\0'; p++)
+    depth += *p == '/';
+  add_directory(&scanner.workers[0], dir_path, -1, depth);
+
+  uint32_t started = 1;
+  for (; started < threads; started++) {
+    if (!thread_create(&handles[started], scan_worker_main, &scanner.workers[started]))
+      break;
+  }
+  scan_worker_main(&scanner.workers[0]);
+  for (uint32_t i = 1; i < started; i++)
+    thread_join(handles[i]);
+
+  // Gather every thread's finds into one list in a stable order
+  int ok = 1;
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < threads; i++)
+    total += scanner.workers[i].count;
+  result->paths = (char**)malloc((total ? total : 1) * sizeof(char*));
+  ok = result->paths != NULL;
+  for (uint32_t i = 0; i < threads; i++) {
+    ScanWorker* worker = &scanner.workers[i];
+    for (uint32_t j = 0; j < worker->count; j++) {
+      if (ok)
+        result->paths[result->count++] = worker->paths[j];
+      else
+        free(worker->paths[j]);
+    }
+    result->directories += worker->directories;
+    result->stats += worker->stats;
+    result->pruned += worker->pruned;
+    ok = ok && !worker->failed;
+    free(worker->paths);
+    free(worker->queue.tasks);
+    mutex_destroy(&worker->queue.lock);
+  }
+  if (result->count > 1)
+    qsort(result->paths, result->count, sizeof(char*), compare_paths);
+
+  free(scanner.workers);
+  free(handles);
+  return ok && result->directories > 0;
+}
+
+void scan_result_free(ScanResult* result) {
+  for (uint32_t i = 0; i < result->count; i++)
+    free(result->paths[i]);
+  free(result->paths);
+  memset(result, 0, sizeof(*result));
+}
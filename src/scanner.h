@@ -0,0 +1,30 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdint.h>
+
+#include "library_config.h"
+
+#define SCANNER_MAX_OPEN_DIRS 256  // Directory fds held open by queued work before falling back
+                                   // to opening by path
+
+// Every sound file under a directory tree, found by several threads at once
+typedef struct {
+  char** paths;  // "<root>/<dir>/<file>", sorted
+  uint32_t count;
+  uint32_t directories;  // Directories read, the root included
+  uint32_t stats;  // Entries whose type d_type couldn't tell, so they had to be stat'ed
+  uint32_t pruned;  // Directories past the root's depth limit, and entries it excludes
+} ScanResult;
+
+// Walk dir, root's path or a directory under it (NULL for the root itself), for the sound files
+// root takes. Each thread takes directories off its own queue and steals from the others' when
+// it runs dry; threads 0 means one per CPU, at least four, since a network share keeps threads
+// waiting. Directories are read relative to their parent's fd, and neither pruned directories
+// nor symlinks to directories are opened. Returns 0 if dir can't be read or memory ran out;
+// result then holds whatever was found and must still be freed
+int scan_library(const LibraryRoot* root, const char* dir, uint32_t threads, ScanResult* result);
+
+void scan_result_free(ScanResult* result);
+
+#endif  // SCANNER_H
@@ -0,0 +1,395 @@
+#include "search_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_MAX_TERMS 16
+#define SEARCH_MAX_LISTS 64  // Trigram lists a query intersects at most; the rest are verified
+#define TABLE_MIN_SLOTS 1024
+
+// The items holding one trigram, as varint gaps between ascending item numbers
+typedef struct {
+  uint32_t key;  // The trigram's three bytes, or 0 for a free slot
+  uint32_t count;
+  uint32_t last;  // Item added last, which the next gap is taken from
+  uint32_t size;
+  uint32_t capacity;
+  uint8_t* bytes;
+} Posting;
+
+struct SearchIndex {
+  char* text;  // Every item lowercased and NUL-terminated, back to back
+  size_t text_size;
+  size_t text_capacity;
+  uint32_t* offsets;  // Where each item starts in text
+  uint32_t count;
+  uint32_t offset_capacity;
+  Posting* table;  // Open addressing on the trigram
+  uint32_t table_slots;  // A power of two, at least twice trigrams
+  uint32_t trigrams;
+  uint32_t* candidates;  // Query scratch, one slot per item
+  uint32_t candidate_capacity;
+  char* terms;  // Query scratch holding the lowercased query
+  size_t terms_capacity;
+};
+
+static char lower(char c) {
+  return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+static uint32_t trigram_key(const char* text) {
+  return (uint32_t)(unsigned char)text[0] << 16 | (uint32_t)(unsigned char)text[1] << 8 |
+         (uint32_t)(unsigned char)text[2];
+}
+
+static uint32_t first_slot(uint32_t key, uint32_t slots) {
+  return ((key * 2654435761u) >> 8) & (slots - 1);
+}
+
+static Posting* find_posting(const SearchIndex* index, uint32_t key) {
+  uint32_t mask = index->table_slots - 1;
+  for (uint32_t slot = first_slot(key, index->table_slots);; slot = (slot + 1) & mask) {
+    Posting* posting = &index->table[slot];
+    if (posting->key == key)
+      return posting;
+    if (posting->key == 0)
+      return NULL;
+  }
+}
+
+static int grow_table(SearchIndex* index) {
+  uint32_t slots = index->table_slots ? index->table_slots * 2 : TABLE_MIN_SLOTS;
+  Posting* table = (Posting*)calloc(slots, sizeof(Posting));
+  if (!table)
+    return 0;
+  for (uint32_t i = 0; i < index->table_slots; i++) {
+    const Posting* posting = &index->table[i];
+    if (posting->key == 0)
+      continue;
+    uint32_t slot = first_slot(posting->key, slots);
+    while (table[slot].key != 0)
+      slot = (slot + 1) & (slots - 1);
+    table[slot] = *posting;
+  }
+  free(index->table);
+  index->table = table;
+  index->table_slots = slots;
+  return 1;
+}
+
+static Posting* add_posting(SearchIndex* index, uint32_t key) {
+  Posting* posting = find_posting(index, key);
+  if (posting)
+    return posting;
+  if ((index->trigrams + 1) * 2 > index->table_slots && !grow_table(index))
+    return NULL;
+  uint32_t slot = first_slot(key, index->table_slots);
+  while (index->table[slot].key != 0)
+    slot = (slot + 1) & (index->table_slots - 1);
+  index->trigrams++;
+  posting = &index->table[slot];
+  posting->key = key;
+  return posting;
+}
+
+static int append_item(Posting* posting, uint32_t item) {
+  if (posting->capacity - posting->size < 5) {
+    uint32_t capacity = posting->capacity ? posting->capacity * 2 : 8;
+    uint8_t* grown = (uint8_t*)realloc(posting->bytes, capacity);
+    if (!grown)
+      return 0;
+    posting->bytes = grown;
+    posting->capacity = capacity;
+  }
+  uint32_t gap = item - posting->last;  // The first item is its own gap, from 0
+  while (gap >= 0x80) {
+    posting->bytes[posting->size++] = (uint8_t)(gap | 0x80);
+    gap >>= 7;
+  }
+  posting->bytes[posting->size++] = (uint8_t)gap;
+  posting->last = item;
+  posting->count++;
+  return 1;
+}
+
+static uint32_t next_item(const uint8_t** bytes, uint32_t previous) {
+  uint32_t gap = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*bytes)++;
+    gap |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return previous + gap;
+}
+
+SearchIndex* search_index_create(void) {
+  SearchIndex* index = (SearchIndex*)calloc(1, sizeof(SearchIndex));
+  if (index && !grow_table(index)) {
+    free(index);
+    return NULL;
+  }
+  return index;
+}
+
+void search_index_destroy(SearchIndex* index) {
+  if (!index)
+    return;
+  for (uint32_t i = 0; i < index->table_slots; i++)
+    free(index->table[i].bytes);
+  free(index->table);
+  free(index->text);
+  free(index->offsets);
+  free(index->candidates);
+  free(index->terms);
+  free(index);
+}
+
+int search_index_add(SearchIndex* index, const char* text) {
+  size_t length = strlen(text);
+  if (index->text_size + length + 1 > UINT32_MAX)
+    return 0;
+  if (index->text_capacity - index->text_size < length + 1) {
+    size_t capacity = index->text_capacity ? index->text_capacity * 2 : 65536;
+    while (capacity - index->text_size < length + 1)
+      capacity *= 2;
+    char* grown = (char*)realloc(index->text, capacity);
+    if (!grown)
+      return 0;
+    index->text = grown;
+    index->text_capacity = capacity;
+  }
+  if (index->count == index->offset_capacity) {
+    uint32_t capacity = index->offset_capacity ? index->offset_capacity * 2 : 1024;
+    uint32_t* grown = (uint32_t*)realloc(index->offsets, capacity * sizeof(uint32_t));
+    if (!grown)
+      return 0;
+    index->offsets = grown;
+    index->offset_capacity = capacity;
+  }
+
+  uint32_t item = index->count;
+  char* copy = index->text + index->text_size;
+  for (size_t i = 0; i < length; i++)
+    copy[i] = lower(text[i]);
+  copy[length] = '\0';
+  for (size_t i = 0; i + 3 <= length; i++) {
+    Posting* posting = add_posting(index, trigram_key(copy + i));
+    if (!posting)
+      return 0;
+    if (posting->count > 0 && posting->last == item)
+      continue;  // Repeated within this item
+    if (!append_item(posting, item))
+      return 0;
+  }
+  index->offsets[item] = (uint32_t)index->text_size;
+  index->text_size += length + 1;
+  index->count++;
+  return 1;
+}
+
+void search_index_shrink(SearchIndex* index) {
+  for (uint32_t i = 0; i < index->table_slots; i++) {
+    Posting* posting = &index->table[i];
+    if (posting->capacity == posting->size)
+      continue;
+    uint8_t* shrunk = (uint8_t*)realloc(posting->bytes, posting->size);
+    if (shrunk) {
+      posting->bytes = shrunk;
+      posting->capacity = posting->size;
+    }
+  }
+  char* text = (char*)realloc(index->text, index->text_size ? index->text_size : 1);
+  if (text) {
+    index->text = text;
+    index->text_capacity = index->text_size ? index->text_size : 1;
+  }
+}
+
+uint32_t search_index_count(const SearchIndex* index) {
+  return index->count;
+}
+
+// The first match of a needle in a block of memory, or NULL
+static const char* find_bytes(
+    const char* haystack,
+    size_t size,
+    const char* needle,
+    size_t length) {
+  if (length > size)
+    return NULL;
+  const char* last = haystack + size - length;
+  for (const char* at = haystack; at <= last; at++) {
+    at = (const char*)memchr(at, needle[0], (size_t)(last - at) + 1);
+    if (!at)
+      return NULL;
+    if (memcmp(at, needle, length) == 0)
+      return at;
+  }
+  return NULL;
+}
+
+// Items containing term, found by scanning the packed text and skipping to the next item after
+// each hit
+static uint32_t scan_text(const SearchIndex* index, const char* term, uint32_t* out) {
+  size_t length = strlen(term);
+  uint32_t found = 0;
+  uint32_t item = 0;
+  size_t at = 0;
+  while (at < index->text_size) {
+    const char* hit = find_bytes(index->text + at, index->text_size - at, term, length);
+    if (!hit)
+      break;
+    size_t offset = (size_t)(hit - index->text);
+    while (item + 1 < index->count && index->offsets[item + 1] <= offset)
+      item++;
+    out[found++] = item;
+    at = item + 1 < index->count ? index->offsets[item + 1] : index->text_size;
+  }
+  return found;
+}
+
+static uint32_t decode(const Posting* posting, uint32_t* out) {
+  const uint8_t* bytes = posting->bytes;
+  uint32_t item = 0;
+  for (uint32_t i = 0; i < posting->count; i++)
+    out[i] = item = next_item(&bytes, item);
+  return posting->count;
+}
+
+// Keep the candidates that are also in posting; both are ascending
+static uint32_t intersect(uint32_t* candidates, uint32_t count, const Posting* posting) {
+  const uint8_t* bytes = posting->bytes;
+  uint32_t item = 0;
+  uint32_t kept = 0;
+  uint32_t i = 0;
+  for (uint32_t left = posting->count; left > 0 && i < count; left--) {
+    item = next_item(&bytes, item);
+    while (i < count && candidates[i] < item)
+      i++;
+    if (i < count && candidates[i] == item)
+      candidates[kept++] = candidates[i++];
+  }
+  return kept;
+}
+
+static int reserve_items(uint32_t** items, uint32_t* capacity, uint32_t count) {
+  if (*capacity >= count)
+    return 1;
+  uint32_t* grown = (uint32_t*)realloc(*items, count * sizeof(uint32_t));
+  if (!grown)
+    return 0;
+  *items = grown;
+  *capacity = count;
+  return 1;
+}
+
+uint32_t search_index_query(
+    SearchIndex* index,
+    const char* query,
+    uint32_t** results,
+    uint32_t* capacity) {
+  size_t length = strlen(query);
+  if (index->terms_capacity < length + 1) {
+    char* grown = (char*)realloc(index->terms, length + 1);
+    if (!grown)
+      return 0;
+    index->terms = grown;
+    index->terms_capacity = length + 1;
+  }
+  uint32_t count = index->count;
+  if (count == 0 || !reserve_items(results, capacity, count) ||
+      !reserve_items(&index->candidates, &index->candidate_capacity, count))
+    return 0;
+
+  // Lowercase the query and cut it into terms
+  const char* terms[SEARCH_MAX_TERMS];
+  uint32_t term_count = 0;
+  char* lowered = index->terms;
+  for (size_t i = 0; i <= length; i++) {
+    char c = i < length ? lower(query[i]) : '\0';
+    int separator = c == ' ' || c == '\t' || c == '\0';
+    lowered[i] = separator ? '\0' : c;
+    if (!separator && (i == 0 || lowered[i - 1] == '\0') && term_count < SEARCH_MAX_TERMS)
+      terms[term_count++] = lowered + i;
+  }
+  if (term_count == 0) {
+    for (uint32_t i = 0; i < count; i++)
+      (*results)[i] = i;
+    return count;
+  }
+
+  // The trigram lists of every term, rarest first. A trigram nothing has means no matches
+  const Posting* lists[SEARCH_MAX_LISTS];
+  uint32_t list_count = 0;
+  uint32_t longest = 0;
+  for (uint32_t t = 0; t < term_count; t++) {
+    size_t term_length = strlen(terms[t]);
+    if (term_length > strlen(terms[longest]))
+      longest = t;
+    for (size_t i = 0; i + 3 <= term_length; i++) {
+      const Posting* posting = find_posting(index, trigram_key(terms[t] + i));
+      if (!posting)
+        return 0;
+      uint32_t j = 0;
+      while (j < list_count && lists[j] != posting)
+        j++;
+      if (j == list_count && list_count < SEARCH_MAX_LISTS)
+        lists[list_count++] = posting;
+    }
+  }
+  for (uint32_t i = 1; i < list_count; i++) {
+    const Posting* posting = lists[i];
+    uint32_t j = i;
+    for (; j > 0 && lists[j - 1]->count > posting->count; j--)
+      lists[j] = lists[j - 1];
+    lists[j] = posting;
+  }
+
+  // Narrow down to a few candidates, then check each for the terms that may still be missing:
+  // a scanned term or a three-letter one whose list was intersected is there already
+  uint32_t* candidates = index->candidates;
+  uint32_t found;
+  uint32_t used = 1;
+  const char* check[SEARCH_MAX_TERMS];
+  uint32_t check_count = 0;
+  if (list_count == 0) {
+    found = scan_text(index, terms[longest], candidates);
+  } else {
+    found = decode(lists[0], candidates);
+    for (; used < list_count && found > SEARCH_VERIFY_BELOW; used++)
+      found = intersect(candidates, found, lists[used]);
+  }
+  for (uint32_t t = 0; t < term_count; t++) {
+    int exact = list_count == 0 && t == longest;
+    if (list_count > 0 && strlen(terms[t]) == 3) {
+      const Posting* posting = find_posting(index, trigram_key(terms[t]));
+      for (uint32_t i = 0; i < used && !exact; i++)
+        exact = lists[i] == posting;
+    }
+    if (!exact)
+      check[check_count++] = terms[t];
+  }
+
+  uint32_t matched = 0;
+  for (uint32_t i = 0; i < found; i++) {
+    const char* text = index->text + index->offsets[candidates[i]];
+    uint32_t t = 0;
+    while (t < check_count && strstr(text, check[t]))
+      t++;
+    if (t == check_count)
+      (*results)[matched++] = candidates[i];
+  }
+  return matched;
+}
+
+size_t search_index_memory(const SearchIndex* index) {
+  size_t bytes = sizeof(SearchIndex) + index->text_capacity +
+                 (size_t)index->offset_capacity * sizeof(uint32_t) +
+                 (size_t)index->table_slots * sizeof(Posting) +
+                 (size_t)index->candidate_capacity * sizeof(uint32_t) + index->terms_capacity;
+  for (uint32_t i = 0; i < index->table_slots; i++)
+    bytes += index->table[i].capacity;
+  return bytes;
+}
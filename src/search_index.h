@@ -0,0 +1,39 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEARCH_VERIFY_BELOW 64  // Stop intersecting trigram lists once this few candidates remain
+
+// Case-insensitive substring search over a list of strings. Every string's trigrams point back at
+// it through delta-encoded posting lists, so a query only touches the strings that share its
+// rarest trigrams; terms too short to have one are found by scanning the packed text instead.
+// Items are numbered in the order they were added
+typedef struct SearchIndex SearchIndex;
+
+SearchIndex* search_index_create(void);
+
+void search_index_destroy(SearchIndex* index);
+
+// Add the next item. Returns 0 if out of memory, after which the index must not be used
+int search_index_add(SearchIndex* index, const char* text);
+
+// Give back the room kept for growth, once everything has been added
+void search_index_shrink(SearchIndex* index);
+
+uint32_t search_index_count(const SearchIndex* index);
+
+// Items whose text contains every space-separated term of query, in any order and ignoring ASCII
+// case, in ascending order into *results (grown as needed). A query without terms matches
+// everything. Returns how many matched
+uint32_t search_index_query(
+    SearchIndex* index,
+    const char* query,
+    uint32_t** results,
+    uint32_t* capacity);
+
+// Bytes held by the text, the posting lists and the trigram table
+size_t search_index_memory(const SearchIndex* index);
+
+#endif  // SEARCH_INDEX_H
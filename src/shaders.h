@@ -43,4 +43,32 @@
   "  FragColor = vec4(uColor, 1.0);\n" \
   "}\n"
 
+// Tile vertex shader: a unit quad stretched over each instance's rectangle
+#define TILE_VERTEX_SHADER                                        \
+  "#version 330 core\n"                                           \
+  "layout(location=0) in vec2 aCorner;\n"                         \
+  "layout(location=1) in vec4 aRect;\n"                           \
+  "layout(location=2) in vec3 aColor;\n"                          \
+  "layout(location=3) in float aProgress;\n"                      \
+  "uniform mat4 uProj;\n"                                         \
+  "out vec3 vColor;\n"                                            \
+  "out float vPlayed;\n"                                          \
+  "void main(){\n"                                                \
+  "  vec2 pos = aRect.xy + aCorner * aRect.zw;\n"                 \
+  "  gl_Position = uProj * vec4(pos, 0.0, 1.0);\n"                \
+  "  vColor = aColor;\n"                                          \
+  "  vPlayed = aProgress >= 0.0 ? aCorner.x - aProgress : 1.0;\n" \
+  "}\n"
+
+// Tile fragment shader: the part left of the progress is drawn in the progress color
+#define TILE_FRAGMENT_SHADER                                            \
+  "#version 330 core\n"                                                 \
+  "in vec3 vColor;\n"                                                   \
+  "in float vPlayed;\n"                                                 \
+  "uniform vec3 uProgressColor;\n"                                      \
+  "out vec4 FragColor;\n"                                               \
+  "void main(){\n"                                                      \
+  "  FragColor = vec4(vPlayed < 0.0 ? uProgressColor : vColor, 1.0);\n" \
+  "}\n"
+
 #endif  // SHADERS_H
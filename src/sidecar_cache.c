@@ -0,0 +1,253 @@
+#include "sidecar_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+  SidecarCache* cache;
+  SidecarEntry* entry;  // Entries live until the cache is destroyed
+} RefreshJob;
+
+static uint64_t hash_path(const char* path) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+    hash ^= *p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static int stat_key(const char* path, int64_t* mtime, uint64_t* size) {
+  struct stat s;
+  if (stat(path, &s) != 0)
+    return 0;
+  *mtime = (int64_t)s.st_mtime;
+  *size = (uint64_t)s.st_size;
+  return 1;
+}
+
+static void grow_buckets(SidecarCache* cache) {
+  uint32_t new_count = cache->bucket_count * 2;
+  SidecarEntry** new_buckets = (SidecarEntry**)calloc(new_count, sizeof(SidecarEntry*));
+  if (!new_buckets)
+    return;
+
+  for (uint32_t i = 0; i < cache->bucket_count; i++) {
+    SidecarEntry* entry = cache->buckets[i];
+    while (entry) {
+      SidecarEntry* next = entry->hash_next;
+      entry->hash_next = new_buckets[entry->hash & (new_count - 1)];
+      new_buckets[entry->hash & (new_count - 1)] = entry;
+      entry = next;
+    }
+  }
+
+  free(cache->buckets);
+  cache->buckets = new_buckets;
+  cache->bucket_count = new_count;
+}
+
+static SidecarEntry* find_entry(SidecarCache* cache, const char* path, uint64_t hash) {
+  SidecarEntry* entry = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; entry; entry = entry->hash_next) {
+    if (entry->hash == hash && strcmp(entry->path, path) == 0)
+      return entry;
+  }
+  return NULL;
+}
+
+static void save_file(SidecarCache* cache) {
+  mutex_lock(&cache->save_lock);
+
+  // Encode under the lock, write outside it so lookups from the UI never wait on the disk
+  size_t length = 0;
+  mutex_lock(&cache->lock);
+  void* data = cache->ops->encode(cache, &length);
+  if (data)
+    cache->dirty = 0;
+  mutex_unlock(&cache->lock);
+
+  if (data) {
+    // Write a sibling file and rename it over the old one so a crash never leaves half a cache
+    size_t temp_length = strlen(cache->file) + 5;
+    char* temp_path = (char*)malloc(temp_length);
+    FILE* file = NULL;
+    if (temp_path) {
+      snprintf(temp_path, temp_length, "%s.tmp", cache->file);
+      file = fopen(temp_path, "wb");
+    }
+    if (file) {
+      int ok = fwrite(data, 1, length, file) == length;
+      ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+      if (ok)
+        remove(cache->file);
+#endif
+      if (!ok || rename(temp_path, cache->file) != 0) {
+        fprintf(stderr, "Failed to write %s cache %s\n", cache->ops->name, cache->file);
+        remove(temp_path);
+      }
+    }
+    free(temp_path);
+    free(data);
+  }
+
+  mutex_unlock(&cache->save_lock);
+}
+
+static void refresh_entry(SidecarCache* cache, SidecarEntry* entry) {
+  int64_t mtime = 0;
+  uint64_t size = 0;
+  if (!stat_key(entry->path, &mtime, &size)) {
+    mutex_lock(&cache->lock);
+    cache->failed++;
+    mutex_unlock(&cache->lock);
+    return;
+  }
+
+  mutex_lock(&cache->lock);
+  int fresh = entry->valid && entry->mtime == mtime && entry->size == size;
+  if (fresh)
+    cache->reused++;
+  mutex_unlock(&cache->lock);
+  if (!fresh)
+    cache->ops->refresh(cache, entry, mtime, size);
+}
+
+static void refresh_job(void* arg, int cancelled) {
+  RefreshJob* job = (RefreshJob*)arg;
+  SidecarCache* cache = job->cache;
+  SidecarEntry* entry = job->entry;
+  free(job);
+
+  if (!cancelled)
+    refresh_entry(cache, entry);
+
+  mutex_lock(&cache->lock);
+  entry->queued = 0;
+  cache->pending--;
+  int save = !cancelled && cache->pending == 0 && cache->dirty;
+  mutex_unlock(&cache->lock);
+
+  if (save)
+    save_file(cache);
+}
+
+int sidecar_cache_init(
+    SidecarCache* cache,
+    const SidecarOps* ops,
+    const char* file,
+    WorkerPool* pool) {
+  memset(cache, 0, sizeof(*cache));
+  cache->bucket_count = 64;
+  cache->buckets = (SidecarEntry**)calloc(cache->bucket_count, sizeof(SidecarEntry*));
+  cache->file = (char*)malloc(strlen(file) + 1);
+  if (!cache->buckets || !cache->file) {
+    free(cache->buckets);
+    free(cache->file);
+    return 0;
+  }
+
+  strcpy(cache->file, file);
+  cache->pool = pool;
+  cache->ops = ops;
+  mutex_init(&cache->lock);
+  mutex_init(&cache->save_lock);
+  return 1;
+}
+
+void sidecar_cache_destroy(SidecarCache* cache) {
+  if (cache->dirty)
+    save_file(cache);
+
+  for (uint32_t i = 0; i < cache->bucket_count; i++) {
+    SidecarEntry* entry = cache->buckets[i];
+    while (entry) {
+      SidecarEntry* next = entry->hash_next;
+      if (cache->ops->release)
+        cache->ops->release(entry);
+      free(entry->path);
+      free(entry);
+      entry = next;
+    }
+  }
+  mutex_destroy(&cache->save_lock);
+  mutex_destroy(&cache->lock);
+  free(cache->buckets);
+  free(cache->file);
+}
+
+SidecarEntry* sidecar_cache_find(SidecarCache* cache, const char* path) {
+  return find_entry(cache, path, hash_path(path));
+}
+
+SidecarEntry* sidecar_cache_add(SidecarCache* cache, const char* path) {
+  uint64_t hash = hash_path(path);
+  SidecarEntry* entry = find_entry(cache, path, hash);
+  if (entry)
+    return entry;
+
+  entry = (SidecarEntry*)calloc(1, cache->ops->entry_size);
+  char* path_copy = entry ? (char*)malloc(strlen(path) + 1) : NULL;
+  if (!entry || !path_copy) {
+    free(entry);
+    return NULL;
+  }
+
+  strcpy(path_copy, path);
+  entry->path = path_copy;
+  entry->hash = hash;
+  if (cache->entries + 1 > cache->bucket_count)
+    grow_buckets(cache);
+  SidecarEntry** bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+  entry->hash_next = *bucket;
+  *bucket = entry;
+  cache->entries++;
+  return entry;
+}
+
+SidecarEntry* sidecar_cache_next(const SidecarCache* cache, const SidecarEntry* entry) {
+  uint32_t i = 0;
+  if (entry) {
+    i = (uint32_t)(entry->hash & (cache->bucket_count - 1)) + 1;
+    for (entry = entry->hash_next; entry; entry = entry->hash_next) {
+      if (entry->valid && entry->seen)
+        return (SidecarEntry*)entry;
+    }
+  }
+  for (; i < cache->bucket_count; i++) {
+    for (entry = cache->buckets[i]; entry; entry = entry->hash_next) {
+      if (entry->valid && entry->seen)
+        return (SidecarEntry*)entry;
+    }
+  }
+  return NULL;
+}
+
+void sidecar_cache_analyze(SidecarCache* cache, const char* path) {
+  mutex_lock(&cache->lock);
+  SidecarEntry* entry = sidecar_cache_add(cache, path);
+  if (!entry || entry->queued) {
+    mutex_unlock(&cache->lock);
+    return;
+  }
+  entry->seen = 1;
+  entry->queued = 1;
+  cache->pending++;
+  mutex_unlock(&cache->lock);
+
+  RefreshJob* job = (RefreshJob*)malloc(sizeof(RefreshJob));
+  if (job) {
+    job->cache = cache;
+    job->entry = entry;
+  }
+  if (!job || !worker_pool_submit(cache->pool, refresh_job, job)) {
+    free(job);
+    mutex_lock(&cache->lock);
+    entry->queued = 0;
+    cache->pending--;
+    mutex_unlock(&cache->lock);
+  }
+}
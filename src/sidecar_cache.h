@@ -0,0 +1,81 @@
+#ifndef SIDECAR_CACHE_H
+#define SIDECAR_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread.h"
+#include "worker_pool.h"
+
+// The part the loudness and waveform caches share: a table of per-sound results keyed by path,
+// each valid for one mtime + size, refreshed by jobs on a worker pool and written back to a
+// sidecar file whenever the queue drains. The owner embeds SidecarCache as its first member and
+// its entry struct starts with a SidecarEntry; only the result, its computation and the file
+// format are its own
+typedef struct SidecarEntry {
+  char* path;
+  uint64_t hash;
+  int64_t mtime;  // What the result was computed from
+  uint64_t size;
+  int valid;  // The owner's result fields hold a result for mtime/size
+  int queued;  // A job for this entry is queued or running
+  int seen;  // Asked for this run; only these are written back, so deleted sounds age out
+  struct SidecarEntry* hash_next;
+} SidecarEntry;
+
+typedef struct SidecarCache SidecarCache;
+
+typedef struct {
+  const char* name;  // For messages, e.g. "loudness"
+  size_t entry_size;  // Of the owner's entry struct
+  // Worker thread, lock not held: compute the result for a file now at mtime/size, then under
+  // the lock install it, set valid, mtime and size and mark the cache dirty. A failure counts
+  // in failed
+  void (*refresh)(SidecarCache* cache, SidecarEntry* entry, int64_t mtime, uint64_t size);
+  // Lock held: the whole file, header included, for the entries sidecar_cache_next visits.
+  // Returns malloc'd bytes, or NULL if out of memory
+  void* (*encode)(SidecarCache* cache, size_t* length);
+  // Free the owner's result fields of an entry; NULL if there are none
+  void (*release)(SidecarEntry* entry);
+} SidecarOps;
+
+struct SidecarCache {
+  Mutex lock;  // Guards the table, the entry fields and counters; never held while decoding
+  Mutex save_lock;  // Serializes writers of the file
+  SidecarEntry** buckets;
+  uint32_t bucket_count;  // Power of two
+  uint32_t entries;
+  uint32_t pending;  // Entries queued or being refreshed
+  uint64_t reused;  // Refreshes that found the stored result still valid
+  uint64_t failed;  // Files that couldn't be stat'ed or decoded
+  int dirty;
+  WorkerPool* pool;
+  char* file;
+  const SidecarOps* ops;
+};
+
+// Returns 1 on success, 0 if out of memory. The owner loads file itself afterwards
+int sidecar_cache_init(
+    SidecarCache* cache,
+    const SidecarOps* ops,
+    const char* file,
+    WorkerPool* pool);
+
+// Save if dirty and free the entries and the table, but not cache itself
+void sidecar_cache_destroy(SidecarCache* cache);
+
+// Lock held (or no workers yet, while loading). Returns NULL if path has no entry
+SidecarEntry* sidecar_cache_find(SidecarCache* cache, const char* path);
+
+// Lock held (or no workers yet, while loading). Find path's entry, adding a zeroed one if it has
+// none. Returns NULL if out of memory
+SidecarEntry* sidecar_cache_add(SidecarCache* cache, const char* path);
+
+// Lock held: the entry after entry (NULL for the first) that should be written back
+SidecarEntry* sidecar_cache_next(const SidecarCache* cache, const SidecarEntry* entry);
+
+// Queue an entry for a refresh unless it is already queued. The worker stats the file and keeps
+// the stored result if mtime and size still match; the caller never touches the disk
+void sidecar_cache_analyze(SidecarCache* cache, const char* path);
+
+#endif  // SIDECAR_CACHE_H
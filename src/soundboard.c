@@ -2,135 +2,590 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
 
+#include "decoder.h"
+#include "loudness_cache.h"
+#include "process.h"
+#include "thread.h"
+#include "waveform_cache.h"
+
 #ifdef _WIN32
 #include <mmsystem.h>
 #pragma comment(lib, "winmm.lib")
-#define str_casecmp _stricmp
 #else
-#include <spawn.h>
 #include <signal.h>
-#include <strings.h>
 #include <sys/wait.h>
 #include <unistd.h>
-#define str_casecmp strcasecmp
-extern char** environ;
+
+// Players the legacy fallback can hand a file to, in order of preference
+#define EXTERNAL_PLAYER_COUNT 5
+static const char* const external_players[EXTERNAL_PLAYER_COUNT] = {
+    "paplay", "mpv", "pw-play", "aplay", "ffplay"};
 #endif
 
-static uint32_t read_u32_le(const unsigned char* bytes) {
-  return ((uint32_t)bytes[0]) | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
-         ((uint32_t)bytes[3] << 24);
-}
+// Files the soundboard writes next to the sounds (its caches) start with this and never trigger
+// a rescan
+#define PRIVATE_FILE_PREFIX ".soundboard-"
+
+#define WATCHER_STOP_CHECK_NS 100000000ULL  // How often the inotify watcher checks for shutdown
 
 static int is_directory_mode(mode_t mode) {
   return S_ISDIR(mode);
 }
 
-static int is_regular_mode(mode_t mode) {
-  return S_ISREG(mode);
+static void load_start_overrides(Soundboard* sb) {
+  for (int i = 0; i < sb->count; i++)
+    sb->sounds[i].start_ms = -1;
+
+  FILE* file = fopen(START_OVERRIDES_FILE, "r");
+  if (!file)
+    return;
+
+  char* line = NULL;
+  size_t capacity = 0;
+  while (read_line(file, &line, &capacity)) {
+    line[strcspn(line, "\r")] = '\0';
+    char* name;
+    long start_ms = strtol(line, &name, 10);
+    if (line[0] == '#' || name == line || *name != ' ' || start_ms < 0)
+      continue;
+    while (*name == ' ')
+      name++;
+
+    // A folder sets every sound under it; later lines override earlier ones
+    int first = find_tile(sb, name);
+    int end = first + 1;
+    if (first < 0 && !find_directory_tiles(sb, name, &first, &end))
+      continue;
+    for (int i = first; i < end; i++)
+      sb->sounds[i].start_ms = (int32_t)start_ms;
+  }
+  free(line);
+  fclose(file);
+}
+
+static void free_tiles(Soundboard* sb) {
+  free(sb->tiles);
+  free(sb->sounds);
+  path_trie_destroy(sb->paths);
+  free(sb->path_buffer);
+  search_index_destroy(sb->search);
+  free(sb->shown);
+  sb->tiles = NULL;
+  sb->sounds = NULL;
+  sb->paths = NULL;
+  sb->path_buffer = NULL;
+  sb->path_capacity = 0;
+  sb->count = 0;
+  sb->search = NULL;
+  sb->shown = NULL;
+  sb->shown_capacity = 0;
+  sb->shown_count = 0;
+  sb->filtered = 0;
 }
 
-void find_sounds_recursive(const char* base_path, Soundboard* sb) {
-  DIR* dir;
-  struct dirent* entry;
-  char path[MAX_PATH];
+// Run search_query again over the current tiles. Without an index that matches them (it is
+// built in the background, and a refresh that ran out of memory may have skipped a sound)
+// every tile stays shown
+static void filter_tiles(Soundboard* sb) {
+  if (sb->search && search_index_count(sb->search) != (uint32_t)sb->count) {
+    search_index_destroy(sb->search);
+    sb->search = NULL;
+  }
+  sb->filtered = 0;
+  sb->shown_count = sb->count;
+  if (!sb->search || sb->search_query[0] == '\0')
+    return;
+  sb->shown_count =
+      (int)search_index_query(sb->search, sb->search_query, &sb->shown, &sb->shown_capacity);
+  sb->filtered = 1;
+}
 
-  if (!(dir = opendir(base_path)))
+// Bring the grid in line with sb->library, given the snapshot it was filled from (NULL at
+// first). Added sounds get a tile and are queued for analysis, changed ones are analyzed again
+// and dropped from the PCM cache, removed ones lose their tile. Every other tile keeps its
+// state, including what is playing on it and the hover, and only moves to keep path order.
+// The paths go into a new trie, so directories that are gone don't linger in it
+static void apply_library(Soundboard* sb, const LibraryIndex* previous) {
+  uint32_t total = library_index_count(sb->library);
+  if (total > INT32_MAX)
+    total = INT32_MAX;
+  size_t slots = total ? total : 1;
+  Tile* next_tiles = (Tile*)malloc(slots * sizeof(Tile));
+  Sound* next = (Sound*)malloc(slots * sizeof(Sound));
+  int* remap = (int*)malloc((sb->count ? (size_t)sb->count : 1) * sizeof(int));
+  int* tile_of_entry = (int*)malloc(slots * sizeof(int));
+  PathTrie* paths = path_trie_create();
+  if (!next_tiles || !next || !remap || !tile_of_entry || !paths) {
+    fprintf(stderr, "Out of memory for %u tiles\n", total);
+    free(next_tiles);
+    free(next);
+    free(remap);
+    free(tile_of_entry);
+    path_trie_destroy(paths);
+    filter_tiles(sb);
     return;
+  }
 
-  while ((entry = readdir(dir)) != NULL && sb->count < MAX_SOUNDS) {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-      continue;
+  // remap takes each old tile to its new one, or to -1 if its sound is gone
+  int count = 0;
+  int old = 0;
+  uint32_t added = 0;
+  uint32_t changed = 0;
+  uint32_t removed = 0;
+  for (uint32_t i = 0; i < total; i++) {
+    const char* path = library_index_path(sb->library, i);
+    const LibraryEntry* entry = library_index_entry(sb->library, i);
 
-    snprintf(path, sizeof(path), "%s/%s", base_path, entry->d_name);
+    // Both lists are in path order, so tiles sorting before this path were removed
+    int order = -1;
+    while (old < sb->count) {
+      const Sound* listed = &sb->sounds[old];
+      order = path_trie_compare(sb->paths, listed->dir, listed->leaf, path);
+      if (order >= 0)
+        break;
+      pcm_cache_invalidate(sb->pcm_cache, sound_path(sb, old));
+      remap[old++] = -1;
+      removed++;
+    }
 
-    struct stat s;
-    if (stat(path, &s) == 0) {
-      if (is_directory_mode(s.st_mode)) {
-        find_sounds_recursive(path, sb);
-      } else if (is_regular_mode(s.st_mode)) {
-        char* ext = strrchr(entry->d_name, '.');
-        if (ext && str_casecmp(ext, ".wav") == 0) {
-          snprintf(sb->sounds[sb->count].name, MAX_PATH, "%s", path);
-          snprintf(sb->sounds[sb->count].path, MAX_PATH, "%s", path);
-          sb->sounds[sb->count].marquee_offset = 0.0f;
-          sb->count++;
-        }
+    Sound* sound = &next[count];
+    uint32_t dir;
+    const char* leaf;
+    tile_of_entry[i] = -1;
+    if (!path_trie_add(paths, path, (uint32_t)count, &dir, &leaf)) {
+      if (old < sb->count && order == 0) {
+        remap[old++] = -1;
+        removed++;
       }
+      continue;  // Out of memory; the next refresh tries again
     }
+
+    // A duplicate is analyzed through its original, so it needs nothing of its own. A sound
+    // that stops being one (its original was removed or changed) is analyzed as any new sound
+    int tile = count++;
+    int original = tile_of_entry[entry->original];
+    tile_of_entry[i] = tile;
+    int analyze = 1;
+    if (old < sb->count && order == 0) {
+      int was_original = sb->sounds[old].audio_tile == old;
+      *sound = sb->sounds[old];
+      next_tiles[tile] = sb->tiles[old];
+      remap[old++] = tile;
+      const LibraryEntry* before = library_index_find(previous, path);
+      if (before && before->mtime == entry->mtime && before->size == entry->size) {
+        analyze = !was_original;
+      } else {
+        pcm_cache_invalidate(sb->pcm_cache, path);
+        changed++;
+      }
+    } else {
+      next_tiles[tile].slot = -1;
+      next_tiles[tile].marquee_offset = 0.0f;
+      added++;
+    }
+    sound->dir = dir;
+    sound->leaf = leaf;
+    sound->duration_ms = entry->duration_ms;
+    sound->audio_tile = original >= 0 ? original : tile;
+    if (analyze && sound->audio_tile == tile) {
+      loudness_cache_analyze(sb->loudness, path);
+      waveform_cache_analyze(sb->waveforms, path);
+    }
+  }
+  for (; old < sb->count; old++) {
+    pcm_cache_invalidate(sb->pcm_cache, sound_path(sb, old));
+    remap[old] = -1;
+    removed++;
   }
 
-  closedir(dir);
+  // A sound that was removed while playing plays on, but no tile shows it any more
+  for (int i = 0; i < MAX_PLAYING; i++) {
+    int tile = sb->playing[i].tile;
+    sb->playing[i].tile = tile >= 0 && tile < sb->count ? remap[tile] : -1;
+  }
+  int hovered = sb->hovered_tile;
+  sb->hovered_tile = hovered >= 0 && hovered < sb->count ? remap[hovered] : -1;
+
+  free(remap);
+  free(tile_of_entry);
+  free(sb->tiles);
+  free(sb->sounds);
+  path_trie_destroy(sb->paths);
+  sb->tiles = next_tiles;
+  sb->sounds = next;
+  sb->paths = paths;
+  sb->count = count;
+  load_start_overrides(sb);
+  filter_tiles(sb);
+  if (previous && (added || changed || removed))
+    printf("Library refresh: %u added, %u changed, %u removed\n", added, changed, removed);
+}
+
+// Scan the roots, or only the paths in changes, against the previous snapshot and save the
+// result if anything differs
+static LibraryIndex* reconcile_library(
+    const LibraryIndex* previous,
+    const LibraryConfig* config,
+    const ChangeSet* changes,
+    LoudnessCache* loudness,
+    const int* cancel) {
+  LibraryIndexStats stats;
+  LibraryRootStats* root_stats = NULL;
+  LibraryIndex* index;
+  if (changes) {
+    index = library_index_update(previous, config, changes, loudness, cancel, &stats);
+  } else {
+    root_stats = (LibraryRootStats*)calloc(config->count ? config->count : 1, sizeof(*root_stats));
+    index = library_index_build(config, previous, loudness, cancel, &stats, root_stats);
+  }
+  if (!index) {
+    free(root_stats);
+    return NULL;
+  }
+
+  // Where a full scan spent its time, to tune the roots' depth limits and excludes by
+  for (uint32_t i = 0; root_stats && i < config->count; i++) {
+    printf(
+        "Library root %s: %u sounds in %u directories, %u entries pruned, scanned in %.1f ms\n",
+        config->roots[i].path,
+        root_stats[i].sounds,
+        root_stats[i].directories,
+        root_stats[i].pruned,
+        (double)root_stats[i].scan_ns / 1e6);
+  }
+  free(root_stats);
+
+  if (changes) {
+    printf(
+        "Library: %u changed paths reconciled in %.1f ms (%u sounds, %u probed in %u round trips, "
+        "%u directories rescanned)\n",
+        changes->count,
+        (double)stats.total_ns / 1e6,
+        library_index_count(index),
+        stats.probed,
+        stats.header_round_trips,
+        stats.directories);
+  } else {
+    printf(
+        "Library: %u sounds in %u directories, scanned in %.1f ms and reconciled in %.1f ms "
+        "(%u unchanged, %u probed in %u round trips)\n",
+        library_index_count(index),
+        stats.directories,
+        (double)stats.scan_ns / 1e6,
+        (double)stats.total_ns / 1e6,
+        stats.reused,
+        stats.probed,
+        stats.header_round_trips);
+  }
+  if (stats.duplicates > 0)
+    printf(
+        "Library: %u sounds share their audio with another (%u files hashed)\n",
+        stats.duplicates,
+        stats.hashed);
+  if (!library_index_identical(index, previous))
+    library_index_save(index, LIBRARY_INDEX_FILE);
+  return index;
+}
+
+// Index every path of a snapshot for the search field, in the order apply_library() gives them
+// tiles. Returns NULL if out of memory
+static SearchIndex* index_library(const LibraryIndex* library) {
+  uint64_t start = time_ns();
+  uint32_t count = library_index_count(library);
+  SearchIndex* search = search_index_create();
+  for (uint32_t i = 0; i < count && search; i++) {
+    if (!search_index_add(search, library_index_path(library, i))) {
+      search_index_destroy(search);
+      search = NULL;
+    }
+  }
+  if (!search) {
+    fprintf(stderr, "Out of memory for the search index\n");
+    return NULL;
+  }
+  search_index_shrink(search);
+  printf(
+      "Search: %u paths indexed in %.1f ms (%.1f MB)\n",
+      count,
+      (double)(time_ns() - start) / 1e6,
+      (double)search_index_memory(search) / 1048576.0);
+  return search;
+}
+
+static void* reconcile_thread(void* arg) {
+  Soundboard* sb = (Soundboard*)arg;
+  LibraryIndex* index = reconcile_library(
+      sb->library, &sb->library_config, sb->library_changes, sb->loudness, &sb->library_cancel);
+  SearchIndex* search = NULL;
+  if (index && !__atomic_load_n(&sb->library_cancel, __ATOMIC_ACQUIRE))
+    search = index_library(index);
+  sb->search_update = search;
+  __atomic_store_n(&sb->library_update, index, __ATOMIC_RELEASE);
+  __atomic_store_n(&sb->library_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Without roots from main(), read them from the config file alone
+static void configure_library(Soundboard* sb) {
+  if (sb->library_config.count == 0)
+    library_config_load(&sb->library_config, NULL, 0, NULL);
 }
 
 void load_sounds(Soundboard* sb) {
-  sb->count = 0;
-  sb->hovered_tile = -1;
-  sb->playing_tile = -1;
-  sb->play_start_time_ms = 0;
-  sb->sound_duration_ms = 0;
+  configure_library(sb);
+  LibraryIndex* previous = sb->library;
+  LibraryIndex* index = reconcile_library(previous, &sb->library_config, NULL, sb->loudness, NULL);
+  if (!index)
+    return;
+  sb->library = index;
+  if (!sb->headless) {
+    search_index_destroy(sb->search);
+    sb->search = index_library(index);
+  }
+  apply_library(sb, previous);
+  library_index_free(previous);
+}
 
-  find_sounds_recursive(".", sb);
+static void free_changes(ChangeSet* changes) {
+  if (changes) {
+    change_set_free(changes);
+    free(changes);
+  }
+}
+
+// Reconcile the paths in changes (taken over), or the whole tree if it is NULL. The snapshot on
+// screen stays untouched until the reconcile has been joined
+static void start_reconcile(Soundboard* sb, ChangeSet* changes) {
+  sb->library_done = 0;
+  sb->library_cancel = 0;
+  sb->library_update = NULL;
+  sb->search_update = NULL;
+  sb->library_changes = changes;
+  if (thread_create(&sb->library_thread, reconcile_thread, sb)) {
+    sb->library_reconciling = 1;
+    return;
+  }
+  sb->library_changes = NULL;
+  free_changes(changes);
+  load_sounds(sb);
+}
+
+void open_library(Soundboard* sb) {
+  configure_library(sb);
+  uint64_t start = time_ns();
+  sb->library = library_index_map(LIBRARY_INDEX_FILE);
+  if (!sb->library) {
+    load_sounds(sb);
+    return;
+  }
+
+  printf(
+      "Library: %u sounds from %s in %.1f ms, reconciling in the background\n",
+      library_index_count(sb->library),
+      LIBRARY_INDEX_FILE,
+      (double)(time_ns() - start) / 1e6);
+  apply_library(sb, NULL);
+  start_reconcile(sb, NULL);
+}
+
+void refresh_library(Soundboard* sb) {
+  if (sb->library_reconciling) {
+    // A change flagged meanwhile waits for this reconcile, then starts the next one
+    if (!__atomic_load_n(&sb->library_done, __ATOMIC_ACQUIRE))
+      return;
+    thread_join(sb->library_thread);
+    sb->library_reconciling = 0;
+    free_changes(sb->library_changes);
+    sb->library_changes = NULL;
+
+    // Unchanged files cost a string compare; the start overrides are reread in case they
+    // were what changed
+    LibraryIndex* previous = sb->library;
+    LibraryIndex* update = sb->library_update;
+    sb->library_update = NULL;
+    if (update) {
+      sb->library = update;
+      search_index_destroy(sb->search);
+      sb->search = sb->search_update;
+      sb->search_update = NULL;
+      apply_library(sb, previous);
+      library_index_free(previous);
+    }
+  }
+
+  // A full rescan covers whatever paths were reported as well
+  ChangeSet* changes = __atomic_exchange_n(&sb->pending_changes, NULL, __ATOMIC_ACQ_REL);
+  if (__atomic_exchange_n(&sb->needs_refresh, 0, __ATOMIC_ACQ_REL)) {
+    free_changes(changes);
+    start_reconcile(sb, NULL);
+  } else if (changes) {
+    start_reconcile(sb, changes);
+  }
+}
+
+void close_library(Soundboard* sb) {
+  if (sb->library_reconciling) {
+    __atomic_store_n(&sb->library_cancel, 1, __ATOMIC_RELEASE);
+    thread_join(sb->library_thread);
+    sb->library_reconciling = 0;
+    library_index_free(sb->library_update);
+    sb->library_update = NULL;
+    search_index_destroy(sb->search_update);
+    sb->search_update = NULL;
+    free_changes(sb->library_changes);
+    sb->library_changes = NULL;
+  }
+  free_changes(__atomic_exchange_n(&sb->pending_changes, NULL, __ATOMIC_ACQ_REL));
+  library_index_free(sb->library);
+  sb->library = NULL;
+  library_config_free(&sb->library_config);
+  free_tiles(sb);
+  sb->hovered_tile = -1;
 }
 
 #ifdef _WIN32
-DWORD WINAPI file_watcher_thread(LPVOID lpParam) {
-  Soundboard* sb = (Soundboard*)lpParam;
-  char path[MAX_PATH];
-  GetCurrentDirectory(MAX_PATH, path);
+// Whether a change record under root names something a scan of it would take, or might have
+// (a deleted entry can't be told apart as a file or a directory any more)
+static int record_affects_library(
+    const LibraryConfig* config,
+    const LibraryRoot* root,
+    const FILE_NOTIFY_INFORMATION* info) {
+  static const WCHAR prefix[] = L"" PRIVATE_FILE_PREFIX;
+  const DWORD prefix_bytes = sizeof(prefix) - sizeof(WCHAR);
+  if (info->FileNameLength >= prefix_bytes && memcmp(info->FileName, prefix, prefix_bytes) == 0)
+    return 0;
 
-  HANDLE hDir = CreateFile(
-      path,
-      FILE_LIST_DIRECTORY,
-      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+  char path[4096];
+  int root_length = snprintf(path, sizeof(path), "%s/", root->path);
+  if (root_length <= 0 || root_length >= (int)sizeof(path))
+    return 1;
+  int length = WideCharToMultiByte(
+      CP_UTF8,
+      0,
+      info->FileName,
+      (int)(info->FileNameLength / sizeof(WCHAR)),
+      path + root_length,
+      (int)sizeof(path) - root_length - 1,
       NULL,
-      OPEN_EXISTING,
-      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
       NULL);
-
-  if (hDir == INVALID_HANDLE_VALUE) {
-    fprintf(stderr, "Failed to create file handle for watcher\n");
+  if (length <= 0)
     return 1;
+  path[root_length + length] = '\0';
+  for (char* p = path + root_length; *p != '\0'; p++) {
+    if (*p == '\\')
+      *p = '/';
   }
+  return library_config_takes(config, path, 0) || library_config_takes(config, path, 1);
+}
 
-  OVERLAPPED overlapped;
-  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-  if (!overlapped.hEvent) {
-    fprintf(stderr, "Failed to create event for watcher\n");
-    CloseHandle(hDir);
-    return 1;
+// Whether a batch of change records touches anything besides the soundboard's own files and
+// what the roots leave out
+static int changes_affect_library(
+    const LibraryConfig* config,
+    const LibraryRoot* root,
+    const BYTE* records) {
+  const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)records;
+  for (;;) {
+    if (record_affects_library(config, root, info))
+      return 1;
+    if (info->NextEntryOffset == 0)
+      return 0;
+    info = (const FILE_NOTIFY_INFORMATION*)((const BYTE*)info + info->NextEntryOffset);
   }
+}
 
-  BYTE buffer[4096];
+// One root's directory handle and the change read pending on it
+typedef struct {
+  const LibraryRoot* root;
+  HANDLE dir;
+  OVERLAPPED overlapped;
+  DWORD buffer[1024];  // ReadDirectoryChangesW needs DWORD alignment
+} RootWatch;
+
+static int read_root_changes(RootWatch* watch) {
   DWORD bytes_returned;
+  if (ReadDirectoryChangesW(
+          watch->dir,
+          watch->buffer,
+          sizeof(watch->buffer),
+          TRUE,
+          FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+              FILE_NOTIFY_CHANGE_LAST_WRITE,
+          &bytes_returned,
+          &watch->overlapped,
+          NULL))
+    return 1;
+  fprintf(stderr, "ReadDirectoryChangesW failed for %s\n", watch->root->path);
+  return 0;
+}
 
-  while (1) {
-    if (!ReadDirectoryChangesW(
-            hDir,
-            buffer,
-            sizeof(buffer),
-            TRUE,
-            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
-                FILE_NOTIFY_CHANGE_LAST_WRITE,
-            &bytes_returned,
-            &overlapped,
-            NULL)) {
-      fprintf(stderr, "ReadDirectoryChangesW failed\n");
-      break;
-    }
+DWORD WINAPI file_watcher_thread(LPVOID lpParam) {
+  Soundboard* sb = (Soundboard*)lpParam;
+  const LibraryConfig* config = &sb->library_config;
+
+  // Every root's read and the stop event are waited on together, which caps the roots watched
+  uint32_t count = config->count;
+  if (count > MAXIMUM_WAIT_OBJECTS - 1) {
+    fprintf(stderr, "Watching only the first %d roots\n", MAXIMUM_WAIT_OBJECTS - 1);
+    count = MAXIMUM_WAIT_OBJECTS - 1;
+  }
+  RootWatch* watches = (RootWatch*)calloc(count ? count : 1, sizeof(RootWatch));
+  HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+  if (!watches) {
+    fprintf(stderr, "Out of memory for the watcher\n");
+    return 1;
+  }
 
-    HANDLE handles[2] = {overlapped.hEvent, sb->watcher_stop_event};
-    DWORD wait_status = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+  DWORD active = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    RootWatch* watch = &watches[active];
+    watch->root = &config->roots[i];
+    watch->dir = CreateFile(
+        watch->root->path,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL);
+    if (watch->dir == INVALID_HANDLE_VALUE) {
+      fprintf(stderr, "Failed to create file handle for watching %s\n", watch->root->path);
+      continue;
+    }
+    watch->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!watch->overlapped.hEvent) {
+      fprintf(stderr, "Failed to create event for watching %s\n", watch->root->path);
+      CloseHandle(watch->dir);
+      continue;
+    }
+    handles[active++] = watch->overlapped.hEvent;
+  }
+  handles[active] = sb->watcher_stop_event;
 
-    if (wait_status == WAIT_OBJECT_0) {
-      sb->needs_refresh = 1;
-      ResetEvent(overlapped.hEvent);
-    } else if (wait_status == WAIT_OBJECT_0 + 1) {
+  int running = 1;
+  for (DWORD i = 0; running && i < active; i++)
+    running = read_root_changes(&watches[i]);
+  while (running) {
+    DWORD wait_status = WaitForMultipleObjects(active + 1, handles, FALSE, INFINITE);
+    if (wait_status < WAIT_OBJECT_0 + active) {
+      // No records means the buffer overflowed and anything may have changed
+      RootWatch* watch = &watches[wait_status - WAIT_OBJECT_0];
+      DWORD bytes_returned;
+      if (!GetOverlappedResult(watch->dir, &watch->overlapped, &bytes_returned, FALSE) ||
+          bytes_returned == 0 ||
+          changes_affect_library(config, watch->root, (const BYTE*)watch->buffer))
+        __atomic_store_n(&sb->needs_refresh, 1, __ATOMIC_RELEASE);
+      ResetEvent(watch->overlapped.hEvent);
+      running = read_root_changes(watch);
+    } else if (wait_status == WAIT_OBJECT_0 + active) {
       break;
     } else {
       fprintf(stderr, "WaitForMultipleObjects failed\n");
@@ -138,29 +593,41 @@ DWORD WINAPI file_watcher_thread(LPVOID lpParam) {
     }
   }
 
-  CloseHandle(hDir);
-  CloseHandle(overlapped.hEvent);
+  for (DWORD i = 0; i < active; i++) {
+    CloseHandle(watches[i].dir);
+    CloseHandle(watches[i].overlapped.hEvent);
+  }
+  free(watches);
   return 0;
 }
 #else
-static uint64_t compute_tree_signature(const char* base_path) {
+// Sizes and times of what a scan of root reads under base_path, depth levels below the root,
+// folded into one value
+static uint64_t compute_tree_signature(const LibraryRoot* root, const char* base_path, int depth) {
   DIR* dir = opendir(base_path);
   if (!dir)
     return 0;
 
   struct dirent* entry;
   uint64_t signature = 1469598103934665603ULL;
-  char path[MAX_PATH];
+  char path[4096];
 
   while ((entry = readdir(dir)) != NULL) {
     if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
       continue;
+    if (strncmp(entry->d_name, PRIVATE_FILE_PREFIX, strlen(PRIVATE_FILE_PREFIX)) == 0)
+      continue;
 
     snprintf(path, sizeof(path), "%s/%s", base_path, entry->d_name);
+    if (library_root_excludes(root, entry->d_name, path + strlen(root->path) + 1))
+      continue;
 
     struct stat s;
     if (stat(path, &s) != 0)
       continue;
+    if (is_directory_mode(s.st_mode) ? root->max_depth >= 0 && depth >= root->max_depth
+                                     : !library_root_takes_file(root, entry->d_name))
+      continue;
 
     signature ^= (uint64_t)s.st_mtime;
     signature *= 1099511628211ULL;
@@ -168,7 +635,7 @@ static uint64_t compute_tree_signature(const char* base_path) {
     signature *= 1099511628211ULL;
 
     if (is_directory_mode(s.st_mode)) {
-      signature ^= compute_tree_signature(path);
+      signature ^= compute_tree_signature(root, path, depth + 1);
       signature *= 1099511628211ULL;
     }
   }
@@ -177,14 +644,64 @@ static uint64_t compute_tree_signature(const char* base_path) {
   return signature;
 }
 
+static uint64_t library_signature(const LibraryConfig* config) {
+  uint64_t signature = 1469598103934665603ULL;
+  for (uint32_t i = 0; i < config->count; i++) {
+    signature ^= compute_tree_signature(&config->roots[i], config->roots[i].path, 0);
+    signature *= 1099511628211ULL;
+  }
+  return signature;
+}
+
+// Hand a burst of changes to the main thread, merged with any it hasn't taken yet. Lost events
+// mean a full rescan
+static void publish_changes(Soundboard* sb, ChangeSet* changes) {
+  ChangeSet* pending = __atomic_exchange_n(&sb->pending_changes, NULL, __ATOMIC_ACQ_REL);
+  if (!pending)
+    pending = (ChangeSet*)calloc(1, sizeof(ChangeSet));
+  if (pending)
+    change_set_merge(pending, changes);
+  else
+    change_set_free(changes);
+
+  if (!pending || pending->overflow) {
+    free_changes(pending);
+    __atomic_store_n(&sb->needs_refresh, 1, __ATOMIC_RELEASE);
+    return;
+  }
+  __atomic_store_n(&sb->pending_changes, pending, __ATOMIC_RELEASE);
+}
+
 void* file_watcher_thread(void* lpParam) {
   Soundboard* sb = (Soundboard*)lpParam;
-  uint64_t last_signature = compute_tree_signature(".");
 
-  while (!sb->watcher_stop) {
-    uint64_t current_signature = compute_tree_signature(".");
+  // inotify reports what changed as it happens. Without it, or once it runs out of watches, the
+  // whole tree is polled instead
+  DirWatcher* watcher = dir_watcher_create(&sb->library_config, PRIVATE_FILE_PREFIX);
+  if (watcher) {
+    printf("Watching %u directories for changes\n", dir_watcher_count(watcher));
+    ChangeSet changes;
+    memset(&changes, 0, sizeof(changes));
+    int result = 0;
+    while (!__atomic_load_n(&sb->watcher_stop, __ATOMIC_ACQUIRE) &&
+           (result = dir_watcher_wait(watcher, WATCHER_STOP_CHECK_NS, &changes)) >= 0) {
+      if (result > 0)
+        publish_changes(sb, &changes);
+    }
+    change_set_free(&changes);
+    dir_watcher_destroy(watcher);
+    if (result >= 0)
+      return NULL;
+    __atomic_store_n(&sb->needs_refresh, 1, __ATOMIC_RELEASE);  // The broken watch may have
+                                                                 // missed something
+  }
+
+  uint64_t last_signature = library_signature(&sb->library_config);
+
+  while (!__atomic_load_n(&sb->watcher_stop, __ATOMIC_ACQUIRE)) {
+    uint64_t current_signature = library_signature(&sb->library_config);
     if (current_signature != last_signature) {
-      sb->needs_refresh = 1;
+      __atomic_store_n(&sb->needs_refresh, 1, __ATOMIC_RELEASE);
       last_signature = current_signature;
     }
 
@@ -198,14 +715,58 @@ void* file_watcher_thread(void* lpParam) {
 }
 #endif
 
-void play_sound(const char* path, Soundboard* sb, int tile_index) {
-  sb->sound_duration_ms = get_sound_duration(path);
-  sb->playing_tile = tile_index;
-  sb->play_start_time_ms = get_time_ms();
+static uint64_t pcm_cache_budget(void) {
+  const char* cache_mb = getenv("SOUNDBOARD_CACHE_MB");
+  uint64_t budget_mb = cache_mb ? strtoull(cache_mb, NULL, 10) : PCM_CACHE_DEFAULT_MB;
+  return budget_mb * 1024ULL * 1024ULL;
+}
 
-#ifdef _WIN32
-  PlaySoundA(path, NULL, SND_FILENAME | SND_ASYNC);
-#else
+void init_audio(Soundboard* sb) {
+#ifndef _WIN32
+  // Find the fallback player once rather than trying every binary on every click
+  sb->external_player = -1;
+  for (int i = 0; i < EXTERNAL_PLAYER_COUNT && sb->external_player < 0; i++) {
+    if (program_on_path(external_players[i]))
+      sb->external_player = i;
+  }
+#endif
+
+  const char* backend = getenv("SOUNDBOARD_AUDIO");
+  if (backend && strcmp(backend, "external") == 0)
+    return;
+
+  sb->audio = audio_engine_create(backend);
+  if (sb->audio) {
+    sb->pcm_cache = pcm_cache_create(pcm_cache_budget());
+    sb->streams = stream_decoder_create();
+    printf("Audio engine started (%s)\n", audio_engine_backend_name(sb->audio));
+  } else {
+    fprintf(stderr, "No audio device available, falling back to external players\n");
+  }
+}
+
+int init_offline_audio(Soundboard* sb, const char* wav_path) {
+  size_t size = strlen(wav_path) + sizeof("bounce:");
+  char* backend = (char*)malloc(size);
+  if (!backend)
+    return 0;
+  snprintf(backend, size, "bounce:%s", wav_path);
+  sb->headless = 1;
+#ifndef _WIN32
+  sb->external_player = -1;
+#endif
+
+  // No stream decoder: how far a background decode gets per period depends on the machine
+  sb->audio = audio_engine_create_offline(backend);
+  free(backend);
+  if (!sb->audio)
+    return 0;
+  sb->pcm_cache = pcm_cache_create(pcm_cache_budget());
+  return 1;
+}
+
+#ifndef _WIN32
+static void stop_external_player(Soundboard* sb) {
   if (sb->player_pid > 0) {
     int status = 0;
     pid_t wait_result = waitpid(sb->player_pid, &status, WNOHANG);
@@ -215,11 +776,132 @@ void play_sound(const char* path, Soundboard* sb, int tile_index) {
     }
     sb->player_pid = 0;
   }
+}
+#endif
+
+void init_analysis(Soundboard* sb) {
+  sb->workers = worker_pool_create(0);
+  if (!sb->workers) {
+    fprintf(stderr, "Failed to start analysis threads; no waveforms or normalization\n");
+    return;
+  }
+  if (!sb->headless)
+    sb->waveforms = waveform_cache_create(WAVEFORM_CACHE_FILE, sb->workers);
+
+  // Normalization gains and start offsets only matter to sounds the engine plays. With
+  // normalization off, sounds are still measured for their leading silence
+  const char* target = getenv("SOUNDBOARD_LOUDNESS_TARGET");
+  if (sb->audio) {
+    float target_lufs = !target                    ? LOUDNESS_DEFAULT_TARGET_LUFS
+                        : strcmp(target, "off") == 0 ? NAN
+                                                     : strtof(target, NULL);
+    sb->loudness = loudness_cache_create(LOUDNESS_CACHE_FILE, sb->workers, target_lufs);
+  }
+}
+
+void shutdown_analysis(Soundboard* sb) {
+  // Stop the workers first; their queued jobs point into the caches
+  worker_pool_destroy(sb->workers);
+  sb->workers = NULL;
+
+  if (sb->loudness) {
+    LoudnessCacheStats stats;
+    loudness_cache_get_stats(sb->loudness, &stats);
+    printf(
+        "Loudness: %" PRIu64 " analyzed in %.1f s of worker time, %" PRIu64
+        " reused from cache, %" PRIu64 " undecodable, %u left unanalyzed\n",
+        stats.analyzed,
+        (double)stats.analysis_ns / 1e9,
+        stats.reused,
+        stats.failed,
+        stats.pending);
+    loudness_cache_destroy(sb->loudness);
+    sb->loudness = NULL;
+  }
 
-  struct {
-    const char* cmd;
-    char* const* argv;
-  } backends[5];
+  if (sb->waveforms) {
+    WaveformCacheStats stats;
+    waveform_cache_get_stats(sb->waveforms, &stats);
+    printf(
+        "Waveforms: %" PRIu64 " built in %.1f s of worker time, %" PRIu64
+        " reused from cache, %" PRIu64 " undecodable, %u left unbuilt, %" PRIu64 " KB\n",
+        stats.built,
+        (double)stats.build_ns / 1e9,
+        stats.reused,
+        stats.failed,
+        stats.pending,
+        stats.bytes / 1024);
+    waveform_cache_destroy(sb->waveforms);
+    sb->waveforms = NULL;
+  }
+}
+
+// Stop the engine and drop what only it uses. Sounds play through the external player after this
+static void close_audio_engine(Soundboard* sb) {
+  if (sb->audio) {
+    AudioEngineStats stats;
+    audio_engine_get_stats(sb->audio, &stats);
+    printf(
+        "Audio thread: %" PRIu64 " periods, %" PRIu64 " underruns, %" PRIu64 " overruns, %" PRIu64
+        " late callbacks, %" PRIu64 " stream starvations, worst callback %.1f us\n",
+        stats.periods,
+        stats.underruns,
+        stats.overruns,
+        stats.late_callbacks,
+        stats.stream_starvations,
+        (double)stats.worst_callback_ns / 1000.0);
+  }
+  audio_engine_destroy(sb->audio);
+  sb->audio = NULL;
+  stream_decoder_destroy(sb->streams);
+  sb->streams = NULL;
+
+  if (sb->pcm_cache) {
+    PcmCacheStats stats;
+    pcm_cache_get_stats(sb->pcm_cache, &stats);
+    printf(
+        "PCM cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions, %" PRIu64
+        " invalidations, %" PRIu64 " KB decoded + %" PRIu64 " KB mapped in %u sounds\n",
+        stats.hits,
+        stats.misses,
+        stats.evictions,
+        stats.invalidations,
+        stats.bytes_used / 1024,
+        stats.mapped_bytes / 1024,
+        stats.entries);
+    pcm_cache_destroy(sb->pcm_cache);
+    sb->pcm_cache = NULL;
+  }
+}
+
+// Fall back to the external player once the engine has given up on its device
+static void check_audio_engine(Soundboard* sb) {
+  if (!sb->audio || !audio_engine_failed(sb->audio))
+    return;
+  fprintf(stderr, "Audio engine stopped, falling back to external players\n");
+  close_audio_engine(sb);
+}
+
+void shutdown_audio(Soundboard* sb) {
+  close_audio_engine(sb);
+#ifndef _WIN32
+  stop_external_player(sb);
+#endif
+}
+
+#ifndef _WIN32
+const char* external_player_name(int index) {
+  return index >= 0 && index < EXTERNAL_PLAYER_COUNT ? external_players[index] : NULL;
+}
+#endif
+
+// Legacy path: hand the file to whichever player binary can be started
+static void play_sound_external(const char* path, Soundboard* sb) {
+#ifdef _WIN32
+  (void)sb;
+  PlaySoundA(path, NULL, SND_FILENAME | SND_ASYNC);
+#else
+  stop_external_player(sb);
 
   char* const paplay_argv[] = {"paplay", (char*)path, NULL};
   char* const mpv_argv[] = {"mpv", "--no-video", "--really-quiet", (char*)path, NULL};
@@ -227,109 +909,323 @@ void play_sound(const char* path, Soundboard* sb, int tile_index) {
   char* const aplay_argv[] = {"aplay", "-q", (char*)path, NULL};
   char* const ffplay_argv[] = {
       "ffplay", "-nodisp", "-autoexit", "-loglevel", "quiet", (char*)path, NULL};
+  char* const* player_argv[EXTERNAL_PLAYER_COUNT] = {
+      paplay_argv, mpv_argv, pw_play_argv, aplay_argv, ffplay_argv};
 
-  backends[0].cmd = "paplay";
-  backends[0].argv = paplay_argv;
-  backends[1].cmd = "mpv";
-  backends[1].argv = mpv_argv;
-  backends[2].cmd = "pw-play";
-  backends[2].argv = pw_play_argv;
-  backends[3].cmd = "aplay";
-  backends[3].argv = aplay_argv;
-  backends[4].cmd = "ffplay";
-  backends[4].argv = ffplay_argv;
-
-  int launched = 0;
-  for (int i = 0; i < 5; i++) {
-    pid_t pid = 0;
-    int spawn_result = posix_spawnp(&pid, backends[i].cmd, NULL, NULL, backends[i].argv, environ);
-    if (spawn_result == 0) {
-      sb->player_pid = pid;
-      launched = 1;
-      break;
-    }
+  if (sb->external_player < 0) {
+    fprintf(stderr, "No audio player found (looked for paplay, mpv, pw-play, aplay, ffplay)\n");
+    return;
   }
 
-  if (!launched) {
-    fprintf(stderr, "Failed to start audio player (tried paplay, mpv, pw-play, aplay, ffplay)\n");
-  }
+  pid_t pid = spawn_program(player_argv[sb->external_player], NULL);
+  if (pid > 0)
+    sb->player_pid = pid;
+  else
+    fprintf(stderr, "Failed to start audio player %s\n", external_players[sb->external_player]);
 #endif
 }
 
-uint32_t get_sound_duration(const char* path) {
-  FILE* f = fopen(path, "rb");
-  if (!f)
-    return 0;
+void set_search(Soundboard* sb, const char* query) {
+  snprintf(sb->search_query, sizeof(sb->search_query), "%s", query);
+  filter_tiles(sb);
+  sb->scroll_offset = 0.0f;
+  sb->hovered_tile = -1;  // Whatever is under the cursor now shows up when it next moves
+}
 
-  unsigned char header[12];
-  if (fread(header, 1, sizeof(header), f) != sizeof(header)) {
-    fclose(f);
-    return 0;
+int shown_tile(const Soundboard* sb, int position) {
+  if (position < 0 || position >= sb->shown_count)
+    return -1;
+  return sb->filtered ? (int)sb->shown[position] : position;
+}
+
+// The grid is laid out as main.c draws it: tile (row, col) has its bottom-left corner at
+// x = 50 + col * (TILE_WIDTH + TILE_SPACING),
+// y = window_height - (row * (TILE_HEIGHT + TILE_SPACING) + 50) - scroll_offset
+int tile_at(const Soundboard* sb, double x, double y) {
+  if (sb->grid_cols <= 0)
+    return -1;
+  double col = floor((x - 50.0) / (TILE_WIDTH + TILE_SPACING));
+  double row = ceil(
+      (sb->window_height - 50.0 - sb->scroll_offset - y) / (TILE_HEIGHT + TILE_SPACING));
+  if (col < 0.0 || col >= sb->grid_cols || row < 0.0 || row > (double)sb->shown_count)
+    return -1;
+
+  int i = (int)row * sb->grid_cols + (int)col;
+  float tile_x = 50.0f + (int)col * (TILE_WIDTH + TILE_SPACING);
+  float tile_y =
+      sb->window_height - ((int)row * (TILE_HEIGHT + TILE_SPACING) + 50.0f) - sb->scroll_offset;
+  if (x <= tile_x + TILE_WIDTH && y >= tile_y && y <= tile_y + TILE_HEIGHT)
+    return shown_tile(sb, i);
+  return -1;
+}
+
+void visible_tiles(const Soundboard* sb, int* first, int* end) {
+  *first = 0;
+  *end = 0;
+  if (sb->grid_cols <= 0 || sb->shown_count == 0)
+    return;
+  float pitch = TILE_HEIGHT + TILE_SPACING;
+  float top = floorf((-50.0f - sb->scroll_offset) / pitch);
+  float bottom = floorf((sb->window_height - 50.0f - sb->scroll_offset + TILE_HEIGHT) / pitch);
+  int rows = (sb->shown_count + sb->grid_cols - 1) / sb->grid_cols;
+  int first_row = top < 0.0f ? 0 : top > (float)rows ? rows : (int)top;
+  int end_row = bottom < 0.0f ? 0 : bottom >= (float)rows ? rows : (int)bottom + 1;
+  if (end_row <= first_row)
+    return;
+  *first = first_row * sb->grid_cols;
+  *end = end_row * sb->grid_cols < sb->shown_count ? end_row * sb->grid_cols : sb->shown_count;
+}
+
+static int find_path(const Soundboard* sb, const char* path) {
+  int low = 0;
+  int high = sb->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    int order = path_trie_compare(sb->paths, sb->sounds[mid].dir, sb->sounds[mid].leaf, path);
+    if (order == 0)
+      return mid;
+    if (order < 0)
+      low = mid + 1;
+    else
+      high = mid;
   }
+  return -1;
+}
+
+int find_tile(const Soundboard* sb, const char* name) {
+  int tile = find_path(sb, name);
+  if (tile >= 0 || strncmp(name, "./", 2) == 0)
+    return tile;
 
-  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
-    fclose(f);
+  size_t length = strlen(name);
+  char* path = (char*)malloc(length + 3);
+  if (!path)
+    return -1;
+  memcpy(path, "./", 2);
+  memcpy(path + 2, name, length + 1);
+  tile = find_path(sb, path);
+  free(path);
+  return tile;
+}
+
+int find_directory_tiles(const Soundboard* sb, const char* dir, int* first, int* end) {
+  *first = 0;
+  *end = 0;
+  if (!sb->paths)
     return 0;
+  size_t length = strlen(dir);
+  uint32_t node = path_trie_find(sb->paths, PATH_TRIE_ROOT, dir, length);
+  if (node == PATH_TRIE_NONE && strncmp(dir, "./", 2) != 0) {
+    uint32_t current = path_trie_find(sb->paths, PATH_TRIE_ROOT, ".", 1);
+    if (current != PATH_TRIE_NONE)
+      node = path_trie_find(sb->paths, current, dir, length);
   }
+  if (node == PATH_TRIE_NONE)
+    return 0;
+  uint32_t begin, stop;
+  path_trie_items(sb->paths, node, &begin, &stop);
+  *first = (int)begin;
+  *end = (int)stop;
+  return stop > begin;
+}
 
-  uint32_t byte_rate = 0;
-  uint32_t data_size = 0;
-
-  while (!feof(f)) {
-    unsigned char chunk_header[8];
-    if (fread(chunk_header, 1, sizeof(chunk_header), f) != sizeof(chunk_header))
-      break;
+const char* sound_path(Soundboard* sb, int tile_index) {
+  if (tile_index < 0 || tile_index >= sb->count)
+    return "";
+  const Sound* sound = &sb->sounds[tile_index];
+  size_t length =
+      path_trie_format(sb->paths, sound->dir, sound->leaf, sb->path_buffer, sb->path_capacity);
+  if (length >= sb->path_capacity) {
+    size_t capacity = length + 1 > 256 ? length + 1 : 256;
+    char* grown = (char*)realloc(sb->path_buffer, capacity);
+    if (!grown)
+      return "";
+    sb->path_buffer = grown;
+    sb->path_capacity = capacity;
+    path_trie_format(sb->paths, sound->dir, sound->leaf, sb->path_buffer, sb->path_capacity);
+  }
+  return sb->path_buffer;
+}
 
-    uint32_t chunk_size = read_u32_le(chunk_header + 4);
+const char* audio_path(Soundboard* sb, int tile_index) {
+  if (tile_index < 0 || tile_index >= sb->count)
+    return "";
+  return sound_path(sb, sb->sounds[tile_index].audio_tile);
+}
 
-    if (memcmp(chunk_header, "fmt ", 4) == 0) {
-      if (chunk_size < 16) {
-        fclose(f);
+int read_line(FILE* file, char** line, size_t* capacity) {
+  size_t length = 0;
+  for (;;) {
+    if (*capacity - length < 2) {
+      size_t grown_capacity = *capacity ? *capacity * 2 : 256;
+      char* grown = (char*)realloc(*line, grown_capacity);
+      if (!grown)
         return 0;
-      }
+      *line = grown;
+      *capacity = grown_capacity;
+    }
+    if (!fgets(*line + length, (int)(*capacity - length), file))
+      return length > 0;
+    length += strlen(*line + length);
+    if (length > 0 && (*line)[length - 1] == '\n') {
+      (*line)[length - 1] = '\0';
+      return 1;
+    }
+  }
+}
 
-      unsigned char fmt_data[16];
-      if (fread(fmt_data, 1, sizeof(fmt_data), f) != sizeof(fmt_data)) {
-        fclose(f);
-        return 0;
-      }
+// Point a tile at the newest of the slots still playing for it
+static void retarget_tile(Soundboard* sb, int tile_index) {
+  if (tile_index < 0 || tile_index >= sb->count)
+    return;
+  int latest = -1;
+  for (int i = 0; i < MAX_PLAYING; i++) {
+    if (sb->playing[i].tile == tile_index &&
+        (latest < 0 || sb->playing[i].sequence > sb->playing[latest].sequence))
+      latest = i;
+  }
+  sb->tiles[tile_index].slot = latest;
+}
 
-      byte_rate = read_u32_le(fmt_data + 8);
+void play_sound(const char* path, Soundboard* sb, int tile_index) {
+  check_audio_engine(sb);
+  float gain = loudness_cache_gain(sb->loudness, path);
+  uint32_t start = loudness_cache_onset(sb->loudness, path);
+  if (tile_index >= 0 && tile_index < sb->count && sb->sounds[tile_index].start_ms >= 0)
+    start = (uint32_t)((uint64_t)sb->sounds[tile_index].start_ms * AUDIO_SAMPLE_RATE / 1000);
 
-      if (chunk_size > 16) {
-        long extra = (long)(chunk_size - 16);
-        if (fseek(f, extra, SEEK_CUR) != 0) {
-          fclose(f);
-          return 0;
-        }
-      }
-    } else if (memcmp(chunk_header, "data", 4) == 0) {
-      data_size = chunk_size;
-      if (fseek(f, (long)chunk_size, SEEK_CUR) != 0) {
-        fclose(f);
-        return 0;
-      }
+  // A big file that isn't cached and can't be mapped is decoded on the fly by the stream
+  // decoder, so no click waits for a whole file to decode
+  int slot = -1;
+  uint64_t decode_limit = sb->streams ? STREAM_MIN_FILE_BYTES : 0;
+  PcmBuffer* buffer = sb->pcm_cache ? pcm_cache_acquire(sb->pcm_cache, path, decode_limit) : NULL;
+  if (buffer) {
+    slot = audio_engine_play(sb->audio, buffer, start, gain);
+    if (slot < 0)
+      pcm_buffer_release(buffer);
+  } else if (sb->streams) {
+    Stream* stream = stream_open(sb->streams, path, start);
+    if (stream) {
+      slot = audio_engine_play_stream(sb->audio, stream, start, gain);
+      if (slot < 0)
+        stream_release(stream);
+    }
+  }
+
+  PlayingSound* playing;
+  if (slot >= 0) {
+    playing = &sb->playing[slot];
+  } else if (sb->headless) {
+    fprintf(stderr, "Failed to play %s\n", path);
+    return;
+  } else {
+    // The external player only ever plays one sound; starting it stops the previous one.
+    // Nothing reports its position, so its progress is estimated from the clock
+    playing = &sb->playing[EXTERNAL_PLAYER_SLOT];
+    playing->start_time_ms = get_time_ms();
+    playing->duration_ms = tile_index >= 0 && tile_index < sb->count
+                               ? sb->sounds[tile_index].duration_ms
+                               : 0;
+    if (playing->duration_ms == 0)
+      playing->duration_ms = get_sound_duration(path);
+    play_sound_external(path, sb);
+  }
+
+  // A reused slot (a stolen voice, or the external player) no longer plays for its old tile
+  int replaced = playing->tile;
+  playing->tile = tile_index;
+  playing->sequence = ++sb->play_sequence;
+  playing->progress = 0.0f;
+  if (replaced != tile_index)
+    retarget_tile(sb, replaced);
+  retarget_tile(sb, tile_index);
+}
+
+void stop_tile(Soundboard* sb, int tile_index) {
+  for (int i = 0; i < MAX_PLAYING; i++) {
+    if (sb->playing[i].tile != tile_index)
+      continue;
+    if (i == EXTERNAL_PLAYER_SLOT) {
+#ifdef _WIN32
+      PlaySoundA(NULL, NULL, 0);
+#else
+      stop_external_player(sb);
+#endif
+    } else if (sb->audio) {
+      audio_engine_stop(sb->audio, i);
+    }
+    sb->playing[i].tile = -1;
+  }
+  if (tile_index >= 0 && tile_index < sb->count)
+    sb->tiles[tile_index].slot = -1;
+}
+
+// Clock-based progress of the spawned player. Returns -1 once it is done
+static float external_player_progress(Soundboard* sb) {
+  PlayingSound* playing = &sb->playing[EXTERNAL_PLAYER_SLOT];
+#ifndef _WIN32
+  // A player that exited early, or was killed, is noticed here rather than when its time is up
+  if (sb->player_pid <= 0 || waitpid(sb->player_pid, NULL, WNOHANG) != 0) {
+    sb->player_pid = 0;
+    return -1.0f;
+  }
+#endif
+  if (playing->duration_ms == 0) {
+#ifdef _WIN32
+    return -1.0f;  // Nothing tells us when PlaySound finishes a sound of unknown length
+#else
+    return 0.0f;
+#endif
+  }
+  uint32_t elapsed = get_time_ms() - playing->start_time_ms;
+  if (elapsed >= playing->duration_ms)
+    return -1.0f;
+  return (float)elapsed / (float)playing->duration_ms;
+}
+
+void update_playback(Soundboard* sb) {
+  check_audio_engine(sb);
+  if (sb->audio)
+    audio_engine_update(sb->audio);
+
+  for (int i = 0; i < MAX_PLAYING; i++) {
+    PlayingSound* playing = &sb->playing[i];
+    if (playing->tile < 0)
+      continue;
+
+    if (i == EXTERNAL_PLAYER_SLOT) {
+      playing->progress = external_player_progress(sb);
     } else {
-      if (fseek(f, (long)chunk_size, SEEK_CUR) != 0) {
-        fclose(f);
-        return 0;
-      }
+      uint32_t position = 0;
+      uint32_t length = 0;
+      if (!sb->audio || !audio_engine_voice_position(sb->audio, i, &position, &length))
+        playing->progress = -1.0f;
+      else
+        playing->progress = length > 0 ? (float)position / (float)length : 0.0f;
     }
 
-    if (chunk_size & 1) {
-      if (fseek(f, 1, SEEK_CUR) != 0) {
-        fclose(f);
-        return 0;
-      }
+    if (playing->progress < 0.0f) {
+      int tile = playing->tile;
+      playing->tile = -1;
+      retarget_tile(sb, tile);
     }
   }
+}
 
-  fclose(f);
+float get_tile_progress(const Soundboard* sb, int tile_index) {
+  if (tile_index < 0 || tile_index >= sb->count || sb->tiles[tile_index].slot < 0)
+    return -1.0f;
+  return sb->playing[sb->tiles[tile_index].slot].progress;
+}
 
-  if (byte_rate == 0 || data_size == 0)
+uint32_t get_sound_duration(const char* path) {
+  Decoder* decoder = decoder_open(path);
+  if (!decoder)
     return 0;
 
-  return (uint32_t)(((uint64_t)data_size * 1000ULL) / (uint64_t)byte_rate);
+  uint32_t frames = decoder_frame_count(decoder);
+  decoder_close(decoder);
+  return (uint32_t)((uint64_t)frames * 1000ULL / AUDIO_SAMPLE_RATE);
 }
 
 uint32_t get_time_ms(void) {
@@ -2,6 +2,18 @@
 #define SOUNDBOARD_H
 
 #include <stdint.h>
+#include <stdio.h>
+
+#include "audio.h"
+#include "library_config.h"
+#include "library_index.h"
+#include "loudness_cache.h"
+#include "path_trie.h"
+#include "pcm_cache.h"
+#include "search_index.h"
+#include "thread.h"
+#include "waveform_cache.h"
+#include "worker_pool.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -10,48 +22,123 @@
 #include <sys/types.h>
 #endif
 
-#define MAX_SOUNDS 100
 #define TILE_WIDTH 150.0f
 #define TILE_HEIGHT 60.0f
 #define TILE_SPACING 10.0f
+#define TILE_WAVEFORM_COLUMNS 140  // One bar per pixel, inside a 5 px margin
 #define REFRESH_BUTTON_WIDTH 80.0f
 #define REFRESH_BUTTON_HEIGHT 30.0f
-#define MAX_PATH 260
+#define MAX_PLAYING (AUDIO_MAX_VOICES + 1)
+#define START_OVERRIDES_FILE "soundboard-offsets.txt"  // "<ms> <sound>" lines; see load_sounds
+#define EXTERNAL_PLAYER_SLOT AUDIO_MAX_VOICES  // Slot tracking the spawned-player fallback
+#define SEARCH_QUERY_MAX 128
 
+// What a frame needs of a tile, kept apart from the sound's strings so that drawing and hit
+// tests walk a dense array
 typedef struct {
-  char name[MAX_PATH];
-  char path[MAX_PATH];
+  int slot;  // Playing slot of the newest sound started on the tile, -1 if idle
   float marquee_offset;  // For scrolling text
+} Tile;
+
+// The sound behind a tile, at the same index. Its path is its directory in the tiles' trie plus
+// a leaf name; sound_path() puts them back together
+typedef struct {
+  uint32_t dir;
+  const char* leaf;  // In the trie's arena
+  int audio_tile;  // First tile with the same audio (a link to the file, or a copy), else its own
+  int32_t start_ms;  // Where playback starts, from the overrides file; -1 skips leading silence
+  uint32_t duration_ms;  // From the library index, 0 if unknown
 } Sound;
 
 typedef struct {
-  Sound sounds[MAX_SOUNDS];
+  int tile;  // Index of the playing tile (-1 if the slot is free)
+  uint32_t sequence;  // Order the slots were started in; the newest one drives the tile
+  float progress;  // 0..1 of what has been heard so far, refreshed by update_playback()
+  uint32_t start_time_ms;  // External player only: when it was started
+  uint32_t duration_ms;  // External player only: how long the sound is
+} PlayingSound;
+
+typedef struct {
+  Tile* tiles;  // count of each, in path order, reallocated as the library changes
+  Sound* sounds;
   int count;
+  PathTrie* paths;  // Directories of the sounds; item i of a directory is tile i
+  char* path_buffer;  // Holds what sound_path() returned last
+  size_t path_capacity;
+
+  // Search field. The grid shows shown_count tiles: those in shown while a query filters it,
+  // every tile otherwise
+  SearchIndex* search;  // Item i is the path of tile i; NULL until the first reconcile is done
+  char search_query[SEARCH_QUERY_MAX];
+  uint32_t* shown;
+  uint32_t shown_capacity;
+  int shown_count;
+  int filtered;  // shown holds the matches of search_query
   int grid_cols;
   float window_width;
   float window_height;
   float scroll_offset;
   int hovered_tile;  // Index of currently hovered tile (-1 if none)
   int hovered_refresh_button;  // 1 if hovered, 0 otherwise
-  int playing_tile;  // Index of currently playing tile (-1 if none)
-  uint32_t play_start_time_ms;  // Time when playback started
-  uint32_t sound_duration_ms;  // Duration of currently playing sound in ms
+  PlayingSound playing[MAX_PLAYING];  // One slot per engine voice, plus the external player
+  uint32_t play_sequence;
+
+  // In-process playback engine (NULL when no device could be opened)
+  AudioEngine* audio;
+  PcmCache* pcm_cache;  // Decoded sounds, revalidated whenever the watcher signals a refresh
+  StreamDecoder* streams;  // Background decoding of long compressed sounds
+  int headless;  // Offline render: no streaming, no waveforms, no external player
+
+  // Library snapshot the grid was filled from, and the background reconcile replacing it
+  LibraryConfig library_config;  // Roots to scan and watch; read by the first load if still empty
+  LibraryIndex* library;
+  Thread library_thread;
+  int library_reconciling;  // library_thread was started and hasn't been joined yet
+  int library_done;  // Set by library_thread, with library_update, when it finishes
+  int library_cancel;
+  LibraryIndex* library_update;  // The reconciled snapshot, or NULL if the reconcile failed
+  SearchIndex* search_update;  // Its paths, indexed by library_thread as well
+  ChangeSet* library_changes;  // What the running reconcile looks at again; NULL rescans all
 
-  // Filesystem watcher
-  volatile int needs_refresh;
+  // Background analysis of every sound in the library
+  WorkerPool* workers;  // One thread per CPU
+  LoudnessCache* loudness;  // Normalization gains and start offsets (NULL without the engine)
+  WaveformCache* waveforms;  // Peak pyramids drawn in the tiles
+
+  // Filesystem watcher. The flags are shared between threads and only touched with atomics
+  int needs_refresh;  // Anything may have changed: rescan the whole tree
+  ChangeSet* pending_changes;  // Paths the watcher saw change, handed over by exchanging it
 #ifdef _WIN32
   HANDLE watcher_thread;
   HANDLE watcher_stop_event;
 #else
   pthread_t watcher_thread;
-  volatile int watcher_stop;
+  int watcher_stop;
   pid_t player_pid;
+  int external_player;  // Fallback player found on PATH at startup, -1 if none
 #endif
 } Soundboard;
 
-// Load sound files from current directory
+// Scan the library's roots for sounds (the current directory, unless LIBRARY_CONFIG_FILE or the
+// command line says otherwise), save the result to LIBRARY_INDEX_FILE and apply what was added,
+// removed or changed to the grid, queueing those sounds for analysis. Sounds start past their
+// leading silence unless START_OVERRIDES_FILE gives them a start time: one
+// "<milliseconds> <sound or folder>" line each, where 0 plays a sound from the top
 void load_sounds(Soundboard* sb);
 
+// Show the library as LIBRARY_INDEX_FILE last saw it, without walking the tree, and reconcile it
+// with the disk in the background. Without a usable index this is load_sounds()
+void open_library(Soundboard* sb);
+
+// Take over a finished background reconcile and start a new one when the watcher has flagged a
+// change. Only the tiles of added, removed or changed files are touched: the rest keep their
+// playback progress, hover and marquee, and move only to stay in path order. Call once per frame
+void refresh_library(Soundboard* sb);
+
+// Stop any reconcile and free the library, its config and the tiles. Stop the watcher first, and
+// call before shutdown_analysis()
+void close_library(Soundboard* sb);
+
 // Filesystem watcher thread function
 #ifdef _WIN32
 DWORD WINAPI file_watcher_thread(LPVOID lpParam);
@@ -59,10 +146,78 @@ DWORD WINAPI file_watcher_thread(LPVOID lpParam);
 void* file_watcher_thread(void* lpParam);
 #endif
 
+// Start the in-process audio engine on the backend named by SOUNDBOARD_AUDIO.
+// "external" keeps the legacy spawn-a-player path only. SOUNDBOARD_CACHE_MB sizes the PCM cache.
+// Also probes PATH once for the player the legacy path uses
+void init_audio(Soundboard* sb);
+
+// Start an offline engine that bounces everything played to wav_path instead of a device, for
+// rendering trigger scripts. Sounds are always decoded whole so the output is reproducible.
+// Returns 0 if the file can't be opened
+int init_offline_audio(Soundboard* sb, const char* wav_path);
+
+// Start the analysis workers and load the waveform and loudness caches. Call after init_audio()
+// and before load_sounds(). SOUNDBOARD_LOUDNESS_TARGET sets the normalization target in LUFS
+// ("off" disables it); there is no normalization or silence trimming without the engine
+void init_analysis(Soundboard* sb);
+
+// Stop the analysis workers and save what they measured
+void shutdown_analysis(Soundboard* sb);
+
+// Stop the audio engine and any external player
+void shutdown_audio(Soundboard* sb);
+
+#ifndef _WIN32
+// Name of the index-th player the legacy fallback looks for, in order of preference (the index
+// external_player holds), or NULL past the last one
+const char* external_player_name(int index);
+#endif
+
+// Show only the tiles whose path contains every space-separated word of query, ignoring case,
+// and scroll back to the top. "" shows them all again
+void set_search(Soundboard* sb, const char* query);
+
+// Tile at a position of the grid (row * grid_cols + col), or -1 past the last one shown
+int shown_tile(const Soundboard* sb, int position);
+
+// Index of the tile under a point in window coordinates (origin bottom-left), or -1
+int tile_at(const Soundboard* sb, double x, double y);
+
+// Range of grid positions [*first, *end) in the rows that are at least partly inside the window
+void visible_tiles(const Soundboard* sb, int* first, int* end);
+
+// Tile of a sound named as in a script or overrides file ("./dir/file.wav", "./" optional), or -1
+int find_tile(const Soundboard* sb, const char* name);
+
+// Tiles [*first, *end) of every sound under a directory ("./drums", "./" optional), found without
+// looking at the others. Returns 0 if no sound is under it
+int find_directory_tiles(const Soundboard* sb, const char* dir, int* first, int* end);
+
+// Path of a tile's sound, valid until the next call, or "" if there is no such tile
+const char* sound_path(Soundboard* sb, int tile_index);
+
+// Path a tile is played and analyzed from, like sound_path(): that of its audio_tile, so that
+// every copy of a sound shares one decoded buffer, waveform and loudness measurement
+const char* audio_path(Soundboard* sb, int tile_index);
+
+// Read a line of any length, without its line break, into *line (grown as needed; free it when
+// done). Returns 0 at end of file or when out of memory
+int read_line(FILE* file, char** line, size_t* capacity);
+
 // Play a sound file and track playback
 void play_sound(const char* path, Soundboard* sb, int tile_index);
 
-// Get the duration of a WAV file in milliseconds
+// Stop every sound playing on a tile
+void stop_tile(Soundboard* sb, int tile_index);
+
+// Read every voice's position from the audio clock, free slots whose sound has finished or was
+// stopped, and keep mapped sounds reading ahead. Call once per frame
+void update_playback(Soundboard* sb);
+
+// Get playback progress (0..1) of the most recent sound started on a tile, or -1 if idle
+float get_tile_progress(const Soundboard* sb, int tile_index);
+
+// Get the duration of a sound file in milliseconds, as reported by its decoder
 uint32_t get_sound_duration(const char* path);
 
 // Get current monotonic time in milliseconds
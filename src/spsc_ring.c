@@ -0,0 +1,99 @@
+#include "spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_ring_init(SpscRing* ring, uint32_t item_size, uint32_t capacity) {
+  memset(ring, 0, sizeof(*ring));
+
+  uint32_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  ring->slots = (unsigned char*)malloc((size_t)size * item_size);
+  if (!ring->slots)
+    return 0;
+  ring->item_size = item_size;
+  ring->mask = size - 1;
+  return 1;
+}
+
+void spsc_ring_destroy(SpscRing* ring) {
+  free(ring->slots);
+  ring->slots = NULL;
+}
+
+int spsc_ring_push(SpscRing* ring, const void* item) {
+  uint32_t write = ring->write_index;
+  uint32_t read = __atomic_load_n(&ring->read_index, __ATOMIC_ACQUIRE);
+  if (write - read > ring->mask)
+    return 0;
+
+  memcpy(ring->slots + (size_t)(write & ring->mask) * ring->item_size, item, ring->item_size);
+  __atomic_store_n(&ring->write_index, write + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int spsc_ring_pop(SpscRing* ring, void* item) {
+  uint32_t read = ring->read_index;
+  uint32_t write = __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE);
+  if (read == write)
+    return 0;
+
+  memcpy(item, ring->slots + (size_t)(read & ring->mask) * ring->item_size, ring->item_size);
+  __atomic_store_n(&ring->read_index, read + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+// Copy count items between a linear buffer and the ring starting at index, wrapping at the end
+static void copy_wrapped(SpscRing* ring, uint32_t index, void* items, uint32_t count, int to_ring) {
+  uint32_t start = index & ring->mask;
+  uint32_t first = ring->mask + 1 - start;
+  if (first > count)
+    first = count;
+
+  unsigned char* linear = (unsigned char*)items;
+  size_t first_bytes = (size_t)first * ring->item_size;
+  size_t rest_bytes = (size_t)(count - first) * ring->item_size;
+  unsigned char* slot = ring->slots + (size_t)start * ring->item_size;
+  if (to_ring) {
+    memcpy(slot, linear, first_bytes);
+    memcpy(ring->slots, linear + first_bytes, rest_bytes);
+  } else {
+    memcpy(linear, slot, first_bytes);
+    memcpy(linear + first_bytes, ring->slots, rest_bytes);
+  }
+}
+
+uint32_t spsc_ring_write(SpscRing* ring, const void* items, uint32_t count) {
+  uint32_t write = ring->write_index;
+  uint32_t read = __atomic_load_n(&ring->read_index, __ATOMIC_ACQUIRE);
+  uint32_t space = ring->mask + 1 - (write - read);
+  if (count > space)
+    count = space;
+
+  copy_wrapped(ring, write, (void*)items, count, 1);
+  __atomic_store_n(&ring->write_index, write + count, __ATOMIC_RELEASE);
+  return count;
+}
+
+uint32_t spsc_ring_read(SpscRing* ring, void* items, uint32_t count) {
+  uint32_t read = ring->read_index;
+  uint32_t write = __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE);
+  if (count > write - read)
+    count = write - read;
+
+  copy_wrapped(ring, read, items, count, 0);
+  __atomic_store_n(&ring->read_index, read + count, __ATOMIC_RELEASE);
+  return count;
+}
+
+uint32_t spsc_ring_count(const SpscRing* ring) {
+  uint32_t write = __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE);
+  uint32_t read = __atomic_load_n(&ring->read_index, __ATOMIC_ACQUIRE);
+  return write - read;
+}
+
+uint32_t spsc_ring_capacity(const SpscRing* ring) {
+  return ring->mask + 1;
+}
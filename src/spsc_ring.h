@@ -0,0 +1,45 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+
+#define SPSC_CACHE_LINE 64
+
+// Wait-free single-producer / single-consumer queue of fixed-size items. One thread may push
+// and one other thread may pop concurrently; neither ever blocks, allocates or makes a syscall
+typedef struct {
+  unsigned char* slots;
+  uint32_t item_size;
+  uint32_t mask;  // Capacity - 1; capacity is a power of two
+  char pad0[SPSC_CACHE_LINE];
+  uint32_t write_index;  // Advanced only by the producer
+  char pad1[SPSC_CACHE_LINE];
+  uint32_t read_index;  // Advanced only by the consumer
+  char pad2[SPSC_CACHE_LINE];
+} SpscRing;
+
+// Allocate room for at least capacity items of item_size bytes. Returns 1 on success, 0 otherwise
+int spsc_ring_init(SpscRing* ring, uint32_t item_size, uint32_t capacity);
+
+// Free the slots. Neither side may be using the ring any more
+void spsc_ring_destroy(SpscRing* ring);
+
+// Copy an item in. Returns 0 without blocking if the ring is full
+int spsc_ring_push(SpscRing* ring, const void* item);
+
+// Copy the oldest item out. Returns 0 if the ring is empty
+int spsc_ring_pop(SpscRing* ring, void* item);
+
+// Copy up to count items in at once. Returns how many fitted
+uint32_t spsc_ring_write(SpscRing* ring, const void* items, uint32_t count);
+
+// Copy up to count of the oldest items out at once. Returns how many were there
+uint32_t spsc_ring_read(SpscRing* ring, void* items, uint32_t count);
+
+// Items waiting to be popped. Exact for the consumer, a lower bound for the producer
+uint32_t spsc_ring_count(const SpscRing* ring);
+
+// Number of items the ring can hold
+uint32_t spsc_ring_capacity(const SpscRing* ring);
+
+#endif  // SPSC_RING_H
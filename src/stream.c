@@ -0,0 +1,205 @@
+#include "stream.h"
+
+#include <stdlib.h>
+
+#include "decoder.h"
+#include "pcm_buffer.h"
+#include "spsc_ring.h"
+#include "thread.h"
+
+// How often the decode thread tops streams up when nobody wakes it
+#define STREAM_POLL_NS 20000000ULL
+
+// Smallest top-up worth a decode call
+#define STREAM_MIN_REFILL_FRAMES 1024
+
+struct Stream {
+  Decoder* decoder;  // Only touched by whichever thread is filling the ring
+  SpscRing ring;  // Device-format frames: the decode thread produces, the audio thread consumes
+  uint32_t frame_count;
+  uint32_t skip;  // Lead-in the decode thread still has to drop, for sources that can't seek
+  int refcount;
+  int released;  // Set when the opener drops its reference
+  int at_end;  // Set once the decoder has written its last frame
+  Stream* next;  // Link in the decode thread's lists
+};
+
+struct StreamDecoder {
+  Thread thread;
+  Mutex lock;
+  CondVar wake;
+  int running;
+  Stream* incoming;  // Opened but not picked up yet; guarded by lock
+  Stream* streams;  // Owned by the decode thread
+};
+
+static void stream_free(Stream* stream) {
+  decoder_close(stream->decoder);
+  spsc_ring_destroy(&stream->ring);
+  free(stream);
+}
+
+static void stream_unref(Stream* stream) {
+  if (__atomic_sub_fetch(&stream->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+    stream_free(stream);
+}
+
+// Decode into the ring until it holds at least target frames or the file ends
+static void fill(Stream* stream, uint32_t target) {
+  int16_t chunk[DECODER_CHUNK_FRAMES * AUDIO_CHANNELS];
+  while (stream->skip > 0) {
+    uint32_t frames = stream->skip < DECODER_CHUNK_FRAMES ? stream->skip : DECODER_CHUNK_FRAMES;
+    frames = decoder_read(stream->decoder, chunk, frames);
+    stream->skip = frames > 0 ? stream->skip - frames : 0;
+  }
+
+  while (!__atomic_load_n(&stream->at_end, __ATOMIC_RELAXED)) {
+    uint32_t queued = spsc_ring_count(&stream->ring);
+    uint32_t space = spsc_ring_capacity(&stream->ring) - queued;
+    if (queued >= target || space < STREAM_MIN_REFILL_FRAMES)
+      break;
+
+    uint32_t frames = space < DECODER_CHUNK_FRAMES ? space : DECODER_CHUNK_FRAMES;
+    frames = decoder_read(stream->decoder, chunk, frames);
+    if (frames == 0) {
+      // Everything written so far is visible to the audio thread before it sees this flag
+      __atomic_store_n(&stream->at_end, 1, __ATOMIC_RELEASE);
+      break;
+    }
+    spsc_ring_write(&stream->ring, chunk, frames);
+  }
+}
+
+static void* decode_thread_main(void* arg) {
+  StreamDecoder* decoder = (StreamDecoder*)arg;
+
+  mutex_lock(&decoder->lock);
+  while (decoder->running) {
+    while (decoder->incoming) {
+      Stream* stream = decoder->incoming;
+      decoder->incoming = stream->next;
+      stream->next = decoder->streams;
+      decoder->streams = stream;
+    }
+    mutex_unlock(&decoder->lock);
+
+    // Drop streams nobody will read any more, and stop tracking those that are fully decoded
+    Stream** link = &decoder->streams;
+    while (*link) {
+      Stream* stream = *link;
+      if (__atomic_load_n(&stream->released, __ATOMIC_ACQUIRE) ||
+          __atomic_load_n(&stream->at_end, __ATOMIC_ACQUIRE)) {
+        *link = stream->next;
+        stream_unref(stream);
+      } else {
+        link = &stream->next;
+      }
+    }
+
+    // Decode without the lock so stream_open never waits behind it
+    for (Stream* stream = decoder->streams; stream; stream = stream->next)
+      fill(stream, STREAM_RING_FRAMES);
+
+    mutex_lock(&decoder->lock);
+    if (decoder->running && !decoder->incoming)
+      cond_timed_wait(&decoder->wake, &decoder->lock, STREAM_POLL_NS);
+  }
+  mutex_unlock(&decoder->lock);
+  return NULL;
+}
+
+StreamDecoder* stream_decoder_create(void) {
+  StreamDecoder* decoder = (StreamDecoder*)calloc(1, sizeof(StreamDecoder));
+  if (!decoder)
+    return NULL;
+
+  mutex_init(&decoder->lock);
+  cond_init(&decoder->wake);
+  decoder->running = 1;
+  if (!thread_create(&decoder->thread, decode_thread_main, decoder)) {
+    cond_destroy(&decoder->wake);
+    mutex_destroy(&decoder->lock);
+    free(decoder);
+    return NULL;
+  }
+  return decoder;
+}
+
+void stream_decoder_destroy(StreamDecoder* decoder) {
+  if (!decoder)
+    return;
+
+  mutex_lock(&decoder->lock);
+  decoder->running = 0;
+  cond_signal(&decoder->wake);
+  mutex_unlock(&decoder->lock);
+  thread_join(decoder->thread);
+
+  Stream* lists[2] = {decoder->incoming, decoder->streams};
+  for (int i = 0; i < 2; i++) {
+    while (lists[i]) {
+      Stream* stream = lists[i];
+      lists[i] = stream->next;
+      stream_unref(stream);
+    }
+  }
+  cond_destroy(&decoder->wake);
+  mutex_destroy(&decoder->lock);
+  free(decoder);
+}
+
+Stream* stream_open(StreamDecoder* decoder, const char* path, uint32_t start) {
+  Stream* stream = (Stream*)calloc(1, sizeof(Stream));
+  if (!stream)
+    return NULL;
+
+  stream->decoder = decoder_open(path);
+  if (!stream->decoder ||
+      !spsc_ring_init(&stream->ring, AUDIO_CHANNELS * sizeof(int16_t), STREAM_RING_FRAMES)) {
+    decoder_close(stream->decoder);
+    free(stream);
+    return NULL;
+  }
+  stream->frame_count = decoder_frame_count(stream->decoder);
+
+  // An offset can be as long as the sound, so seek past the lead-in rather than decode it.
+  // A source that can't seek leaves the decoding to the decode thread instead
+  if (start > 0 && !decoder_seek(stream->decoder, start))
+    stream->skip = start;
+
+  // Prime one chunk here so the first periods never wait on the decode thread
+  if (stream->skip == 0)
+    fill(stream, DECODER_CHUNK_FRAMES);
+  if (__atomic_load_n(&stream->at_end, __ATOMIC_RELAXED)) {
+    stream->refcount = 1;
+    return stream;  // Short enough to be decoded completely already
+  }
+
+  stream->refcount = 2;
+  mutex_lock(&decoder->lock);
+  stream->next = decoder->incoming;
+  decoder->incoming = stream;
+  cond_signal(&decoder->wake);
+  mutex_unlock(&decoder->lock);
+  return stream;
+}
+
+void stream_release(Stream* stream) {
+  if (!stream)
+    return;
+  __atomic_store_n(&stream->released, 1, __ATOMIC_RELEASE);
+  stream_unref(stream);
+}
+
+uint32_t stream_frame_count(const Stream* stream) {
+  return stream->frame_count;
+}
+
+uint32_t stream_read(Stream* stream, int16_t* out, uint32_t frames) {
+  return spsc_ring_read(&stream->ring, out, frames);
+}
+
+int stream_finished(const Stream* stream) {
+  return __atomic_load_n(&stream->at_end, __ATOMIC_ACQUIRE) &&
+         spsc_ring_count(&stream->ring) == 0;
+}
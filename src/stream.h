@@ -0,0 +1,39 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+
+#define STREAM_RING_FRAMES 16384  // ~340 ms decoded ahead of each streaming voice
+#define STREAM_MIN_FILE_BYTES (1024u * 1024u)  // Unmappable files this big stream; smaller are cached
+
+// A sound decoded incrementally by a background thread into a ring the audio thread drains,
+// so a long file is never held in memory whole
+typedef struct Stream Stream;
+
+// The background decode thread shared by every stream
+typedef struct StreamDecoder StreamDecoder;
+
+StreamDecoder* stream_decoder_create(void);
+
+// Stop the decode thread and drop its references to any streams still open
+void stream_decoder_destroy(StreamDecoder* decoder);
+
+// Open a file and start decoding it ahead from frame start, seeking past the frames before it.
+// The first chunk is decoded before this returns so playback can start at once. Returns a stream
+// holding one reference, or NULL
+Stream* stream_open(StreamDecoder* decoder, const char* path, uint32_t start);
+
+// Drop a reference. The decode thread stops feeding a stream once its opener lets go.
+// Never call this from the audio thread
+void stream_release(Stream* stream);
+
+// Length in device-rate frames as reported by the decoder (0 if unknown)
+uint32_t stream_frame_count(const Stream* stream);
+
+// Audio thread: take up to frames decoded frames. Wait-free; returns how many were ready
+uint32_t stream_read(Stream* stream, int16_t* out, uint32_t frames);
+
+// Audio thread: whether the decoder reached the end and every frame has been read
+int stream_finished(const Stream* stream);
+
+#endif  // STREAM_H
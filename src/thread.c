@@ -0,0 +1,186 @@
+#include "thread.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef struct {
+  void* (*fn)(void*);
+  void* arg;
+} ThreadStart;
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+  ThreadStart start = *(ThreadStart*)param;
+  free(param);
+  start.fn(start.arg);
+  return 0;
+}
+#endif
+
+int thread_create(Thread* thread, void* (*fn)(void*), void* arg) {
+#ifdef _WIN32
+  ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+  if (!start)
+    return 0;
+  start->fn = fn;
+  start->arg = arg;
+  *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+  if (!*thread) {
+    free(start);
+    return 0;
+  }
+  return 1;
+#else
+  return pthread_create(thread, NULL, fn, arg) == 0;
+#endif
+}
+
+void thread_join(Thread thread) {
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+void thread_lower_priority(void) {
+#ifdef _WIN32
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+  // On Linux this renices only the calling thread
+  setpriority(PRIO_PROCESS, 0, 10);
+#endif
+}
+
+uint32_t cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+void mutex_init(Mutex* mutex) {
+#ifdef _WIN32
+  InitializeCriticalSection(mutex);
+#else
+  pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_destroy(Mutex* mutex) {
+#ifdef _WIN32
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+void mutex_lock(Mutex* mutex) {
+#ifdef _WIN32
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutex_unlock(Mutex* mutex) {
+#ifdef _WIN32
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+void cond_init(CondVar* cond) {
+#ifdef _WIN32
+  InitializeConditionVariable(cond);
+#else
+  pthread_cond_init(cond, NULL);
+#endif
+}
+
+void cond_destroy(CondVar* cond) {
+#ifdef _WIN32
+  (void)cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+void cond_wait(CondVar* cond, Mutex* mutex) {
+#ifdef _WIN32
+  SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void cond_timed_wait(CondVar* cond, Mutex* mutex, uint64_t timeout_ns) {
+#ifdef _WIN32
+  SleepConditionVariableCS(cond, mutex, (DWORD)(timeout_ns / 1000000ULL));
+#else
+  // Condition variables default to CLOCK_REALTIME deadlines
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  uint64_t nsec = (uint64_t)deadline.tv_nsec + timeout_ns;
+  deadline.tv_sec += (time_t)(nsec / 1000000000ULL);
+  deadline.tv_nsec = (long)(nsec % 1000000000ULL);
+  pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
+}
+
+void cond_signal(CondVar* cond) {
+#ifdef _WIN32
+  WakeConditionVariable(cond);
+#else
+  pthread_cond_signal(cond);
+#endif
+}
+
+void cond_broadcast(CondVar* cond) {
+#ifdef _WIN32
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+void sleep_ns(uint64_t ns) {
+#ifdef _WIN32
+  Sleep((DWORD)(ns / 1000000ULL));
+#else
+  struct timespec interval;
+  interval.tv_sec = (time_t)(ns / 1000000000ULL);
+  interval.tv_nsec = (long)(ns % 1000000000ULL);
+  while (nanosleep(&interval, &interval) != 0 && errno == EINTR) {
+  }
+#endif
+}
+
+uint64_t time_ns(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
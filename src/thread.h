@@ -0,0 +1,54 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+// Start a thread running fn(arg). Returns 1 on success, 0 on failure
+int thread_create(Thread* thread, void* (*fn)(void*), void* arg);
+
+// Wait for a thread to finish
+void thread_join(Thread thread);
+
+// Drop the calling thread below normal priority so bulk work yields to the UI and audio threads
+void thread_lower_priority(void);
+
+// Number of online CPUs (at least 1)
+uint32_t cpu_count(void);
+
+void mutex_init(Mutex* mutex);
+void mutex_destroy(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+void cond_init(CondVar* cond);
+void cond_destroy(CondVar* cond);
+void cond_wait(CondVar* cond, Mutex* mutex);
+
+// Wait like cond_wait, but give up after timeout_ns
+void cond_timed_wait(CondVar* cond, Mutex* mutex, uint64_t timeout_ns);
+void cond_signal(CondVar* cond);
+void cond_broadcast(CondVar* cond);
+
+// Sleep the calling thread for the given number of nanoseconds
+void sleep_ns(uint64_t ns);
+
+// Get current monotonic time in nanoseconds
+uint64_t time_ns(void);
+
+#endif  // THREAD_H
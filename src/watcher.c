@@ -0,0 +1,414 @@
+#include "watcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int compare_paths(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int change_set_add(ChangeSet* set, const char* path) {
+  if (set->count == set->capacity) {
+    uint32_t capacity = set->capacity ? set->capacity * 2 : 64;
+    char** grown = (char**)realloc(set->paths, capacity * sizeof(char*));
+    if (!grown) {
+      set->overflow = 1;
+      return 0;
+    }
+    set->paths = grown;
+    set->capacity = capacity;
+  }
+  size_t length = strlen(path) + 1;
+  char* copy = (char*)malloc(length);
+  if (!copy) {
+    set->overflow = 1;
+    return 0;
+  }
+  memcpy(copy, path, length);
+  set->paths[set->count++] = copy;
+  return 1;
+}
+
+// Whether the first length bytes of path, taken as a string of their own, are among the first
+// count (sorted) paths of the set
+static int contains_prefix(
+    const ChangeSet* set,
+    uint32_t count,
+    const char* path,
+    size_t length) {
+  uint32_t low = 0;
+  uint32_t high = count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    const char* entry = set->paths[mid];
+    int order = strncmp(entry, path, length);
+    if (order == 0 && entry[length] != '\0')
+      order = 1;  // Longer, so it sorts after the prefix
+    if (order == 0)
+      return 1;
+    if (order < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return 0;
+}
+
+// Whether a directory above path is in the set
+static int has_ancestor(const ChangeSet* set, uint32_t count, const char* path) {
+  for (size_t i = 1; path[i] != '\0'; i++) {
+    if (path[i] == '/' && contains_prefix(set, count, path, i))
+      return 1;
+  }
+  return 0;
+}
+
+void change_set_normalize(ChangeSet* set) {
+  if (set->count < 2)
+    return;
+  qsort(set->paths, set->count, sizeof(char*), compare_paths);
+
+  uint32_t unique = 1;
+  for (uint32_t i = 1; i < set->count; i++) {
+    if (strcmp(set->paths[i], set->paths[unique - 1]) == 0)
+      free(set->paths[i]);
+    else
+      set->paths[unique++] = set->paths[i];
+  }
+  set->count = unique;
+
+  // Flag first, then compact, so the lookups always see the whole sorted set
+  unsigned char* covered = (unsigned char*)malloc(set->count);
+  if (!covered) {
+    set->overflow = 1;
+    return;
+  }
+  for (uint32_t i = 0; i < set->count; i++)
+    covered[i] = (unsigned char)has_ancestor(set, set->count, set->paths[i]);
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < set->count; i++) {
+    if (covered[i])
+      free(set->paths[i]);
+    else
+      set->paths[kept++] = set->paths[i];
+  }
+  set->count = kept;
+  free(covered);
+}
+
+void change_set_merge(ChangeSet* set, ChangeSet* from) {
+  for (uint32_t i = 0; i < from->count; i++) {
+    if (!set->overflow)
+      change_set_add(set, from->paths[i]);
+  }
+  set->overflow |= from->overflow;
+  change_set_free(from);
+  change_set_normalize(set);
+}
+
+int change_set_covers(const ChangeSet* set, const char* path) {
+  return contains_prefix(set, set->count, path, strlen(path)) ||
+         has_ancestor(set, set->count, path);
+}
+
+void change_set_free(ChangeSet* set) {
+  for (uint32_t i = 0; i < set->count; i++)
+    free(set->paths[i]);
+  free(set->paths);
+  memset(set, 0, sizeof(*set));
+}
+
+#ifdef __linux__
+
+// Everything that can change what the library holds. Writes are seen when the file is closed,
+// so a long copy is one event rather than one per block
+#define WATCH_MASK                                                                      \
+  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | \
+   IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+// A watched directory, where it sits in its root
+typedef struct {
+  char* path;  // NULL if the slot's descriptor isn't in use
+  const LibraryRoot* root;
+  int depth;
+} WatchedDir;
+
+struct DirWatcher {
+  int fd;
+  WatchedDir* dirs;  // Indexed by watch descriptor
+  uint32_t dir_capacity;
+  uint32_t count;
+  char* ignore_prefix;
+  int failed;  // A new directory couldn't be watched; the caller has to poll
+};
+
+static int join_path(char* out, size_t size, const char* dir, const char* name) {
+  return snprintf(out, size, "%s/%s", dir, name) < (int)size;
+}
+
+// Returns -1 if the watch limit was hit, 0 if the directory couldn't be watched (it may be gone
+// or unreadable), 1 once it is watched
+static int add_watch(DirWatcher* watcher, const char* path, const LibraryRoot* root, int depth) {
+  int wd = inotify_add_watch(watcher->fd, path, WATCH_MASK);
+  if (wd < 0)
+    return errno == ENOSPC || errno == ENOMEM ? -1 : 0;
+
+  if ((uint32_t)wd >= watcher->dir_capacity) {
+    uint32_t capacity = watcher->dir_capacity ? watcher->dir_capacity : 64;
+    while (capacity <= (uint32_t)wd)
+      capacity *= 2;
+    WatchedDir* grown = (WatchedDir*)realloc(watcher->dirs, capacity * sizeof(WatchedDir));
+    if (!grown) {
+      inotify_rm_watch(watcher->fd, wd);
+      return -1;
+    }
+    memset(
+        grown + watcher->dir_capacity,
+        0,
+        (capacity - watcher->dir_capacity) * sizeof(WatchedDir));
+    watcher->dirs = grown;
+    watcher->dir_capacity = capacity;
+  }
+
+  // A directory moved within the tree keeps its descriptor; only its path changes
+  size_t length = strlen(path) + 1;
+  char* copy = (char*)malloc(length);
+  if (!copy) {
+    inotify_rm_watch(watcher->fd, wd);
+    return -1;
+  }
+  memcpy(copy, path, length);
+  if (watcher->dirs[wd].path)
+    free(watcher->dirs[wd].path);
+  else
+    watcher->count++;
+  watcher->dirs[wd].path = copy;
+  watcher->dirs[wd].root = root;
+  watcher->dirs[wd].depth = depth;
+  return 1;
+}
+
+// Whether a scan of root would read a directory depth levels down, given its name and path
+static int takes_directory(const LibraryRoot* root, const char* name, const char* path, int depth) {
+  return (root->max_depth < 0 || depth <= root->max_depth) &&
+         !library_root_excludes(root, name, path + strlen(root->path) + 1);
+}
+
+static int add_tree(DirWatcher* watcher, const char* path, const LibraryRoot* root, int depth) {
+  int added = add_watch(watcher, path, root, depth);
+  if (added <= 0)
+    return added;
+
+  DIR* dir = opendir(path);
+  if (!dir)
+    return 1;
+  struct dirent* entry;
+  char child[4096];
+  int ok = 1;
+  while (ok && (entry = readdir(dir)) != NULL) {
+    const char* name = entry->d_name;
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+    int is_dir = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_UNKNOWN) {
+      struct stat s;
+      is_dir = fstatat(dirfd(dir), name, &s, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(s.st_mode);
+    }
+    if (is_dir && join_path(child, sizeof(child), path, name) &&
+        takes_directory(root, name, child, depth + 1))
+      ok = add_tree(watcher, child, root, depth + 1) >= 0;
+  }
+  closedir(dir);
+  return ok ? 1 : -1;
+}
+
+static void forget_watch(DirWatcher* watcher, int wd) {
+  if (wd >= 0 && (uint32_t)wd < watcher->dir_capacity && watcher->dirs[wd].path) {
+    free(watcher->dirs[wd].path);
+    watcher->dirs[wd].path = NULL;
+    watcher->count--;
+  }
+}
+
+static void handle_event(
+    DirWatcher* watcher,
+    const struct inotify_event* event,
+    ChangeSet* changes) {
+  if (event->mask & IN_Q_OVERFLOW) {
+    changes->overflow = 1;
+    return;
+  }
+  if (event->mask & IN_IGNORED) {
+    forget_watch(watcher, event->wd);
+    return;
+  }
+  if (event->wd < 0 || (uint32_t)event->wd >= watcher->dir_capacity ||
+      !watcher->dirs[event->wd].path || event->len == 0)
+    return;
+  if (strncmp(event->name, watcher->ignore_prefix, strlen(watcher->ignore_prefix)) == 0)
+    return;
+
+  const WatchedDir* dir = &watcher->dirs[event->wd];
+  char path[4096];
+  if (!join_path(path, sizeof(path), dir->path, event->name)) {
+    changes->overflow = 1;
+    return;
+  }
+
+  // What a scan wouldn't take can't change the library
+  int is_dir = (event->mask & IN_ISDIR) != 0;
+  if (is_dir ? !takes_directory(dir->root, event->name, path, dir->depth + 1)
+             : !library_root_takes_file(dir->root, event->name) ||
+                   library_root_excludes(
+                       dir->root, event->name, path + strlen(dir->root->path) + 1))
+    return;
+  if (is_dir && (event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+      add_tree(watcher, path, dir->root, dir->depth + 1) < 0) {
+    fprintf(stderr, "Ran out of inotify watches at %s; polling instead\n", path);
+    watcher->failed = 1;
+  }
+  change_set_add(changes, path);
+}
+
+// Drain every queued event. Returns 0 if the descriptor failed
+static int read_events(DirWatcher* watcher, ChangeSet* changes) {
+  char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+    if (length < 0)
+      return errno == EAGAIN || errno == EINTR;
+    if (length == 0)
+      return 0;
+    for (char* p = buffer; p < buffer + length;) {
+      const struct inotify_event* event = (const struct inotify_event*)p;
+      handle_event(watcher, event, changes);
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
+DirWatcher* dir_watcher_create(const LibraryConfig* config, const char* ignore_prefix) {
+  DirWatcher* watcher = (DirWatcher*)calloc(1, sizeof(DirWatcher));
+  char* prefix = (char*)malloc(strlen(ignore_prefix) + 1);
+  if (!watcher || !prefix) {
+    free(watcher);
+    free(prefix);
+    return NULL;
+  }
+  strcpy(prefix, ignore_prefix);
+  watcher->ignore_prefix = prefix;
+  watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watcher->fd < 0) {
+    dir_watcher_destroy(watcher);
+    return NULL;
+  }
+
+  // A root that can't be read yet is left to the next full scan, as long as one is watched
+  int watched = 0;
+  for (uint32_t i = 0; i < config->count; i++) {
+    const LibraryRoot* root = &config->roots[i];
+    int added = add_tree(watcher, root->path, root, 0);
+    if (added < 0) {
+      fprintf(
+          stderr,
+          "Not enough inotify watches for %s (raise fs.inotify.max_user_watches); polling "
+          "instead\n",
+          root->path);
+      dir_watcher_destroy(watcher);
+      return NULL;
+    }
+    watched |= added > 0;
+  }
+  if (!watched) {
+    dir_watcher_destroy(watcher);
+    return NULL;
+  }
+  return watcher;
+}
+
+void dir_watcher_destroy(DirWatcher* watcher) {
+  if (!watcher)
+    return;
+  if (watcher->fd >= 0)
+    close(watcher->fd);
+  for (uint32_t i = 0; i < watcher->dir_capacity; i++)
+    free(watcher->dirs[i].path);
+  free(watcher->dirs);
+  free(watcher->ignore_prefix);
+  free(watcher);
+}
+
+int dir_watcher_wait(DirWatcher* watcher, uint64_t timeout_ns, ChangeSet* changes) {
+  uint64_t start = time_ns();
+  uint64_t deadline = 0;  // Set by the first event of a burst
+  uint64_t wait_ns = timeout_ns;
+  for (;;) {
+    struct pollfd descriptor = {watcher->fd, POLLIN, 0};
+    int ready = poll(&descriptor, 1, (int)((wait_ns + 999999) / 1000000));
+    if (ready < 0 && errno != EINTR)
+      return -1;
+    if (ready > 0 && !read_events(watcher, changes))
+      return -1;
+    if (watcher->failed)
+      return -1;
+
+    uint64_t now = time_ns();
+    if (deadline == 0 && (changes->count > 0 || changes->overflow))
+      deadline = now + WATCHER_MAX_DELAY_NS;
+    if (deadline != 0 && (ready == 0 || now >= deadline)) {
+      change_set_normalize(changes);
+      return 1;
+    }
+    if (deadline == 0) {
+      // Nothing yet, or only the soundboard's own files
+      if (now - start >= timeout_ns)
+        return 0;
+      wait_ns = timeout_ns - (now - start);
+    } else {
+      wait_ns = deadline - now < WATCHER_QUIET_NS ? deadline - now : WATCHER_QUIET_NS;
+    }
+  }
+}
+
+uint32_t dir_watcher_count(const DirWatcher* watcher) {
+  return watcher->count;
+}
+
+#else
+
+DirWatcher* dir_watcher_create(const LibraryConfig* config, const char* ignore_prefix) {
+  (void)config;
+  (void)ignore_prefix;
+  return NULL;
+}
+
+void dir_watcher_destroy(DirWatcher* watcher) {
+  (void)watcher;
+}
+
+int dir_watcher_wait(DirWatcher* watcher, uint64_t timeout_ns, ChangeSet* changes) {
+  (void)watcher;
+  (void)timeout_ns;
+  (void)changes;
+  return -1;
+}
+
+uint32_t dir_watcher_count(const DirWatcher* watcher) {
+  (void)watcher;
+  return 0;
+}
+
+#endif
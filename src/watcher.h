@@ -0,0 +1,55 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <stdint.h>
+
+#include "library_config.h"
+
+#define WATCHER_QUIET_NS 200000000ULL  // A burst of events ends after this long without one
+#define WATCHER_MAX_DELAY_NS 2000000000ULL  // Or this long after its first event, at the latest
+
+// Paths that changed under a watched tree. A directory stands for everything under it
+typedef struct {
+  char** paths;  // Sorted, without duplicates or paths under another entry, after normalizing
+  uint32_t count;
+  uint32_t capacity;
+  int overflow;  // Events were lost, so anything may have changed
+} ChangeSet;
+
+// Add a copy of path. Returns 0 if out of memory, which marks the set as overflowed
+int change_set_add(ChangeSet* set, const char* path);
+
+// Sort, drop duplicates and drop paths under a directory that is also in the set
+void change_set_normalize(ChangeSet* set);
+
+// Move every path of from into set and normalize it. from is left empty
+void change_set_merge(ChangeSet* set, ChangeSet* from);
+
+// Whether path, or a directory above it, is in the set. The set must be normalized
+int change_set_covers(const ChangeSet* set, const char* path);
+
+void change_set_free(ChangeSet* set);
+
+// Kernel notifications (inotify) for the library's directory trees. Directories created or moved
+// in are watched as they appear, and watches on deleted ones are dropped. Linux only; elsewhere
+// dir_watcher_create() returns NULL and callers fall back to polling
+typedef struct DirWatcher DirWatcher;
+
+// Watch every root of config (which must outlive the watcher) and the directories under it that
+// a scan would read, without following symlinks. Only entries a scan would take count as
+// changes, and never files whose names start with ignore_prefix. Returns NULL if inotify is
+// unavailable or the per-user watch limit is too low for the trees
+DirWatcher* dir_watcher_create(const LibraryConfig* config, const char* ignore_prefix);
+
+void dir_watcher_destroy(DirWatcher* watcher);
+
+// Wait up to timeout_ns for an event. Once one arrives, keep collecting until the burst has been
+// quiet for WATCHER_QUIET_NS, so a copy of hundreds of files is reported once. Adds what changed
+// to changes and returns 1, returns 0 on timeout, or -1 if the watch broke and the caller should
+// fall back to polling
+int dir_watcher_wait(DirWatcher* watcher, uint64_t timeout_ns, ChangeSet* changes);
+
+// Directories being watched
+uint32_t dir_watcher_count(const DirWatcher* watcher);
+
+#endif  // WATCHER_H
@@ -0,0 +1,139 @@
+#include "wav.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t read_u16_le(const unsigned char* bytes) {
+  return (uint16_t)(((uint16_t)bytes[0]) | ((uint16_t)bytes[1] << 8));
+}
+
+static uint32_t read_u32_le(const unsigned char* bytes) {
+  return ((uint32_t)bytes[0]) | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+         ((uint32_t)bytes[3] << 24);
+}
+
+// Reads len bytes at offset into dst; returns 1 only if all of them were available
+typedef int (*WavReadFn)(void* ctx, uint64_t offset, void* dst, uint32_t len);
+
+// The RIFF chunk walk shared by every way of getting at a file's header bytes
+static int walk_chunks(WavReadFn read_at, void* ctx, WavInfo* info) {
+  memset(info, 0, sizeof(*info));
+
+  unsigned char header[12];
+  if (!read_at(ctx, 0, header, sizeof(header)))
+    return 0;
+
+  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+    return 0;
+
+  int have_fmt = 0;
+  int have_data = 0;
+  uint64_t offset = sizeof(header);
+
+  while (!(have_fmt && have_data)) {
+    unsigned char chunk_header[8];
+    if (!read_at(ctx, offset, chunk_header, sizeof(chunk_header)))
+      break;
+    offset += sizeof(chunk_header);
+
+    uint32_t chunk_size = read_u32_le(chunk_header + 4);
+
+    if (memcmp(chunk_header, "fmt ", 4) == 0) {
+      if (chunk_size < 16)
+        return 0;
+
+      unsigned char fmt_data[40];
+      uint32_t fmt_len = chunk_size < sizeof(fmt_data) ? chunk_size : sizeof(fmt_data);
+      if (!read_at(ctx, offset, fmt_data, fmt_len))
+        return 0;
+
+      info->format_tag = read_u16_le(fmt_data);
+      info->channels = read_u16_le(fmt_data + 2);
+      info->sample_rate = read_u32_le(fmt_data + 4);
+      info->byte_rate = read_u32_le(fmt_data + 8);
+      info->block_align = read_u16_le(fmt_data + 12);
+      info->bits_per_sample = read_u16_le(fmt_data + 14);
+
+      // WAVE_FORMAT_EXTENSIBLE keeps the real format tag in the sub-format GUID
+      if (info->format_tag == WAV_FORMAT_EXTENSIBLE && fmt_len >= 26)
+        info->format_tag = read_u16_le(fmt_data + 24);
+      have_fmt = 1;
+    } else if (memcmp(chunk_header, "data", 4) == 0) {
+      info->data_offset = offset;
+      info->data_size = chunk_size;
+      have_data = 1;
+    }
+
+    offset += (uint64_t)chunk_size + (chunk_size & 1);
+  }
+
+  return have_fmt && have_data && info->byte_rate != 0 && info->block_align != 0;
+}
+
+static int read_file_at(void* ctx, uint64_t offset, void* dst, uint32_t len) {
+  FILE* f = (FILE*)ctx;
+  if (fseek(f, (long)offset, SEEK_SET) != 0)
+    return 0;
+  return fread(dst, 1, len, f) == len;
+}
+
+typedef struct {
+  const unsigned char* bytes;
+  uint64_t size;
+} MemoryReader;
+
+static int read_memory_at(void* ctx, uint64_t offset, void* dst, uint32_t len) {
+  MemoryReader* reader = (MemoryReader*)ctx;
+  if (offset > reader->size || reader->size - offset < len)
+    return 0;
+  memcpy(dst, reader->bytes + offset, len);
+  return 1;
+}
+
+int wav_read_info(FILE* f, WavInfo* info) {
+  return walk_chunks(read_file_at, f, info);
+}
+
+int wav_parse_info(const void* bytes, uint64_t size, WavInfo* info) {
+  return wav_parse_header(bytes, size, size, info);
+}
+
+int wav_parse_header(const void* bytes, uint64_t length, uint64_t file_size, WavInfo* info) {
+  MemoryReader reader;
+  reader.bytes = (const unsigned char*)bytes;
+  reader.size = length;
+  if (!walk_chunks(read_memory_at, &reader, info))
+    return 0;
+
+  // Truncated files: only trust the samples that are actually there
+  if (info->data_offset > file_size)
+    return 0;
+  if (file_size - info->data_offset < info->data_size)
+    info->data_size = (uint32_t)(file_size - info->data_offset);
+  return 1;
+}
+
+int wav_sample_format(const WavInfo* info, SampleFormat* format) {
+  if (info->format_tag == WAV_FORMAT_IEEE_FLOAT && info->bits_per_sample == 32) {
+    *format = SAMPLE_F32;
+    return 1;
+  }
+  if (info->format_tag != WAV_FORMAT_PCM)
+    return 0;
+
+  switch (info->bits_per_sample) {
+    case 8:
+      *format = SAMPLE_U8;
+      return 1;
+    case 16:
+      *format = SAMPLE_S16;
+      return 1;
+    case 24:
+      *format = SAMPLE_S24;
+      return 1;
+    case 32:
+      *format = SAMPLE_S32;
+      return 1;
+  }
+  return 0;
+}
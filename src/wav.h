@@ -0,0 +1,38 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "convert.h"
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IEEE_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+typedef struct {
+  uint16_t format_tag;  // WAV_FORMAT_PCM or WAV_FORMAT_IEEE_FLOAT (extensible is resolved)
+  uint16_t channels;
+  uint32_t sample_rate;
+  uint32_t byte_rate;
+  uint16_t block_align;
+  uint16_t bits_per_sample;
+  uint64_t data_offset;  // Byte offset of the first sample in the file
+  uint32_t data_size;  // Size of the data chunk in bytes
+} WavInfo;
+
+// Walk the RIFF chunks of an open WAV file and fill in its format and data location
+int wav_read_info(FILE* f, WavInfo* info);
+
+// Same chunk walk over a file's bytes already in memory (a mapping or a header block).
+// data_size is clamped to the bytes that are present
+int wav_parse_info(const void* bytes, uint64_t size, WavInfo* info);
+
+// Same chunk walk over the first length bytes of a file of file_size bytes, which must reach the
+// data chunk's header. data_size is clamped to the file
+int wav_parse_header(const void* bytes, uint64_t length, uint64_t file_size, WavInfo* info);
+
+// Sample format of a WAV's data chunk: 8/16/24/32-bit PCM or 32-bit float. Returns 0 if unsupported
+int wav_sample_format(const WavInfo* info, SampleFormat* format);
+
+#endif  // WAV_H
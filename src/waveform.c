@@ -0,0 +1,392 @@
+#include "waveform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define WAVEFORM_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define WAVEFORM_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define WAVEFORM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+  const char* name;
+  // Widen *min/*max to cover count samples
+  void (*minmax)(const int16_t* src, uint32_t count, int16_t* min, int16_t* max);
+  // dst[i] = min (or max) of src[2i] and src[2i + 1]. dst may equal src
+  void (*pair_min)(int16_t* dst, const int16_t* src, uint32_t pairs);
+  void (*pair_max)(int16_t* dst, const int16_t* src, uint32_t pairs);
+} WaveformKernels;
+
+static void minmax_scalar(const int16_t* src, uint32_t count, int16_t* min, int16_t* max) {
+  int16_t lo = *min;
+  int16_t hi = *max;
+  for (uint32_t i = 0; i < count; i++) {
+    lo = src[i] < lo ? src[i] : lo;
+    hi = src[i] > hi ? src[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+static void pair_min_scalar(int16_t* dst, const int16_t* src, uint32_t pairs) {
+  for (uint32_t i = 0; i < pairs; i++)
+    dst[i] = src[2 * i] < src[2 * i + 1] ? src[2 * i] : src[2 * i + 1];
+}
+
+static void pair_max_scalar(int16_t* dst, const int16_t* src, uint32_t pairs) {
+  for (uint32_t i = 0; i < pairs; i++)
+    dst[i] = src[2 * i] > src[2 * i + 1] ? src[2 * i] : src[2 * i + 1];
+}
+
+#ifdef WAVEFORM_HAVE_SSE2
+static void minmax_sse2(const int16_t* src, uint32_t count, int16_t* min, int16_t* max) {
+  __m128i lo = _mm_set1_epi16(*min);
+  __m128i hi = _mm_set1_epi16(*max);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    lo = _mm_min_epi16(lo, s);
+    hi = _mm_max_epi16(hi, s);
+  }
+
+  int16_t lanes_lo[8];
+  int16_t lanes_hi[8];
+  _mm_storeu_si128((__m128i*)lanes_lo, lo);
+  _mm_storeu_si128((__m128i*)lanes_hi, hi);
+  for (int lane = 0; lane < 8; lane++) {
+    *min = lanes_lo[lane] < *min ? lanes_lo[lane] : *min;
+    *max = lanes_hi[lane] > *max ? lanes_hi[lane] : *max;
+  }
+  minmax_scalar(src + i, count - i, min, max);
+}
+
+// Bring each odd lane next to its even neighbour, combine, then keep the even lanes
+#define PAIR_REDUCE_SSE2(name, op, scalar)                             \
+  static void name(int16_t* dst, const int16_t* src, uint32_t pairs) { \
+    uint32_t i = 0;                                                    \
+    for (; i + 8 <= pairs; i += 8) {                                   \
+      __m128i a = _mm_loadu_si128((const __m128i*)(src + 2 * i));      \
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + 2 * i + 8));  \
+      a = op(a, _mm_srli_epi32(a, 16));                                \
+      b = op(b, _mm_srli_epi32(b, 16));                                \
+      a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);                   \
+      b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);                   \
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a, b));    \
+    }                                                                  \
+    scalar(dst + i, src + 2 * i, pairs - i);                           \
+  }
+
+PAIR_REDUCE_SSE2(pair_min_sse2, _mm_min_epi16, pair_min_scalar)
+PAIR_REDUCE_SSE2(pair_max_sse2, _mm_max_epi16, pair_max_scalar)
+#endif
+
+#ifdef WAVEFORM_HAVE_AVX2
+__attribute__((target("avx2"))) static void minmax_avx2(
+    const int16_t* src,
+    uint32_t count,
+    int16_t* min,
+    int16_t* max) {
+  __m256i lo = _mm256_set1_epi16(*min);
+  __m256i hi = _mm256_set1_epi16(*max);
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+    lo = _mm256_min_epi16(lo, s);
+    hi = _mm256_max_epi16(hi, s);
+  }
+
+  int16_t lanes_lo[16];
+  int16_t lanes_hi[16];
+  _mm256_storeu_si256((__m256i*)lanes_lo, lo);
+  _mm256_storeu_si256((__m256i*)lanes_hi, hi);
+  for (int lane = 0; lane < 16; lane++) {
+    *min = lanes_lo[lane] < *min ? lanes_lo[lane] : *min;
+    *max = lanes_hi[lane] > *max ? lanes_hi[lane] : *max;
+  }
+  minmax_sse2(src + i, count - i, min, max);
+}
+
+// The 256-bit pack works within 128-bit halves, so the permute restores element order
+#define PAIR_REDUCE_AVX2(name, op, fallback)                                     \
+  __attribute__((target("avx2"))) static void name(                              \
+      int16_t* dst,                                                              \
+      const int16_t* src,                                                        \
+      uint32_t pairs) {                                                          \
+    uint32_t i = 0;                                                              \
+    for (; i + 16 <= pairs; i += 16) {                                           \
+      __m256i a = _mm256_loadu_si256((const __m256i*)(src + 2 * i));             \
+      __m256i b = _mm256_loadu_si256((const __m256i*)(src + 2 * i + 16));        \
+      a = op(a, _mm256_srli_epi32(a, 16));                                       \
+      b = op(b, _mm256_srli_epi32(b, 16));                                       \
+      a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);                       \
+      b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);                       \
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8); \
+      _mm256_storeu_si256((__m256i*)(dst + i), packed);                          \
+    }                                                                            \
+    fallback(dst + i, src + 2 * i, pairs - i);                                   \
+  }
+
+PAIR_REDUCE_AVX2(pair_min_avx2, _mm256_min_epi16, pair_min_sse2)
+PAIR_REDUCE_AVX2(pair_max_avx2, _mm256_max_epi16, pair_max_sse2)
+#endif
+
+#ifdef WAVEFORM_HAVE_NEON
+static void minmax_neon(const int16_t* src, uint32_t count, int16_t* min, int16_t* max) {
+  int16x8_t lo = vdupq_n_s16(*min);
+  int16x8_t hi = vdupq_n_s16(*max);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t s = vld1q_s16(src + i);
+    lo = vminq_s16(lo, s);
+    hi = vmaxq_s16(hi, s);
+  }
+  *min = vminvq_s16(lo);
+  *max = vmaxvq_s16(hi);
+  minmax_scalar(src + i, count - i, min, max);
+}
+
+static void pair_min_neon(int16_t* dst, const int16_t* src, uint32_t pairs) {
+  uint32_t i = 0;
+  for (; i + 8 <= pairs; i += 8)
+    vst1q_s16(dst + i, vpminq_s16(vld1q_s16(src + 2 * i), vld1q_s16(src + 2 * i + 8)));
+  pair_min_scalar(dst + i, src + 2 * i, pairs - i);
+}
+
+static void pair_max_neon(int16_t* dst, const int16_t* src, uint32_t pairs) {
+  uint32_t i = 0;
+  for (; i + 8 <= pairs; i += 8)
+    vst1q_s16(dst + i, vpmaxq_s16(vld1q_s16(src + 2 * i), vld1q_s16(src + 2 * i + 8)));
+  pair_max_scalar(dst + i, src + 2 * i, pairs - i);
+}
+#endif
+
+static const WaveformKernels* select_kernels(void) {
+  static const WaveformKernels scalar = {
+      "scalar", minmax_scalar, pair_min_scalar, pair_max_scalar};
+#ifdef WAVEFORM_HAVE_AVX2
+  static const WaveformKernels avx2 = {"avx2", minmax_avx2, pair_min_avx2, pair_max_avx2};
+  if (__builtin_cpu_supports("avx2"))
+    return &avx2;
+#endif
+#ifdef WAVEFORM_HAVE_SSE2
+  static const WaveformKernels sse2 = {"sse2", minmax_sse2, pair_min_sse2, pair_max_sse2};
+  return &sse2;
+#endif
+#ifdef WAVEFORM_HAVE_NEON
+  static const WaveformKernels neon = {"neon", minmax_neon, pair_min_neon, pair_max_neon};
+  return &neon;
+#endif
+  return &scalar;
+}
+
+static const WaveformKernels* kernels(void) {
+  static const WaveformKernels* selected = NULL;
+  const WaveformKernels* k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+  if (!k) {
+    k = select_kernels();
+    __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+const char* waveform_kernel_name(void) {
+  return kernels()->name;
+}
+
+// Halve a level into the next one up. An odd last pair is carried over unchanged
+static uint32_t reduce_level(
+    int16_t* dst_min,
+    int16_t* dst_max,
+    const int16_t* src_min,
+    const int16_t* src_max,
+    uint32_t count) {
+  const WaveformKernels* k = kernels();
+  uint32_t pairs = count / 2;
+  k->pair_min(dst_min, src_min, pairs);
+  k->pair_max(dst_max, src_max, pairs);
+  if (count & 1) {
+    dst_min[pairs] = src_min[count - 1];
+    dst_max[pairs] = src_max[count - 1];
+  }
+  return (count + 1) / 2;
+}
+
+uint32_t waveform_pair_count(uint32_t count0) {
+  uint32_t total = 0;
+  for (uint32_t count = count0; count > 0; count = (count + 1) / 2) {
+    total += count;
+    if (count == 1)
+      break;
+  }
+  return total;
+}
+
+Waveform* waveform_alloc(uint32_t frames, uint32_t count0) {
+  if (count0 > WAVEFORM_MAX_BUCKETS)
+    return NULL;
+
+  uint32_t pairs = waveform_pair_count(count0);
+  Waveform* waveform =
+      (Waveform*)calloc(1, sizeof(Waveform) + (size_t)pairs * 2 * sizeof(int16_t));
+  if (!waveform)
+    return NULL;
+
+  waveform->frames = frames;
+  int16_t* cursor = waveform->data;
+  for (uint32_t count = count0; count > 0; count = (count + 1) / 2) {
+    uint32_t level = waveform->level_count++;
+    waveform->counts[level] = count;
+    waveform->min[level] = cursor;
+    waveform->max[level] = cursor + count;
+    cursor += 2 * count;
+    if (count == 1)
+      break;
+  }
+  return waveform;
+}
+
+void waveform_free(Waveform* waveform) {
+  free(waveform);
+}
+
+// Level 0 accumulator: one pair per WAVEFORM_BUCKET_FRAMES, halved in place whenever it fills
+typedef struct {
+  int16_t* min;
+  int16_t* max;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t bucket_frames;  // Grows as the buckets are halved
+  uint32_t open_frames;  // Frames in the bucket being filled
+  uint32_t frames;
+} PeakBuilder;
+
+static void builder_add(PeakBuilder* builder, const int16_t* samples, uint32_t frames) {
+  const WaveformKernels* k = kernels();
+  while (frames > 0) {
+    if (builder->open_frames == 0) {
+      if (builder->count == builder->capacity) {
+        // Rather than growing without bound, halve what we have and double the bucket size
+        builder->count =
+            reduce_level(builder->min, builder->max, builder->min, builder->max, builder->count);
+        builder->bucket_frames *= 2;
+      }
+      builder->min[builder->count] = INT16_MAX;
+      builder->max[builder->count] = INT16_MIN;
+      builder->count++;
+    }
+
+    uint32_t span = builder->bucket_frames - builder->open_frames;
+    if (span > frames)
+      span = frames;
+    uint32_t last = builder->count - 1;
+    k->minmax(samples, span * 2, &builder->min[last], &builder->max[last]);
+    builder->open_frames = (builder->open_frames + span) % builder->bucket_frames;
+    builder->frames += span;
+    samples += (size_t)span * 2;
+    frames -= span;
+  }
+}
+
+static Waveform* builder_finish(PeakBuilder* builder) {
+  Waveform* waveform = waveform_alloc(builder->frames, builder->count);
+  if (!waveform)
+    return NULL;
+
+  if (waveform->level_count > 0) {
+    memcpy(waveform->min[0], builder->min, builder->count * sizeof(int16_t));
+    memcpy(waveform->max[0], builder->max, builder->count * sizeof(int16_t));
+  }
+  for (uint32_t level = 1; level < waveform->level_count; level++) {
+    reduce_level(
+        waveform->min[level],
+        waveform->max[level],
+        waveform->min[level - 1],
+        waveform->max[level - 1],
+        waveform->counts[level - 1]);
+  }
+  return waveform;
+}
+
+static int builder_init(PeakBuilder* builder) {
+  memset(builder, 0, sizeof(*builder));
+  builder->capacity = WAVEFORM_MAX_BUCKETS;
+  builder->bucket_frames = WAVEFORM_BUCKET_FRAMES;
+  builder->min = (int16_t*)malloc(WAVEFORM_MAX_BUCKETS * sizeof(int16_t));
+  builder->max = (int16_t*)malloc(WAVEFORM_MAX_BUCKETS * sizeof(int16_t));
+  return builder->min && builder->max;
+}
+
+static void builder_free(PeakBuilder* builder) {
+  free(builder->min);
+  free(builder->max);
+}
+
+Waveform* waveform_from_samples(const int16_t* samples, uint32_t frames) {
+  PeakBuilder builder;
+  Waveform* waveform = NULL;
+  if (builder_init(&builder)) {
+    builder_add(&builder, samples, frames);
+    waveform = builder_finish(&builder);
+  }
+  builder_free(&builder);
+  return waveform;
+}
+
+Waveform* waveform_build(const char* path) {
+  Decoder* decoder = decoder_open(path);
+  if (!decoder)
+    return NULL;
+
+  PeakBuilder builder;
+  int16_t* chunk = (int16_t*)malloc(DECODER_CHUNK_FRAMES * 2 * sizeof(int16_t));
+  int ok = builder_init(&builder) && chunk;
+  uint32_t frames;
+  while (ok && (frames = decoder_read(decoder, chunk, DECODER_CHUNK_FRAMES)) > 0)
+    builder_add(&builder, chunk, frames);
+
+  Waveform* waveform = ok ? builder_finish(&builder) : NULL;
+  builder_free(&builder);
+  free(chunk);
+  decoder_close(decoder);
+  return waveform;
+}
+
+void waveform_columns(const Waveform* waveform, uint32_t columns, float* mins, float* maxs) {
+  if (waveform->level_count == 0) {
+    memset(mins, 0, columns * sizeof(float));
+    memset(maxs, 0, columns * sizeof(float));
+    return;
+  }
+
+  // The coarsest level that still has a pair for every column
+  uint32_t level = 0;
+  while (level + 1 < waveform->level_count && waveform->counts[level + 1] >= columns)
+    level++;
+
+  uint32_t count = waveform->counts[level];
+  const int16_t* level_min = waveform->min[level];
+  const int16_t* level_max = waveform->max[level];
+  for (uint32_t c = 0; c < columns; c++) {
+    uint32_t first = (uint32_t)((uint64_t)c * count / columns);
+    uint32_t end = (uint32_t)((uint64_t)(c + 1) * count / columns);
+    if (end <= first)
+      end = first + 1;
+    int16_t lo = INT16_MAX;
+    int16_t hi = INT16_MIN;
+    for (uint32_t b = first; b < end; b++) {
+      lo = level_min[b] < lo ? level_min[b] : lo;
+      hi = level_max[b] > hi ? level_max[b] : hi;
+    }
+    mins[c] = (float)lo / 32768.0f;
+    maxs[c] = (float)hi / 32768.0f;
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+
+#define WAVEFORM_BUCKET_FRAMES 256  // Frames reduced into each min/max pair while decoding
+#define WAVEFORM_MAX_BUCKETS 1024  // Finest level kept; enough for any tile width
+#define WAVEFORM_MAX_LEVELS 11  // 1024 buckets halved down to 1
+
+// Min/max peak pyramid of a sound: level 0 holds up to WAVEFORM_MAX_BUCKETS pairs, and every
+// level above halves the one below, so drawing any width touches a bounded number of pairs
+typedef struct {
+  uint32_t frames;  // Length of the sound in frames
+  uint32_t level_count;
+  uint32_t counts[WAVEFORM_MAX_LEVELS];  // Pairs per level
+  int16_t* min[WAVEFORM_MAX_LEVELS];
+  int16_t* max[WAVEFORM_MAX_LEVELS];
+  int16_t data[];  // Every level's min array followed by its max array
+} Waveform;
+
+// Decode a sound file and build its pyramid. Returns NULL if it can't be decoded
+Waveform* waveform_build(const char* path);
+
+// Build a pyramid from device-format samples (interleaved stereo int16)
+Waveform* waveform_from_samples(const int16_t* samples, uint32_t frames);
+
+// Allocate a pyramid whose level 0 has count0 pairs; the caller fills every level
+Waveform* waveform_alloc(uint32_t frames, uint32_t count0);
+
+// Total pairs over all levels of a pyramid with count0 pairs at level 0
+uint32_t waveform_pair_count(uint32_t count0);
+
+void waveform_free(Waveform* waveform);
+
+// Reduce the pyramid to columns min/max pairs spanning the whole sound, scaled to [-1, 1]
+void waveform_columns(const Waveform* waveform, uint32_t columns, float* mins, float* maxs);
+
+// Name of the kernel set picked for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* waveform_kernel_name(void);
+
+#endif  // WAVEFORM_H
@@ -0,0 +1,214 @@
+#include "waveform_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sidecar_cache.h"
+#include "thread.h"
+
+#define CACHE_FILE_MAGIC 0x46574253u  // "SBWF"
+#define CACHE_FILE_VERSION 1u
+
+// The file is the header followed by one record per sound: RecordHeader, the path (not
+// terminated), then every level's min and max arrays as in Waveform.data. Native byte order
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+} FileHeader;
+
+typedef struct {
+  int64_t mtime;
+  uint64_t size;
+  uint32_t path_length;
+  uint32_t frames;
+  uint32_t count0;  // Pairs at level 0
+  uint32_t reserved;
+} RecordHeader;
+
+typedef struct {
+  SidecarEntry base;  // valid is set whenever waveform is
+  Waveform* waveform;  // Immutable once published; replaced whole under the lock
+} CacheEntry;
+
+struct WaveformCache {
+  SidecarCache base;
+  WaveformCacheStats stats;  // built, build_ns and bytes; the rest come from base
+};
+
+static uint64_t waveform_bytes(const Waveform* waveform) {
+  if (!waveform || waveform->level_count == 0)
+    return 0;
+  return (uint64_t)waveform_pair_count(waveform->counts[0]) * 2 * sizeof(int16_t);
+}
+
+static void load_file(WaveformCache* cache) {
+  FILE* file = fopen(cache->base.file, "rb");
+  if (!file)
+    return;
+
+  FileHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CACHE_FILE_MAGIC ||
+      header.version != CACHE_FILE_VERSION) {
+    fclose(file);
+    return;
+  }
+
+  RecordHeader record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    // A damaged record ends the load; everything before it is kept
+    if (record.path_length == 0 || record.path_length > 65535 ||
+        record.count0 > WAVEFORM_MAX_BUCKETS)
+      break;
+    char* path = (char*)malloc(record.path_length + 1);
+    Waveform* waveform = path ? waveform_alloc(record.frames, record.count0) : NULL;
+    size_t samples = (size_t)waveform_pair_count(record.count0) * 2;
+    if (!waveform || fread(path, 1, record.path_length, file) != record.path_length ||
+        fread(waveform->data, sizeof(int16_t), samples, file) != samples) {
+      free(path);
+      waveform_free(waveform);
+      break;
+    }
+    path[record.path_length] = '\0';
+
+    CacheEntry* entry = (CacheEntry*)sidecar_cache_add(&cache->base, path);
+    free(path);
+    if (!entry) {
+      waveform_free(waveform);
+      break;
+    }
+    cache->stats.bytes -= waveform_bytes(entry->waveform);
+    waveform_free(entry->waveform);
+    entry->waveform = waveform;
+    entry->base.mtime = record.mtime;
+    entry->base.size = record.size;
+    entry->base.valid = 1;
+    cache->stats.bytes += waveform_bytes(waveform);
+  }
+
+  fclose(file);
+}
+
+static void* encode_file(SidecarCache* base, size_t* length) {
+  *length = sizeof(FileHeader);
+  for (SidecarEntry* it = sidecar_cache_next(base, NULL); it; it = sidecar_cache_next(base, it)) {
+    const Waveform* waveform = ((CacheEntry*)it)->waveform;
+    *length += sizeof(RecordHeader) + strlen(it->path) + waveform_bytes(waveform);
+  }
+
+  char* data = (char*)malloc(*length);
+  if (!data)
+    return NULL;
+
+  FileHeader header = {CACHE_FILE_MAGIC, CACHE_FILE_VERSION};
+  memcpy(data, &header, sizeof(header));
+  size_t offset = sizeof(header);
+  for (SidecarEntry* it = sidecar_cache_next(base, NULL); it; it = sidecar_cache_next(base, it)) {
+    const Waveform* waveform = ((CacheEntry*)it)->waveform;
+    RecordHeader record = {0};
+    record.mtime = it->mtime;
+    record.size = it->size;
+    record.path_length = (uint32_t)strlen(it->path);
+    record.frames = waveform->frames;
+    record.count0 = waveform->level_count > 0 ? waveform->counts[0] : 0;
+    memcpy(data + offset, &record, sizeof(record));
+    offset += sizeof(record);
+    memcpy(data + offset, it->path, record.path_length);
+    offset += record.path_length;
+    memcpy(data + offset, waveform->data, (size_t)waveform_bytes(waveform));
+    offset += (size_t)waveform_bytes(waveform);
+  }
+  return data;
+}
+
+static void build_entry(SidecarCache* base, SidecarEntry* it, int64_t mtime, uint64_t size) {
+  WaveformCache* cache = (WaveformCache*)base;
+  CacheEntry* entry = (CacheEntry*)it;
+
+  uint64_t start = time_ns();
+  Waveform* waveform = waveform_build(it->path);
+
+  mutex_lock(&base->lock);
+  Waveform* old = NULL;
+  if (waveform) {
+    old = entry->waveform;
+    entry->waveform = waveform;
+    it->mtime = mtime;
+    it->size = size;
+    it->valid = 1;
+    cache->stats.bytes += waveform_bytes(waveform) - waveform_bytes(old);
+    base->dirty = 1;
+    cache->stats.built++;
+  } else {
+    base->failed++;
+  }
+  cache->stats.build_ns += time_ns() - start;
+  mutex_unlock(&base->lock);
+  waveform_free(old);
+}
+
+static void release_entry(SidecarEntry* entry) {
+  waveform_free(((CacheEntry*)entry)->waveform);
+}
+
+static const SidecarOps WAVEFORM_OPS = {
+    "waveform",
+    sizeof(CacheEntry),
+    build_entry,
+    encode_file,
+    release_entry,
+};
+
+WaveformCache* waveform_cache_create(const char* file, WorkerPool* pool) {
+  WaveformCache* cache = (WaveformCache*)calloc(1, sizeof(WaveformCache));
+  if (!cache)
+    return NULL;
+  if (!sidecar_cache_init(&cache->base, &WAVEFORM_OPS, file, pool)) {
+    free(cache);
+    return NULL;
+  }
+
+  load_file(cache);
+  return cache;
+}
+
+void waveform_cache_destroy(WaveformCache* cache) {
+  if (!cache)
+    return;
+
+  sidecar_cache_destroy(&cache->base);
+  free(cache);
+}
+
+void waveform_cache_analyze(WaveformCache* cache, const char* path) {
+  if (cache)
+    sidecar_cache_analyze(&cache->base, path);
+}
+
+int waveform_cache_columns(
+    WaveformCache* cache,
+    const char* path,
+    uint32_t columns,
+    float* mins,
+    float* maxs) {
+  if (!cache)
+    return 0;
+
+  mutex_lock(&cache->base.lock);
+  const CacheEntry* entry = (const CacheEntry*)sidecar_cache_find(&cache->base, path);
+  int found = entry && entry->waveform;
+  if (found)
+    waveform_columns(entry->waveform, columns, mins, maxs);
+  mutex_unlock(&cache->base.lock);
+  return found;
+}
+
+void waveform_cache_get_stats(WaveformCache* cache, WaveformCacheStats* stats) {
+  mutex_lock(&cache->base.lock);
+  *stats = cache->stats;
+  stats->reused = cache->base.reused;
+  stats->failed = cache->base.failed;
+  stats->pending = cache->base.pending;
+  stats->entries = cache->base.entries;
+  mutex_unlock(&cache->base.lock);
+}
@@ -0,0 +1,48 @@
+#ifndef WAVEFORM_CACHE_H
+#define WAVEFORM_CACHE_H
+
+#include <stdint.h>
+
+#include "waveform.h"
+#include "worker_pool.h"
+
+#define WAVEFORM_CACHE_FILE ".soundboard-waveforms"
+
+// Waveform pyramids built in the background and persisted across runs in one binary sidecar
+// file, keyed by path + mtime + size
+typedef struct WaveformCache WaveformCache;
+
+typedef struct {
+  uint64_t built;  // Sounds decoded and reduced this run
+  uint64_t reused;  // Sounds whose stored pyramid was still valid
+  uint64_t failed;  // Sounds that couldn't be decoded
+  uint64_t build_ns;  // Worker time spent decoding and reducing
+  uint64_t bytes;  // Memory held by pyramids
+  uint32_t pending;  // Sounds queued or being built
+  uint32_t entries;
+} WaveformCacheStats;
+
+// Load pyramids saved in file (a missing or damaged file is fine). Builds run as jobs on pool,
+// which must be destroyed before the cache
+WaveformCache* waveform_cache_create(const char* file, WorkerPool* pool);
+
+// Save anything built since the last save and free the cache
+void waveform_cache_destroy(WaveformCache* cache);
+
+// Queue a sound for a pyramid unless it is already queued. The worker stats the file and keeps
+// the stored pyramid if mtime and size still match. The file is rewritten whenever the queue
+// drains
+void waveform_cache_analyze(WaveformCache* cache, const char* path);
+
+// Reduce a sound's pyramid to columns min/max pairs in [-1, 1]. Returns 0 if it has none yet
+int waveform_cache_columns(
+    WaveformCache* cache,
+    const char* path,
+    uint32_t columns,
+    float* mins,
+    float* maxs);
+
+// Snapshot the cache counters
+void waveform_cache_get_stats(WaveformCache* cache, WaveformCacheStats* stats);
+
+#endif  // WAVEFORM_CACHE_H
@@ -0,0 +1,123 @@
+#include "worker_pool.h"
+
+#include <stdlib.h>
+
+#include "thread.h"
+
+typedef struct QueuedJob {
+  WorkerJob job;
+  void* arg;
+  struct QueuedJob* next;
+} QueuedJob;
+
+struct WorkerPool {
+  Mutex lock;
+  CondVar wake;
+  QueuedJob* head;
+  QueuedJob* tail;
+  int stop;
+  Thread* threads;
+  uint32_t thread_count;
+};
+
+static void* worker_main(void* arg) {
+  WorkerPool* pool = (WorkerPool*)arg;
+  thread_lower_priority();
+
+  mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->head && !pool->stop)
+      cond_wait(&pool->wake, &pool->lock);
+    if (pool->stop)
+      break;
+
+    QueuedJob* queued = pool->head;
+    pool->head = queued->next;
+    if (!pool->head)
+      pool->tail = NULL;
+    mutex_unlock(&pool->lock);
+
+    queued->job(queued->arg, 0);
+    free(queued);
+
+    mutex_lock(&pool->lock);
+  }
+  mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+WorkerPool* worker_pool_create(uint32_t threads) {
+  WorkerPool* pool = (WorkerPool*)calloc(1, sizeof(WorkerPool));
+  if (!pool)
+    return NULL;
+
+  if (threads == 0)
+    threads = cpu_count();
+  pool->threads = (Thread*)calloc(threads, sizeof(Thread));
+  if (!pool->threads) {
+    free(pool);
+    return NULL;
+  }
+
+  mutex_init(&pool->lock);
+  cond_init(&pool->wake);
+  for (uint32_t i = 0; i < threads; i++) {
+    if (!thread_create(&pool->threads[pool->thread_count], worker_main, pool))
+      break;
+    pool->thread_count++;
+  }
+
+  if (pool->thread_count == 0) {
+    worker_pool_destroy(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+void worker_pool_destroy(WorkerPool* pool) {
+  if (!pool)
+    return;
+
+  mutex_lock(&pool->lock);
+  pool->stop = 1;
+  cond_broadcast(&pool->wake);
+  mutex_unlock(&pool->lock);
+  for (uint32_t i = 0; i < pool->thread_count; i++)
+    thread_join(pool->threads[i]);
+
+  QueuedJob* queued = pool->head;
+  while (queued) {
+    QueuedJob* next = queued->next;
+    queued->job(queued->arg, 1);
+    free(queued);
+    queued = next;
+  }
+
+  cond_destroy(&pool->wake);
+  mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+int worker_pool_submit(WorkerPool* pool, WorkerJob job, void* arg) {
+  QueuedJob* queued = (QueuedJob*)malloc(sizeof(QueuedJob));
+  if (!queued)
+    return 0;
+  queued->job = job;
+  queued->arg = arg;
+  queued->next = NULL;
+
+  mutex_lock(&pool->lock);
+  if (pool->tail)
+    pool->tail->next = queued;
+  else
+    pool->head = queued;
+  pool->tail = queued;
+  cond_signal(&pool->wake);
+  mutex_unlock(&pool->lock);
+  return 1;
+}
+
+uint32_t worker_pool_thread_count(const WorkerPool* pool) {
+  return pool->thread_count;
+}
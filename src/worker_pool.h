@@ -0,0 +1,24 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+
+// A fixed set of below-normal-priority threads draining a FIFO of jobs
+typedef struct WorkerPool WorkerPool;
+
+// Run a job. cancelled is 1 when the pool is being destroyed before the job got to run,
+// in which case the job should only free what it owns
+typedef void (*WorkerJob)(void* arg, int cancelled);
+
+// Start threads workers; 0 means one per CPU. Returns NULL if no thread could be started
+WorkerPool* worker_pool_create(uint32_t threads);
+
+// Let running jobs finish, cancel the queued ones and stop the threads
+void worker_pool_destroy(WorkerPool* pool);
+
+// Queue a job. Returns 1 on success, 0 if out of memory (the job is not run)
+int worker_pool_submit(WorkerPool* pool, WorkerJob job, void* arg);
+
+uint32_t worker_pool_thread_count(const WorkerPool* pool);
+
+#endif  // WORKER_POOL_H
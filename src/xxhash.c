@@ -0,0 +1,113 @@
+#include "xxhash.h"
+
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotate_left(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t read_u64_le(const unsigned char* bytes) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--)
+    value = (value << 8) | bytes[i];
+  return value;
+}
+
+static uint32_t read_u32_le(const unsigned char* bytes) {
+  return ((uint32_t)bytes[0]) | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+         ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t mix_lane(uint64_t lane, uint64_t input) {
+  lane += input * PRIME2;
+  return rotate_left(lane, 31) * PRIME1;
+}
+
+static uint64_t merge_lane(uint64_t hash, uint64_t lane) {
+  hash ^= mix_lane(0, lane);
+  return hash * PRIME1 + PRIME4;
+}
+
+// One 32-byte stripe, a 64-bit word into each lane
+static void consume_stripe(uint64_t lanes[4], const unsigned char* stripe) {
+  for (int i = 0; i < 4; i++)
+    lanes[i] = mix_lane(lanes[i], read_u64_le(stripe + 8 * i));
+}
+
+void xxh64_init(Xxh64* state, uint64_t seed) {
+  memset(state, 0, sizeof(*state));
+  state->seed = seed;
+  state->lanes[0] = seed + PRIME1 + PRIME2;
+  state->lanes[1] = seed + PRIME2;
+  state->lanes[2] = seed;
+  state->lanes[3] = seed - PRIME1;
+}
+
+void xxh64_update(Xxh64* state, const void* bytes, size_t length) {
+  const unsigned char* input = (const unsigned char*)bytes;
+  state->total += length;
+  if (state->buffered + length < sizeof(state->buffer)) {
+    memcpy(state->buffer + state->buffered, input, length);
+    state->buffered += (uint32_t)length;
+    return;
+  }
+
+  if (state->buffered > 0) {
+    size_t fill = sizeof(state->buffer) - state->buffered;
+    memcpy(state->buffer + state->buffered, input, fill);
+    consume_stripe(state->lanes, state->buffer);
+    input += fill;
+    length -= fill;
+    state->buffered = 0;
+  }
+  for (; length >= 32; input += 32, length -= 32)
+    consume_stripe(state->lanes, input);
+  memcpy(state->buffer, input, length);
+  state->buffered = (uint32_t)length;
+}
+
+uint64_t xxh64_digest(const Xxh64* state) {
+  uint64_t hash;
+  if (state->total >= 32) {
+    const uint64_t* lanes = state->lanes;
+    hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+           rotate_left(lanes[3], 18);
+    for (int i = 0; i < 4; i++)
+      hash = merge_lane(hash, lanes[i]);
+  } else {
+    hash = state->seed + PRIME5;
+  }
+  hash += state->total;
+
+  const unsigned char* tail = state->buffer;
+  uint32_t left = state->buffered;
+  for (; left >= 8; tail += 8, left -= 8)
+    hash = rotate_left(hash ^ mix_lane(0, read_u64_le(tail)), 27) * PRIME1 + PRIME4;
+  if (left >= 4) {
+    hash = rotate_left(hash ^ (uint64_t)read_u32_le(tail) * PRIME1, 23) * PRIME2 + PRIME3;
+    tail += 4;
+    left -= 4;
+  }
+  for (; left > 0; tail++, left--)
+    hash = rotate_left(hash ^ *tail * PRIME5, 11) * PRIME1;
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t xxh64(const void* bytes, size_t length, uint64_t seed) {
+  Xxh64 state;
+  xxh64_init(&state, seed);
+  xxh64_update(&state, bytes, length);
+  return xxh64_digest(&state);
+}
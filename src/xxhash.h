@@ -0,0 +1,25 @@
+#ifndef XXHASH_H
+#define XXHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64, fed in pieces: the digest equals xxHash's XXH64() of everything passed to
+// xxh64_update() in order
+typedef struct {
+  uint64_t lanes[4];
+  uint64_t total;  // Bytes fed so far
+  uint64_t seed;
+  unsigned char buffer[32];  // Tail not yet making up a whole stripe
+  uint32_t buffered;
+} Xxh64;
+
+void xxh64_init(Xxh64* state, uint64_t seed);
+
+void xxh64_update(Xxh64* state, const void* bytes, size_t length);
+
+uint64_t xxh64_digest(const Xxh64* state);
+
+uint64_t xxh64(const void* bytes, size_t length, uint64_t seed);
+
+#endif  // XXHASH_H
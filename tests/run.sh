@@ -0,0 +1,14 @@
+#!/usr/bin/env sh
+# Builds the standalone tests into build/ and runs them. They need no GL or vcpkg dependencies.
+set -eu
+
+mkdir -p build
+
+CC="${CC:-cc}"
+CFLAGS="-std=c99 -D_GNU_SOURCE -Wall -Wextra -O2 -Isrc"
+
+set -x
+${CC} ${CFLAGS} -o build/test_mixer tests/test_mixer.c src/mixer.c -lm
+set +x
+
+build/test_mixer
@@ -0,0 +1,77 @@
+// Every mixer kernel set this CPU can run must produce the same samples, ties included.
+#include <stdio.h>
+#include <string.h>
+
+#include "mixer.h"
+
+#define SAMPLES 67  // Not a multiple of 8 or 16, so the SIMD bodies and scalar tails both run
+
+static const char* kernel_names[] = {"scalar", "sse2", "avx2", "neon"};
+
+// Round half to even, written out rather than left to the library under test
+static int16_t expected_sample(float value) {
+  if (value >= 32767.0f)
+    return 32767;
+  if (value <= -32768.0f)
+    return -32768;
+  long whole = (long)value;  // Toward zero
+  float fraction = value - (float)whole;
+  if (fraction > 0.5f || (fraction == 0.5f && (whole & 1)))
+    whole++;
+  else if (fraction < -0.5f || (fraction == -0.5f && (whole & 1)))
+    whole--;
+  return (int16_t)whole;
+}
+
+static int check_kernel(const char* name) {
+  int failures = 0;
+
+  // Clip x.5 values straight from the accumulator
+  float acc[SAMPLES];
+  int16_t out[SAMPLES];
+  for (int i = 0; i < SAMPLES; i++)
+    acc[i] = (float)(i - SAMPLES / 2) + 0.5f;
+  acc[0] = 32766.5f;
+  acc[1] = -32767.5f;
+  acc[2] = 40000.5f;
+  acc[3] = -40000.5f;
+  mix_clip_s16(out, acc, SAMPLES);
+  for (int i = 0; i < SAMPLES; i++) {
+    if (out[i] != expected_sample(acc[i])) {
+      printf("%s: clip(%.1f) = %d, expected %d\n", name, acc[i], out[i], expected_sample(acc[i]));
+      failures++;
+    }
+  }
+
+  // Odd samples at half gain land on x.5, as loudness normalization can
+  int16_t src[SAMPLES];
+  for (int i = 0; i < SAMPLES; i++) {
+    src[i] = (int16_t)(2 * (i - SAMPLES / 2) + 1);
+    acc[i] = 0.0f;
+  }
+  mix_accumulate_s16(acc, src, SAMPLES, 0.5f);
+  mix_clip_s16(out, acc, SAMPLES);
+  for (int i = 0; i < SAMPLES; i++) {
+    int16_t expected = expected_sample((float)src[i] * 0.5f);
+    if (out[i] != expected) {
+      printf("%s: %d at gain 0.5 = %d, expected %d\n", name, src[i], out[i], expected);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+int main(void) {
+  int failures = 0;
+  int checked = 0;
+  for (size_t k = 0; k < sizeof(kernel_names) / sizeof(kernel_names[0]); k++) {
+    if (!mix_force_kernel(kernel_names[k]))
+      continue;
+    failures += check_kernel(kernel_names[k]);
+    checked++;
+  }
+  mix_force_kernel(NULL);
+
+  printf("mixer: %d kernel sets checked, %d mismatches\n", checked, failures);
+  return failures == 0 ? 0 : 1;
+}